@@ -10,6 +10,7 @@
  */
 
 
+#include <deque>
 #include <fstream>
 #include "core/assets/CameraRecorder.hpp"
 #include "core/assets/InputCamera.hpp"
@@ -455,6 +456,15 @@ namespace sibr
 
 		std::cout << "Rendering path with " << _cameras.size() << " cameras to " << outpathd << std::endl;
 
+		// Frames are saved a few frames after being rendered, so that their readback overlaps the next renderings.
+		AsyncReadback readback;
+		std::deque<std::pair<AsyncReadback::Ticket, std::string>> pendingFrames;
+		const auto savePendingFrame = [&]() {
+			readback.retrieve(pendingFrames.front().first, *outImage);
+			outImage->save(pendingFrames.front().second, false);
+			pendingFrames.pop_front();
+		};
+
 		for (int i = 0; i < _cameras.size(); ++i) {
 			outFrame->clear();
 			std::ostringstream ssZeroPad;
@@ -462,8 +472,13 @@ namespace sibr
 			outFileName = outpathd + "/" +  ssZeroPad.str() + ".png";
 			std::cout << outFileName << " " << std::endl;
 			view->onRenderIBR(*outFrame, _cameras[i]);
-			outFrame->readBack(*outImage);
-			outImage->save(outFileName, false);
+			pendingFrames.emplace_back(outFrame->requestReadBack(readback), outFileName);
+			if (pendingFrames.size() >= readback.numBuffers()) {
+				savePendingFrame();
+			}
+		}
+		while (!pendingFrames.empty()) {
+			savePendingFrame();
 		}
 		std::cout << std::endl;
 
@@ -17,6 +17,7 @@
 # include "core/assets/Config.hpp"
 # include "core/assets/IFileLoader.hpp"
 # include "core/assets/ActiveImageFile.hpp"
+# include "core/system/TaskScheduler.hpp"
 
 namespace sibr
 {
@@ -87,10 +88,10 @@ namespace sibr
 		out.resize(_infos.size());
 		if (_infos.empty() == false)
 		{
-			#pragma omp parallel for
-			for (int i = 0; i < _infos.size(); ++i)
+			sibr::parallelFor(0, int(_infos.size()), [&](int i) {
 				if( ac.active()[i] )
 					out[i].load(_basename + "/" + _infos.at(i).filename, false);
+			}, 1);
 		}
 		else
 			SIBR_WRG << "cannot load images (ImageListFile is empty. Did you use ImageListFile::load(...) before ?";
@@ -107,9 +108,9 @@ namespace sibr
 		out.resize(_infos.size());
 		if (_infos.empty() == false)
 		{
-			#pragma omp parallel for
-			for (int i = 0; i < _infos.size(); ++i)
+			sibr::parallelFor(0, int(_infos.size()), [&](int i) {
 				out[i].load(_basename + "/" + _infos.at(i).filename, false);
+			}, 1);
 		}
 		else
 			SIBR_WRG << "cannot load images (ImageListFile is empty. Did you use ImageListFile::load(...) before ?";
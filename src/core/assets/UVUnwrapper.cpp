@@ -12,9 +12,14 @@
 
 #include "UVUnwrapper.hpp"
 #include <core/system/SimpleTimer.hpp>
+#include <core/system/Utils.hpp>
 #include <core/graphics/Utils.hpp>
 #include "xatlas.h"
 
+#include <fstream>
+#include <numeric>
+#include <unordered_map>
+
 int printCallback(const char * format, ...) {
 	va_list args;
 	va_start(args, format);
@@ -98,125 +103,525 @@ void rasterizeTriangle(uint8_t *dest, int destWidth, const int *t0, const int *t
 
 using namespace sibr;
 
+namespace {
+
+	/** Chart and pack a set of triangles with xatlas.
+	 * \param mesh the input mesh
+	 * \param vertexIds the input vertices to use, empty to use all of them
+	 * \param indices the triangle indices, referring to vertexIds if not empty
+	 * \param indexCount the number of indices
+	 * \param packOptions the packing options
+	 * \param verbose display the xatlas progress
+	 * \param result will contain the atlas, mapping refers to the input mesh vertices
+	 */
+	void generateAtlas(const Mesh & mesh, const std::vector<uint> & vertexIds, const uint * indices, size_t indexCount,
+		const xatlas::PackOptions & packOptions, bool verbose, UVUnwrapper::Result & result)
+	{
+		// Gather the vertex attributes of the subset, if any.
+		std::vector<sibr::Vector3f> positions, normals;
+		std::vector<sibr::Vector2f> uvs;
+		if (!vertexIds.empty()) {
+			positions.reserve(vertexIds.size());
+			for (const uint vid : vertexIds) {
+				positions.push_back(mesh.vertices()[vid]);
+				if (mesh.hasNormals()) {
+					normals.push_back(mesh.normals()[vid]);
+				}
+				if (mesh.hasTexCoords()) {
+					uvs.push_back(mesh.texCoords()[vid]);
+				}
+			}
+		}
+		const bool subset = !vertexIds.empty();
+
+		xatlas::Atlas * atlas = xatlas::Create();
+		if (verbose) {
+			xatlas::SetProgressCallback(atlas, progressCallback, nullptr);
+		}
+		xatlas::MeshDecl meshDecl;
+		meshDecl.vertexCount = uint32_t(subset ? positions.size() : mesh.vertices().size());
+		meshDecl.vertexPositionData = subset ? positions[0].data() : mesh.vertexArray();
+		meshDecl.vertexPositionStride = sizeof(sibr::Vector3f);
+		if (mesh.hasNormals()) {
+			meshDecl.vertexNormalData = subset ? normals[0].data() : mesh.normalArray();
+			meshDecl.vertexNormalStride = sizeof(sibr::Vector3f);
+		}
+		// UV can be used as a hint.
+		if (mesh.hasTexCoords()) {
+			meshDecl.vertexUvData = subset ? uvs[0].data() : mesh.texCoordArray();
+			meshDecl.vertexUvStride = sizeof(sibr::Vector2f);
+		}
+		meshDecl.indexCount = uint32_t(indexCount);
+		meshDecl.indexData = indices;
+		meshDecl.indexFormat = xatlas::IndexFormat::UInt32;
+		const xatlas::AddMeshError error = xatlas::AddMesh(atlas, meshDecl, 1);
+		if (error != xatlas::AddMeshError::Success) {
+			xatlas::Destroy(atlas);
+			SIBR_ERR << "\r[UVMapper] Error adding mesh: " << xatlas::StringForEnum(error) << std::endl;
+		}
+		// Not necessary. Only called here so geometry totals are printed after the AddMesh progress indicator
+		xatlas::AddMeshJoin(atlas);
+
+		xatlas::ChartOptions chartOptions = xatlas::ChartOptions();
+		xatlas::Generate(atlas, chartOptions, packOptions);
+		if (verbose) {
+			for (uint32_t i = 0; i < atlas->atlasCount; i++) {
+				SIBR_LOG << "[UVMapper] \tAtlas " << i << ": utilisation: " << atlas->utilization[i] * 100.0f << "%" << std::endl;
+			}
+		}
+
+		result = UVUnwrapper::Result();
+		result.width = atlas->width;
+		result.height = atlas->height;
+		result.chartCount = atlas->chartCount;
+		result.atlasCount = atlas->atlasCount;
+		uint32_t firstVertex = 0;
+		uint32_t firstChart = 0;
+		for (uint32_t i = 0; i < atlas->meshCount; i++) {
+			const xatlas::Mesh& xmesh = atlas->meshes[i];
+			for (uint32_t v = 0; v < xmesh.vertexCount; v++) {
+				const xatlas::Vertex& vertex = xmesh.vertexArray[v];
+				result.mapping.push_back(subset ? vertexIds[vertex.xref] : uint(vertex.xref));
+				result.uvs.emplace_back(vertex.uv[0], vertex.uv[1]);
+			}
+			const size_t firstTriangle = result.triangles.size();
+			for (uint32_t f = 0; f < xmesh.indexCount; f += 3) {
+				result.triangles.emplace_back(firstVertex + xmesh.indexArray[f + 0], firstVertex + xmesh.indexArray[f + 1], firstVertex + xmesh.indexArray[f + 2]);
+			}
+			result.charts.resize(result.triangles.size(), 0);
+			result.atlases.resize(result.triangles.size(), 0);
+			for (uint32_t c = 0; c < xmesh.chartCount; c++) {
+				const xatlas::Chart & chart = xmesh.chartArray[c];
+				for (uint32_t k = 0; k < chart.faceCount; k++) {
+					result.charts[firstTriangle + chart.faceArray[k]] = firstChart + c;
+					result.atlases[firstTriangle + chart.faceArray[k]] = chart.atlasIndex;
+				}
+			}
+			firstVertex += xmesh.vertexCount;
+			firstChart += xmesh.chartCount;
+		}
+		xatlas::Destroy(atlas);
+	}
+
+	/** Split a set of triangles in two along the longest axis of their centroids bounding box.
+	 * \param centroids the triangle centroids
+	 * \param triangles the triangles to split, reordered in place
+	 * \return the size of the first half
+	 */
+	size_t splitTriangles(const std::vector<sibr::Vector3f> & centroids, std::vector<uint> & triangles)
+	{
+		Eigen::AlignedBox3f box;
+		for (const uint tid : triangles) {
+			box.extend(centroids[tid]);
+		}
+		int axis = 0;
+		box.sizes().maxCoeff(&axis);
+		const size_t half = triangles.size() / 2;
+		std::nth_element(triangles.begin(), triangles.begin() + half, triangles.end(), [&centroids, axis](uint a, uint b) {
+			return centroids[a][axis] < centroids[b][axis];
+		});
+		return half;
+	}
+
+	/** \return the area of a 3D triangle. */
+	float triangleArea(const sibr::Vector3f & a, const sibr::Vector3f & b, const sibr::Vector3f & c)
+	{
+		return 0.5f * (b - a).cross(c - a).norm();
+	}
+
+	/** \return the area of a 2D triangle. */
+	float triangleArea(const sibr::Vector2f & a, const sibr::Vector2f & b, const sibr::Vector2f & c)
+	{
+		const sibr::Vector2f ab = b - a;
+		const sibr::Vector2f ac = c - a;
+		return 0.5f * std::abs(ab[0] * ac[1] - ab[1] * ac[0]);
+	}
+
+	/** Compute the quality of an unwrapping.
+	 * \param mesh the input mesh
+	 * \param result the unwrapping
+	 * \param utilization will contain the ratio of atlas texels covered by charts
+	 * \param distortion will contain the area-weighted average of the log deviation of each triangle texel density from the global density
+	 */
+	void unwrapQuality(const Mesh & mesh, const UVUnwrapper::Result & result, double & utilization, double & distortion)
+	{
+		const size_t count = result.triangles.size();
+		std::vector<double> areas3D(count), areasUV(count);
+		double total3D = 0.0, totalUV = 0.0;
+		for (size_t tid = 0; tid < count; ++tid) {
+			const sibr::Vector3u & tri = result.triangles[tid];
+			areas3D[tid] = triangleArea(mesh.vertices()[result.mapping[tri[0]]], mesh.vertices()[result.mapping[tri[1]]], mesh.vertices()[result.mapping[tri[2]]]);
+			areasUV[tid] = triangleArea(result.uvs[tri[0]], result.uvs[tri[1]], result.uvs[tri[2]]);
+			total3D += areas3D[tid];
+			totalUV += areasUV[tid];
+		}
+		const double atlasArea = double(result.width) * double(result.height) * double(std::max(result.atlasCount, 1u));
+		utilization = atlasArea > 0.0 ? totalUV / atlasArea : 0.0;
+		distortion = 0.0;
+		if (total3D <= 0.0 || totalUV <= 0.0) {
+			return;
+		}
+		const double density = totalUV / total3D;
+		for (size_t tid = 0; tid < count; ++tid) {
+			if (areas3D[tid] <= 0.0) {
+				continue;
+			}
+			const double ratio = std::max(areasUV[tid] / areas3D[tid], 1e-6 * density);
+			distortion += areas3D[tid] * std::abs(std::log(ratio / density));
+		}
+		distortion /= total3D;
+	}
+
+}
+
 UVUnwrapper::UVUnwrapper(const sibr::Mesh& mesh, unsigned int res) : _mesh(mesh) {
 	_size = res;
-	// Create empty atlas.
 	xatlas::SetPrint(printCallback, false);
-	_atlas = xatlas::Create();
-	xatlas::SetProgressCallback(_atlas, progressCallback, nullptr);
-
-	// Add the mesh to the atlas.
-	SIBR_LOG << "[UVMapper] Adding one mesh with " << mesh.vertices().size() << " vertices and " << mesh.triangles().size() << " triangles." << std::endl;
-	// For now consider everything as one mesh. Splitting in components *might* help.
-	xatlas::MeshDecl meshDecl;
-	meshDecl.vertexCount = uint32_t(mesh.vertices().size());
-	meshDecl.vertexPositionData = mesh.vertexArray();
-	meshDecl.vertexPositionStride = sizeof(sibr::Vector3f);
-	if (mesh.hasNormals()) {
-		meshDecl.vertexNormalData = mesh.normalArray();
-		meshDecl.vertexNormalStride = sizeof(sibr::Vector3f);
-	}
-	// UV can be used as a hint.
-	if (mesh.hasTexCoords()) {
-		meshDecl.vertexUvData = mesh.texCoordArray();
-		meshDecl.vertexUvStride = sizeof(sibr::Vector2f);
-	}
-	meshDecl.indexCount = uint32_t(mesh.triangles().size() * 3);
-	meshDecl.indexData = mesh.triangleArray();
-	meshDecl.indexFormat = xatlas::IndexFormat::UInt32;
-	const xatlas::AddMeshError error = xatlas::AddMesh(_atlas, meshDecl, 1);
-	if (error != xatlas::AddMeshError::Success) {
-		xatlas::Destroy(_atlas);
-		SIBR_ERR << "\r[UVMapper] Error adding mesh: " << xatlas::StringForEnum(error) << std::endl;
-	}
-	// Not necessary. Only called here so geometry totals are printed after the AddMesh progress indicator
-	xatlas::AddMeshJoin(_atlas);
 }
 
 	
 sibr::Mesh::Ptr UVUnwrapper::unwrap() {
 
+	const std::string cacheFile = cachePath(0);
+	if (!cacheFile.empty() && loadCache(cacheFile)) {
+		SIBR_LOG << "[UVMapper] Loaded cached atlas from " << cacheFile << "." << std::endl;
+		return buildMesh();
+	}
+
+	// Add the mesh to the atlas.
+	SIBR_LOG << "[UVMapper] Adding one mesh with " << _mesh.vertices().size() << " vertices and " << _mesh.triangles().size() << " triangles." << std::endl;
+
 	// Generate atlas.
 	SIBR_LOG << "[UVMapper] Generating atlas.." << std::endl;
 
-	xatlas::ChartOptions chartOptions = xatlas::ChartOptions();
 	xatlas::PackOptions packOptions = xatlas::PackOptions();
 	packOptions.bruteForce = false;
 	packOptions.resolution = uint32_t(_size);
 	Timer timer;
 	timer.tic();
-	xatlas::Generate(_atlas, chartOptions, packOptions);
+	generateAtlas(_mesh, {}, _mesh.triangleArray(), _mesh.triangles().size() * 3, packOptions, true, _result);
 
 	SIBR_LOG << "[UVMapper] Generation took: " << timer.deltaTimeFromLastTic<Timer::s>() << "s." << std::endl;
-	SIBR_LOG << "[UVMapper] Output resolution: " << _atlas->width << "x" << _atlas->height << std::endl;
-	SIBR_LOG << "[UVMapper] Generated " << _atlas->chartCount << " charts, " << _atlas->atlasCount << " atlases." << std::endl;
-	for (uint32_t i = 0; i < _atlas->atlasCount; i++) {
-		SIBR_LOG << "[UVMapper] \tAtlas " << i << ": utilisation: " << _atlas->utilization[i] * 100.0f << "%" << std::endl;
+	if (!cacheFile.empty()) {
+		saveCache(cacheFile);
 	}
+	return buildMesh();
+}
 
+sibr::Mesh::Ptr UVUnwrapper::unwrapPartitioned(uint maxTriangles) {
+	maxTriangles = std::max(maxTriangles, 1u);
+	const std::string cacheFile = cachePath(maxTriangles);
+	if (!cacheFile.empty() && loadCache(cacheFile)) {
+		SIBR_LOG << "[UVMapper] Loaded cached atlas from " << cacheFile << "." << std::endl;
+		return buildMesh();
+	}
 
-	uint32_t totalVertices = 0;
-	uint32_t totalFaces = 0;
-	for (uint32_t i = 0; i < _atlas->meshCount; i++) {
-		const xatlas::Mesh& xmesh = _atlas->meshes[i];
-		totalVertices += xmesh.vertexCount;
-		totalFaces += xmesh.indexCount / 3;
+	Timer timer;
+	timer.tic();
+	const Mesh::Vertices & vertices = _mesh.vertices();
+	const Mesh::Triangles & triangles = _mesh.triangles();
+	const int triangleCount = int(triangles.size());
+
+	// Gather the triangles of each connected component.
+	std::vector<uint> componentSizes;
+	const std::vector<uint> componentIds = _mesh.connectedComponents(&componentSizes);
+	std::vector<std::vector<uint>> components(componentSizes.size());
+	for (size_t cid = 0; cid < components.size(); ++cid) {
+		components[cid].reserve(componentSizes[cid]);
 	}
-	SIBR_LOG << "[UVMapper] Output geometry data: " << totalVertices << " vertices, " << totalFaces << " triangles." << std::endl;
-	// Write meshes.
-	uint32_t firstVertex = 0;
-	std::vector<sibr::Vector3f> positions;
-	std::vector<sibr::Vector3f> normals;
-	std::vector<sibr::Vector2f> texcoords;
-	std::vector<sibr::Vector3f> colors;
-	std::vector<sibr::Vector3u> triangles;
-	
-	// We could preallocate and paraellize if needed.
-	for (uint32_t i = 0; i < _atlas->meshCount; i++) {
-		const xatlas::Mesh& xmesh = _atlas->meshes[i];
-		for (uint32_t v = 0; v < xmesh.vertexCount; v++) {
-			const xatlas::Vertex& vertex = xmesh.vertexArray[v];
-			const sibr::Vector3f& pos = _mesh.vertices()[vertex.xref];
-			positions.emplace_back(pos);
-			if (_mesh.hasNormals()) {
-				const sibr::Vector3f& n = _mesh.normals()[vertex.xref];
-				normals.emplace_back(n);
+	std::vector<sibr::Vector3f> centroids(triangles.size());
+	for (int tid = 0; tid < triangleCount; ++tid) {
+		const sibr::Vector3u & tri = triangles[tid];
+		components[componentIds[tri[0]]].push_back(uint(tid));
+		centroids[tid] = (vertices[tri[0]] + vertices[tri[1]] + vertices[tri[2]]) / 3.0f;
+	}
+	// Unreferenced vertices are empty components at the end.
+	while (!components.empty() && components.back().empty()) {
+		components.pop_back();
+	}
+
+	// Group small components and split large ones, along the longest axis of their centroids.
+	std::vector<sibr::Vector3f> componentCentroids(components.size(), sibr::Vector3f(0.0f, 0.0f, 0.0f));
+	for (size_t cid = 0; cid < components.size(); ++cid) {
+		for (const uint tid : components[cid]) {
+			componentCentroids[cid] += centroids[tid];
+		}
+		componentCentroids[cid] /= float(components[cid].size());
+	}
+	std::vector<std::vector<uint>> clusters;
+	std::vector<std::vector<uint>> componentGroups = { std::vector<uint>(components.size()) };
+	std::iota(componentGroups[0].begin(), componentGroups[0].end(), 0u);
+	while (!componentGroups.empty()) {
+		std::vector<uint> group = std::move(componentGroups.back());
+		componentGroups.pop_back();
+		size_t groupSize = 0;
+		for (const uint cid : group) {
+			groupSize += components[cid].size();
+		}
+		if (groupSize <= maxTriangles) {
+			clusters.emplace_back();
+			for (const uint cid : group) {
+				clusters.back().insert(clusters.back().end(), components[cid].begin(), components[cid].end());
 			}
-			if (_mesh.hasColors()) {
-				const sibr::Vector3f& c = _mesh.colors()[vertex.xref];
-				colors.emplace_back(c);
+			continue;
+		}
+		if (group.size() == 1) {
+			// A single large component, split its triangles.
+			std::vector<std::vector<uint>> parts = { components[group[0]] };
+			while (!parts.empty()) {
+				std::vector<uint> part = std::move(parts.back());
+				parts.pop_back();
+				if (part.size() <= maxTriangles) {
+					clusters.emplace_back(std::move(part));
+					continue;
+				}
+				const size_t half = splitTriangles(centroids, part);
+				parts.emplace_back(part.begin(), part.begin() + half);
+				parts.emplace_back(part.begin() + half, part.end());
+			}
+			continue;
+		}
+		const size_t half = splitTriangles(componentCentroids, group);
+		componentGroups.emplace_back(group.begin(), group.begin() + half);
+		componentGroups.emplace_back(group.begin() + half, group.end());
+	}
+	SIBR_LOG << "[UVMapper] " << components.size() << " connected components, " << clusters.size() << " clusters of at most " << maxTriangles << " triangles." << std::endl;
+
+	// Use the same texel density for all clusters, chosen so that the final atlas is close to the requested size.
+	double totalArea = 0.0;
+	for (const sibr::Vector3u & tri : triangles) {
+		totalArea += triangleArea(vertices[tri[0]], vertices[tri[1]], vertices[tri[2]]);
+	}
+	const float expectedUtilization = 0.7f;
+	xatlas::PackOptions packOptions = xatlas::PackOptions();
+	packOptions.bruteForce = false;
+	packOptions.resolution = 0;
+	packOptions.texelsPerUnit = totalArea > 0.0 ? float(double(_size) * std::sqrt(expectedUtilization / totalArea)) : 1.0f;
+
+	// Chart each cluster separately. Clusters are processed one after the other, xatlas already uses all cores for each of them.
+	std::vector<Result> results(clusters.size());
+	for (int cid = 0; cid < int(clusters.size()); ++cid) {
+		// Compact the cluster vertices.
+		std::unordered_map<uint, uint> localIds;
+		std::vector<uint> vertexIds;
+		std::vector<uint> indices;
+		indices.reserve(clusters[cid].size() * 3);
+		for (const uint tid : clusters[cid]) {
+			for (int k = 0; k < 3; ++k) {
+				const uint vid = triangles[tid][k];
+				const auto inserted = localIds.emplace(vid, uint(vertexIds.size()));
+				if (inserted.second) {
+					vertexIds.push_back(vid);
+				}
+				indices.push_back(inserted.first->second);
+			}
+		}
+		generateAtlas(_mesh, vertexIds, indices.data(), indices.size(), packOptions, false, results[cid]);
+		std::cout << "\r[UVMapper] Charted " << (cid + 1) << "/" << clusters.size() << " clusters." << std::flush;
+	}
+	std::cout << std::endl;
+
+	// Pack the cluster atlases in shelves, tallest first.
+	struct Block {
+		uint cluster;
+		uint atlas;
+		uint x;
+		uint y;
+	};
+	std::vector<Block> blocks;
+	double blocksArea = 0.0;
+	uint maxWidth = 0;
+	for (uint cid = 0; cid < uint(results.size()); ++cid) {
+		for (uint aid = 0; aid < results[cid].atlasCount; ++aid) {
+			blocks.push_back({ cid, aid, 0, 0 });
+			blocksArea += double(results[cid].width) * double(results[cid].height);
+			maxWidth = std::max(maxWidth, results[cid].width);
+		}
+	}
+	std::sort(blocks.begin(), blocks.end(), [&results](const Block & a, const Block & b) {
+		return results[a.cluster].height > results[b.cluster].height;
+	});
+	const uint width = std::max(maxWidth, uint(std::ceil(std::sqrt(blocksArea))));
+	uint shelfX = 0, shelfY = 0, shelfHeight = 0;
+	for (Block & block : blocks) {
+		const Result & res = results[block.cluster];
+		if (shelfX + res.width > width) {
+			shelfY += shelfHeight;
+			shelfX = 0;
+			shelfHeight = 0;
+		}
+		block.x = shelfX;
+		block.y = shelfY;
+		shelfX += res.width;
+		shelfHeight = std::max(shelfHeight, res.height);
+	}
+
+	// Merge the clusters results. The atlas is square, so that texture coordinates are scaled the same way along u and v.
+	_result = Result();
+	_result.width = std::max(width, std::max(shelfY + shelfHeight, 1u));
+	_result.height = _result.width;
+	_result.atlasCount = 1;
+	std::vector<std::vector<sibr::Vector2u>> offsets(results.size());
+	for (const Block & block : blocks) {
+		offsets[block.cluster].resize(results[block.cluster].atlasCount);
+		offsets[block.cluster][block.atlas] = sibr::Vector2u(block.x, block.y);
+	}
+	for (size_t cid = 0; cid < results.size(); ++cid) {
+		const Result & res = results[cid];
+		if (offsets[cid].empty()) {
+			continue;
+		}
+		const uint firstVertex = uint(_result.mapping.size());
+		// A vertex belongs to a single chart, thus to a single atlas.
+		std::vector<uint> vertexAtlas(res.uvs.size(), 0);
+		for (size_t tid = 0; tid < res.triangles.size(); ++tid) {
+			for (int k = 0; k < 3; ++k) {
+				vertexAtlas[res.triangles[tid][k]] = res.atlases[tid];
 			}
-			
-			_mapping.emplace_back(vertex.xref);
-			texcoords.emplace_back(vertex.uv[0] / float(_atlas->width), vertex.uv[1] / float(_atlas->height));
+			_result.triangles.push_back(res.triangles[tid] + sibr::Vector3u(firstVertex, firstVertex, firstVertex));
+			_result.charts.push_back(_result.chartCount + res.charts[tid]);
+			_result.atlases.push_back(0);
 		}
-		for (uint32_t f = 0; f < xmesh.indexCount; f += 3) {
-			const uint32_t i0 = firstVertex + xmesh.indexArray[f + 0];
-			const uint32_t i1 = firstVertex + xmesh.indexArray[f + 1];
-			const uint32_t i2 = firstVertex + xmesh.indexArray[f + 2];
-			triangles.emplace_back(i0, i1, i2);
+		for (size_t vid = 0; vid < res.uvs.size(); ++vid) {
+			_result.mapping.push_back(res.mapping[vid]);
+			_result.uvs.push_back(res.uvs[vid] + offsets[cid][vertexAtlas[vid]].cast<float>());
 		}
-		firstVertex += xmesh.vertexCount;
+		_result.chartCount += res.chartCount;
+	}
+
+	SIBR_LOG << "[UVMapper] Generation took: " << timer.deltaTimeFromLastTic<Timer::s>() << "s." << std::endl;
+	if (!cacheFile.empty()) {
+		saveCache(cacheFile);
+	}
+	return buildMesh();
+}
+
+sibr::Mesh::Ptr UVUnwrapper::buildMesh() const {
+	SIBR_LOG << "[UVMapper] Output resolution: " << _result.width << "x" << _result.height << std::endl;
+	SIBR_LOG << "[UVMapper] Generated " << _result.chartCount << " charts, " << _result.atlasCount << " atlases." << std::endl;
+	SIBR_LOG << "[UVMapper] Output geometry data: " << _result.mapping.size() << " vertices, " << _result.triangles.size() << " triangles." << std::endl;
+
+	// Write meshes.
+	const int vertexCount = int(_result.mapping.size());
+	std::vector<sibr::Vector3f> positions(vertexCount);
+	std::vector<sibr::Vector3f> normals(_mesh.hasNormals() ? vertexCount : 0);
+	std::vector<sibr::Vector2f> texcoords(vertexCount);
+	std::vector<sibr::Vector3f> colors(_mesh.hasColors() ? vertexCount : 0);
+	const sibr::Vector2f scale(1.0f / float(std::max(_result.width, 1u)), 1.0f / float(std::max(_result.height, 1u)));
+
+#pragma omp parallel for
+	for (int v = 0; v < vertexCount; v++) {
+		const uint xref = _result.mapping[v];
+		positions[v] = _mesh.vertices()[xref];
+		if (_mesh.hasNormals()) {
+			normals[v] = _mesh.normals()[xref];
+		}
+		if (_mesh.hasColors()) {
+			colors[v] = _mesh.colors()[xref];
+		}
+		texcoords[v] = _result.uvs[v].cwiseProduct(scale);
 	}
 	Mesh::Ptr finalMesh(new Mesh(false));
 	finalMesh->vertices(positions);
 	finalMesh->normals(normals);
 	finalMesh->texCoords(texcoords);
 	finalMesh->colors(colors);
-	finalMesh->triangles(triangles);
+	finalMesh->triangles(_result.triangles);
 
 	SIBR_LOG << "[UVMapper] Done." << std::endl;
 	return finalMesh;
 }
 
+std::string UVUnwrapper::cachePath(uint maxTriangles) const {
+	if (_cacheDirectory.empty()) {
+		return "";
+	}
+	// FNV-1a hash of the mesh data and the parameters.
+	uint64_t hash = 14695981039346656037ull;
+	const auto hashBytes = [&hash](const void * data, size_t size) {
+		const uint8_t * bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; ++i) {
+			hash = (hash ^ bytes[i]) * 1099511628211ull;
+		}
+	};
+	hashBytes(_mesh.vertices().data(), _mesh.vertices().size() * sizeof(sibr::Vector3f));
+	hashBytes(_mesh.triangles().data(), _mesh.triangles().size() * sizeof(sibr::Vector3u));
+	hashBytes(_mesh.normals().data(), _mesh.normals().size() * sizeof(sibr::Vector3f));
+	hashBytes(_mesh.texCoords().data(), _mesh.texCoords().size() * sizeof(sibr::Vector2f));
+	hashBytes(&_size, sizeof(_size));
+	hashBytes(&maxTriangles, sizeof(maxTriangles));
+	std::stringstream name;
+	name << std::hex << hash;
+	return _cacheDirectory + "/" + name.str() + ".uvatlas";
+}
+
+bool UVUnwrapper::loadCache(const std::string & path) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open()) {
+		return false;
+	}
+	char magic[8];
+	file.read(magic, 8);
+	if (!file || std::string(magic, 8) != "SIBRUV01") {
+		return false;
+	}
+	Result result;
+	uint32_t counts[6];
+	file.read(reinterpret_cast<char*>(counts), sizeof(counts));
+	result.width = counts[0];
+	result.height = counts[1];
+	result.chartCount = counts[2];
+	result.atlasCount = counts[3];
+	result.mapping.resize(counts[4]);
+	result.uvs.resize(counts[4]);
+	result.triangles.resize(counts[5]);
+	result.charts.resize(counts[5]);
+	result.atlases.resize(counts[5]);
+	file.read(reinterpret_cast<char*>(result.mapping.data()), result.mapping.size() * sizeof(uint));
+	file.read(reinterpret_cast<char*>(result.uvs.data()), result.uvs.size() * sizeof(sibr::Vector2f));
+	file.read(reinterpret_cast<char*>(result.triangles.data()), result.triangles.size() * sizeof(sibr::Vector3u));
+	file.read(reinterpret_cast<char*>(result.charts.data()), result.charts.size() * sizeof(uint));
+	file.read(reinterpret_cast<char*>(result.atlases.data()), result.atlases.size() * sizeof(uint));
+	if (!file) {
+		SIBR_WRG << "[UVMapper] Truncated cache file " << path << "." << std::endl;
+		return false;
+	}
+	for (const uint xref : result.mapping) {
+		if (xref >= _mesh.vertices().size()) {
+			SIBR_WRG << "[UVMapper] Invalid cache file " << path << "." << std::endl;
+			return false;
+		}
+	}
+	_result = std::move(result);
+	return true;
+}
+
+void UVUnwrapper::saveCache(const std::string & path) const {
+	makeDirectory(_cacheDirectory);
+	std::ofstream file(path, std::ios::binary);
+	if (!file.is_open()) {
+		SIBR_WRG << "[UVMapper] Unable to write cache file " << path << "." << std::endl;
+		return;
+	}
+	file.write("SIBRUV01", 8);
+	const uint32_t counts[6] = { _result.width, _result.height, _result.chartCount, _result.atlasCount,
+		uint32_t(_result.mapping.size()), uint32_t(_result.triangles.size()) };
+	file.write(reinterpret_cast<const char*>(counts), sizeof(counts));
+	file.write(reinterpret_cast<const char*>(_result.mapping.data()), _result.mapping.size() * sizeof(uint));
+	file.write(reinterpret_cast<const char*>(_result.uvs.data()), _result.uvs.size() * sizeof(sibr::Vector2f));
+	file.write(reinterpret_cast<const char*>(_result.triangles.data()), _result.triangles.size() * sizeof(sibr::Vector3u));
+	file.write(reinterpret_cast<const char*>(_result.charts.data()), _result.charts.size() * sizeof(uint));
+	file.write(reinterpret_cast<const char*>(_result.atlases.data()), _result.atlases.size() * sizeof(uint));
+}
+
 const std::vector<uint>& UVUnwrapper::mapping() const
 {
-	return _mapping;
+	return _result.mapping;
 }
 
 
 std::vector<ImageRGB::Ptr> UVUnwrapper::atlasVisualization() const {
-	if(!_atlas || _atlas->width <= 0 || _atlas->height <= 0) {
+	if(_result.width <= 0 || _result.height <= 0) {
 		SIBR_WRG << "[UVMapper] Atlas has not been created/processed." << std::endl;
 		return {};
 	}
@@ -226,40 +631,38 @@ std::vector<ImageRGB::Ptr> UVUnwrapper::atlasVisualization() const {
 	// Rasterize unwrapped meshes.
 	// \todo port to SIBR image API.
 	std::vector<uint8_t> outputChartsImage;
-	const uint32_t imageDataSize = _atlas->width * _atlas->height * 3;
-	outputChartsImage.resize(_atlas->atlasCount * imageDataSize);
-	for (uint32_t i = 0; i < _atlas->meshCount; i++) {
-		const xatlas::Mesh &xmesh = _atlas->meshes[i];
-		const sibr::Vector3ub white = { 255, 255, 255 };
-		// Rasterize mesh charts.
-		for (uint32_t j = 0; j < xmesh.chartCount; j++) {
-			const xatlas::Chart *chart = &xmesh.chartArray[j];
-			const sibr::Vector3ub color = sibr::randomColor<unsigned char>();
-			for (uint32_t k = 0; k < chart->faceCount; k++) {
-				int verts[3][2];
-				for (int l = 0; l < 3; l++) {
-					const xatlas::Vertex &v = xmesh.vertexArray[xmesh.indexArray[chart->faceArray[k] * 3 + l]];
-					verts[l][0] = int(v.uv[0]);
-					verts[l][1] = int(v.uv[1]);
-				}
-				uint8_t *imageData = &outputChartsImage[chart->atlasIndex * imageDataSize];
-				rasterizeTriangle(imageData, _atlas->width, verts[0], verts[1], verts[2], color);
-				rasterizeLine(imageData, _atlas->width, verts[0], verts[1], white);
-				rasterizeLine(imageData, _atlas->width, verts[1], verts[2], white);
-				rasterizeLine(imageData, _atlas->width, verts[2], verts[0], white);
-			}
+	const size_t imageDataSize = size_t(_result.width) * size_t(_result.height) * 3;
+	outputChartsImage.resize(_result.atlasCount * imageDataSize);
+	const sibr::Vector3ub white = { 255, 255, 255 };
+	std::vector<sibr::Vector3ub> chartColors(_result.chartCount);
+	for (sibr::Vector3ub & color : chartColors) {
+		color = sibr::randomColor<unsigned char>();
+	}
+	// Rasterize mesh charts.
+	for (size_t tid = 0; tid < _result.triangles.size(); ++tid) {
+		int verts[3][2];
+		for (int l = 0; l < 3; l++) {
+			const sibr::Vector2f & uv = _result.uvs[_result.triangles[tid][l]];
+			verts[l][0] = int(uv[0]);
+			verts[l][1] = int(uv[1]);
 		}
+		const sibr::Vector3ub & color = chartColors[_result.charts[tid]];
+		uint8_t *imageData = &outputChartsImage[_result.atlases[tid] * imageDataSize];
+		rasterizeTriangle(imageData, _result.width, verts[0], verts[1], verts[2], color);
+		rasterizeLine(imageData, _result.width, verts[0], verts[1], white);
+		rasterizeLine(imageData, _result.width, verts[1], verts[2], white);
+		rasterizeLine(imageData, _result.width, verts[2], verts[0], white);
 	}
 	
 	// Convert raw vectors to images.
-	std::vector<ImageRGB::Ptr> views(_atlas->meshCount);
-	for (uint32_t i = 0; i < _atlas->meshCount; i++) {
-		views[i].reset(new ImageRGB(_atlas->width, _atlas->height));
+	std::vector<ImageRGB::Ptr> views(_result.atlasCount);
+	for (uint32_t i = 0; i < _result.atlasCount; i++) {
+		views[i].reset(new ImageRGB(_result.width, _result.height));
 		uint8_t *imageData = &outputChartsImage[i * imageDataSize];
 #pragma omp parallel for
-		for(int y = 0; y < int(_atlas->height); ++y) {
-			for(int x = 0; x < int(_atlas->width); ++x) {
-				const size_t baseId = (y * _atlas->width + x)*3;
+		for(int y = 0; y < int(_result.height); ++y) {
+			for(int x = 0; x < int(_result.width); ++x) {
+				const size_t baseId = (size_t(y) * _result.width + x)*3;
 				for(int j = 0; j < 3; ++j) {
 					views[i](x, y)[j] = imageData[baseId + j];
 				}		
@@ -270,7 +673,25 @@ std::vector<ImageRGB::Ptr> UVUnwrapper::atlasVisualization() const {
 	return views;
 }
 
-UVUnwrapper::~UVUnwrapper() {
-	xatlas::Destroy(_atlas);
+void UVUnwrapper::benchmark(const sibr::Mesh & mesh, unsigned int res, const std::vector<uint> & clusterSizes) {
+	std::vector<uint> configs = { 0 };
+	configs.insert(configs.end(), clusterSizes.begin(), clusterSizes.end());
+	std::stringstream report;
+	for (const uint config : configs) {
+		UVUnwrapper unwrapper(mesh, res);
+		Timer timer;
+		timer.tic();
+		if (config == 0) {
+			unwrapper.unwrap();
+		} else {
+			unwrapper.unwrapPartitioned(config);
+		}
+		const double time = timer.deltaTimeFromLastTic<Timer::s>();
+		double utilization = 0.0, distortion = 0.0;
+		unwrapQuality(mesh, unwrapper._result, utilization, distortion);
+		report << "\t" << (config == 0 ? std::string("whole mesh") : ("clusters of " + std::to_string(config))) << ": " << time << "s, "
+			<< unwrapper._result.chartCount << " charts, " << unwrapper._result.width << "x" << unwrapper._result.height << " x" << unwrapper._result.atlasCount << ", utilization "
+			<< utilization * 100.0 << "%, area distortion " << distortion << std::endl;
+	}
+	SIBR_LOG << "[UVMapper] Benchmark on " << mesh.triangles().size() << " triangles:\n" << report.str();
 }
-
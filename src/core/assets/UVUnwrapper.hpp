@@ -15,14 +15,11 @@
 #include <core/assets/Config.hpp>
 #include <core/graphics/Mesh.hpp>
 
-namespace xatlas {
-	struct Atlas;
-}
-
 namespace sibr
 {
 	/** Unwraps a mesh onto a plane, generating texture coordinates for each vertex.
-	 * Internaly relies on xatlas for unwrapping.
+	 * Internaly relies on xatlas for unwrapping. Large meshes can be split in spatial clusters that are charted in parallel
+	 * and packed together, and results can be cached on disk.
 	\ingroup sibr_assets
 	*/
 	class SIBR_ASSETS_EXPORT UVUnwrapper {
@@ -39,6 +36,19 @@ namespace sibr
 		 */
 		sibr::Mesh::Ptr unwrap();
 
+		/** Unwrap the mesh by clusters: connected components are grouped or split along their longest axis until each cluster
+		 * has at most maxTriangles triangles, clusters are charted in parallel with the same texel density, and the cluster
+		 * atlases are then packed together.
+		 * \param maxTriangles maximum number of triangles in a cluster
+		 * \return the unwrapped mesh
+		 */
+		sibr::Mesh::Ptr unwrapPartitioned(uint maxTriangles);
+
+		/** Set the directory where results are cached, keyed by a hash of the mesh and the unwrapping parameters.
+		 * \param directory the cache directory, empty to disable caching
+		 */
+		void setCacheDirectory(const std::string & directory) { _cacheDirectory = directory; }
+
 		/** For each vertex of the unwrapped mesh, the mapping give the index of the corresponding vertex in the input mesh.
 		 * \return a reference to the mapping vector
 		 */
@@ -49,15 +59,54 @@ namespace sibr
 		 */
 		std::vector<ImageRGB::Ptr> atlasVisualization() const;
 
-		/// Destructor.
-		~UVUnwrapper();
-		
+		/** Compare the whole mesh unwrapping with partitioned unwrappings, logging timings, chart counts, atlas utilization and area distortion.
+		 * \param mesh the mesh to unwrap
+		 * \param res the target texture width
+		 * \param clusterSizes the maximum number of triangles per cluster to test
+		 */
+		static void benchmark(const sibr::Mesh & mesh, unsigned int res, const std::vector<uint> & clusterSizes = { 50000, 200000, 1000000 });
+
+		/** Unwrapping result, UVs are expressed in texels. */
+		struct Result {
+			std::vector<uint> mapping; ///< Mapping from the new vertices to the old (some might be duplicated with different UV values).
+			std::vector<sibr::Vector2f> uvs; ///< UV of each new vertex, in texels.
+			std::vector<sibr::Vector3u> triangles; ///< New triangles.
+			std::vector<uint> charts; ///< Chart of each triangle.
+			std::vector<uint> atlases; ///< Atlas of each triangle.
+			uint width = 0; ///< Atlas width.
+			uint height = 0; ///< Atlas height.
+			uint chartCount = 0; ///< Number of charts.
+			uint atlasCount = 0; ///< Number of atlases.
+		};
+
 	private:
-		
+
+		/** Build the final mesh from the result.
+		 * \return the unwrapped mesh
+		 */
+		sibr::Mesh::Ptr buildMesh() const;
+
+		/** Generate the path of the cache file for a given unwrapping mode.
+		 * \param maxTriangles the maximum cluster size, 0 for the whole mesh
+		 * \return the path, empty if caching is disabled
+		 */
+		std::string cachePath(uint maxTriangles) const;
+
+		/** Load the result from the cache.
+		 * \param path the cache file
+		 * \return true if the result was loaded
+		 */
+		bool loadCache(const std::string & path);
+
+		/** Save the result to the cache.
+		 * \param path the cache file
+		 */
+		void saveCache(const std::string & path) const;
+
 		const sibr::Mesh& _mesh; ///< Unwrapped mesh.
 		unsigned int _size; ///< Width of the atlas, detemrine the accuracy of the estimated UVs.
-		xatlas::Atlas* _atlas; ///< Atlas object.
-		std::vector<uint> _mapping; ///< Mapping from the new vertices to the old (some might be duplicated with different UV values).
+		Result _result; ///< Unwrapped geometry.
+		std::string _cacheDirectory; ///< Cache location, empty if disabled.
 		
 	};
 }
@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#include "core/graphics/AsyncReadback.hpp"
+#include "core/graphics/RenderTarget.hpp"
+#include "core/system/SimpleTimer.hpp"
+
+#include <cstring>
+#include <deque>
+
+namespace sibr
+{
+	AsyncReadback::AsyncReadback(uint numBuffers)
+		: _numBuffers(std::max(numBuffers, 1u))
+	{
+	}
+
+	AsyncReadback::~AsyncReadback()
+	{
+		for (Slot & slot : _slots) {
+			if (slot.fence) {
+				glDeleteSync(slot.fence);
+			}
+			glDeleteBuffers(1, &slot.pbo);
+		}
+	}
+
+	AsyncReadback::Ticket AsyncReadback::request(GLuint fbo, GLenum attachment, uint w, uint h, GLenum format, GLenum type, int cvType)
+	{
+		if (_slots.empty()) {
+			_slots.resize(_numBuffers);
+		}
+		Slot & slot = _slots[_nextSlot];
+		_nextSlot = (_nextSlot + 1) % _numBuffers;
+
+		// The ring is full: keep the oldest result on the CPU side.
+		if (slot.ticket != 0) {
+			resolve(slot, _resolved[slot.ticket]);
+		}
+
+		const size_t bytes = size_t(w) * size_t(h) * CV_ELEM_SIZE(cvType);
+		if (slot.pbo == 0) {
+			glGenBuffers(1, &slot.pbo);
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+		if (bytes > slot.capacity) {
+			glBufferData(GL_PIXEL_PACK_BUFFER, GLsizeiptr(bytes), nullptr, GL_STREAM_READ);
+			slot.capacity = bytes;
+		}
+
+		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+		if (format != GL_DEPTH_COMPONENT) {
+			glReadBuffer(attachment);
+		}
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glReadPixels(0, 0, GLsizei(w), GLsizei(h), format, type, nullptr);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		// Submit the copy now, it is then done while the next frames are prepared.
+		glFlush();
+		slot.ticket = _nextTicket++;
+		slot.w = w;
+		slot.h = h;
+		slot.cvType = cvType;
+		CHECK_GL_ERROR;
+		return slot.ticket;
+	}
+
+	bool AsyncReadback::ready(Ticket ticket) const
+	{
+		if (_resolved.count(ticket) > 0) {
+			return true;
+		}
+		for (const Slot & slot : _slots) {
+			if (slot.ticket == ticket) {
+				GLint status = GL_UNSIGNALED;
+				glGetSynciv(slot.fence, GL_SYNC_STATUS, 1, nullptr, &status);
+				return status == GL_SIGNALED;
+			}
+		}
+		return false;
+	}
+
+	bool AsyncReadback::retrieve(Ticket ticket, cv::Mat & image)
+	{
+		const auto resolved = _resolved.find(ticket);
+		if (resolved != _resolved.end()) {
+			image = resolved->second;
+			_resolved.erase(resolved);
+			return true;
+		}
+		for (Slot & slot : _slots) {
+			if (ticket != 0 && slot.ticket == ticket) {
+				resolve(slot, image);
+				return true;
+			}
+		}
+		SIBR_WRG << "[AsyncReadback] Unknown readback ticket " << ticket << "." << std::endl;
+		return false;
+	}
+
+	size_t AsyncReadback::pending() const
+	{
+		size_t count = _resolved.size();
+		for (const Slot & slot : _slots) {
+			count += slot.ticket != 0 ? 1 : 0;
+		}
+		return count;
+	}
+
+	void AsyncReadback::release()
+	{
+		for (Slot & slot : _slots) {
+			if (slot.ticket != 0) {
+				resolve(slot, _resolved[slot.ticket]);
+			}
+			glDeleteBuffers(1, &slot.pbo);
+		}
+		_slots.clear();
+		_nextSlot = 0;
+	}
+
+	void AsyncReadback::resolve(Slot & slot, cv::Mat & image)
+	{
+		GLenum status;
+		do {
+			status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+		} while (status == GL_TIMEOUT_EXPIRED);
+		glDeleteSync(slot.fence);
+		slot.fence = 0;
+
+		image = cv::Mat(int(slot.h), int(slot.w), slot.cvType);
+		const size_t rowBytes = size_t(slot.w) * CV_ELEM_SIZE(slot.cvType);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+		const uchar * mapped = static_cast<const uchar*>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, GLsizeiptr(rowBytes * slot.h), GL_MAP_READ_BIT));
+		if (mapped) {
+			// OpenGL rows start at the bottom.
+			for (uint y = 0; y < slot.h; ++y) {
+				std::memcpy(image.ptr<uchar>(int(slot.h - 1 - y)), mapped + y * rowBytes, rowBytes);
+			}
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		} else {
+			SIBR_WRG << "[AsyncReadback] Unable to map readback buffer." << std::endl;
+			image.setTo(cv::Scalar::all(0));
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		slot.ticket = 0;
+		CHECK_GL_ERROR;
+	}
+
+	void AsyncReadback::benchmark(uint w, uint h, uint numFrames, uint numBuffers)
+	{
+		RenderTargetRGB rt(w, h);
+		// Clearing does not rescale 8-bit values, each channel is either 0 or 1.
+		const auto colorOf = [](uint frame) {
+			return Vector3ub(uchar(frame & 1), uchar((frame >> 1) & 1), uchar((frame >> 2) & 1));
+		};
+
+		ImageRGB image;
+		uint errors = 0;
+		Timer timer(true);
+		for (uint f = 0; f < numFrames; ++f) {
+			rt.clear(colorOf(f));
+			rt.readBack(image);
+		}
+		glFinish();
+		const double syncTime = timer.deltaTimeFromLastTic<Timer::micro>() * 1e-6;
+
+		AsyncReadback readback(numBuffers);
+		std::deque<std::pair<uint, Ticket>> inFlight;
+		const auto check = [&](uint frame, Ticket ticket) {
+			readback.retrieve(ticket, image);
+			errors += image(w / 2, h / 2) != ImageRGB::Pixel(colorOf(frame) * uchar(255)) ? 1 : 0;
+		};
+		timer.tic();
+		for (uint f = 0; f < numFrames; ++f) {
+			rt.clear(colorOf(f));
+			inFlight.emplace_back(f, rt.requestReadBack(readback));
+			// Only wait for frames that were requested numBuffers frames ago.
+			if (inFlight.size() >= readback.numBuffers()) {
+				check(inFlight.front().first, inFlight.front().second);
+				inFlight.pop_front();
+			}
+		}
+		for (const auto & frame : inFlight) {
+			check(frame.first, frame.second);
+		}
+		const double asyncTime = timer.deltaTimeFromLastTic<Timer::micro>() * 1e-6;
+
+		SIBR_LOG << "[AsyncReadback] " << numFrames << " frames of " << w << "x" << h << ": synchronous " << double(numFrames) / std::max(syncTime, 1e-9)
+			<< " fps, asynchronous (" << numBuffers << " buffers) " << double(numFrames) / std::max(asyncTime, 1e-9) << " fps, "
+			<< errors << " wrong frames." << std::endl;
+	}
+
+} // namespace sibr
@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+# include "core/graphics/Config.hpp"
+# include "core/graphics/Image.hpp"
+
+# include <map>
+
+namespace sibr
+{
+	/** \brief Asynchronous framebuffer readback through a ring of pixel pack buffers.
+	* A request copies a framebuffer attachment into a buffer on the GPU side and returns immediately with a ticket.
+	* The data is mapped and copied to the CPU only when the ticket is retrieved, ideally a few frames later, so that
+	* readbacks overlap rendering instead of stalling the pipeline. When all buffers are in flight, the oldest readback
+	* is resolved to CPU memory to free its buffer; its ticket stays valid.
+	* Retrieved images are flipped so that their first row is the top of the framebuffer, as with RenderTarget::readBack.
+	* \warning All functions must be called from the thread owning the OpenGL context.
+	* \sa RenderTarget::requestReadBack
+	* \ingroup sibr_graphics
+	*/
+	class SIBR_GRAPHICS_EXPORT AsyncReadback
+	{
+		SIBR_DISALLOW_COPY(AsyncReadback);
+		SIBR_CLASS_PTR(AsyncReadback);
+
+	public:
+
+		/** Readback identifier, 0 is never a valid ticket. */
+		typedef uint64_t Ticket;
+
+		/** Constructor, buffers are allocated on first use.
+		\param numBuffers number of readbacks that can be in flight on the GPU
+		*/
+		explicit AsyncReadback(uint numBuffers = 3);
+
+		/** Destructor, frees the GPU buffers. */
+		~AsyncReadback();
+
+		/** Start reading a framebuffer attachment.
+		\param fbo the framebuffer handle
+		\param attachment the color attachment to read (GL_COLOR_ATTACHMENT0 + i), ignored for depth formats
+		\param w the width of the region to read
+		\param h the height of the region to read
+		\param format the GL pixel format to read
+		\param type the GL component type to read
+		\param cvType the matching OpenCV matrix type
+		\return the ticket to use to retrieve the result
+		*/
+		Ticket request(GLuint fbo, GLenum attachment, uint w, uint h, GLenum format, GLenum type, int cvType);
+
+		/** Check if a readback is done on the GPU, without blocking.
+		\param ticket the readback ticket
+		\return true if the data can be retrieved without waiting
+		*/
+		bool ready(Ticket ticket) const;
+
+		/** Get the result of a readback, waiting for the GPU if needed. The ticket is then invalid.
+		\param ticket the readback ticket
+		\param image will contain the pixels, with the OpenCV type given at request time
+		\return false if the ticket is unknown
+		*/
+		bool retrieve(Ticket ticket, cv::Mat & image);
+
+		/** Get the result of a readback as an image, converting the pixels if needed. The ticket is then invalid.
+		\param ticket the readback ticket
+		\param image will contain the pixels
+		\return false if the ticket is unknown
+		*/
+		template<typename T_Type, unsigned int T_NumComp>
+		bool retrieve(Ticket ticket, Image<T_Type, T_NumComp> & image) {
+			cv::Mat pixels;
+			if (!retrieve(ticket, pixels)) {
+				return false;
+			}
+			image.fromOpenCV(pixels);
+			return true;
+		}
+
+		/** \return the number of readbacks requested and not retrieved yet. */
+		size_t pending() const;
+
+		/** \return the number of readbacks that can be in flight on the GPU. */
+		uint numBuffers() const { return _numBuffers; }
+
+		/** Resolve the pending readbacks to CPU memory and free the GPU buffers. */
+		void release();
+
+		/** Compare synchronous and asynchronous readbacks of a rendertarget cleared with a different color every frame.
+		\param w the rendertarget width
+		\param h the rendertarget height
+		\param numFrames the number of frames to capture
+		\param numBuffers the number of readbacks in flight for the asynchronous version
+		\warning An OpenGL context must be current.
+		*/
+		static void benchmark(uint w = 1920, uint h = 1080, uint numFrames = 300, uint numBuffers = 3);
+
+	private:
+
+		/** Pixel pack buffer and the readback it holds. */
+		struct Slot {
+			GLuint pbo = 0; ///< Buffer handle.
+			size_t capacity = 0; ///< Buffer size in bytes.
+			GLsync fence = 0; ///< Signaled when the copy to the buffer is done.
+			Ticket ticket = 0; ///< Readback stored in the buffer, 0 if free.
+			uint w = 0; ///< Region width.
+			uint h = 0; ///< Region height.
+			int cvType = 0; ///< OpenCV type of the pixels.
+		};
+
+		/** Wait for a readback and copy it to the CPU, freeing its slot.
+		\param slot the slot to resolve
+		\param image will contain the pixels
+		*/
+		static void resolve(Slot & slot, cv::Mat & image);
+
+		uint _numBuffers; ///< Number of slots in the ring.
+		std::vector<Slot> _slots; ///< Buffers ring.
+		uint _nextSlot = 0; ///< Next slot to use.
+		Ticket _nextTicket = 1; ///< Next ticket to give.
+		std::map<Ticket, cv::Mat> _resolved; ///< Readbacks moved to the CPU before being retrieved.
+	};
+
+} // namespace sibr
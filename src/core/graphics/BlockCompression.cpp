@@ -0,0 +1,803 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#include "core/graphics/BlockCompression.hpp"
+#include "core/system/SimpleTimer.hpp"
+
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <sstream>
+
+namespace sibr
+{
+	namespace {
+
+		/** RGBA pixels of a 4x4 block, row-major. */
+		typedef uchar Block[16][4];
+
+		/** BC7 4-bit interpolation weights, out of 64. */
+		const int bc7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+		template<typename T>
+		T clampValue(T value, T low, T high)
+		{
+			return std::min(std::max(value, low), high);
+		}
+
+		/** Read a block, clamping coordinates to the image and expanding to RGBA. */
+		void fetchBlock(const cv::Mat & image, int bx, int by, Block & px)
+		{
+			const int ch = image.channels();
+			for (int y = 0; y < 4; ++y) {
+				const uchar * row = image.ptr<uchar>(std::min(by * 4 + y, image.rows - 1));
+				for (int x = 0; x < 4; ++x) {
+					const uchar * p = row + std::min(bx * 4 + x, image.cols - 1) * ch;
+					uchar * d = px[y * 4 + x];
+					if (ch >= 3) {
+						d[0] = p[0]; d[1] = p[1]; d[2] = p[2]; d[3] = ch == 4 ? p[3] : 255;
+					} else if (ch == 2) {
+						d[0] = p[0]; d[1] = p[1]; d[2] = 0; d[3] = 255;
+					} else {
+						d[0] = d[1] = d[2] = p[0]; d[3] = 255;
+					}
+				}
+			}
+		}
+
+		/** Fit a segment to N-dimensional points along their principal axis.
+		\param pts the points, only the first N components are used
+		\param e0 will contain the endpoint with the highest projection
+		\param e1 will contain the endpoint with the lowest projection
+		*/
+		template<int N>
+		void fitEndpoints(const float pts[16][4], float e0[4], float e1[4])
+		{
+			float mean[N] = { 0.0f };
+			for (int i = 0; i < 16; ++i) {
+				for (int c = 0; c < N; ++c) {
+					mean[c] += pts[i][c] / 16.0f;
+				}
+			}
+			float cov[N][N] = { { 0.0f } };
+			for (int i = 0; i < 16; ++i) {
+				for (int a = 0; a < N; ++a) {
+					for (int b = 0; b < N; ++b) {
+						cov[a][b] += (pts[i][a] - mean[a]) * (pts[i][b] - mean[b]);
+					}
+				}
+			}
+			// Power iterations, starting from the direction with the largest variance.
+			int start = 0;
+			for (int c = 1; c < N; ++c) {
+				start = cov[c][c] > cov[start][start] ? c : start;
+			}
+			float axis[N];
+			for (int c = 0; c < N; ++c) {
+				axis[c] = cov[start][c];
+			}
+			for (int it = 0; it < 8; ++it) {
+				float next[N] = { 0.0f };
+				float norm = 0.0f;
+				for (int a = 0; a < N; ++a) {
+					for (int b = 0; b < N; ++b) {
+						next[a] += cov[a][b] * axis[b];
+					}
+					norm += next[a] * next[a];
+				}
+				norm = std::sqrt(norm);
+				if (norm < 1e-8f) {
+					break;
+				}
+				for (int c = 0; c < N; ++c) {
+					axis[c] = next[c] / norm;
+				}
+			}
+			float norm = 0.0f;
+			for (int c = 0; c < N; ++c) {
+				norm += axis[c] * axis[c];
+			}
+			if (norm < 1e-8f) {
+				for (int c = 0; c < N; ++c) {
+					e0[c] = e1[c] = mean[c];
+				}
+				return;
+			}
+			norm = std::sqrt(norm);
+			float tMin = 1e10f, tMax = -1e10f;
+			for (int i = 0; i < 16; ++i) {
+				float t = 0.0f;
+				for (int c = 0; c < N; ++c) {
+					t += (pts[i][c] - mean[c]) * axis[c] / norm;
+				}
+				tMin = std::min(tMin, t);
+				tMax = std::max(tMax, t);
+			}
+			for (int c = 0; c < N; ++c) {
+				e0[c] = clampValue(mean[c] + axis[c] / norm * tMax, 0.0f, 255.0f);
+				e1[c] = clampValue(mean[c] + axis[c] / norm * tMin, 0.0f, 255.0f);
+			}
+		}
+
+		/** Least squares endpoints given the interpolation parameter of each pixel.
+		\param pts the points
+		\param t the position of each point between e0 (0) and e1 (1)
+		\param e0 will contain the first endpoint
+		\param e1 will contain the second endpoint
+		\return false if the system is degenerate
+		*/
+		template<int N>
+		bool refineEndpoints(const float pts[16][4], const float t[16], float e0[4], float e1[4])
+		{
+			float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+			float ax[N] = { 0.0f }, bx[N] = { 0.0f };
+			for (int i = 0; i < 16; ++i) {
+				const float a = 1.0f - t[i], b = t[i];
+				aa += a * a;
+				ab += a * b;
+				bb += b * b;
+				for (int c = 0; c < N; ++c) {
+					ax[c] += a * pts[i][c];
+					bx[c] += b * pts[i][c];
+				}
+			}
+			const float det = aa * bb - ab * ab;
+			if (std::abs(det) < 1e-6f) {
+				return false;
+			}
+			for (int c = 0; c < N; ++c) {
+				e0[c] = clampValue((bb * ax[c] - ab * bx[c]) / det, 0.0f, 255.0f);
+				e1[c] = clampValue((aa * bx[c] - ab * ax[c]) / det, 0.0f, 255.0f);
+			}
+			return true;
+		}
+
+		/** Append bits to a little-endian bit stream. */
+		class BitWriter
+		{
+		public:
+			explicit BitWriter(uchar * out) : _out(out) {}
+			void write(uint value, int count) {
+				for (int b = 0; b < count; ++b, ++_pos) {
+					_out[_pos >> 3] |= uchar(((value >> b) & 1u) << (_pos & 7));
+				}
+			}
+		private:
+			uchar * _out;
+			int _pos = 0;
+		};
+
+		/** Read bits from a little-endian bit stream. */
+		class BitReader
+		{
+		public:
+			explicit BitReader(const uchar * in) : _in(in) {}
+			uint read(int count) {
+				uint value = 0;
+				for (int b = 0; b < count; ++b, ++_pos) {
+					value |= uint((_in[_pos >> 3] >> (_pos & 7)) & 1u) << b;
+				}
+				return value;
+			}
+		private:
+			const uchar * _in;
+			int _pos = 0;
+		};
+
+		// --- BC1 ---------------------------------------------------------
+
+		uint16_t to565(const float c[4])
+		{
+			const int r = clampValue(int(c[0] * 31.0f / 255.0f + 0.5f), 0, 31);
+			const int g = clampValue(int(c[1] * 63.0f / 255.0f + 0.5f), 0, 63);
+			const int b = clampValue(int(c[2] * 31.0f / 255.0f + 0.5f), 0, 31);
+			return uint16_t((r << 11) | (g << 5) | b);
+		}
+
+		void from565(uint16_t v, int c[3])
+		{
+			const int r = (v >> 11) & 31, g = (v >> 5) & 63, b = v & 31;
+			c[0] = (r << 3) | (r >> 2);
+			c[1] = (g << 2) | (g >> 4);
+			c[2] = (b << 3) | (b >> 2);
+		}
+
+		/** BC1 four colors palette, endpoints must be ordered (q0 > q1). */
+		void bc1Palette(uint16_t q0, uint16_t q1, int pal[4][3])
+		{
+			from565(q0, pal[0]);
+			from565(q1, pal[1]);
+			for (int c = 0; c < 3; ++c) {
+				pal[2][c] = (2 * pal[0][c] + pal[1][c]) / 3;
+				pal[3][c] = (pal[0][c] + 2 * pal[1][c]) / 3;
+			}
+		}
+
+		/** Choose the BC1 indices for ordered endpoints, or equal endpoints (all indices 0).
+		\return the squared error
+		*/
+		int bc1Indices(const Block & px, uint16_t q0, uint16_t q1, uint & indices)
+		{
+			int pal[4][3];
+			bc1Palette(q0, q1, pal);
+			const int numColors = q0 == q1 ? 1 : 4;
+			indices = 0;
+			int error = 0;
+			for (int i = 0; i < 16; ++i) {
+				int best = 0, bestErr = INT_MAX;
+				for (int k = 0; k < numColors; ++k) {
+					const int dr = px[i][0] - pal[k][0], dg = px[i][1] - pal[k][1], db = px[i][2] - pal[k][2];
+					const int err = dr * dr + dg * dg + db * db;
+					if (err < bestErr) {
+						bestErr = err;
+						best = k;
+					}
+				}
+				indices |= uint(best) << (2 * i);
+				error += bestErr;
+			}
+			return error;
+		}
+
+		void encodeBC1(const Block & px, uchar * out)
+		{
+			float pts[16][4];
+			for (int i = 0; i < 16; ++i) {
+				for (int c = 0; c < 4; ++c) {
+					pts[i][c] = float(px[i][c]);
+				}
+			}
+			float e0[4], e1[4];
+			fitEndpoints<3>(pts, e0, e1);
+
+			static const float bc1T[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+			uint16_t best0 = 0, best1 = 0;
+			uint bestIndices = 0;
+			int bestError = INT_MAX;
+			for (int it = 0; it < 3; ++it) {
+				uint16_t q0 = to565(e0), q1 = to565(e1);
+				if (q0 < q1) {
+					std::swap(q0, q1);
+				}
+				uint indices;
+				const int error = bc1Indices(px, q0, q1, indices);
+				if (error < bestError) {
+					bestError = error;
+					best0 = q0;
+					best1 = q1;
+					bestIndices = indices;
+				}
+				if (error == 0 || q0 == q1) {
+					break;
+				}
+				float t[16];
+				for (int i = 0; i < 16; ++i) {
+					t[i] = bc1T[(indices >> (2 * i)) & 3];
+				}
+				if (!refineEndpoints<3>(pts, t, e0, e1)) {
+					break;
+				}
+			}
+			out[0] = uchar(best0 & 0xFF); out[1] = uchar(best0 >> 8);
+			out[2] = uchar(best1 & 0xFF); out[3] = uchar(best1 >> 8);
+			for (int b = 0; b < 4; ++b) {
+				out[4 + b] = uchar((bestIndices >> (8 * b)) & 0xFF);
+			}
+		}
+
+		void decodeBC1(const uchar * in, Block & px)
+		{
+			const uint16_t q0 = uint16_t(in[0] | (in[1] << 8)), q1 = uint16_t(in[2] | (in[3] << 8));
+			int pal[4][3];
+			from565(q0, pal[0]);
+			from565(q1, pal[1]);
+			int alpha3 = 255;
+			for (int c = 0; c < 3; ++c) {
+				if (q0 > q1) {
+					pal[2][c] = (2 * pal[0][c] + pal[1][c]) / 3;
+					pal[3][c] = (pal[0][c] + 2 * pal[1][c]) / 3;
+				} else {
+					pal[2][c] = (pal[0][c] + pal[1][c]) / 2;
+					pal[3][c] = 0;
+					alpha3 = 0;
+				}
+			}
+			const uint indices = uint(in[4]) | (uint(in[5]) << 8) | (uint(in[6]) << 16) | (uint(in[7]) << 24);
+			for (int i = 0; i < 16; ++i) {
+				const uint k = (indices >> (2 * i)) & 3;
+				px[i][0] = uchar(pal[k][0]); px[i][1] = uchar(pal[k][1]); px[i][2] = uchar(pal[k][2]);
+				px[i][3] = uchar(k == 3 ? alpha3 : 255);
+			}
+		}
+
+		// --- BC4 ---------------------------------------------------------
+
+		void encodeBC4(const Block & px, int channel, uchar * out)
+		{
+			int mn = 255, mx = 0;
+			for (int i = 0; i < 16; ++i) {
+				mn = std::min(mn, int(px[i][channel]));
+				mx = std::max(mx, int(px[i][channel]));
+			}
+			std::memset(out, 0, 8);
+			out[0] = uchar(mx);
+			out[1] = uchar(mn);
+			if (mx == mn) {
+				return;
+			}
+			// Eight values mode: index 0 is the max, 1 the min, 2 to 7 interpolate from max to min.
+			int pal[8];
+			pal[0] = mx;
+			pal[1] = mn;
+			for (int k = 2; k < 8; ++k) {
+				pal[k] = ((8 - k) * mx + (k - 1) * mn + 3) / 7;
+			}
+			uint64_t bits = 0;
+			for (int i = 0; i < 16; ++i) {
+				int best = 0, bestErr = INT_MAX;
+				for (int k = 0; k < 8; ++k) {
+					const int err = std::abs(int(px[i][channel]) - pal[k]);
+					if (err < bestErr) {
+						bestErr = err;
+						best = k;
+					}
+				}
+				bits |= uint64_t(best) << (3 * i);
+			}
+			for (int b = 0; b < 6; ++b) {
+				out[2 + b] = uchar((bits >> (8 * b)) & 0xFF);
+			}
+		}
+
+		void decodeBC4(const uchar * in, int channel, Block & px)
+		{
+			const int r0 = in[0], r1 = in[1];
+			int pal[8];
+			pal[0] = r0;
+			pal[1] = r1;
+			if (r0 > r1) {
+				for (int k = 2; k < 8; ++k) {
+					pal[k] = ((8 - k) * r0 + (k - 1) * r1 + 3) / 7;
+				}
+			} else {
+				for (int k = 2; k < 6; ++k) {
+					pal[k] = ((6 - k) * r0 + (k - 1) * r1 + 2) / 5;
+				}
+				pal[6] = 0;
+				pal[7] = 255;
+			}
+			uint64_t bits = 0;
+			for (int b = 0; b < 6; ++b) {
+				bits |= uint64_t(in[2 + b]) << (8 * b);
+			}
+			for (int i = 0; i < 16; ++i) {
+				px[i][channel] = uchar(pal[(bits >> (3 * i)) & 7]);
+			}
+		}
+
+		// --- BC7 (mode 6) ------------------------------------------------
+
+		/** Quantize an endpoint to 7 bits per channel plus a shared p-bit. */
+		void quantizeBC7(const float e[4], int q[4], int & p)
+		{
+			float bestErr = 1e10f;
+			for (int pb = 0; pb < 2; ++pb) {
+				int cand[4];
+				float err = 0.0f;
+				for (int c = 0; c < 4; ++c) {
+					cand[c] = clampValue(int(std::floor((e[c] - float(pb)) * 0.5f + 0.5f)), 0, 127);
+					const float d = e[c] - float(2 * cand[c] + pb);
+					err += d * d;
+				}
+				if (err < bestErr) {
+					bestErr = err;
+					p = pb;
+					std::copy(cand, cand + 4, q);
+				}
+			}
+		}
+
+		/** Choose the BC7 mode 6 indices for quantized endpoints.
+		\return the squared error
+		*/
+		int bc7Indices(const Block & px, const int q0[4], int p0, const int q1[4], int p1, int indices[16])
+		{
+			int pal[16][4];
+			for (int c = 0; c < 4; ++c) {
+				const int a = 2 * q0[c] + p0, b = 2 * q1[c] + p1;
+				for (int k = 0; k < 16; ++k) {
+					pal[k][c] = ((64 - bc7Weights[k]) * a + bc7Weights[k] * b + 32) >> 6;
+				}
+			}
+			// Project each pixel on the segment, then only test the closest weights.
+			float axis[4], axisNorm = 0.0f;
+			for (int c = 0; c < 4; ++c) {
+				axis[c] = float(pal[15][c] - pal[0][c]);
+				axisNorm += axis[c] * axis[c];
+			}
+			int error = 0;
+			for (int i = 0; i < 16; ++i) {
+				int guess = 0;
+				if (axisNorm > 0.0f) {
+					float t = 0.0f;
+					for (int c = 0; c < 4; ++c) {
+						t += (float(px[i][c]) - float(pal[0][c])) * axis[c];
+					}
+					t = clampValue(t / axisNorm * 64.0f, 0.0f, 64.0f);
+					while (guess < 15 && float(bc7Weights[guess + 1]) <= t) {
+						++guess;
+					}
+				}
+				int best = 0, bestErr = INT_MAX;
+				for (int k = std::max(guess - 1, 0); k <= std::min(guess + 2, 15); ++k) {
+					int err = 0;
+					for (int c = 0; c < 4; ++c) {
+						const int d = int(px[i][c]) - pal[k][c];
+						err += d * d;
+					}
+					if (err < bestErr) {
+						bestErr = err;
+						best = k;
+					}
+				}
+				indices[i] = best;
+				error += bestErr;
+			}
+			return error;
+		}
+
+		void encodeBC7(const Block & px, uchar * out)
+		{
+			float pts[16][4];
+			for (int i = 0; i < 16; ++i) {
+				for (int c = 0; c < 4; ++c) {
+					pts[i][c] = float(px[i][c]);
+				}
+			}
+			float e0[4], e1[4];
+			fitEndpoints<4>(pts, e0, e1);
+
+			int bestQ0[4] = { 0 }, bestQ1[4] = { 0 }, bestP0 = 0, bestP1 = 0, bestIndices[16] = { 0 };
+			int bestError = INT_MAX;
+			for (int it = 0; it < 3; ++it) {
+				int q0[4], q1[4], p0 = 0, p1 = 0, indices[16];
+				quantizeBC7(e0, q0, p0);
+				quantizeBC7(e1, q1, p1);
+				const int error = bc7Indices(px, q0, p0, q1, p1, indices);
+				if (error < bestError) {
+					bestError = error;
+					std::copy(q0, q0 + 4, bestQ0);
+					std::copy(q1, q1 + 4, bestQ1);
+					bestP0 = p0;
+					bestP1 = p1;
+					std::copy(indices, indices + 16, bestIndices);
+				}
+				if (error == 0) {
+					break;
+				}
+				float t[16];
+				for (int i = 0; i < 16; ++i) {
+					t[i] = float(bc7Weights[indices[i]]) / 64.0f;
+				}
+				if (!refineEndpoints<4>(pts, t, e0, e1)) {
+					break;
+				}
+			}
+
+			// The most significant bit of the first index is implicit and must be zero.
+			if (bestIndices[0] & 8) {
+				std::swap(bestQ0, bestQ1);
+				std::swap(bestP0, bestP1);
+				for (int i = 0; i < 16; ++i) {
+					bestIndices[i] = 15 - bestIndices[i];
+				}
+			}
+
+			std::memset(out, 0, 16);
+			BitWriter writer(out);
+			writer.write(1u << 6, 7);
+			for (int c = 0; c < 4; ++c) {
+				writer.write(uint(bestQ0[c]), 7);
+				writer.write(uint(bestQ1[c]), 7);
+			}
+			writer.write(uint(bestP0), 1);
+			writer.write(uint(bestP1), 1);
+			writer.write(uint(bestIndices[0]), 3);
+			for (int i = 1; i < 16; ++i) {
+				writer.write(uint(bestIndices[i]), 4);
+			}
+		}
+
+		/** Decode a BC7 block, only mode 6 (as produced by the encoder) is supported, other modes decode to black. */
+		void decodeBC7(const uchar * in, Block & px)
+		{
+			BitReader reader(in);
+			if (reader.read(7) != (1u << 6)) {
+				std::memset(px, 0, sizeof(Block));
+				return;
+			}
+			int e[2][4];
+			for (int c = 0; c < 4; ++c) {
+				e[0][c] = int(reader.read(7)) << 1;
+				e[1][c] = int(reader.read(7)) << 1;
+			}
+			const int p0 = int(reader.read(1)), p1 = int(reader.read(1));
+			for (int c = 0; c < 4; ++c) {
+				e[0][c] |= p0;
+				e[1][c] |= p1;
+			}
+			for (int i = 0; i < 16; ++i) {
+				const int w = bc7Weights[reader.read(i == 0 ? 3 : 4)];
+				for (int c = 0; c < 4; ++c) {
+					px[i][c] = uchar(((64 - w) * e[0][c] + w * e[1][c] + 32) >> 6);
+				}
+			}
+		}
+
+		/** Hash the content of an image, with the format and size. */
+		uint64_t contentHash(const cv::Mat & image, BlockCompression::Format format)
+		{
+			uint64_t hash = 1469598103934665603ull;
+			const auto mix = [&hash](uint64_t v) {
+				hash ^= v;
+				hash *= 1099511628211ull;
+			};
+			mix(uint64_t(format));
+			mix(uint64_t(image.cols));
+			mix(uint64_t(image.rows));
+			mix(uint64_t(image.channels()));
+			const size_t rowBytes = size_t(image.cols) * image.channels();
+			for (int y = 0; y < image.rows; ++y) {
+				const uchar * row = image.ptr<uchar>(y);
+				size_t x = 0;
+				for (; x + 8 <= rowBytes; x += 8) {
+					uint64_t v;
+					std::memcpy(&v, row + x, 8);
+					mix(v);
+				}
+				for (; x < rowBytes; ++x) {
+					mix(row[x]);
+				}
+			}
+			return hash;
+		}
+
+		const char cacheMagic[8] = { 'S', 'I', 'B', 'R', 'B', 'C', '0', '1' };
+
+	}
+
+	bool BlockCompression::fromGLFormat(uint glFormat, Format & format)
+	{
+		switch (glFormat) {
+		case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+		case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+			format = Format::BC1;
+			return true;
+		case GL_COMPRESSED_RED_RGTC1:
+			format = Format::BC4;
+			return true;
+		case GL_COMPRESSED_RG_RGTC2:
+			format = Format::BC5;
+			return true;
+		case GL_COMPRESSED_RGBA_BPTC_UNORM:
+		case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+			format = Format::BC7;
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	uint BlockCompression::glFormat(Format format)
+	{
+		switch (format) {
+		case Format::BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+		case Format::BC4: return GL_COMPRESSED_RED_RGTC1;
+		case Format::BC5: return GL_COMPRESSED_RG_RGTC2;
+		default: return GL_COMPRESSED_RGBA_BPTC_UNORM;
+		}
+	}
+
+	uint BlockCompression::blockBytes(Format format)
+	{
+		return (format == Format::BC1 || format == Format::BC4) ? 8 : 16;
+	}
+
+	size_t BlockCompression::compressedSize(Format format, uint w, uint h)
+	{
+		return size_t((w + 3) / 4) * size_t((h + 3) / 4) * blockBytes(format);
+	}
+
+	void BlockCompression::encode(const cv::Mat & image, Format format, std::vector<uchar> & blocks)
+	{
+		const int bw = (image.cols + 3) / 4, bh = (image.rows + 3) / 4;
+		const size_t bytes = blockBytes(format);
+		blocks.resize(compressedSize(format, uint(image.cols), uint(image.rows)));
+		if (image.empty() || image.depth() != CV_8U) {
+			SIBR_WRG << "[BlockCompression] Only non empty 8-bit images can be compressed." << std::endl;
+			return;
+		}
+
+#pragma omp parallel for schedule(dynamic)
+		for (int by = 0; by < bh; ++by) {
+			Block px;
+			for (int bx = 0; bx < bw; ++bx) {
+				fetchBlock(image, bx, by, px);
+				uchar * out = blocks.data() + (size_t(by) * bw + bx) * bytes;
+				switch (format) {
+				case Format::BC1:
+					encodeBC1(px, out);
+					break;
+				case Format::BC4:
+					encodeBC4(px, 0, out);
+					break;
+				case Format::BC5:
+					encodeBC4(px, 0, out);
+					encodeBC4(px, 1, out + 8);
+					break;
+				case Format::BC7:
+					encodeBC7(px, out);
+					break;
+				}
+			}
+		}
+	}
+
+	bool BlockCompression::encodeCached(const cv::Mat & image, Format format, std::vector<uchar> & blocks)
+	{
+		const std::string & directory = cacheDirectory();
+		if (directory.empty()) {
+			encode(image, format, blocks);
+			return false;
+		}
+
+		std::stringstream name;
+		name << directory << "/" << std::hex << std::setw(16) << std::setfill('0') << contentHash(image, format) << ".bcn";
+		const std::string path = name.str();
+		const size_t expectedSize = compressedSize(format, uint(image.cols), uint(image.rows));
+
+		std::ifstream in(path, std::ios::binary);
+		if (in) {
+			char magic[8];
+			uint64_t size = 0;
+			in.read(magic, sizeof(magic));
+			in.read(reinterpret_cast<char*>(&size), sizeof(size));
+			if (in && std::memcmp(magic, cacheMagic, sizeof(magic)) == 0 && size == expectedSize) {
+				blocks.resize(expectedSize);
+				in.read(reinterpret_cast<char*>(blocks.data()), std::streamsize(expectedSize));
+				if (in) {
+					return true;
+				}
+			}
+			SIBR_WRG << "[BlockCompression] Invalid cache file " << path << ", compressing again." << std::endl;
+		}
+
+		encode(image, format, blocks);
+		if (!directoryExists(directory)) {
+			makeDirectory(directory);
+		}
+		std::ofstream out(path, std::ios::binary);
+		const uint64_t size = blocks.size();
+		out.write(cacheMagic, sizeof(cacheMagic));
+		out.write(reinterpret_cast<const char*>(&size), sizeof(size));
+		out.write(reinterpret_cast<const char*>(blocks.data()), std::streamsize(blocks.size()));
+		if (!out) {
+			SIBR_WRG << "[BlockCompression] Unable to write cache file " << path << "." << std::endl;
+		}
+		return false;
+	}
+
+	void BlockCompression::decode(const std::vector<uchar> & blocks, Format format, uint w, uint h, cv::Mat & image)
+	{
+		image = cv::Mat(int(h), int(w), CV_8UC4);
+		const int bw = (int(w) + 3) / 4, bh = (int(h) + 3) / 4;
+		const size_t bytes = blockBytes(format);
+		if (blocks.size() < compressedSize(format, w, h)) {
+			SIBR_WRG << "[BlockCompression] Not enough compressed data for a " << w << "x" << h << " image." << std::endl;
+			return;
+		}
+
+#pragma omp parallel for schedule(dynamic)
+		for (int by = 0; by < bh; ++by) {
+			Block px;
+			for (int bx = 0; bx < bw; ++bx) {
+				const uchar * in = blocks.data() + (size_t(by) * bw + bx) * bytes;
+				for (int i = 0; i < 16; ++i) {
+					px[i][0] = px[i][1] = px[i][2] = 0;
+					px[i][3] = 255;
+				}
+				switch (format) {
+				case Format::BC1:
+					decodeBC1(in, px);
+					break;
+				case Format::BC4:
+					decodeBC4(in, 0, px);
+					break;
+				case Format::BC5:
+					decodeBC4(in, 0, px);
+					decodeBC4(in + 8, 1, px);
+					break;
+				case Format::BC7:
+					decodeBC7(in, px);
+					break;
+				}
+				for (int y = 0; y < 4 && by * 4 + y < int(h); ++y) {
+					uchar * row = image.ptr<uchar>(by * 4 + y);
+					for (int x = 0; x < 4 && bx * 4 + x < int(w); ++x) {
+						std::memcpy(row + (bx * 4 + x) * 4, px[y * 4 + x], 4);
+					}
+				}
+			}
+		}
+	}
+
+	std::string & BlockCompression::cacheDirectory()
+	{
+		static std::string directory;
+		return directory;
+	}
+
+	void BlockCompression::benchmark(uint numImages, uint w, uint h)
+	{
+		// Smooth gradients, sharp edges and noise, loosely resembling photographs.
+		std::mt19937 rng(42);
+		std::normal_distribution<float> noise(0.0f, 6.0f);
+		std::vector<cv::Mat> images(numImages);
+		for (uint i = 0; i < numImages; ++i) {
+			images[i] = cv::Mat(int(h), int(w), CV_8UC3);
+			for (int y = 0; y < int(h); ++y) {
+				uchar * row = images[i].ptr<uchar>(y);
+				for (int x = 0; x < int(w); ++x) {
+					const float u = float(x) / float(w), v = float(y) / float(h);
+					const float edge = (std::sin(40.0f * u + 3.0f * float(i)) > 0.6f) ? 60.0f : 0.0f;
+					row[3 * x + 0] = uchar(clampValue(255.0f * u + edge + noise(rng), 0.0f, 255.0f));
+					row[3 * x + 1] = uchar(clampValue(255.0f * v + noise(rng), 0.0f, 255.0f));
+					row[3 * x + 2] = uchar(clampValue(128.0f + 100.0f * std::sin(10.0f * (u + v)) - edge + noise(rng), 0.0f, 255.0f));
+				}
+			}
+		}
+
+		const std::pair<Format, const char*> formats[] = { { Format::BC1, "BC1" }, { Format::BC4, "BC4" }, { Format::BC5, "BC5" }, { Format::BC7, "BC7" } };
+		const std::pair<Format, int> usedChannels[] = { { Format::BC1, 3 }, { Format::BC4, 1 }, { Format::BC5, 2 }, { Format::BC7, 3 } };
+		for (int f = 0; f < 4; ++f) {
+			const Format format = formats[f].first;
+			const int numChannels = usedChannels[f].second;
+			std::vector<uchar> blocks;
+			cv::Mat decoded;
+			double encodeTime = 0.0, squaredError = 0.0;
+			for (const cv::Mat & image : images) {
+				Timer timer(true);
+				encode(image, format, blocks);
+				encodeTime += timer.deltaTimeFromLastTic<Timer::micro>() * 1e-6;
+				decode(blocks, format, w, h, decoded);
+				for (int y = 0; y < int(h); ++y) {
+					const uchar * src = image.ptr<uchar>(y);
+					const uchar * dst = decoded.ptr<uchar>(y);
+					for (int x = 0; x < int(w); ++x) {
+						for (int c = 0; c < numChannels; ++c) {
+							const double d = double(src[3 * x + c]) - double(dst[4 * x + c]);
+							squaredError += d * d;
+						}
+					}
+				}
+			}
+			const double mse = squaredError / (double(numImages) * w * h * numChannels);
+			const double psnr = mse > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : 100.0;
+			const double megapixels = double(numImages) * w * h * 1e-6;
+			SIBR_LOG << "[BlockCompression] " << formats[f].second << ": " << megapixels / std::max(encodeTime, 1e-9) << " MPix/s, PSNR "
+				<< psnr << "dB, ratio " << double(numImages) * w * h * numChannels / double(numImages * compressedSize(format, w, h)) << ":1." << std::endl;
+		}
+	}
+
+} // namespace sibr
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+# include "core/graphics/Config.hpp"
+
+namespace sibr
+{
+	/** \brief CPU encoder for the BC1, BC4, BC5 and BC7 block compression formats, used to upload pre-compressed textures.
+	* Blocks are encoded in parallel. Endpoints are fitted along the principal axis of each block and refined by least squares.
+	* BC7 blocks all use mode 6 (single subset, RGBA, 4-bit indices), which is fast and well suited to natural images.
+	* Encoded images can be cached on disk, keyed by their content, so that the compression is done once per dataset.
+	* \ingroup sibr_graphics
+	*/
+	class SIBR_GRAPHICS_EXPORT BlockCompression
+	{
+	public:
+
+		/** Supported formats. */
+		enum class Format {
+			BC1, ///< RGB, 4 bits per pixel.
+			BC4, ///< One channel, 4 bits per pixel.
+			BC5, ///< Two channels, 8 bits per pixel.
+			BC7 ///< RGBA, 8 bits per pixel.
+		};
+
+		/** Find the format matching an OpenGL compressed internal format.
+		\param glFormat the GL_COMPRESSED_* format
+		\param format will contain the matching format
+		\return false if the format is not supported by the encoder
+		*/
+		static bool fromGLFormat(uint glFormat, Format & format);
+
+		/** \return the default OpenGL internal format of a format.
+		\param format the format
+		*/
+		static uint glFormat(Format format);
+
+		/** \return the size in bytes of a 4x4 block.
+		\param format the format
+		*/
+		static uint blockBytes(Format format);
+
+		/** \return the size in bytes of a compressed image.
+		\param format the format
+		\param w image width
+		\param h image height
+		*/
+		static size_t compressedSize(Format format, uint w, uint h);
+
+		/** Compress an image. Partial blocks on the right and bottom edges are padded by clamping.
+		\param image an 8-bit image with 1 to 4 channels
+		\param format the target format, using the first channels of the image
+		\param blocks will contain the compressed blocks, row by row
+		*/
+		static void encode(const cv::Mat & image, Format format, std::vector<uchar> & blocks);
+
+		/** Compress an image, reusing the result cached on disk if any (see cacheDirectory()).
+		\param image an 8-bit image with 1 to 4 channels
+		\param format the target format
+		\param blocks will contain the compressed blocks, row by row
+		\return true if the result was loaded from the cache
+		*/
+		static bool encodeCached(const cv::Mat & image, Format format, std::vector<uchar> & blocks);
+
+		/** Decompress an image.
+		\param blocks the compressed blocks
+		\param format the format of the blocks
+		\param w image width
+		\param h image height
+		\param image will contain the RGBA 8-bit result, unused channels set to 0 and alpha to 255
+		*/
+		static void decode(const std::vector<uchar> & blocks, Format format, uint w, uint h, cv::Mat & image);
+
+		/** \return the directory where compressed images are cached, empty to disable caching (default). */
+		static std::string & cacheDirectory();
+
+		/** Compress synthetic images in all formats, log the throughput and the PSNR of the decoded results.
+		\param numImages number of images
+		\param w images width
+		\param h images height
+		*/
+		static void benchmark(uint numImages = 4, uint w = 1920, uint h = 1080);
+	};
+
+} // namespace sibr
@@ -396,6 +396,68 @@ namespace sibr
 				idToShapegroups[id] = shapeGroup;
 			}
 		}
+		// Load each referenced mesh once and count the size of the merged mesh, so that it is allocated a single time.
+		size_t vertexCount = 0;
+		size_t triangleCount = 0;
+		bool allNormals = true, allColors = true, allTexCoords = true;
+		const auto countMesh = [&](const sibr::MaterialMesh& mesh) {
+			vertexCount += mesh.vertices().size();
+			triangleCount += mesh.triangles().size();
+			allNormals = allNormals && mesh.hasNormals();
+			allColors = allColors && mesh.hasColors();
+			allTexCoords = allTexCoords && mesh.hasTexCoords();
+		};
+		for (rapidxml::xml_node<> *node = nodeScene->first_node("shape");
+			node; node = node->next_sibling("shape"))
+		{
+			rapidxml::xml_attribute<>* typeAttribute = node->first_attribute("type");
+			if (!typeAttribute) {
+				continue;
+			}
+			const std::string type = typeAttribute->value();
+			if (type == "instance") {
+				rapidxml::xml_node<>* nodeRef = node->first_node("ref");
+				const auto shapeGroup = idToShapegroups.find(nodeRef->first_attribute("id")->value());
+				if (shapeGroup == idToShapegroups.end()) {
+					continue;
+				}
+				for (const auto& shape : shapeGroup->second.shapes) {
+					const std::string meshPath = pathFolder + "/" + shape.filename;
+					if (meshes.find(meshPath) == meshes.end()) {
+						meshes[meshPath] = MaterialMesh();
+						meshes[meshPath].load(meshPath);
+					}
+					countMesh(meshes[meshPath]);
+				}
+			}
+			else if (type == "obj" || type == "ply") {
+				const std::string filename = node->first_node("string")->first_attribute("value")->value();
+				if (meshes.find(filename) == meshes.end()) {
+					meshes[filename] = sibr::MaterialMesh();
+					if (!meshes[filename].load(pathFolder + "/" + filename)) {
+						return false;
+					}
+					if (meshes[filename].matIds().empty())
+					{
+						SIBR_WRG << "Material (" << filename << ") not present ..." << std::endl;
+					}
+				}
+				countMesh(meshes[filename]);
+			}
+		}
+		_vertices.reserve(_vertices.size() + vertexCount);
+		_triangles.reserve(_triangles.size() + triangleCount);
+		_matIds.reserve(_matIds.size() + triangleCount);
+		if (allNormals) {
+			_normals.reserve(_normals.size() + vertexCount);
+		}
+		if (allColors) {
+			_colors.reserve(_colors.size() + vertexCount);
+		}
+		if (allTexCoords) {
+			_texcoords.reserve(_texcoords.size() + vertexCount);
+		}
+
 		// Second: Create all the actual shapes
 		for (rapidxml::xml_node<> *node = nodeScene->first_node("shape");
 			node; node = node->next_sibling("shape"))
@@ -1290,6 +1352,10 @@ namespace sibr
 
 	void MaterialMesh::ambientOcclusion(const MaterialMesh::AmbientOcclusion & ao)
 	{
+		if (!_aoFunction) {
+			SIBR_WRG << "[MaterialMesh] No AO function set, see AmbientOcclusionBaker::aoFunction." << std::endl;
+			return;
+		}
 		if (!_aoInitialized) {
 
 			_ambientOcclusion = ao;
@@ -329,6 +329,7 @@ namespace sibr
 		inline const AmbientOcclusion& ambientOcclusion(void);
 
 		/** Set the function used to compute ambient occlusion at each vertex. 
+		See AmbientOcclusionBaker::aoFunction in sibr_raycaster for a batched Embree implementation.
 		\param aoFunction the new function to use 
 		*/
 		inline void aoFunction(std::function<sibr::Mesh::Colors(
@@ -14,6 +14,9 @@
 #include <memory>
 #include <map>
 #include <queue>
+#include <atomic>
+#include <numeric>
+#include <random>
 
 #include <assimp/Importer.hpp> // C++ importer interface
 #include <assimp/scene.h> // Output data structure
@@ -23,6 +26,8 @@
 
 #include "core/system/ByteStream.hpp"
 #include "core/graphics/Mesh.hpp"
+#include "core/graphics/MeshInstances.hpp"
+#include "core/system/SimpleTimer.hpp"
 
 #include "boost/filesystem.hpp"
 #include "core/system/XMLTree.h"
@@ -675,153 +680,20 @@ namespace sibr
 
 	bool sibr::Mesh::loadMtsXML(const std::string& xmlFile)
 	{
-		bool allLoaded = true;
-		std::string pathFolder = boost::filesystem::path(xmlFile).parent_path().string();
-		sibr::XMLTree doc(xmlFile);
-
-		std::map<std::string, sibr::Mesh> meshes;
-		std::map<std::string, std::string> idToFilename;
-
-		rapidxml::xml_node<>* nodeScene = doc.first_node("scene");
-
-		for (rapidxml::xml_node<>* node = nodeScene->first_node("shape");
-			node; node = node->next_sibling("shape"))
-		{
-			if (strcmp(node->first_attribute()->name(), "type") == 0 &&
-				strcmp(node->first_attribute()->value(), "shapegroup") == 0) {
-
-				std::cout << "Found : " << node->first_attribute("id")->value() << std::endl;
-
-				std::string id = node->first_attribute("id")->value();
-				std::string filename = node->first_node("shape")->first_node("string")->first_attribute("value")->value();
-				idToFilename[id] = filename;
-			}
+		// Repeated shapes are kept shared while parsing, and merged once at the end.
+		MeshInstances instances;
+		if (!instances.loadMtsXML(xmlFile)) {
+			return false;
 		}
-
-		for (rapidxml::xml_node<>* node = nodeScene->first_node("shape");
-			node; node = node->next_sibling("shape"))
-		{
-
-			if (strcmp(node->first_attribute()->name(), "type") == 0 &&
-				strcmp(node->first_attribute()->value(), "instance") == 0
-				) {
-				rapidxml::xml_node<>* nodeRef = node->first_node("ref");
-				const std::string id = nodeRef->first_attribute("id")->value();
-				const std::string filename = idToFilename[id];
-				const std::string meshPath = pathFolder + "/" + filename;
-
-				if (meshes.find(filename) == meshes.end()) {
-					meshes[filename] = sibr::Mesh();
-					if (!meshes[filename].load(meshPath)) {
-						return false;
-					}
-
-				}
-
-				std::cout << "Adding one instance of : " << filename << std::endl;
-
-				rapidxml::xml_node<>* nodeTrans = node->first_node("transform");
-				if (nodeTrans) {
-					sibr::Mesh toWorldMesh = meshes[filename];
-					rapidxml::xml_node<>* nodeM1 = nodeTrans->first_node("matrix");
-					std::string matrix1 = nodeM1->first_attribute("value")->value();
-					rapidxml::xml_node<>* nodeM2 = nodeM1->next_sibling("matrix");
-					std::string matrix2 = nodeM2->first_attribute("value")->value();
-
-
-					std::istringstream issM1(matrix1);
-					std::vector<std::string> splitM1(std::istream_iterator<std::string>{issM1},
-						std::istream_iterator<std::string>());
-					sibr::Matrix4f m1;
-					m1 <<
-						std::stof(splitM1[0]), std::stof(splitM1[1]), std::stof(splitM1[2]), std::stof(splitM1[3]),
-						std::stof(splitM1[4]), std::stof(splitM1[5]), std::stof(splitM1[6]), std::stof(splitM1[7]),
-						std::stof(splitM1[8]), std::stof(splitM1[9]), std::stof(splitM1[10]), std::stof(splitM1[11]),
-						std::stof(splitM1[12]), std::stof(splitM1[13]), std::stof(splitM1[14]), std::stof(splitM1[15]);
-
-					std::istringstream issM2(matrix2);
-					std::vector<std::string> splitM2(std::istream_iterator<std::string>{issM2},
-						std::istream_iterator<std::string>());
-					sibr::Matrix4f m2;
-					m2 <<
-						std::stof(splitM2[0]), std::stof(splitM2[1]), std::stof(splitM2[2]), std::stof(splitM2[3]),
-						std::stof(splitM2[4]), std::stof(splitM2[5]), std::stof(splitM2[6]), std::stof(splitM2[7]),
-						std::stof(splitM2[8]), std::stof(splitM2[9]), std::stof(splitM2[10]), std::stof(splitM2[11]),
-						std::stof(splitM2[12]), std::stof(splitM2[13]), std::stof(splitM2[14]), std::stof(splitM2[15]);
-
-					sibr::Mesh::Vertices vertices;
-					for (int v = 0; v < toWorldMesh.vertices().size(); v++) {
-						sibr::Vector4f v4(toWorldMesh.vertices()[v].x(), toWorldMesh.vertices()[v].y(), toWorldMesh.vertices()[v].z(), 1.0);
-						vertices.push_back((m2 * (m1 * v4)).xyz());
-
-					}
-
-					toWorldMesh.vertices(vertices);
-					merge(toWorldMesh);
-
-				}
-				else {
-					merge(meshes[filename]);
-				}
-
-
-			}
-			else if (strcmp(node->first_attribute()->name(), "type") == 0 &&
-				strcmp(node->first_attribute()->value(), "obj") == 0
-				) {
-				rapidxml::xml_node<>* nodeRef = node->first_node("string");
-				const std::string filename = nodeRef->first_attribute("value")->value();
-				const std::string meshPath = pathFolder + "/" + filename;
-
-				if (meshes.find(filename) == meshes.end()) {
-					meshes[filename] = sibr::Mesh();
-					if (!meshes[filename].load(meshPath)) {
-						return false;
-					}
-
-				}
-
-				std::cout << "Adding one instance of : " << filename << std::endl;
-
-				rapidxml::xml_node<>* nodeTrans = node->first_node("transform");
-				if (nodeTrans) {
-					sibr::Mesh toWorldMesh = meshes[filename];
-					rapidxml::xml_node<>* nodeM1 = nodeTrans->first_node("matrix");
-					std::string matrix1 = nodeM1->first_attribute("value")->value();
-
-
-					std::istringstream issM1(matrix1);
-					std::vector<std::string> splitM1(std::istream_iterator<std::string>{issM1},
-						std::istream_iterator<std::string>());
-					sibr::Matrix4f m1;
-					m1 <<
-						std::stof(splitM1[0]), std::stof(splitM1[1]), std::stof(splitM1[2]), std::stof(splitM1[3]),
-						std::stof(splitM1[4]), std::stof(splitM1[5]), std::stof(splitM1[6]), std::stof(splitM1[7]),
-						std::stof(splitM1[8]), std::stof(splitM1[9]), std::stof(splitM1[10]), std::stof(splitM1[11]),
-						std::stof(splitM1[12]), std::stof(splitM1[13]), std::stof(splitM1[14]), std::stof(splitM1[15]);
-
-
-					sibr::Mesh::Vertices vertices;
-					for (int v = 0; v < toWorldMesh.vertices().size(); v++) {
-						sibr::Vector4f v4(toWorldMesh.vertices()[v].x(), toWorldMesh.vertices()[v].y(), toWorldMesh.vertices()[v].z(), 1.0);
-						vertices.push_back((m1 * v4).xyz());
-
-					}
-
-					toWorldMesh.vertices(vertices);
-					merge(toWorldMesh);
-
-				}
-				else {
-					merge(meshes[filename]);
-				}
-
-
-			}
+		if (_vertices.empty()) {
+			instances.flatten(*this);
+		}
+		else {
+			Mesh flattened(false);
+			instances.flatten(flattened);
+			merge(flattened);
 		}
-
 		return true;
-
 	}
 
 	void	Mesh::save(const std::string& filename, bool universal, const std::string &textureName) const
@@ -1400,7 +1272,18 @@ namespace sibr
 	{
 		if (!_gl.bufferGL) { SIBR_ERR << "Tried to forceBufferGL on a non OpenGL Mesh" << std::endl; return; }
 		_gl.dirtyBufferGL = false;
-		_gl.bufferGL->build(*this, adjacency);
+		_gl.bufferGL->build(*this, _gl.options, adjacency);
+	}
+
+	void	Mesh::bufferGLOptions(const MeshBufferGL::Options & options)
+	{
+		_gl.options = options;
+		_gl.dirtyBufferGL = true;
+	}
+
+	const MeshBufferGL::Options & Mesh::bufferGLOptions(void) const
+	{
+		return _gl.options;
 	}
 
 	void	Mesh::freeBufferGLUpdate(void) const
@@ -2420,4 +2303,249 @@ namespace sibr
 		return allComponents;
 	}
 
+	namespace {
+
+		/** Find the root of an element, halving the path on the way. Safe with concurrent unions. */
+		uint findRoot(std::vector<std::atomic<uint>> & parents, uint id)
+		{
+			uint parent = parents[id].load(std::memory_order_relaxed);
+			while (parent != id) {
+				const uint grandParent = parents[parent].load(std::memory_order_relaxed);
+				if (grandParent != parent) {
+					// Failing is harmless, another thread already moved this element closer to the root.
+					parents[id].compare_exchange_weak(parent, grandParent, std::memory_order_relaxed);
+				}
+				id = grandParent;
+				parent = parents[id].load(std::memory_order_relaxed);
+			}
+			return id;
+		}
+
+		/** Merge the sets of two elements, the root with the largest index being linked to the other one. */
+		void unite(std::vector<std::atomic<uint>> & parents, uint a, uint b)
+		{
+			while (true) {
+				a = findRoot(parents, a);
+				b = findRoot(parents, b);
+				if (a == b) {
+					return;
+				}
+				if (a < b) {
+					std::swap(a, b);
+				}
+				// Only link a if it is still a root, else try again from the new roots.
+				uint expected = a;
+				if (parents[a].compare_exchange_strong(expected, b, std::memory_order_relaxed)) {
+					return;
+				}
+			}
+		}
+
+		/** Compute the new index of each kept element with a parallel prefix sum.
+		\param count the number of elements
+		\param keep the predicate telling if an element is kept
+		\param remap will contain the new index of each element, -1 for removed ones
+		\return the number of kept elements
+		*/
+		template<typename Predicate>
+		size_t compactIndices(size_t count, const Predicate & keep, std::vector<int> & remap)
+		{
+			const int blockSize = 1 << 16;
+			const int blockCount = int((count + blockSize - 1) / blockSize);
+			std::vector<size_t> offsets(blockCount + 1, 0);
+			remap.resize(count);
+#pragma omp parallel for
+			for (int bid = 0; bid < blockCount; ++bid) {
+				const size_t end = std::min(count, size_t(bid + 1) * blockSize);
+				size_t kept = 0;
+				for (size_t id = size_t(bid) * blockSize; id < end; ++id) {
+					kept += keep(id) ? 1 : 0;
+				}
+				offsets[bid + 1] = kept;
+			}
+			for (int bid = 0; bid < blockCount; ++bid) {
+				offsets[bid + 1] += offsets[bid];
+			}
+#pragma omp parallel for
+			for (int bid = 0; bid < blockCount; ++bid) {
+				const size_t end = std::min(count, size_t(bid + 1) * blockSize);
+				size_t next = offsets[bid];
+				for (size_t id = size_t(bid) * blockSize; id < end; ++id) {
+					remap[id] = keep(id) ? int(next++) : -1;
+				}
+			}
+			return offsets[blockCount];
+		}
+
+		/** Move the kept elements of a per-vertex attribute to their new location.
+		\param attribute the attribute values
+		\param remap the new index of each element, -1 for removed ones
+		\param count the number of kept elements
+		\return the compacted attribute
+		*/
+		template<typename Container>
+		Container compactAttribute(const Container & attribute, const std::vector<int> & remap, size_t count)
+		{
+			Container newAttribute(count);
+#pragma omp parallel for
+			for (int id = 0; id < int(remap.size()); ++id) {
+				if (remap[id] >= 0) {
+					newAttribute[remap[id]] = attribute[id];
+				}
+			}
+			return newAttribute;
+		}
+	}
+
+	std::vector<uint> Mesh::connectedComponents(std::vector<uint> * componentSizes) const
+	{
+		const int vertexCount = int(vertices().size());
+		const int triangleCount = int(triangles().size());
+
+		std::vector<std::atomic<uint>> parents(vertexCount);
+#pragma omp parallel for
+		for (int v_id = 0; v_id < vertexCount; ++v_id) {
+			parents[v_id].store(uint(v_id), std::memory_order_relaxed);
+		}
+#pragma omp parallel for
+		for (int t_id = 0; t_id < triangleCount; ++t_id) {
+			const Vector3u & t = triangles()[t_id];
+			unite(parents, t[0], t[1]);
+			unite(parents, t[0], t[2]);
+		}
+
+		// All unions are done, flatten the trees.
+		std::vector<uint> labels(vertexCount);
+#pragma omp parallel for
+		for (int v_id = 0; v_id < vertexCount; ++v_id) {
+			labels[v_id] = findRoot(parents, uint(v_id));
+		}
+
+		// Count triangles per root, and sort components by decreasing size.
+		std::vector<uint> rootSizes(vertexCount, 0);
+		for (const Vector3u & t : triangles()) {
+			++rootSizes[labels[t[0]]];
+		}
+		std::vector<uint> roots;
+		for (int v_id = 0; v_id < vertexCount; ++v_id) {
+			if (labels[v_id] == uint(v_id)) {
+				roots.push_back(uint(v_id));
+			}
+		}
+		std::sort(roots.begin(), roots.end(), [&rootSizes](uint a, uint b) {
+			return rootSizes[a] > rootSizes[b] || (rootSizes[a] == rootSizes[b] && a < b);
+		});
+		std::vector<uint> rootToComponent(vertexCount, 0);
+		for (uint c_id = 0; c_id < uint(roots.size()); ++c_id) {
+			rootToComponent[roots[c_id]] = c_id;
+		}
+#pragma omp parallel for
+		for (int v_id = 0; v_id < vertexCount; ++v_id) {
+			labels[v_id] = rootToComponent[labels[v_id]];
+		}
+
+		if (componentSizes) {
+			componentSizes->resize(roots.size());
+			for (size_t c_id = 0; c_id < roots.size(); ++c_id) {
+				(*componentSizes)[c_id] = rootSizes[roots[c_id]];
+			}
+		}
+		return labels;
+	}
+
+	size_t Mesh::filterComponents(size_t keepLargest, size_t minTriangles)
+	{
+		std::vector<uint> sizes;
+		const std::vector<uint> labels = connectedComponents(&sizes);
+
+		// Components are sorted by size, the kept ones are the first ones.
+		size_t keptCount = std::min(keepLargest, sizes.size());
+		while (keptCount > 0 && sizes[keptCount - 1] < minTriangles) {
+			--keptCount;
+		}
+		if (keptCount == sizes.size()) {
+			return 0;
+		}
+
+		std::vector<int> vertexRemap, triangleRemap;
+		const size_t newVertexCount = compactIndices(labels.size(), [&](size_t v_id) { return labels[v_id] < keptCount; }, vertexRemap);
+		const size_t newTriangleCount = compactIndices(triangles().size(), [&](size_t t_id) { return labels[triangles()[t_id][0]] < keptCount; }, triangleRemap);
+
+		Mesh::Triangles newTris(newTriangleCount);
+#pragma omp parallel for
+		for (int t_id = 0; t_id < int(triangleRemap.size()); ++t_id) {
+			if (triangleRemap[t_id] >= 0) {
+				const Vector3u & t = triangles()[t_id];
+				newTris[triangleRemap[t_id]] = Vector3u(uint(vertexRemap[t[0]]), uint(vertexRemap[t[1]]), uint(vertexRemap[t[2]]));
+			}
+		}
+
+		if (hasColors()) {
+			colors(compactAttribute(colors(), vertexRemap, newVertexCount));
+		}
+		if (hasNormals()) {
+			normals(compactAttribute(normals(), vertexRemap, newVertexCount));
+		}
+		if (hasTexCoords()) {
+			texCoords(compactAttribute(texCoords(), vertexRemap, newVertexCount));
+		}
+		triangles(newTris);
+		vertices(compactAttribute(vertices(), vertexRemap, newVertexCount));
+		return sizes.size() - keptCount;
+	}
+
+	void Mesh::benchmarkComponents(uint floaters, uint gridSize)
+	{
+		// A large grid and many single triangle floaters, with shuffled vertices as in reconstructed meshes.
+		const uint gridVertices = (gridSize + 1) * (gridSize + 1);
+		const uint vertexCount = gridVertices + 3 * floaters;
+		std::vector<uint> shuffle(vertexCount);
+		std::iota(shuffle.begin(), shuffle.end(), 0u);
+		std::shuffle(shuffle.begin(), shuffle.end(), std::mt19937(42));
+
+		Mesh::Vertices verts(vertexCount);
+		Mesh::Triangles tris;
+		tris.reserve(size_t(2) * gridSize * gridSize + floaters);
+		for (uint y = 0; y <= gridSize; ++y) {
+			for (uint x = 0; x <= gridSize; ++x) {
+				verts[shuffle[y * (gridSize + 1) + x]] = Vector3f(float(x), float(y), 0.0f);
+			}
+		}
+		for (uint y = 0; y < gridSize; ++y) {
+			for (uint x = 0; x < gridSize; ++x) {
+				const uint a = y * (gridSize + 1) + x;
+				tris.emplace_back(shuffle[a], shuffle[a + 1], shuffle[a + gridSize + 1]);
+				tris.emplace_back(shuffle[a + 1], shuffle[a + gridSize + 2], shuffle[a + gridSize + 1]);
+			}
+		}
+		for (uint f = 0; f < floaters; ++f) {
+			const uint a = gridVertices + 3 * f;
+			const Vector3f p(float(f % 1000), float(f / 1000), 1.0f);
+			verts[shuffle[a]] = p;
+			verts[shuffle[a + 1]] = p + Vector3f(0.5f, 0.0f, 0.0f);
+			verts[shuffle[a + 2]] = p + Vector3f(0.0f, 0.5f, 0.0f);
+			tris.emplace_back(shuffle[a], shuffle[a + 1], shuffle[a + 2]);
+		}
+		Mesh mesh(false);
+		mesh.vertices(verts);
+		mesh.triangles(tris);
+
+		Timer timer(true);
+		const size_t previousCount = mesh.removeDisconnectedComponents().size();
+		const double previousTime = timer.deltaTimeFromLastTic<Timer::micro>() * 1e-6;
+
+		timer.tic();
+		std::vector<uint> sizes;
+		mesh.connectedComponents(&sizes);
+		const double labelTime = timer.deltaTimeFromLastTic<Timer::micro>() * 1e-6;
+
+		timer.tic();
+		const size_t removed = mesh.filterComponents(1);
+		const double filterTime = timer.deltaTimeFromLastTic<Timer::micro>() * 1e-6;
+
+		SIBR_LOG << "[Mesh] " << tris.size() << " triangles, " << sizes.size() << " components (" << previousCount << " with removeDisconnectedComponents): "
+			<< "removeDisconnectedComponents " << previousTime << "s, connectedComponents " << labelTime << "s, filterComponents " << filterTime << "s, "
+			<< removed << " components removed, " << mesh.triangles().size() << " triangles left." << std::endl;
+	}
+
 } // namespace sibr
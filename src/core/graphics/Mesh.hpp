@@ -239,7 +239,7 @@ namespace sibr
 		bool	loadSfM( const std::string& filename, const std::string& dataset_path = "" );
 		
 		/** Load a scene from a set of mitsuba XML scene files (referencing multiple OBJs/PLYs). 
-		It handles instances (duplicating the geoemtry and applying the per-instance transformation).
+		Instances are kept shared while loading and merged in a single pass, use MeshInstances::load to keep them separate.
 		\param filename the file path
 		\return a success flag
 		*/
@@ -331,6 +331,14 @@ namespace sibr
 		/** Delete GPU mesh data. */
 		void	freeBufferGLUpdate(void) const;
 
+		/** Set the optimizations applied when uploading the mesh to the GPU (none by default).
+		\param options the optimizations, see MeshBufferGL::Options
+		*/
+		void	bufferGLOptions(const MeshBufferGL::Options & options);
+
+		/** \return the optimizations applied when uploading the mesh to the GPU. */
+		const MeshBufferGL::Options &	bufferGLOptions(void) const;
+
 		/** Render the mesh vertices as points.
 		\param depthTest should depth testing be performed
 		*/
@@ -412,6 +420,25 @@ namespace sibr
 		*/
 		std::vector<std::vector<int> > removeDisconnectedComponents();
 
+		/** Label the connected components of the mesh, using a lock-free parallel union-find over the triangle edges.
+		\param componentSizes if not null, will contain the number of triangles of each component
+		\return the component of each vertex. Components are sorted by decreasing number of triangles, unreferenced vertices are isolated components at the end
+		*/
+		std::vector<uint> connectedComponents(std::vector<uint> * componentSizes = nullptr) const;
+
+		/** Remove small connected components (floaters) in a single parallel compaction pass.
+		\param keepLargest the maximum number of components to keep, the largest ones
+		\param minTriangles components with fewer triangles are removed
+		\return the number of removed components
+		*/
+		size_t filterComponents(size_t keepLargest = std::numeric_limits<size_t>::max(), size_t minTriangles = 0);
+
+		/** Compare connectedComponents and filterComponents with removeDisconnectedComponents on a synthetic mesh, logging timings.
+		\param floaters the number of small disconnected components
+		\param gridSize the resolution of the main component, a grid of gridSize x gridSize quads
+		*/
+		static void benchmarkComponents(uint floaters = 1000000, uint gridSize = 1000);
+
 		/** Generate a simple cube with normals.
 		\param withGraphics should the mesh be on the GPU
 		\return a cube mesh
@@ -461,10 +488,12 @@ namespace sibr
 			BufferGL& operator =(const BufferGL& other) {
 				bufferGL.reset(other.bufferGL? new MeshBufferGL() : nullptr);
 				dirtyBufferGL = (other.bufferGL!=nullptr);
+				options = other.options;
 				return *this;
 			}
 
 			bool			dirtyBufferGL; ///< Should GL data be updated.
+			MeshBufferGL::Options	options; ///< Optimizations applied when uploading.
 			std::unique_ptr<MeshBufferGL>	bufferGL; ///< Internal OpenGL data.
 		};
 		public: mutable BufferGL	_gl; ///< Internal OpenGL data.
@@ -15,6 +15,7 @@
 #include "core/graphics/MeshBufferGL.hpp"
 
 #include <unordered_map>
+#include <cstring>
 
 namespace sibr
 {
@@ -82,7 +83,8 @@ namespace sibr
 		_bufferIds			(std::move(other._bufferIds)),
 		_indexCount			(std::move(other._indexCount)),
 		_adjacentIndexCount	(std::move(other._adjacentIndexCount)),
-		_vertexCount		(std::move(other._vertexCount))
+		_vertexCount		(std::move(other._vertexCount)),
+		_meshlets			(std::move(other._meshlets))
 	{
 	}
 
@@ -93,6 +95,7 @@ namespace sibr
 		_indexCount			= std::move(other._indexCount);
 		_adjacentIndexCount	= std::move(other._adjacentIndexCount);
 		_vertexCount		= std::move(other._vertexCount);
+		_meshlets			= std::move(other._meshlets);
 
 		return *this;
 	}
@@ -193,6 +196,90 @@ namespace sibr
 		std::vector<GLfloat> normals = prepareVertexData<GLfloat>(
 			mesh.normals(), numVertices);
 
+		uploadAttributes(vertices, colors, texcoords, normals);
+
+		glBindVertexArray(0);
+		_meshlets.clear();
+	}
+
+	void 	MeshBufferGL::build( const Mesh& mesh, const Options& options, bool adjacency )
+	{
+		if (!options.reorder && !options.compact && !options.meshlets) {
+			build(mesh, adjacency);
+			return;
+		}
+		if (!_vaoId)
+		{
+			glGenVertexArrays(1, &_vaoId);
+			glGenBuffers(BUFCOUNT, &_bufferIds[0]);
+		}
+
+		glBindVertexArray(_vaoId);
+
+		CHECK_GL_ERROR;
+
+		const uint numVertices = (uint)mesh.vertices().size();
+		_vertexCount = numVertices;
+		std::vector<GLuint> indices(mesh.triangleArray(), mesh.triangleArray() + mesh.triangles().size() * 3);
+		std::vector<uint> vertexOrder;
+		if (options.reorder) {
+			const MeshOptimizer::CacheStats before = MeshOptimizer::analyzeVertexCache(indices, numVertices);
+			MeshOptimizer::optimizeVertexCache(indices, numVertices);
+			// The adjacency buffer uses the mesh vertex indices, only triangles can be reordered.
+			if (!adjacency) {
+				vertexOrder = MeshOptimizer::optimizeVertexFetch(indices, numVertices);
+			}
+			if (options.log) {
+				const MeshOptimizer::CacheStats after = MeshOptimizer::analyzeVertexCache(indices, numVertices);
+				SIBR_LOG << "[MeshBufferGL] Vertex cache: ACMR " << before.acmr << " -> " << after.acmr
+					<< ", ATVR " << before.atvr << " -> " << after.atvr << "." << std::endl;
+			}
+		}
+
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _bufferIds[BUFINDEX]);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint)*indices.size(), indices.data(), GL_STATIC_DRAW);
+		_indexCount = (uint)indices.size();
+		CHECK_GL_ERROR;
+
+		if (adjacency)
+			fetchIndices(mesh, true);
+
+		// Attributes in the new vertex order.
+		const auto reordered = [&vertexOrder](const auto & data) {
+			std::vector<GLfloat> values = prepareVertexData<GLfloat>(data, uint(data.size()));
+			if (vertexOrder.empty() || data.empty()) {
+				return values;
+			}
+			const size_t components = values.size() / data.size();
+			std::vector<GLfloat> result(values.size());
+			for (size_t vid = 0; vid < vertexOrder.size(); ++vid) {
+				std::copy_n(values.begin() + vertexOrder[vid] * components, components, result.begin() + vid * components);
+			}
+			return result;
+		};
+
+		if (options.compact) {
+			uploadCompactAttributes(mesh, vertexOrder, options.halfTexCoords);
+		}
+		else {
+			uploadAttributes(reordered(mesh.vertices()), reordered(mesh.colors()), reordered(mesh.texCoords()), reordered(mesh.normals()));
+		}
+
+		_meshlets.clear();
+		if (options.meshlets) {
+			Mesh::Vertices positions(numVertices);
+			for (uint vid = 0; vid < numVertices; ++vid) {
+				positions[vid] = mesh.vertices()[vertexOrder.empty() ? vid : vertexOrder[vid]];
+			}
+			_meshlets = MeshOptimizer::buildMeshlets(indices, positions);
+		}
+
+		glBindVertexArray(0);
+	}
+
+	void	MeshBufferGL::uploadAttributes( const std::vector<GLfloat>& vertices, const std::vector<GLfloat>& colors,
+		const std::vector<GLfloat>& texcoords, const std::vector<GLfloat>& normals )
+	{
 		// Following this order:
 		//VertexAttribLocation		= 0,
 		//ColorAttribLocation		= 1,
@@ -228,8 +315,75 @@ namespace sibr
 		/// \todo TODO:
 		/// We could ignore attrib that are empty (where mesh.colors().empty() == true, don't do anything with this).
 		/// This could improve a bit performances.
+	}
 
-		glBindVertexArray(0);
+	void	MeshBufferGL::uploadCompactAttributes( const Mesh& mesh, const std::vector<uint>& vertexOrder, bool halfTexCoords )
+	{
+		// Interleaved layout: float position, 10-bit normal, 8-bit color and half or float UVs, only for available attributes.
+		const size_t normalOffset = 3 * sizeof(GLfloat);
+		const size_t colorOffset = normalOffset + (mesh.hasNormals() ? sizeof(uint32_t) : 0);
+		const size_t texCoordOffset = colorOffset + (mesh.hasColors() ? 4 * sizeof(uint8) : 0);
+		const size_t stride = texCoordOffset + (mesh.hasTexCoords() ? (halfTexCoords ? 2 * sizeof(uint16_t) : 2 * sizeof(GLfloat)) : 0);
+
+		const int numVertices = int(mesh.vertices().size());
+		std::vector<uint8> vertexData(stride * numVertices);
+#pragma omp parallel for
+		for (int vid = 0; vid < numVertices; ++vid) {
+			const uint src = vertexOrder.empty() ? uint(vid) : vertexOrder[vid];
+			uint8 * dst = vertexData.data() + stride * vid;
+			std::memcpy(dst, mesh.vertices()[src].data(), 3 * sizeof(GLfloat));
+			if (mesh.hasNormals()) {
+				const uint32_t normal = MeshOptimizer::packNormal(mesh.normals()[src]);
+				std::memcpy(dst + normalOffset, &normal, sizeof(normal));
+			}
+			if (mesh.hasColors()) {
+				for (int k = 0; k < 3; ++k) {
+					dst[colorOffset + k] = uint8(std::round(std::min(std::max(mesh.colors()[src][k], 0.0f), 1.0f) * 255.0f));
+				}
+				dst[colorOffset + 3] = 255;
+			}
+			if (mesh.hasTexCoords()) {
+				const Vector2f & uv = mesh.texCoords()[src];
+				if (halfTexCoords) {
+					const uint16_t halfs[2] = { MeshOptimizer::toHalf(uv[0]), MeshOptimizer::toHalf(uv[1]) };
+					std::memcpy(dst + texCoordOffset, halfs, sizeof(halfs));
+				}
+				else {
+					std::memcpy(dst + texCoordOffset, uv.data(), 2 * sizeof(GLfloat));
+				}
+			}
+		}
+
+		glBindBuffer(GL_ARRAY_BUFFER, _bufferIds[BUFVERTEX]);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(uint8)*vertexData.size(), vertexData.data(), GL_STATIC_DRAW);
+		CHECK_GL_ERROR;
+
+		const GLsizei glStride = GLsizei(stride);
+		glVertexAttribPointer(VertexAttribLocation, 3, GL_FLOAT, GL_FALSE, glStride, (uint8_t*)(0));
+		glEnableVertexAttribArray(VertexAttribLocation);
+		// Missing attributes are disabled, shaders then read the default attribute value.
+		if (mesh.hasColors()) {
+			glVertexAttribPointer(ColorAttribLocation, 4, GL_UNSIGNED_BYTE, GL_TRUE, glStride, (uint8_t*)(0) + colorOffset);
+			glEnableVertexAttribArray(ColorAttribLocation);
+		}
+		else {
+			glDisableVertexAttribArray(ColorAttribLocation);
+		}
+		if (mesh.hasTexCoords()) {
+			glVertexAttribPointer(TexCoordAttribLocation, 2, halfTexCoords ? GL_HALF_FLOAT : GL_FLOAT, GL_FALSE, glStride, (uint8_t*)(0) + texCoordOffset);
+			glEnableVertexAttribArray(TexCoordAttribLocation);
+		}
+		else {
+			glDisableVertexAttribArray(TexCoordAttribLocation);
+		}
+		if (mesh.hasNormals()) {
+			glVertexAttribPointer(NormalAttribLocation, 4, GL_INT_2_10_10_10_REV, GL_TRUE, glStride, (uint8_t*)(0) + normalOffset);
+			glEnableVertexAttribArray(NormalAttribLocation);
+		}
+		else {
+			glDisableVertexAttribArray(NormalAttribLocation);
+		}
+		CHECK_GL_ERROR;
 	}
 
 	void	MeshBufferGL::free(void)
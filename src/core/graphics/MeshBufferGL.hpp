@@ -15,6 +15,7 @@
 # include <array>
 # include <vector>
 # include "core/graphics/Config.hpp"
+# include "core/graphics/MeshOptimizer.hpp"
 
 
 namespace sibr
@@ -72,6 +73,15 @@ namespace sibr
 			} 
 		}; 
 
+		/** Optional optimizations applied when building the buffers, see MeshOptimizer. */
+		struct Options {
+			bool reorder = false; ///< Reorder triangles for the vertex cache and vertices for fetch locality. Triangle and vertex IDs seen by shaders and by draw ranges then differ from the mesh ones.
+			bool compact = false; ///< Interleave attributes, with 10-bit normals and 8-bit colors (clamped to [0,1]).
+			bool halfTexCoords = false; ///< When compact, store UVs as half floats, precise enough for textures up to 2K.
+			bool meshlets = false; ///< Group consecutive triangles in meshlets with bounding spheres, see meshlets().
+			bool log = true; ///< Log vertex cache statistics before and after reordering.
+		};
+
 	public:
 
 		/// Constructor.
@@ -100,6 +110,16 @@ namespace sibr
 		*/
 		void	build( const Mesh& mesh, bool adjacency = false );
 
+		/** Build from a mesh, applying CPU optimizations to the buffers before upload.
+		* \param mesh the mesh to upload
+		* \param options the optimizations to apply
+		* \param adjacency tells whether the indices should contain adjacents vertices (vertices are then not renumbered)
+		*/
+		void	build( const Mesh& mesh, const Options& options, bool adjacency = false );
+
+		/** \return the meshlets built with the last upload, empty if not requested. Their index ranges can be passed to draw(begin, end). */
+		const std::vector<MeshOptimizer::Meshlet> &	meshlets(void) const { return _meshlets; }
+
 		/** Delete the GPU buffer, freeing memory. */
 		void	free(void);
 
@@ -146,12 +166,29 @@ namespace sibr
 		MeshBufferGL& operator =(const MeshBufferGL&) = delete;
 
 	private:
+
+		/** Upload attributes as consecutive float arrays, in the vertex buffer.
+		* \param vertices the positions
+		* \param colors the colors, can be empty
+		* \param texcoords the texture coordinates, can be empty
+		* \param normals the normals, can be empty
+		*/
+		void	uploadAttributes( const std::vector<GLfloat>& vertices, const std::vector<GLfloat>& colors,
+			const std::vector<GLfloat>& texcoords, const std::vector<GLfloat>& normals );
+
+		/** Upload interleaved and quantized attributes in the vertex buffer.
+		* \param mesh the mesh
+		* \param vertexOrder for each vertex of the buffer, the mesh vertex to use (identity if empty)
+		* \param halfTexCoords store UVs as half floats
+		*/
+		void	uploadCompactAttributes( const Mesh& mesh, const std::vector<uint>& vertexOrder, bool halfTexCoords );
 		
 		GLuint 							_vaoId; ///< Vertex array object ID.
 		std::array<GLuint, BUFCOUNT>	_bufferIds; ///< Buffers IDs.
 		uint 							_indexCount; ///< Number of elements in the index buffer.
 		uint							_adjacentIndexCount; ///< Number of elements in the triangles_adjacency index buffer.
 		uint							_vertexCount; ///< Number of elements in the vertex buffer.
+		std::vector<MeshOptimizer::Meshlet>	_meshlets; ///< Triangle clusters of the index buffer.
 
 		bool initVertexBuffer = false,
 			 initIndexBuffer = false,
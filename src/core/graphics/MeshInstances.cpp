@@ -0,0 +1,305 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#include "core/graphics/MeshInstances.hpp"
+#include "core/system/SimpleTimer.hpp"
+#include "core/system/TaskScheduler.hpp"
+#include "core/system/XMLTree.h"
+
+#include <random>
+#include <boost/filesystem.hpp>
+
+namespace sibr
+{
+	// Mitsuba parsing helpers, defined with the MaterialMesh loader.
+	sibr::Matrix4f parseTransform(const rapidxml::xml_node<>* nodeTrans);
+	bool shouldFlipNormals(const rapidxml::xml_node<>* shape);
+	std::string parseFilename(const rapidxml::xml_node<>* shape);
+
+	uint MeshInstances::addMesh(const Mesh::Ptr & mesh)
+	{
+		_meshes.push_back(mesh);
+		return uint(_meshes.size() - 1);
+	}
+
+	void MeshInstances::addInstance(uint mesh, const Matrix4f & toWorld, bool flipNormals)
+	{
+		Instance instance;
+		instance.mesh = mesh;
+		instance.toWorld = toWorld;
+		instance.flipNormals = flipNormals;
+		_instances.push_back(instance);
+	}
+
+	void MeshInstances::clear()
+	{
+		_meshes.clear();
+		_instances.clear();
+	}
+
+	bool MeshInstances::loadMtsXML(const std::string & xmlFile, bool withGraphics)
+	{
+		const std::string pathFolder = boost::filesystem::path(xmlFile).parent_path().string();
+		sibr::XMLTree doc(xmlFile);
+		rapidxml::xml_node<>* nodeScene = doc.first_node("scene");
+		if (!nodeScene) {
+			SIBR_WRG << "No scene found in " << xmlFile << "." << std::endl;
+			return false;
+		}
+
+		// Each file is loaded once.
+		std::map<std::string, uint> fileToMesh;
+		const auto meshFor = [&](const std::string & filename, uint & meshId) {
+			const auto known = fileToMesh.find(filename);
+			if (known != fileToMesh.end()) {
+				meshId = known->second;
+				return true;
+			}
+			Mesh::Ptr mesh(new Mesh(withGraphics));
+			if (!mesh->load(pathFolder + "/" + filename)) {
+				return false;
+			}
+			meshId = addMesh(mesh);
+			fileToMesh[filename] = meshId;
+			return true;
+		};
+
+		struct Shape {
+			std::string filename;
+			Matrix4f toWorld;
+			bool flipNormals;
+		};
+		std::map<std::string, std::vector<Shape>> shapeGroups;
+		std::map<std::string, Matrix4f> shapeGroupTransforms;
+		for (rapidxml::xml_node<>* node = nodeScene->first_node("shape"); node; node = node->next_sibling("shape")) {
+			rapidxml::xml_attribute<>* type = node->first_attribute("type");
+			if (!type || strcmp(type->value(), "shapegroup") != 0) {
+				continue;
+			}
+			const std::string id = node->first_attribute("id")->value();
+			for (rapidxml::xml_node<>* shapeNode = node->first_node("shape"); shapeNode; shapeNode = shapeNode->next_sibling("shape")) {
+				shapeGroups[id].push_back({ parseFilename(shapeNode), parseTransform(shapeNode->first_node("transform")), shouldFlipNormals(shapeNode) });
+			}
+			shapeGroupTransforms[id] = parseTransform(node->first_node("transform"));
+		}
+
+		size_t shapeCount = 0;
+		for (rapidxml::xml_node<>* node = nodeScene->first_node("shape"); node; node = node->next_sibling("shape")) {
+			rapidxml::xml_attribute<>* type = node->first_attribute("type");
+			if (!type) {
+				continue;
+			}
+			if (strcmp(type->value(), "instance") == 0) {
+				const std::string id = node->first_node("ref")->first_attribute("id")->value();
+				const auto group = shapeGroups.find(id);
+				if (group == shapeGroups.end()) {
+					SIBR_WRG << "Could not find shapegroup " << id << "." << std::endl;
+					continue;
+				}
+				const Matrix4f objectToWorld = shapeGroupTransforms[id] * parseTransform(node->first_node("transform"));
+				for (const Shape & shape : group->second) {
+					uint meshId;
+					if (!meshFor(shape.filename, meshId)) {
+						return false;
+					}
+					addInstance(meshId, shape.toWorld * objectToWorld, shape.flipNormals);
+				}
+			}
+			else if (strcmp(type->value(), "obj") == 0 || strcmp(type->value(), "ply") == 0) {
+				uint meshId;
+				if (!meshFor(node->first_node("string")->first_attribute("value")->value(), meshId)) {
+					return false;
+				}
+				addInstance(meshId, parseTransform(node->first_node("transform")), shouldFlipNormals(node));
+			}
+			else {
+				continue;
+			}
+			++shapeCount;
+		}
+		SIBR_LOG << "[MeshInstances] Loaded " << _meshes.size() << " meshes and " << _instances.size() << " instances from "
+			<< shapeCount << " shapes (" << triangleCount() << " triangles once flattened)." << std::endl;
+		return true;
+	}
+
+	MeshInstances::Ptr MeshInstances::load(const std::string & xmlFile, bool withGraphics)
+	{
+		MeshInstances::Ptr instances(new MeshInstances());
+		if (!instances->loadMtsXML(xmlFile, withGraphics)) {
+			return nullptr;
+		}
+		return instances;
+	}
+
+	size_t MeshInstances::vertexCount() const
+	{
+		size_t count = 0;
+		for (const Instance & instance : _instances) {
+			count += _meshes[instance.mesh]->vertices().size();
+		}
+		return count;
+	}
+
+	size_t MeshInstances::triangleCount() const
+	{
+		size_t count = 0;
+		for (const Instance & instance : _instances) {
+			count += _meshes[instance.mesh]->triangles().size();
+		}
+		return count;
+	}
+
+	size_t MeshInstances::memorySize() const
+	{
+		size_t bytes = _instances.size() * sizeof(Instance);
+		for (const Mesh::Ptr & mesh : _meshes) {
+			bytes += mesh->vertices().size() * sizeof(Vector3f) + mesh->normals().size() * sizeof(Vector3f)
+				+ mesh->colors().size() * sizeof(Vector3f) + mesh->texCoords().size() * sizeof(Vector2f)
+				+ mesh->triangles().size() * sizeof(Vector3u);
+		}
+		return bytes;
+	}
+
+	Eigen::AlignedBox3f MeshInstances::getBoundingBox() const
+	{
+		std::vector<Eigen::AlignedBox3f> meshBoxes(_meshes.size());
+		for (size_t mid = 0; mid < _meshes.size(); ++mid) {
+			meshBoxes[mid] = _meshes[mid]->getBoundingBox();
+		}
+		Eigen::AlignedBox3f box;
+		for (const Instance & instance : _instances) {
+			const Eigen::AlignedBox3f & local = meshBoxes[instance.mesh];
+			if (local.isEmpty()) {
+				continue;
+			}
+			for (int cid = 0; cid < 8; ++cid) {
+				const Vector3f corner = local.corner(Eigen::AlignedBox3f::CornerType(cid));
+				box.extend((instance.toWorld * Vector4f(corner[0], corner[1], corner[2], 1.0f)).xyz());
+			}
+		}
+		return box;
+	}
+
+	void MeshInstances::flatten(Mesh & mesh) const
+	{
+		// Offsets of each instance in the merged arrays.
+		const int instanceCount = int(_instances.size());
+		std::vector<size_t> vertexOffsets(instanceCount + 1, 0);
+		std::vector<size_t> triangleOffsets(instanceCount + 1, 0);
+		for (int iid = 0; iid < instanceCount; ++iid) {
+			const Mesh & shared = *_meshes[_instances[iid].mesh];
+			vertexOffsets[iid + 1] = vertexOffsets[iid] + shared.vertices().size();
+			triangleOffsets[iid + 1] = triangleOffsets[iid] + shared.triangles().size();
+		}
+		bool withNormals = !_instances.empty(), withColors = !_instances.empty(), withUVs = !_instances.empty();
+		for (const Mesh::Ptr & shared : _meshes) {
+			withNormals = withNormals && shared->hasNormals();
+			withColors = withColors && shared->hasColors();
+			withUVs = withUVs && shared->hasTexCoords();
+		}
+
+		Mesh::Vertices vertices(vertexOffsets.back());
+		Mesh::Normals normals(withNormals ? vertexOffsets.back() : 0);
+		Mesh::Colors colors(withColors ? vertexOffsets.back() : 0);
+		Mesh::UVs texCoords(withUVs ? vertexOffsets.back() : 0);
+		Mesh::Triangles triangles(triangleOffsets.back());
+
+		sibr::parallelFor(0, instanceCount, [&](int iid) {
+			const Instance & instance = _instances[iid];
+			const Mesh & shared = *_meshes[instance.mesh];
+			const size_t vOffset = vertexOffsets[iid];
+			const Matrix3f normalMatrix = (instance.flipNormals ? -1.0f : 1.0f) * Matrix3f(instance.toWorld.block<3, 3>(0, 0).inverse().transpose());
+			for (size_t vid = 0; vid < shared.vertices().size(); ++vid) {
+				const Vector3f & p = shared.vertices()[vid];
+				vertices[vOffset + vid] = (instance.toWorld * Vector4f(p[0], p[1], p[2], 1.0f)).xyz();
+				if (withNormals) {
+					normals[vOffset + vid] = (normalMatrix * shared.normals()[vid]).normalized();
+				}
+				if (withColors) {
+					colors[vOffset + vid] = shared.colors()[vid];
+				}
+				if (withUVs) {
+					texCoords[vOffset + vid] = shared.texCoords()[vid];
+				}
+			}
+			const Vector3u shift(uint(vOffset), uint(vOffset), uint(vOffset));
+			for (size_t tid = 0; tid < shared.triangles().size(); ++tid) {
+				triangles[triangleOffsets[iid] + tid] = shared.triangles()[tid] + shift;
+			}
+		}, 16);
+
+		mesh.vertices(vertices);
+		mesh.normals(normals);
+		mesh.colors(colors);
+		mesh.texCoords(texCoords);
+		mesh.triangles(triangles);
+	}
+
+	Mesh::Ptr MeshInstances::flatten(bool withGraphics) const
+	{
+		Mesh::Ptr mesh(new Mesh(withGraphics));
+		flatten(*mesh);
+		return mesh;
+	}
+
+	void MeshInstances::render(GLuniform<Matrix4f> & mvp, const Matrix4f & viewProj, bool depthTest, bool backFaceCulling) const
+	{
+		for (const Instance & instance : _instances) {
+			mvp.set(viewProj * instance.toWorld);
+			_meshes[instance.mesh]->render(depthTest, backFaceCulling);
+		}
+	}
+
+	void MeshInstances::benchmark(uint assets, uint instances)
+	{
+		MeshInstances scene;
+		for (uint aid = 0; aid < assets; ++aid) {
+			const Mesh::Ptr asset = Mesh::getSphereMesh(Vector3f(0.0f, 0.0f, 0.0f), 1.0f, false, 50 + 10 * int(aid));
+			scene.addMesh(asset);
+		}
+		std::mt19937 gen(0);
+		std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+		std::uniform_real_distribution<float> scale(0.5f, 2.0f);
+		for (uint iid = 0; iid < instances; ++iid) {
+			Matrix4f toWorld = Matrix4f::Identity();
+			toWorld.block<3, 3>(0, 0) *= scale(gen);
+			toWorld.block<3, 1>(0, 3) = Vector3f(position(gen), position(gen), position(gen));
+			scene.addInstance(iid % assets, toWorld);
+		}
+
+		// Previous loading path: one transformed copy merged per instance.
+		Timer timer(true);
+		Mesh merged(false);
+		for (const Instance & instance : scene.instances()) {
+			Mesh toWorldMesh = *scene.meshes()[instance.mesh];
+			Mesh::Vertices transformed(toWorldMesh.vertices().size());
+			for (size_t vid = 0; vid < transformed.size(); ++vid) {
+				const Vector3f & p = toWorldMesh.vertices()[vid];
+				transformed[vid] = (instance.toWorld * Vector4f(p[0], p[1], p[2], 1.0f)).xyz();
+			}
+			toWorldMesh.vertices(transformed);
+			merged.merge(toWorldMesh);
+		}
+		const double mergeTime = timer.deltaTimeFromLastTic<Timer::micro>() * 1e-6;
+
+		timer.tic();
+		const Mesh::Ptr flat = scene.flatten(false);
+		const double flattenTime = timer.deltaTimeFromLastTic<Timer::micro>() * 1e-6;
+
+		MeshInstances flatScene;
+		flatScene.addMesh(flat);
+		SIBR_LOG << "[MeshInstances] " << assets << " meshes, " << instances << " instances, " << scene.triangleCount() << " triangles: "
+			<< "incremental merge " << mergeTime << "s, single flatten " << flattenTime << "s, memory instanced "
+			<< double(scene.memorySize()) / (1024.0 * 1024.0) << "MB, flattened " << double(flatScene.memorySize()) / (1024.0 * 1024.0) << "MB." << std::endl;
+	}
+
+} // namespace sibr
@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+# include "core/graphics/Config.hpp"
+# include "core/graphics/Mesh.hpp"
+# include "core/graphics/Shader.hpp"
+# include "core/system/Matrix.hpp"
+
+namespace sibr
+{
+	/** \brief Scene made of shared meshes placed several times with different transformations.
+	* Each mesh is stored (and uploaded to the GPU) once, and instances only store a reference and a transformation,
+	* so that scenes with many repeated assets stay small. A single merged mesh can be generated on request with flatten(),
+	* the Raycaster can use them directly as Embree instances (see Raycaster::addInstances).
+	* \ingroup sibr_graphics
+	*/
+	class SIBR_GRAPHICS_EXPORT MeshInstances
+	{
+		SIBR_CLASS_PTR(MeshInstances);
+
+	public:
+
+		/** An instance of a shared mesh. */
+		struct Instance {
+			uint mesh = 0; ///< Index of the shared mesh.
+			Matrix4f toWorld = Matrix4f::Identity(); ///< Object to world transformation.
+			bool flipNormals = false; ///< Should the normals be flipped.
+		};
+
+		/** Add a shared mesh.
+		\param mesh the mesh
+		\return its index, to reference in instances
+		*/
+		uint addMesh(const Mesh::Ptr & mesh);
+
+		/** Add an instance of a shared mesh.
+		\param mesh the shared mesh index
+		\param toWorld the object to world transformation
+		\param flipNormals should the normals be flipped
+		*/
+		void addInstance(uint mesh, const Matrix4f & toWorld, bool flipNormals = false);
+
+		/** \return the shared meshes */
+		const std::vector<Mesh::Ptr> & meshes() const { return _meshes; }
+
+		/** \return the instances */
+		const std::vector<Instance> & instances() const { return _instances; }
+
+		/** Remove all meshes and instances. */
+		void clear();
+
+		/** Load the shapes of a Mitsuba scene, keeping repeated shapes and shapegroup instances shared.
+		\param xmlFile the scene file
+		\param withGraphics should the shared meshes be on the GPU
+		\return a success boolean
+		*/
+		bool loadMtsXML(const std::string & xmlFile, bool withGraphics = false);
+
+		/** Load the shapes of a Mitsuba scene in a new set of instances, see loadMtsXML.
+		\param xmlFile the scene file
+		\param withGraphics should the shared meshes be on the GPU
+		\return the instances, or nullptr if loading failed
+		*/
+		static MeshInstances::Ptr load(const std::string & xmlFile, bool withGraphics = false);
+
+		/** \return the number of vertices once flattened */
+		size_t vertexCount() const;
+
+		/** \return the number of triangles once flattened */
+		size_t triangleCount() const;
+
+		/** \return the memory used by the shared geometry and the instances, in bytes */
+		size_t memorySize() const;
+
+		/** \return the bounding box of all instances */
+		Eigen::AlignedBox3f getBoundingBox() const;
+
+		/** Merge all instances in a single mesh, allocated once and filled in parallel.
+		Attributes are kept only if all shared meshes have them, normals are transformed.
+		\param mesh will contain the merged geometry
+		*/
+		void flatten(Mesh & mesh) const;
+
+		/** Merge all instances in a new mesh, see flatten(Mesh&).
+		\param withGraphics should the mesh be on the GPU
+		\return the merged mesh
+		*/
+		Mesh::Ptr flatten(bool withGraphics = true) const;
+
+		/** Render all instances with the shared GPU buffers, updating a transformation uniform of the currently bound shader for each instance.
+		\param mvp the model-view-projection uniform
+		\param viewProj the view-projection matrix of the camera
+		\param depthTest should depth testing be performed
+		\param backFaceCulling should culling be performed
+		*/
+		void render(GLuniform<Matrix4f> & mvp, const Matrix4f & viewProj, bool depthTest = true, bool backFaceCulling = true) const;
+
+		/** Compare instanced loading and flattening on a synthetic scene, logging timings and memory.
+		\param assets number of distinct meshes
+		\param instances number of instances
+		*/
+		static void benchmark(uint assets = 10, uint instances = 10000);
+
+	private:
+
+		std::vector<Mesh::Ptr> _meshes; ///< Shared meshes.
+		std::vector<Instance> _instances; ///< Instances of the shared meshes.
+	};
+
+} // namespace sibr
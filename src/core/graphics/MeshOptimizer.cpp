@@ -0,0 +1,284 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#include "core/graphics/MeshOptimizer.hpp"
+#include "core/graphics/Mesh.hpp"
+#include "core/system/SimpleTimer.hpp"
+
+#include <cstring>
+
+namespace sibr
+{
+	MeshOptimizer::CacheStats MeshOptimizer::analyzeVertexCache(const std::vector<uint> & indices, uint vertexCount, uint cacheSize)
+	{
+		CacheStats stats;
+		if (indices.empty()) {
+			return stats;
+		}
+		// A vertex is in the FIFO if it was pushed less than cacheSize misses ago.
+		std::vector<size_t> pushedAt(vertexCount, 0);
+		std::vector<uint8_t> referenced(vertexCount, 0);
+		size_t misses = 0;
+		for (const uint vid : indices) {
+			if (pushedAt[vid] == 0 || misses - (pushedAt[vid] - 1) >= cacheSize) {
+				++misses;
+				pushedAt[vid] = misses;
+			}
+			referenced[vid] = 1;
+		}
+		size_t referencedCount = 0;
+		for (const uint8_t flag : referenced) {
+			referencedCount += flag;
+		}
+		stats.acmr = float(double(misses) / double(indices.size() / 3));
+		stats.atvr = float(double(misses) / double(std::max(referencedCount, size_t(1))));
+		return stats;
+	}
+
+	void MeshOptimizer::optimizeVertexCache(std::vector<uint> & indices, uint vertexCount, uint cacheSize)
+	{
+		const uint triangleCount = uint(indices.size() / 3);
+		if (triangleCount == 0) {
+			return;
+		}
+
+		// Vertex to triangles adjacency, and number of triangles left to emit per vertex.
+		std::vector<uint> offsets(vertexCount + 1, 0);
+		for (const uint vid : indices) {
+			++offsets[vid + 1];
+		}
+		for (uint vid = 0; vid < vertexCount; ++vid) {
+			offsets[vid + 1] += offsets[vid];
+		}
+		std::vector<uint> liveCounts(vertexCount);
+		for (uint vid = 0; vid < vertexCount; ++vid) {
+			liveCounts[vid] = offsets[vid + 1] - offsets[vid];
+		}
+		std::vector<uint> adjacency(indices.size());
+		{
+			std::vector<uint> cursors(offsets.begin(), offsets.end() - 1);
+			for (uint tid = 0; tid < triangleCount; ++tid) {
+				for (uint k = 0; k < 3; ++k) {
+					adjacency[cursors[indices[3 * tid + k]]++] = tid;
+				}
+			}
+		}
+
+		std::vector<uint> output;
+		output.reserve(indices.size());
+		std::vector<uint> timestamps(vertexCount, 0);
+		std::vector<uint8_t> emitted(triangleCount, 0);
+		std::vector<uint> deadEnds;
+		std::vector<uint> candidates;
+		uint time = cacheSize + 1;
+		uint cursor = 0;
+		int fanning = 0;
+
+		while (fanning >= 0) {
+			// Emit all the triangles around the fanning vertex.
+			candidates.clear();
+			for (uint aid = offsets[fanning]; aid < offsets[fanning + 1]; ++aid) {
+				const uint tid = adjacency[aid];
+				if (emitted[tid]) {
+					continue;
+				}
+				emitted[tid] = 1;
+				for (uint k = 0; k < 3; ++k) {
+					const uint vid = indices[3 * tid + k];
+					output.push_back(vid);
+					deadEnds.push_back(vid);
+					candidates.push_back(vid);
+					--liveCounts[vid];
+					if (time - timestamps[vid] > cacheSize) {
+						timestamps[vid] = time++;
+					}
+				}
+			}
+
+			// Next fanning vertex: the oldest candidate that will still be in the cache after its fan is emitted.
+			int next = -1;
+			int bestPriority = -1;
+			for (const uint vid : candidates) {
+				if (liveCounts[vid] == 0) {
+					continue;
+				}
+				int priority = 0;
+				if (time - timestamps[vid] + 2 * liveCounts[vid] <= cacheSize) {
+					priority = int(time - timestamps[vid]);
+				}
+				if (priority > bestPriority) {
+					bestPriority = priority;
+					next = int(vid);
+				}
+			}
+			// Dead end: use a recently referenced vertex, or the next vertex in input order.
+			while (next < 0 && !deadEnds.empty()) {
+				const uint vid = deadEnds.back();
+				deadEnds.pop_back();
+				if (liveCounts[vid] > 0) {
+					next = int(vid);
+				}
+			}
+			while (next < 0 && cursor < vertexCount) {
+				if (liveCounts[cursor] > 0) {
+					next = int(cursor);
+				}
+				++cursor;
+			}
+			fanning = next;
+		}
+		indices.swap(output);
+	}
+
+	std::vector<uint> MeshOptimizer::optimizeVertexFetch(std::vector<uint> & indices, uint vertexCount)
+	{
+		std::vector<int> newIds(vertexCount, -1);
+		std::vector<uint> oldIds;
+		oldIds.reserve(vertexCount);
+		for (uint & vid : indices) {
+			if (newIds[vid] < 0) {
+				newIds[vid] = int(oldIds.size());
+				oldIds.push_back(vid);
+			}
+			vid = uint(newIds[vid]);
+		}
+		// Keep unreferenced vertices, so that point rendering still sees all of them.
+		for (uint vid = 0; vid < vertexCount; ++vid) {
+			if (newIds[vid] < 0) {
+				oldIds.push_back(vid);
+			}
+		}
+		return oldIds;
+	}
+
+	std::vector<MeshOptimizer::Meshlet> MeshOptimizer::buildMeshlets(const std::vector<uint> & indices, const std::vector<Vector3f> & positions, uint maxVertices, uint maxTriangles)
+	{
+		std::vector<Meshlet> meshlets;
+		// Last meshlet each vertex was added to, offset by one.
+		std::vector<uint> lastMeshlet(positions.size(), 0);
+		std::vector<uint> meshletVertices;
+		const auto finish = [&](Meshlet & meshlet) {
+			Eigen::AlignedBox3f box;
+			for (const uint vid : meshletVertices) {
+				box.extend(positions[vid]);
+			}
+			meshlet.center = box.center();
+			for (const uint vid : meshletVertices) {
+				meshlet.radius = std::max(meshlet.radius, (positions[vid] - meshlet.center).norm());
+			}
+			meshlet.vertexCount = uint(meshletVertices.size());
+			meshlets.push_back(meshlet);
+			meshletVertices.clear();
+		};
+
+		Meshlet current;
+		for (uint tid = 0; tid < uint(indices.size() / 3); ++tid) {
+			const uint meshletId = uint(meshlets.size()) + 1;
+			uint newVertices = 0;
+			for (uint k = 0; k < 3; ++k) {
+				newVertices += lastMeshlet[indices[3 * tid + k]] != meshletId ? 1 : 0;
+			}
+			if (current.triangleCount > 0 && (meshletVertices.size() + newVertices > maxVertices || current.triangleCount + 1 > maxTriangles)) {
+				finish(current);
+				current = Meshlet();
+				current.firstIndex = 3 * tid;
+			}
+			const uint id = uint(meshlets.size()) + 1;
+			for (uint k = 0; k < 3; ++k) {
+				const uint vid = indices[3 * tid + k];
+				if (lastMeshlet[vid] != id) {
+					lastMeshlet[vid] = id;
+					meshletVertices.push_back(vid);
+				}
+			}
+			++current.triangleCount;
+		}
+		if (current.triangleCount > 0) {
+			finish(current);
+		}
+		return meshlets;
+	}
+
+	uint16_t MeshOptimizer::toHalf(float value)
+	{
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		const uint32_t sign = (bits >> 16) & 0x8000u;
+		const int exponent = int((bits >> 23) & 0xFFu) - 127 + 15;
+		uint32_t mantissa = bits & 0x7FFFFFu;
+
+		if (((bits >> 23) & 0xFFu) == 0xFFu) {
+			// Infinity or NaN.
+			return uint16_t(sign | 0x7C00u | (mantissa ? 0x200u : 0u));
+		}
+		if (exponent >= 31) {
+			return uint16_t(sign | 0x7C00u);
+		}
+		if (exponent <= 0) {
+			// Denormalized half, or zero.
+			if (exponent < -10) {
+				return uint16_t(sign);
+			}
+			mantissa |= 0x800000u;
+			const uint32_t shift = uint32_t(14 - exponent);
+			uint32_t half = mantissa >> shift;
+			const uint32_t remainder = mantissa & ((1u << shift) - 1u);
+			const uint32_t halfway = 1u << (shift - 1);
+			if (remainder > halfway || (remainder == halfway && (half & 1u))) {
+				++half;
+			}
+			return uint16_t(sign | half);
+		}
+		uint32_t half = (uint32_t(exponent) << 10) | (mantissa >> 13);
+		const uint32_t remainder = mantissa & 0x1FFFu;
+		// Rounding can carry into the exponent, which is the expected result.
+		if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u))) {
+			++half;
+		}
+		return uint16_t(sign | half);
+	}
+
+	uint32_t MeshOptimizer::packNormal(const Vector3f & n)
+	{
+		uint32_t packed = 0;
+		for (int k = 0; k < 3; ++k) {
+			const float c = std::min(std::max(n[k], -1.0f), 1.0f);
+			const int value = int(std::round(c * 511.0f));
+			packed |= (uint32_t(value) & 0x3FFu) << (10 * k);
+		}
+		return packed;
+	}
+
+	void MeshOptimizer::benchmark(const Mesh & mesh)
+	{
+		const uint vertexCount = uint(mesh.vertices().size());
+		std::vector<uint> indices(mesh.triangleArray(), mesh.triangleArray() + mesh.triangles().size() * 3);
+		const CacheStats before = analyzeVertexCache(indices, vertexCount);
+
+		Timer timer(true);
+		optimizeVertexCache(indices, vertexCount);
+		const double cacheTime = timer.deltaTimeFromLastTic<Timer::micro>() * 1e-6;
+		const CacheStats after = analyzeVertexCache(indices, vertexCount);
+
+		timer.tic();
+		optimizeVertexFetch(indices, vertexCount);
+		const std::vector<Meshlet> meshlets = buildMeshlets(indices, mesh.vertices());
+		const double fetchTime = timer.deltaTimeFromLastTic<Timer::micro>() * 1e-6;
+
+		const size_t floatSize = 12 + (mesh.hasColors() ? 12 : 0) + (mesh.hasTexCoords() ? 8 : 0) + (mesh.hasNormals() ? 12 : 0);
+		const size_t packedSize = 12 + (mesh.hasColors() ? 4 : 0) + (mesh.hasTexCoords() ? 4 : 0) + (mesh.hasNormals() ? 4 : 0);
+		SIBR_LOG << "[MeshOptimizer] " << mesh.triangles().size() << " triangles: ACMR " << before.acmr << " -> " << after.acmr
+			<< ", ATVR " << before.atvr << " -> " << after.atvr << " (" << cacheTime << "s), vertex fetch and " << meshlets.size()
+			<< " meshlets in " << fetchTime << "s, " << floatSize << " -> " << packedSize << " bytes per vertex." << std::endl;
+	}
+
+} // namespace sibr
@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+# include <vector>
+# include "core/graphics/Config.hpp"
+# include "core/system/Vector.hpp"
+
+namespace sibr
+{
+	class Mesh;
+
+	/** \brief CPU optimizations of index and vertex buffers before their upload, see MeshBufferGL::Options.
+	* Triangles are reordered for the post-transform vertex cache with Tipsify (Sander et al. 2007), vertices are
+	* renumbered in their first use order for fetch locality, and consecutive triangles can be grouped in meshlets
+	* with bounding spheres, for culling. All statistics are computed on the CPU, with a FIFO cache simulation.
+	* \ingroup sibr_graphics
+	*/
+	class SIBR_GRAPHICS_EXPORT MeshOptimizer
+	{
+	public:
+
+		/** Post-transform vertex cache statistics. */
+		struct CacheStats {
+			float acmr = 0.0f; ///< Average cache miss ratio, transformed vertices per triangle (0.5 at best, 3 at worst).
+			float atvr = 0.0f; ///< Average transformed vertex ratio, transformed vertices per referenced vertex (1 at best).
+		};
+
+		/** A group of consecutive triangles in the index buffer. */
+		struct Meshlet {
+			uint firstIndex = 0; ///< Position of the first index in the index buffer.
+			uint triangleCount = 0; ///< Number of triangles.
+			uint vertexCount = 0; ///< Number of distinct vertices.
+			Vector3f center = Vector3f(0.0f, 0.0f, 0.0f); ///< Bounding sphere center.
+			float radius = 0.0f; ///< Bounding sphere radius.
+		};
+
+		/** Simulate a FIFO post-transform cache.
+		\param indices the triangle indices
+		\param vertexCount the number of vertices
+		\param cacheSize the number of cache entries
+		\return the cache statistics
+		*/
+		static CacheStats analyzeVertexCache(const std::vector<uint> & indices, uint vertexCount, uint cacheSize = 16);
+
+		/** Reorder triangles to improve post-transform vertex cache hits, using Tipsify.
+		\param indices the triangle indices, reordered in place
+		\param vertexCount the number of vertices
+		\param cacheSize the number of cache entries targeted
+		*/
+		static void optimizeVertexCache(std::vector<uint> & indices, uint vertexCount, uint cacheSize = 16);
+
+		/** Renumber vertices in the order of their first use by the triangles, unreferenced vertices at the end.
+		\param indices the triangle indices, updated in place
+		\param vertexCount the number of vertices
+		\return for each new vertex position, the index of the original vertex
+		*/
+		static std::vector<uint> optimizeVertexFetch(std::vector<uint> & indices, uint vertexCount);
+
+		/** Split the triangles in groups of consecutive triangles with a bounded number of vertices.
+		\param indices the triangle indices
+		\param positions the vertex positions
+		\param maxVertices the maximum number of distinct vertices in a meshlet
+		\param maxTriangles the maximum number of triangles in a meshlet
+		\return the meshlets, covering all triangles in order
+		*/
+		static std::vector<Meshlet> buildMeshlets(const std::vector<uint> & indices, const std::vector<Vector3f> & positions, uint maxVertices = 64, uint maxTriangles = 126);
+
+		/** Convert a float to a IEEE half float, rounding to nearest.
+		\param value the value to convert
+		\return the half float bits
+		*/
+		static uint16_t toHalf(float value);
+
+		/** Pack a unit vector in a signed normalized GL_INT_2_10_10_10_REV value.
+		\param n the vector
+		\return the packed value
+		*/
+		static uint32_t packNormal(const Vector3f & n);
+
+		/** Log the cache statistics and vertex sizes before and after optimization of a mesh.
+		\param mesh the mesh to analyze
+		*/
+		static void benchmark(const Mesh & mesh);
+	};
+
+} // namespace sibr
@@ -0,0 +1,856 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#include "core/graphics/MeshSimplifier.hpp"
+#include "core/system/SimpleTimer.hpp"
+#include "core/system/String.hpp"
+
+#include <fstream>
+#include <queue>
+#include <random>
+
+namespace sibr
+{
+	namespace {
+
+		typedef Eigen::Matrix<double, 3, 1> Vector3d;
+
+		/** Symmetric 4x4 quadric, storing its 10 unique coefficients and the total weight of its planes. */
+		struct Quadric {
+			double a[10] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+			double weight = 0.0;
+
+			/** Quadric of the squared distance to a plane n.x + d = 0, with n normalized. */
+			static Quadric fromPlane(const Vector3d & n, double d, double w) {
+				Quadric q;
+				q.a[0] = w * n[0] * n[0]; q.a[1] = w * n[0] * n[1]; q.a[2] = w * n[0] * n[2]; q.a[3] = w * n[0] * d;
+				q.a[4] = w * n[1] * n[1]; q.a[5] = w * n[1] * n[2]; q.a[6] = w * n[1] * d;
+				q.a[7] = w * n[2] * n[2]; q.a[8] = w * n[2] * d;
+				q.a[9] = w * d * d;
+				q.weight = w;
+				return q;
+			}
+
+			void add(const Quadric & q) {
+				for (int i = 0; i < 10; ++i) {
+					a[i] += q.a[i];
+				}
+				weight += q.weight;
+			}
+
+			double evaluate(const Vector3d & p) const {
+				const double x = p[0], y = p[1], z = p[2];
+				return a[0] * x * x + 2.0 * a[1] * x * y + 2.0 * a[2] * x * z + 2.0 * a[3] * x
+					+ a[4] * y * y + 2.0 * a[5] * y * z + 2.0 * a[6] * y
+					+ a[7] * z * z + 2.0 * a[8] * z + a[9];
+			}
+
+			/** Find the point minimizing the quadric, if it is well defined. */
+			bool optimum(Vector3d & p) const {
+				Eigen::Matrix3d m;
+				m << a[0], a[1], a[2], a[1], a[4], a[5], a[2], a[5], a[7];
+				const double det = m.determinant();
+				const double scale = m.cwiseAbs().maxCoeff();
+				if (std::abs(det) <= 1e-12 * scale * scale * scale) {
+					return false;
+				}
+				p = m.inverse() * Vector3d(-a[3], -a[6], -a[8]);
+				return true;
+			}
+		};
+
+		/** Plane quadric of a triangle, weighted by its area. */
+		Quadric triangleQuadric(const Vector3f & p0, const Vector3f & p1, const Vector3f & p2) {
+			const Vector3d a = p0.cast<double>();
+			const Vector3d n = (p1.cast<double>() - a).cross(p2.cast<double>() - a);
+			const double len = n.norm();
+			if (len <= 0.0) {
+				return Quadric();
+			}
+			return Quadric::fromPlane(n / len, -(n / len).dot(a), 0.5 * len);
+		}
+
+		/** Candidate collapse in the queue. */
+		struct Collapse {
+			float cost; ///< Quadric error of the collapse.
+			uint v0; ///< First vertex.
+			uint v1; ///< Second vertex.
+			uint version0; ///< Version of the first vertex when the cost was computed.
+			uint version1; ///< Version of the second vertex when the cost was computed.
+
+			bool operator<(const Collapse & other) const {
+				// Lowest cost first in a std::priority_queue.
+				return cost > other.cost;
+			}
+		};
+
+		/** Decimation state. Vertex and triangle arrays are shared between clusters, each cluster only modifying its own elements. */
+		struct Decimator {
+
+			Decimator(const Mesh & mesh, const MeshSimplifier::Options & options) : _options(options) {
+				_positions = mesh.vertices();
+				_normals = mesh.normals();
+				_colors = mesh.colors();
+				_texCoords = mesh.texCoords();
+				// Drop degenerate triangles right away.
+				for (const Vector3u & tri : mesh.triangles()) {
+					if (tri[0] != tri[1] && tri[1] != tri[2] && tri[2] != tri[0]) {
+						_triangles.push_back(tri);
+					}
+				}
+				const int vertexCount = int(_positions.size());
+				const int triangleCount = int(_triangles.size());
+				_triangleAlive.assign(triangleCount, 1);
+				_vertexAlive.assign(vertexCount, 1);
+				_versions.assign(vertexCount, 0);
+				_locked.assign(vertexCount, 0);
+				_cluster.assign(vertexCount, 0);
+				_liveTriangles = triangleCount;
+
+				// Vertex to triangles adjacency.
+				_vertexTriangles.resize(vertexCount);
+				for (int tid = 0; tid < triangleCount; ++tid) {
+					for (int k = 0; k < 3; ++k) {
+						_vertexTriangles[_triangles[tid][k]].push_back(uint(tid));
+					}
+				}
+
+				// Accumulate the plane quadrics of the adjacent triangles, each vertex independently.
+				_quadrics.resize(vertexCount);
+#pragma omp parallel for
+				for (int vid = 0; vid < vertexCount; ++vid) {
+					for (const uint tid : _vertexTriangles[vid]) {
+						const Vector3u & tri = _triangles[tid];
+						_quadrics[vid].add(triangleQuadric(_positions[tri[0]], _positions[tri[1]], _positions[tri[2]]));
+					}
+				}
+
+				// Find open border edges, seen by a single triangle, and constrain them with a plane orthogonal to their face.
+				std::vector<std::pair<uint64_t, uint>> edges(size_t(triangleCount) * 3);
+#pragma omp parallel for
+				for (int tid = 0; tid < triangleCount; ++tid) {
+					for (int k = 0; k < 3; ++k) {
+						const uint a = _triangles[tid][k];
+						const uint b = _triangles[tid][(k + 1) % 3];
+						edges[3 * size_t(tid) + k] = { (uint64_t(std::min(a, b)) << 32) | uint64_t(std::max(a, b)), uint(tid) };
+					}
+				}
+				std::sort(edges.begin(), edges.end());
+				for (size_t eid = 0; eid < edges.size();) {
+					size_t end = eid + 1;
+					while (end < edges.size() && edges[end].first == edges[eid].first) {
+						++end;
+					}
+					if (end - eid == 1) {
+						const Vector3u & tri = _triangles[edges[eid].second];
+						const uint a = uint(edges[eid].first >> 32);
+						const uint b = uint(edges[eid].first & 0xFFFFFFFFu);
+						const Vector3d p0 = _positions[tri[0]].cast<double>();
+						const Vector3d faceNormal = (_positions[tri[1]].cast<double>() - p0).cross(_positions[tri[2]].cast<double>() - p0);
+						const Vector3d edge = (_positions[b] - _positions[a]).cast<double>();
+						const Vector3d n = edge.cross(faceNormal);
+						const double len = n.norm();
+						if (len > 0.0) {
+							const Vector3d nn = n / len;
+							const Quadric q = Quadric::fromPlane(nn, -nn.dot(_positions[a].cast<double>()), double(_options.borderWeight) * edge.squaredNorm());
+							_quadrics[a].add(q);
+							_quadrics[b].add(q);
+						}
+					}
+					eid = end;
+				}
+
+				// Vertices shared by several UV charts or normals discontinuities: keep them in place.
+				if (_options.lockSeams && vertexCount > 1) {
+					std::vector<uint> order(vertexCount);
+					for (int vid = 0; vid < vertexCount; ++vid) {
+						order[vid] = uint(vid);
+					}
+					const auto & positions = _positions;
+					std::sort(order.begin(), order.end(), [&positions](uint a, uint b) {
+						return std::lexicographical_compare(positions[a].data(), positions[a].data() + 3, positions[b].data(), positions[b].data() + 3);
+					});
+					for (int i = 1; i < vertexCount; ++i) {
+						if (_positions[order[i]] == _positions[order[i - 1]]) {
+							_locked[order[i]] = 1;
+							_locked[order[i - 1]] = 1;
+						}
+					}
+				}
+			}
+
+			/** Evaluate the collapse of an edge. The surviving vertex is v0 unless v0 is locked.
+			 * \return false if the collapse is not allowed
+			 */
+			bool evaluate(uint v0, uint v1, Collapse & collapse, Vector3f & target) const {
+				if (_locked[v0] && _locked[v1]) {
+					return false;
+				}
+				if (_locked[v0] == 0 && _locked[v1] != 0) {
+					std::swap(v0, v1);
+				}
+				Quadric q = _quadrics[v0];
+				q.add(_quadrics[v1]);
+				const Vector3d p0 = _positions[v0].cast<double>();
+				const Vector3d p1 = _positions[v1].cast<double>();
+				Vector3d best = p0;
+				double bestCost = q.evaluate(p0);
+				if (!_locked[v0]) {
+					// Try the optimal position, if it does not go too far from the edge, then the endpoints and midpoint.
+					Vector3d opt;
+					const Vector3d mid = 0.5 * (p0 + p1);
+					if (q.optimum(opt) && (opt - mid).norm() <= 2.0 * (p1 - p0).norm()) {
+						const double cost = q.evaluate(opt);
+						if (cost < bestCost) {
+							best = opt;
+							bestCost = cost;
+						}
+					}
+					for (const Vector3d & candidate : { p1, mid }) {
+						const double cost = q.evaluate(candidate);
+						if (cost < bestCost) {
+							best = candidate;
+							bestCost = cost;
+						}
+					}
+				}
+				collapse.cost = float(std::max(bestCost, 0.0));
+				collapse.v0 = v0;
+				collapse.v1 = v1;
+				collapse.version0 = _versions[v0];
+				collapse.version1 = _versions[v1];
+				target = best.cast<float>();
+				return true;
+			}
+
+			/** \return the estimated distance error of a collapse. */
+			float distanceError(const Collapse & collapse) const {
+				const double weight = _quadrics[collapse.v0].weight + _quadrics[collapse.v1].weight;
+				return weight > 0.0 ? float(std::sqrt(double(collapse.cost) / weight)) : 0.0f;
+			}
+
+			/** Check that a collapse keeps the mesh manifold and does not flip triangles. */
+			bool isValid(uint v0, uint v1, const Vector3f & target) const {
+				// Link condition: the common neighbours of both vertices are the ones of the triangles sharing the edge.
+				std::vector<uint> n0, n1;
+				int shared = 0;
+				for (const uint tid : _vertexTriangles[v0]) {
+					if (!_triangleAlive[tid]) {
+						continue;
+					}
+					const Vector3u & tri = _triangles[tid];
+					bool hasV1 = false;
+					for (int k = 0; k < 3; ++k) {
+						n0.push_back(tri[k]);
+						hasV1 = hasV1 || tri[k] == v1;
+					}
+					shared += hasV1 ? 1 : 0;
+				}
+				if (shared == 0) {
+					return false;
+				}
+				for (const uint tid : _vertexTriangles[v1]) {
+					if (!_triangleAlive[tid]) {
+						continue;
+					}
+					for (int k = 0; k < 3; ++k) {
+						n1.push_back(_triangles[tid][k]);
+					}
+				}
+				std::sort(n0.begin(), n0.end());
+				n0.erase(std::unique(n0.begin(), n0.end()), n0.end());
+				std::sort(n1.begin(), n1.end());
+				n1.erase(std::unique(n1.begin(), n1.end()), n1.end());
+				size_t common = 0;
+				for (size_t i = 0, j = 0; i < n0.size() && j < n1.size();) {
+					if (n0[i] < n1[j]) {
+						++i;
+					} else if (n1[j] < n0[i]) {
+						++j;
+					} else {
+						common += (n0[i] != v0 && n0[i] != v1) ? 1 : 0;
+						++i;
+						++j;
+					}
+				}
+				if (common != size_t(shared)) {
+					return false;
+				}
+
+				// The triangles that remain should keep their orientation.
+				for (const uint vid : { v0, v1 }) {
+					for (const uint tid : _vertexTriangles[vid]) {
+						if (!_triangleAlive[tid]) {
+							continue;
+						}
+						const Vector3u & tri = _triangles[tid];
+						if ((tri[0] == v0 || tri[1] == v0 || tri[2] == v0) && (tri[0] == v1 || tri[1] == v1 || tri[2] == v1)) {
+							continue;
+						}
+						Vector3f p[3], q[3];
+						for (int k = 0; k < 3; ++k) {
+							p[k] = _positions[tri[k]];
+							q[k] = (tri[k] == v0 || tri[k] == v1) ? target : p[k];
+						}
+						const Vector3f before = (p[1] - p[0]).cross(p[2] - p[0]);
+						const Vector3f after = (q[1] - q[0]).cross(q[2] - q[0]);
+						const float afterNorm = after.norm();
+						if (afterNorm <= 1e-12f * before.norm() || before.dot(after) < 0.2f * before.norm() * afterNorm) {
+							return false;
+						}
+					}
+				}
+				return true;
+			}
+
+			/** Collapse v1 into v0, moving v0 to the target position and interpolating its attributes. */
+			void apply(uint v0, uint v1, const Vector3f & target, size_t & liveTriangles) {
+				// Interpolate attributes at the projection of the target on the edge.
+				const Vector3f edge = _positions[v1] - _positions[v0];
+				const float len2 = edge.squaredNorm();
+				const float t = _locked[v0] ? 0.0f : (len2 > 0.0f ? std::min(std::max(edge.dot(target - _positions[v0]) / len2, 0.0f), 1.0f) : 0.0f);
+				if (!_normals.empty()) {
+					const Vector3f n = (1.0f - t) * _normals[v0] + t * _normals[v1];
+					_normals[v0] = n.norm() > 0.0f ? Vector3f(n.normalized()) : _normals[v0];
+				}
+				if (!_colors.empty()) {
+					_colors[v0] = (1.0f - t) * _colors[v0] + t * _colors[v1];
+				}
+				if (!_texCoords.empty()) {
+					_texCoords[v0] = (1.0f - t) * _texCoords[v0] + t * _texCoords[v1];
+				}
+				_positions[v0] = target;
+				_quadrics[v0].add(_quadrics[v1]);
+				_vertexAlive[v1] = 0;
+				++_versions[v0];
+
+				for (const uint tid : _vertexTriangles[v1]) {
+					if (!_triangleAlive[tid]) {
+						continue;
+					}
+					Vector3u & tri = _triangles[tid];
+					if (tri[0] == v0 || tri[1] == v0 || tri[2] == v0) {
+						_triangleAlive[tid] = 0;
+						--liveTriangles;
+						continue;
+					}
+					for (int k = 0; k < 3; ++k) {
+						if (tri[k] == v1) {
+							tri[k] = v0;
+						}
+					}
+					_vertexTriangles[v0].push_back(tid);
+				}
+				_vertexTriangles[v1].clear();
+				auto & adjacent = _vertexTriangles[v0];
+				adjacent.erase(std::remove_if(adjacent.begin(), adjacent.end(), [this](uint tid) { return _triangleAlive[tid] == 0; }), adjacent.end());
+			}
+
+			/** Can a vertex be modified by the given cluster (-1 for the global pass). */
+			bool isMovable(uint vid, int cluster) const {
+				return cluster < 0 || (_cluster[vid] == cluster && !_frontier[vid]);
+			}
+
+			/** Run collapses until the target is reached, only touching vertices of the given cluster (-1 for all of them).
+			 * \param seeds the edges to start from
+			 * \param cluster the cluster id or -1
+			 * \param liveTriangles the number of triangles, updated
+			 * \param targetTriangles the number of triangles to reach
+			 * \param maxError will be updated with the largest error of the applied collapses
+			 */
+			void run(const std::vector<std::pair<uint, uint>> & seeds, int cluster, size_t & liveTriangles, size_t targetTriangles, float & maxError) {
+				std::vector<Collapse> initial(seeds.size());
+				std::vector<uint8_t> valid(seeds.size(), 0);
+				Vector3f target;
+				// When called from a cluster we are already in a parallel region, this is only parallel for the global pass.
+#pragma omp parallel for private(target) if(cluster < 0)
+				for (int sid = 0; sid < int(seeds.size()); ++sid) {
+					valid[sid] = evaluate(seeds[sid].first, seeds[sid].second, initial[sid], target) ? 1 : 0;
+				}
+				std::vector<Collapse> heapData;
+				heapData.reserve(seeds.size());
+				for (size_t sid = 0; sid < seeds.size(); ++sid) {
+					if (valid[sid]) {
+						heapData.push_back(initial[sid]);
+					}
+				}
+				std::priority_queue<Collapse> heap(std::less<Collapse>(), std::move(heapData));
+
+				std::vector<uint> neighbours;
+				while (liveTriangles > targetTriangles && !heap.empty()) {
+					const Collapse top = heap.top();
+					heap.pop();
+					// Lazy deletion: skip collapses computed before one of their vertices changed.
+					if (!_vertexAlive[top.v0] || !_vertexAlive[top.v1] || _versions[top.v0] != top.version0 || _versions[top.v1] != top.version1) {
+						continue;
+					}
+					Collapse collapse;
+					if (!evaluate(top.v0, top.v1, collapse, target)) {
+						continue;
+					}
+					const float error = distanceError(collapse);
+					if (error > _options.maxError || !isMovable(collapse.v0, cluster) || !isMovable(collapse.v1, cluster)
+						|| !isValid(collapse.v0, collapse.v1, target)) {
+						continue;
+					}
+					apply(collapse.v0, collapse.v1, target, liveTriangles);
+					maxError = std::max(maxError, error);
+
+					// Update the collapses around the surviving vertex.
+					neighbours.clear();
+					for (const uint tid : _vertexTriangles[collapse.v0]) {
+						for (int k = 0; k < 3; ++k) {
+							if (_triangles[tid][k] != collapse.v0) {
+								neighbours.push_back(_triangles[tid][k]);
+							}
+						}
+					}
+					std::sort(neighbours.begin(), neighbours.end());
+					neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+					for (const uint nid : neighbours) {
+						Collapse next;
+						if (evaluate(collapse.v0, nid, next, target)) {
+							heap.push(next);
+						}
+					}
+				}
+			}
+
+			/** Decimate the mesh to the target triangle count.
+			 * \return the estimated maximum error
+			 */
+			float decimate(size_t targetTriangles) {
+				float maxError = 0.0f;
+				const int vertexCount = int(_positions.size());
+				const int triangleCount = int(_triangles.size());
+
+				// Clustered pass: a grid of clusters is decimated in parallel, vertices touching several clusters are frozen.
+				const int gridSize = triangleCount > 200000 ? 4 : 1;
+				const int clusterCount = gridSize * gridSize * gridSize;
+				_frontier.assign(vertexCount, 0);
+				if (clusterCount > 1) {
+					Eigen::AlignedBox3f box;
+					for (const Vector3f & p : _positions) {
+						box.extend(p);
+					}
+					const Vector3f cellSize = (box.sizes() / float(gridSize)).cwiseMax(Vector3f(1e-12f, 1e-12f, 1e-12f));
+#pragma omp parallel for
+					for (int vid = 0; vid < vertexCount; ++vid) {
+						const Vector3f cell = (_positions[vid] - box.min()).cwiseQuotient(cellSize);
+						int id = 0;
+						for (int k = 2; k >= 0; --k) {
+							id = id * gridSize + std::min(std::max(int(cell[k]), 0), gridSize - 1);
+						}
+						_cluster[vid] = id;
+					}
+					// Gather the edges and triangles of each cluster.
+					std::vector<std::vector<std::pair<uint, uint>>> clusterEdges(clusterCount);
+					std::vector<size_t> clusterTriangles(clusterCount, 0);
+					for (int tid = 0; tid < triangleCount; ++tid) {
+						const Vector3u & tri = _triangles[tid];
+						const int c = _cluster[tri[0]];
+						if (_cluster[tri[1]] != c || _cluster[tri[2]] != c) {
+							_frontier[tri[0]] = _frontier[tri[1]] = _frontier[tri[2]] = 1;
+							continue;
+						}
+						++clusterTriangles[c];
+						for (int k = 0; k < 3; ++k) {
+							const uint a = tri[k];
+							const uint b = tri[(k + 1) % 3];
+							if (a < b) {
+								clusterEdges[c].emplace_back(a, b);
+							}
+						}
+					}
+					const double keepRatio = double(targetTriangles) / double(std::max(triangleCount, 1));
+					std::vector<size_t> clusterLive(clusterTriangles);
+					std::vector<float> clusterErrors(clusterCount, 0.0f);
+#pragma omp parallel for schedule(dynamic, 1)
+					for (int c = 0; c < clusterCount; ++c) {
+						run(clusterEdges[c], c, clusterLive[c], size_t(keepRatio * double(clusterTriangles[c])), clusterErrors[c]);
+					}
+					for (int c = 0; c < clusterCount; ++c) {
+						_liveTriangles -= clusterTriangles[c] - clusterLive[c];
+						maxError = std::max(maxError, clusterErrors[c]);
+					}
+				}
+
+				// Global pass on the remaining edges, without any frozen vertex.
+				std::vector<std::pair<uint, uint>> edges;
+				for (int tid = 0; tid < triangleCount; ++tid) {
+					if (!_triangleAlive[tid]) {
+						continue;
+					}
+					for (int k = 0; k < 3; ++k) {
+						const uint a = _triangles[tid][k];
+						const uint b = _triangles[tid][(k + 1) % 3];
+						edges.emplace_back(std::min(a, b), std::max(a, b));
+					}
+				}
+				std::sort(edges.begin(), edges.end());
+				edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+				run(edges, -1, _liveTriangles, targetTriangles, maxError);
+				return maxError;
+			}
+
+			/** \return the decimated mesh, with unused vertices removed. */
+			Mesh::Ptr result() const {
+				std::vector<int> remap(_positions.size(), -1);
+				Mesh::Vertices vertices;
+				Mesh::Normals normals;
+				Mesh::Colors colors;
+				Mesh::UVs texCoords;
+				Mesh::Triangles triangles;
+				for (size_t tid = 0; tid < _triangles.size(); ++tid) {
+					if (!_triangleAlive[tid]) {
+						continue;
+					}
+					Vector3u tri;
+					for (int k = 0; k < 3; ++k) {
+						const uint vid = _triangles[tid][k];
+						if (remap[vid] < 0) {
+							remap[vid] = int(vertices.size());
+							vertices.push_back(_positions[vid]);
+							if (!_normals.empty()) {
+								normals.push_back(_normals[vid]);
+							}
+							if (!_colors.empty()) {
+								colors.push_back(_colors[vid]);
+							}
+							if (!_texCoords.empty()) {
+								texCoords.push_back(_texCoords[vid]);
+							}
+						}
+						tri[k] = uint(remap[vid]);
+					}
+					triangles.push_back(tri);
+				}
+				Mesh::Ptr mesh(new Mesh(false));
+				mesh->vertices(vertices);
+				mesh->normals(normals);
+				mesh->colors(colors);
+				mesh->texCoords(texCoords);
+				mesh->triangles(triangles);
+				return mesh;
+			}
+
+			const MeshSimplifier::Options & _options;
+			Mesh::Vertices _positions;
+			Mesh::Normals _normals;
+			Mesh::Colors _colors;
+			Mesh::UVs _texCoords;
+			Mesh::Triangles _triangles;
+			std::vector<Quadric> _quadrics;
+			std::vector<std::vector<uint>> _vertexTriangles;
+			std::vector<uint8_t> _triangleAlive;
+			std::vector<uint8_t> _vertexAlive;
+			std::vector<uint> _versions;
+			std::vector<uint8_t> _locked;
+			std::vector<int> _cluster;
+			std::vector<uint8_t> _frontier;
+			size_t _liveTriangles = 0;
+		};
+
+		/** Uniform grid of triangles, for closest point queries. */
+		struct TriangleGrid {
+
+			TriangleGrid(const Mesh & mesh) : _mesh(mesh) {
+				for (const Vector3f & p : mesh.vertices()) {
+					_box.extend(p);
+				}
+				const size_t count = std::max(mesh.triangles().size(), size_t(1));
+				const float volume = std::max(_box.volume(), 1e-12f);
+				_cellSize = std::max(std::cbrt(volume / float(count)) * 2.0f, 1e-6f * _box.diagonal().norm());
+				_dims = ((_box.sizes() / _cellSize).cast<int>() + Vector3i(1, 1, 1)).cwiseMin(Vector3i(1024, 1024, 1024));
+				_cells.resize(size_t(_dims[0]) * _dims[1] * _dims[2]);
+				for (size_t tid = 0; tid < mesh.triangles().size(); ++tid) {
+					const Vector3u & tri = mesh.triangles()[tid];
+					Eigen::AlignedBox3f triBox;
+					for (int k = 0; k < 3; ++k) {
+						triBox.extend(mesh.vertices()[tri[k]]);
+					}
+					const Vector3i lo = cellOf(triBox.min());
+					const Vector3i hi = cellOf(triBox.max());
+					for (int z = lo[2]; z <= hi[2]; ++z) {
+						for (int y = lo[1]; y <= hi[1]; ++y) {
+							for (int x = lo[0]; x <= hi[0]; ++x) {
+								_cells[(size_t(z) * _dims[1] + y) * _dims[0] + x].push_back(uint(tid));
+							}
+						}
+					}
+				}
+			}
+
+			Vector3i cellOf(const Vector3f & p) const {
+				const Vector3f c = (p - _box.min()) / _cellSize;
+				return Vector3i(
+					std::min(std::max(int(c[0]), 0), _dims[0] - 1),
+					std::min(std::max(int(c[1]), 0), _dims[1] - 1),
+					std::min(std::max(int(c[2]), 0), _dims[2] - 1));
+			}
+
+			/** Closest point on a triangle (Ericson, Real-Time Collision Detection). */
+			static Vector3f closestOnTriangle(const Vector3f & p, const Vector3f & a, const Vector3f & b, const Vector3f & c) {
+				const Vector3f ab = b - a, ac = c - a, ap = p - a;
+				const float d1 = ab.dot(ap), d2 = ac.dot(ap);
+				if (d1 <= 0.0f && d2 <= 0.0f) return a;
+				const Vector3f bp = p - b;
+				const float d3 = ab.dot(bp), d4 = ac.dot(bp);
+				if (d3 >= 0.0f && d4 <= d3) return b;
+				const float vc = d1 * d4 - d3 * d2;
+				if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) return a + ab * (d1 / (d1 - d3));
+				const Vector3f cp = p - c;
+				const float d5 = ab.dot(cp), d6 = ac.dot(cp);
+				if (d6 >= 0.0f && d5 <= d6) return c;
+				const float vb = d5 * d2 - d1 * d6;
+				if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) return a + ac * (d2 / (d2 - d6));
+				const float va = d3 * d6 - d5 * d4;
+				if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+				const float denom = 1.0f / (va + vb + vc);
+				return a + ab * (vb * denom) + ac * (vc * denom);
+			}
+
+			/** \return the distance from a point to the mesh. */
+			float distance(const Vector3f & p) const {
+				const Vector3i center = cellOf(p);
+				float best = std::numeric_limits<float>::max();
+				const int maxRing = _dims.maxCoeff();
+				for (int ring = 0; ring <= maxRing; ++ring) {
+					// Cells of the ring are at least (ring - 1) cells away from the point.
+					if (best < float(ring - 1) * _cellSize) {
+						break;
+					}
+					for (int z = center[2] - ring; z <= center[2] + ring; ++z) {
+						for (int y = center[1] - ring; y <= center[1] + ring; ++y) {
+							for (int x = center[0] - ring; x <= center[0] + ring; ++x) {
+								if (std::max(std::abs(x - center[0]), std::max(std::abs(y - center[1]), std::abs(z - center[2]))) != ring) {
+									continue;
+								}
+								if (x < 0 || y < 0 || z < 0 || x >= _dims[0] || y >= _dims[1] || z >= _dims[2]) {
+									continue;
+								}
+								for (const uint tid : _cells[(size_t(z) * _dims[1] + y) * _dims[0] + x]) {
+									const Vector3u & tri = _mesh.triangles()[tid];
+									const Vector3f q = closestOnTriangle(p, _mesh.vertices()[tri[0]], _mesh.vertices()[tri[1]], _mesh.vertices()[tri[2]]);
+									best = std::min(best, (q - p).norm());
+								}
+							}
+						}
+					}
+				}
+				return best;
+			}
+
+			const Mesh & _mesh;
+			Eigen::AlignedBox3f _box;
+			float _cellSize = 1.0f;
+			Vector3i _dims;
+			std::vector<std::vector<uint>> _cells;
+		};
+
+		/** Sample points uniformly on a mesh surface. */
+		std::vector<Vector3f> samplePoints(const Mesh & mesh, size_t count, uint seed) {
+			const Mesh::Triangles & tris = mesh.triangles();
+			std::vector<double> cumulated(tris.size());
+			double total = 0.0;
+			for (size_t tid = 0; tid < tris.size(); ++tid) {
+				const Vector3f & a = mesh.vertices()[tris[tid][0]];
+				total += 0.5 * double((mesh.vertices()[tris[tid][1]] - a).cross(mesh.vertices()[tris[tid][2]] - a).norm());
+				cumulated[tid] = total;
+			}
+			std::vector<Vector3f> points;
+			if (tris.empty() || total <= 0.0) {
+				return points;
+			}
+			std::mt19937 gen(seed);
+			std::uniform_real_distribution<double> uniform(0.0, 1.0);
+			points.reserve(count);
+			for (size_t i = 0; i < count; ++i) {
+				const size_t tid = std::min(size_t(std::lower_bound(cumulated.begin(), cumulated.end(), uniform(gen) * total) - cumulated.begin()), tris.size() - 1);
+				float u = float(uniform(gen)), v = float(uniform(gen));
+				if (u + v > 1.0f) {
+					u = 1.0f - u;
+					v = 1.0f - v;
+				}
+				const Vector3f & a = mesh.vertices()[tris[tid][0]];
+				points.push_back(a + u * (mesh.vertices()[tris[tid][1]] - a) + v * (mesh.vertices()[tris[tid][2]] - a));
+			}
+			return points;
+		}
+
+		/** \return the largest distance from samples of a mesh to another mesh. */
+		float oneSidedDistance(const Mesh & from, const Mesh & to, size_t samples) {
+			const std::vector<Vector3f> points = samplePoints(from, samples, 0x5EED);
+			const TriangleGrid grid(to);
+			std::vector<float> distances(points.size(), 0.0f);
+#pragma omp parallel for
+			for (int pid = 0; pid < int(points.size()); ++pid) {
+				distances[pid] = grid.distance(points[pid]);
+			}
+			return distances.empty() ? 0.0f : *std::max_element(distances.begin(), distances.end());
+		}
+	}
+
+	Mesh::Ptr MeshSimplifier::simplify(const Mesh & mesh, const Options & options, float * error)
+	{
+		Decimator decimator(mesh, options);
+		const float maxError = decimator.decimate(options.targetTriangles);
+		if (error) {
+			*error = maxError;
+		}
+		return decimator.result();
+	}
+
+	std::vector<MeshSimplifier::LOD> MeshSimplifier::generateLODs(const Mesh & mesh, uint levels, float ratio)
+	{
+		std::vector<LOD> lods;
+		const Mesh * previous = &mesh;
+		float error = 0.0f;
+		for (uint level = 0; level < levels; ++level) {
+			Options options;
+			options.targetTriangles = size_t(double(previous->triangles().size()) * double(ratio));
+			float levelError = 0.0f;
+			LOD lod;
+			lod.mesh = simplify(*previous, options, &levelError);
+			// Errors of successive levels add up, at worst.
+			error += levelError;
+			lod.error = error;
+			SIBR_LOG << "[MeshSimplifier] LOD " << level + 1 << ": " << lod.mesh->triangles().size() << " triangles, error " << lod.error << "." << std::endl;
+			// Stop when locked vertices prevent any significant reduction.
+			if (lod.mesh->triangles().size() * 10 >= previous->triangles().size() * 9) {
+				break;
+			}
+			lods.push_back(lod);
+			previous = lods.back().mesh.get();
+		}
+		return lods;
+	}
+
+	void MeshSimplifier::saveLODs(const std::vector<LOD> & lods, const std::string & basePath)
+	{
+		std::ofstream index(basePath + "_lods.txt");
+		if (!index.is_open()) {
+			SIBR_WRG << "[MeshSimplifier] Unable to write " << basePath << "_lods.txt." << std::endl;
+			return;
+		}
+		for (size_t lid = 0; lid < lods.size(); ++lid) {
+			const std::string path = basePath + "_lod" + std::to_string(lid + 1) + ".ply";
+			lods[lid].mesh->save(path);
+			index << getFileName(path) << " " << lods[lid].error << "\n";
+		}
+	}
+
+	std::vector<MeshSimplifier::LOD> MeshSimplifier::loadLODs(const std::string & basePath, bool withGraphics)
+	{
+		std::vector<LOD> lods;
+		std::ifstream index(basePath + "_lods.txt");
+		if (!index.is_open()) {
+			return lods;
+		}
+		const std::string directory = parentDirectory(basePath);
+		std::string name;
+		float error;
+		while (index >> name >> error) {
+			LOD lod;
+			lod.mesh.reset(new Mesh(withGraphics));
+			if (!lod.mesh->load(directory.empty() ? name : directory + "/" + name)) {
+				SIBR_WRG << "[MeshSimplifier] Unable to load LOD " << name << "." << std::endl;
+				break;
+			}
+			lod.error = error;
+			lods.push_back(lod);
+		}
+		return lods;
+	}
+
+	int MeshSimplifier::selectLOD(const std::vector<LOD> & lods, const Camera & eye, float viewportHeight, float pixelError)
+	{
+		if (lods.empty() || pixelError <= 0.0f) {
+			return -1;
+		}
+		// Distance to the closest part of the surface, estimated with the coarsest level.
+		const LOD & coarsest = lods.back();
+		float distance = std::numeric_limits<float>::max();
+		for (const Vector3f & p : coarsest.mesh->vertices()) {
+			distance = std::min(distance, (p - eye.position()).norm());
+		}
+		distance = std::max(distance - coarsest.error, eye.znear());
+		// Pixels per world unit at that distance.
+		const float pixelsPerUnit = eye.ortho() ? viewportHeight / (2.0f * eye.orthoTop()) : viewportHeight / (2.0f * std::tan(0.5f * eye.fovy()) * distance);
+		int selected = -1;
+		for (int lid = 0; lid < int(lods.size()); ++lid) {
+			if (lods[lid].error * pixelsPerUnit <= pixelError) {
+				selected = lid;
+			}
+		}
+		return selected;
+	}
+
+	float MeshSimplifier::hausdorffDistance(const Mesh & a, const Mesh & b, size_t samples)
+	{
+		return std::max(oneSidedDistance(a, b, samples), oneSidedDistance(b, a, samples));
+	}
+
+	void MeshSimplifier::benchmark(const Mesh * mesh)
+	{
+		// A sphere and a bumpy terrain, plus the mesh given by the caller.
+		std::vector<std::pair<std::string, Mesh::Ptr>> meshes;
+		meshes.emplace_back("sphere", Mesh::getSphereMesh(Vector3f(0.0f, 0.0f, 0.0f), 1.0f, false, 400));
+		const int res = 500;
+		Mesh::Vertices vertices;
+		Mesh::Triangles triangles;
+		for (int y = 0; y <= res; ++y) {
+			for (int x = 0; x <= res; ++x) {
+				const float u = float(x) / res, v = float(y) / res;
+				vertices.emplace_back(u, v, 0.05f * std::sin(12.0f * u) * std::cos(9.0f * v) + 0.01f * std::sin(70.0f * u * v));
+			}
+		}
+		for (int y = 0; y < res; ++y) {
+			for (int x = 0; x < res; ++x) {
+				const uint a = uint(y * (res + 1) + x);
+				triangles.emplace_back(a, a + 1, a + res + 1);
+				triangles.emplace_back(a + 1, a + res + 2, a + res + 1);
+			}
+		}
+		Mesh::Ptr terrain(new Mesh(false));
+		terrain->vertices(vertices);
+		terrain->triangles(triangles);
+		meshes.emplace_back("terrain", terrain);
+		if (mesh) {
+			Mesh::Ptr copy(new Mesh(false));
+			copy->vertices(mesh->vertices());
+			copy->triangles(mesh->triangles());
+			copy->normals(mesh->normals());
+			copy->colors(mesh->colors());
+			copy->texCoords(mesh->texCoords());
+			meshes.emplace_back("input", copy);
+		}
+
+		for (const auto & entry : meshes) {
+			const Mesh & input = *entry.second;
+			const float diagonal = input.getBoundingBox().diagonal().norm();
+			for (const float ratio : { 0.5f, 0.1f, 0.01f }) {
+				Options options;
+				options.targetTriangles = size_t(double(input.triangles().size()) * ratio);
+				float error = 0.0f;
+				Timer timer(true);
+				const Mesh::Ptr output = simplify(input, options, &error);
+				const double seconds = timer.deltaTimeFromLastTic<Timer::micro>() * 1e-6;
+				const float hausdorff = hausdorffDistance(input, *output, 50000);
+				SIBR_LOG << "[MeshSimplifier] " << entry.first << " " << input.triangles().size() << " -> " << output->triangles().size()
+					<< " triangles in " << seconds << "s (" << double(input.triangles().size()) / std::max(seconds, 1e-9) << " triangles/s), Hausdorff "
+					<< hausdorff / diagonal * 100.0f << "% of the diagonal, estimated error " << error / diagonal * 100.0f << "%." << std::endl;
+			}
+		}
+	}
+
+} // namespace sibr
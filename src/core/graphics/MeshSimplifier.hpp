@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+# include "core/graphics/Config.hpp"
+# include "core/graphics/Mesh.hpp"
+# include "core/graphics/Camera.hpp"
+
+namespace sibr
+{
+	/** \brief Quadric error metric mesh decimation (Garland and Heckbert), used to generate levels of detail of proxies.
+	* Quadrics are accumulated per vertex in parallel. The mesh is then split in a grid of clusters that are decimated
+	* in parallel, each with its own lazy priority queue of edge collapses, while the vertices on cluster borders are locked.
+	* A final global pass removes the remaining triangles. Normals, colors and texture coordinates are interpolated along
+	* collapsed edges; open borders are constrained by penalty quadrics and vertices shared by several UV charts are locked
+	* so that seams are kept.
+	* \ingroup sibr_graphics
+	*/
+	class SIBR_GRAPHICS_EXPORT MeshSimplifier
+	{
+	public:
+
+		/** Decimation parameters. */
+		struct Options {
+			size_t targetTriangles = 0; ///< Stop when the mesh has at most this number of triangles.
+			float maxError = std::numeric_limits<float>::max(); ///< Skip collapses moving the surface by more than this distance.
+			float borderWeight = 1000.0f; ///< Weight of the quadrics keeping open borders in place.
+			bool lockSeams = true; ///< Do not move vertices that share their position with another vertex.
+		};
+
+		/** A level of detail. */
+		struct LOD {
+			Mesh::Ptr mesh; ///< The decimated mesh.
+			float error = 0.0f; ///< Estimated maximum geometric error, in world units.
+		};
+
+		/** Decimate a mesh.
+		\param mesh the mesh to decimate
+		\param options the decimation parameters
+		\param error if not null, will contain the estimated maximum geometric error
+		\return the decimated mesh, without graphics buffers
+		*/
+		static Mesh::Ptr simplify(const Mesh & mesh, const Options & options, float * error = nullptr);
+
+		/** Generate a chain of levels of detail, each one decimated from the previous one.
+		\param mesh the full resolution mesh
+		\param levels the number of levels to generate
+		\param ratio the ratio of triangles kept from one level to the next
+		\return the levels, from the finest to the coarsest
+		*/
+		static std::vector<LOD> generateLODs(const Mesh & mesh, uint levels = 4, float ratio = 0.25f);
+
+		/** Save levels of detail next to a mesh, as basePath_lod<i>.ply files listed in basePath_lods.txt.
+		\param lods the levels to save
+		\param basePath the mesh path without extension
+		*/
+		static void saveLODs(const std::vector<LOD> & lods, const std::string & basePath);
+
+		/** Load the levels of detail saved next to a mesh.
+		\param basePath the mesh path without extension
+		\param withGraphics should the meshes be on the GPU
+		\return the levels, empty if none were found
+		*/
+		static std::vector<LOD> loadLODs(const std::string & basePath, bool withGraphics = true);
+
+		/** Select the coarsest level whose error, projected at the closest visible distance, stays under a threshold.
+		\param lods the levels, from the finest to the coarsest
+		\param eye the viewpoint
+		\param viewportHeight the height of the viewport in pixels
+		\param pixelError the maximum error in pixels
+		\return the index of the level to use, or -1 if the full resolution mesh is needed
+		*/
+		static int selectLOD(const std::vector<LOD> & lods, const Camera & eye, float viewportHeight, float pixelError);
+
+		/** Estimate the symmetric Hausdorff distance between two meshes, by sampling their surfaces.
+		\param a the first mesh
+		\param b the second mesh
+		\param samples the number of points sampled on each mesh
+		\return the estimated distance
+		*/
+		static float hausdorffDistance(const Mesh & a, const Mesh & b, size_t samples = 100000);
+
+		/** Decimate synthetic meshes, and an optional real one, at several ratios and log triangles/s and Hausdorff errors.
+		\param mesh an optional additional mesh to test
+		*/
+		static void benchmark(const Mesh * mesh = nullptr);
+	};
+
+} // namespace sibr
@@ -18,6 +18,7 @@
 # include "core/graphics/Types.hpp"
 # include "core/system/Vector.hpp"
 # include "core/graphics/RenderUtility.hpp"
+# include "core/graphics/AsyncReadback.hpp"
 
 
 # define SIBR_MAX_SHADER_ATTACHMENTS (1<<3)
@@ -185,6 +186,19 @@ namespace sibr
 		template <typename TType, uint NNumComp>
 		void readBackDepth(sibr::Image<TType, NNumComp>& image) const;
 
+		/** Start an asynchronous readback of a color attachment, without waiting for the GPU.
+		\param readback the readback buffers to use
+		\param target the color attachment index to read
+		\return the ticket to give to AsyncReadback::retrieve, the result has the same orientation as readBack
+		*/
+		AsyncReadback::Ticket requestReadBack(AsyncReadback& readback, uint target = 0) const;
+
+		/** Start an asynchronous readback of the depth attachment, without waiting for the GPU.
+		\param readback the readback buffers to use
+		\return the ticket to give to AsyncReadback::retrieve, the result is a one channel float image with the same orientation as readBack
+		*/
+		AsyncReadback::Ticket requestReadBackDepth(AsyncReadback& readback) const;
+
 		/** \return the number of active color targets. */
 		uint   numTargets(void)  const;
 
@@ -651,6 +665,20 @@ namespace sibr
 		glBindFramebuffer(GL_FRAMEBUFFER, 0);
 	}
 
+	template<typename T_Type, unsigned int T_NumComp>
+	AsyncReadback::Ticket RenderTarget<T_Type, T_NumComp>::requestReadBack(AsyncReadback& readback, uint target) const {
+		if (target >= m_numtargets)
+			SIBR_ERR << "Reading back texture out of bounds" << std::endl;
+
+		return readback.request(m_fbo, GL_COLOR_ATTACHMENT0 + target, m_W, m_H,
+			GLFormat<T_Type, T_NumComp>::format, GLType<T_Type>::type, CV_MAKETYPE(cv::DataType<T_Type>::depth, int(T_NumComp)));
+	}
+
+	template<typename T_Type, unsigned int T_NumComp>
+	AsyncReadback::Ticket RenderTarget<T_Type, T_NumComp>::requestReadBackDepth(AsyncReadback& readback) const {
+		return readback.request(m_fbo, GL_COLOR_ATTACHMENT0, m_W, m_H, GL_DEPTH_COMPONENT, GL_FLOAT, CV_32FC1);
+	}
+
 	template<typename T_Type, unsigned int T_NumComp>
 	uint   RenderTarget<T_Type, T_NumComp>::numTargets(void)  const { return m_numtargets; }
 	template<typename T_Type, unsigned int T_NumComp>
@@ -19,6 +19,8 @@
 # include "core/graphics/Image.hpp"
 # include "core/graphics/Types.hpp"
 # include "core/graphics/RenderTarget.hpp"
+# include "core/graphics/TextureStagingArena.hpp"
+# include "core/graphics/BlockCompression.hpp"
 
 namespace sibr
 {
@@ -285,6 +287,7 @@ namespace sibr
 		\param h the target height
 		\param compression the GL_COMPRESSED format. It must be choosen accordingly to the texture internal format.
 		\param flags options
+		\note 8-bit images targeting BC1, BC4, BC5 or BC7 formats are compressed on the CPU (see BlockCompression), other formats are compressed by the driver.
 		*/
 		template<typename ImageType>
 		void createCompressedFromImages(const std::vector<ImageType>& images, uint w, uint h, uint compression, uint flags = 0);
@@ -378,33 +381,23 @@ namespace sibr
 		template<typename ImageType>
 		void sendMipArray(const std::vector<std::vector<ImageType>>& images);
 
-		/** Flip and rescale a subset of images from a list.
-		\param images the images to resize
-		\param tmp a temporary buffer
+		/** Flip, rescale and upload a subset of images from a list, through the shared staging arena.
+		\param images the images to upload, indexed by slice
+		\param slices the indices of the slices to update
+		\param level the mip level to update
 		\param tw the target width
 		\param th the target height
-		\param slices the indices of the images to process in the list
-		\return a list of pointers to the transformed images
 		*/
 		template<typename ImageType>
-		std::vector<const ImageType*> applyFlipAndResize(
-			const std::vector<ImageType>& images,
-			std::vector<ImageType>& tmp, uint tw, uint th,
-			const std::vector<int>& slices
-		);
+		void sendSlices(const std::vector<ImageType>& images, const std::vector<int>& slices, uint level, uint tw, uint th);
 
-		/** Flip and rescale a set of images.
-		\param images the images to resize
-		\param tmp a temporary buffer
-		\param tw the target width
-		\param th the target height
-		\return a list of pointers to the transformed images
+		/** Compress the images and their mipmaps on the CPU and upload the blocks.
+		\param images the images to upload, one for each layer
+		\param format the block compression format
+		\param compression the GL_COMPRESSED format the texture was created with
 		*/
 		template<typename ImageType>
-		std::vector<const ImageType*> applyFlipAndResize(
-			const std::vector<ImageType>& images,
-			std::vector<ImageType>& tmp, uint tw, uint th
-		);
+		void sendCompressedArray(const std::vector<ImageType>& images, BlockCompression::Format format, uint compression);
 
 		GLuint  m_Handle = 0; ///< Texture handle.
 		uint    m_W = 0; ///< Texture width.
@@ -1036,29 +1029,14 @@ namespace sibr
 
 	template<typename T_Type, unsigned int T_NumComp> template<typename ImageType>
 	void Texture2DArray<T_Type, T_NumComp>::sendArray(const std::vector<ImageType>& images) {
-		using ImgTypeInfo = GLTexFormat<ImageType, T_Type, T_NumComp>;
-		glBindTexture(GL_TEXTURE_2D_ARRAY, m_Handle);
-
-		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-		glPixelStorei(GL_PACK_ALIGNMENT, 1);
-
-		// Make sure all images have the same size.
-		std::vector<ImageType> tmp;
-		std::vector<const ImageType*> imagesPtrToSend = applyFlipAndResize(images, tmp, m_W, m_H);
-
+		// Images are resized to the texture size while staged.
+		std::vector<int> slices(m_Depth);
 		for (int im = 0; im < (int)m_Depth; ++im) {
-			glTexSubImage3D(GL_TEXTURE_2D_ARRAY,
-				0,
-				0, 0, im,
-				m_W,
-				m_H,
-				1, // one slice at a time
-				ImgTypeInfo::format,
-				ImgTypeInfo::type,
-				ImgTypeInfo::data(*imagesPtrToSend[im])
-			);
-			//CHECK_GL_ERROR;
+			slices[im] = im;
 		}
+		sendSlices(images, slices, 0, m_W, m_H);
+
+		glBindTexture(GL_TEXTURE_2D_ARRAY, m_Handle);
 		bool autoMIPMAP = ((m_Flags & SIBR_GPU_AUTOGEN_MIPMAP) != 0);
 		if (autoMIPMAP) {
 			glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
@@ -1068,13 +1046,11 @@ namespace sibr
 
 	template<typename T_Type, unsigned int T_NumComp> template<typename ImageType>
 	void Texture2DArray<T_Type, T_NumComp>::sendMipArray(const std::vector<std::vector<ImageType>>& images) {
-		using ImgTypeInfo = GLTexFormat<ImageType, T_Type, T_NumComp>;
-		glBindTexture(GL_TEXTURE_2D_ARRAY, m_Handle);
-
-		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-		glPixelStorei(GL_PACK_ALIGNMENT, 1);
-
 		assert(m_numLODs == images.size());
+		std::vector<int> slices(m_Depth);
+		for (int im = 0; im < (int)m_Depth; ++im) {
+			slices[im] = im;
+		}
 		for (int lid = 0; lid < int(images.size()); ++lid) {
 
 			assert(m_Depth == images[lid].size());
@@ -1082,21 +1058,7 @@ namespace sibr
 			// Make sure all images have the same size.
 			const uint dW = m_W / (1 << lid);
 			const uint dH = m_H / (1 << lid);
-			std::vector<ImageType> tmp;
-			std::vector<const ImageType*> imagesPtrToSend = applyFlipAndResize(images[lid], tmp, dW, dH);
-
-			for (int im = 0; im < (int)m_Depth; ++im) {
-				glTexSubImage3D(GL_TEXTURE_2D_ARRAY,
-					lid,
-					0, 0, im,
-					dW,
-					dH,
-					1, // one slice at a time
-					ImgTypeInfo::format,
-					ImgTypeInfo::type,
-					ImgTypeInfo::data(*imagesPtrToSend[im])
-				);
-			}
+			sendSlices(images[lid], slices, lid, dW, dH);
 		}
 		// No auto mipmap when specifying the mips.
 		m_Flags &= ~SIBR_GPU_AUTOGEN_MIPMAP;
@@ -1104,50 +1066,49 @@ namespace sibr
 	}
 
 	template<typename T_Type, unsigned int T_NumComp> template<typename ImageType>
-	std::vector<const ImageType*> Texture2DArray<T_Type, T_NumComp>::applyFlipAndResize(
-		const std::vector<ImageType>& images,
-		std::vector<ImageType>& tmp, uint tw, uint th,
-		const std::vector<int>& slices)
+	void Texture2DArray<T_Type, T_NumComp>::sendSlices(const std::vector<ImageType>& images, const std::vector<int>& slices, uint level, uint tw, uint th)
 	{
 		using ImgTypeInfo = GLTexFormat<ImageType, T_Type, T_NumComp>;
 
-		std::vector<const ImageType*> imagesPtrToSend(images.size());
-		tmp.resize(images.size());
+		// Wrap the images data without copying it, the staging arena does the conversions in a single pass.
+		std::vector<cv::Mat> sources(images.size());
+		for (int im : slices) {
+			sources[im] = cv::Mat(int(ImgTypeInfo::height(images[im])), int(ImgTypeInfo::width(images[im])),
+				CV_MAKETYPE(cv::DataType<T_Type>::depth, int(T_NumComp)), const_cast<void*>(ImgTypeInfo::data(images[im])));
+		}
+		TextureStagingArena::shared().uploadSlices(m_Handle, GLint(level), sources, slices, tw, th,
+			ImgTypeInfo::format, ImgTypeInfo::type, (m_Flags & SIBR_FLIP_TEXTURE) != 0, (m_Flags & SIBR_SWIZZLE_BGR) != 0);
+	}
 
-		bool flip = m_Flags & SIBR_FLIP_TEXTURE;
-		//#pragma omp parallel for // Disabled due to performance reasons when live-updating slices.
-		for (int slice_id = 0; slice_id < (int)slices.size(); ++slice_id) {
-			int im = slices[slice_id];
+	template<typename T_Type, unsigned int T_NumComp> template<typename ImageType>
+	void Texture2DArray<T_Type, T_NumComp>::sendCompressedArray(const std::vector<ImageType>& images, BlockCompression::Format format, uint compression)
+	{
+		using ImgTypeInfo = GLTexFormat<ImageType, T_Type, T_NumComp>;
 
-			bool resize = !(tw == ImgTypeInfo::width(images[im]) && th == ImgTypeInfo::height(images[im]));
-			if (!flip && !resize) {
-				imagesPtrToSend[im] = &images[im];
-			}
-			else {
-				if (resize) {
-					tmp[im] = ImgTypeInfo::resize(images[im], tw, th);
-				}
-				if (flip) {
-					tmp[im] = ImgTypeInfo::flip(resize ? tmp[im] : images[im]);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, m_Handle);
+		std::vector<uchar> blocks;
+		uint cachedLevels = 0;
+		for (int im = 0; im < (int)m_Depth; ++im) {
+			const cv::Mat source(int(ImgTypeInfo::height(images[im])), int(ImgTypeInfo::width(images[im])),
+				CV_MAKETYPE(cv::DataType<T_Type>::depth, int(T_NumComp)), const_cast<void*>(ImgTypeInfo::data(images[im])));
+			cv::Mat level(int(m_H), int(m_W), source.type());
+			TextureStagingArena::transformSlice(source, level, (m_Flags & SIBR_FLIP_TEXTURE) != 0, (m_Flags & SIBR_SWIZZLE_BGR) != 0);
+
+			// Mipmaps can't be generated by the GPU for compressed data, they are downscaled here.
+			for (int lid = 0; lid < (int)m_numLODs; ++lid) {
+				if (lid > 0) {
+					cv::Mat smaller;
+					cv::resize(level, smaller, cv::Size(std::max(1, level.cols / 2), std::max(1, level.rows / 2)), 0, 0, cv::INTER_AREA);
+					level = smaller;
 				}
-				imagesPtrToSend[im] = &tmp[im];
+				cachedLevels += BlockCompression::encodeCached(level, format, blocks) ? 1 : 0;
+				glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, lid, 0, 0, im, level.cols, level.rows, 1, compression, GLsizei(blocks.size()), blocks.data());
 			}
 		}
-
-		return imagesPtrToSend;
-	}
-
-	template<typename T_Type, unsigned int T_NumComp>
-	template<typename ImageType>
-	std::vector<const ImageType*> Texture2DArray<T_Type, T_NumComp>::applyFlipAndResize(
-		const std::vector<ImageType>& images,
-		std::vector<ImageType>& tmp, uint tw, uint th
-	) {
-		std::vector<int> slices(m_Depth);
-		for (int i = 0; i < (int)m_Depth; ++i) {
-			slices[i] = i;
+		if (cachedLevels > 0) {
+			SIBR_LOG << "[Texture2DArray] " << cachedLevels << " of " << m_Depth * m_numLODs << " compressed levels loaded from the cache." << std::endl;
 		}
-		return applyFlipAndResize(images, tmp, tw, th, slices);
+		CHECK_GL_ERROR;
 	}
 
 	template<typename T_Type, unsigned int T_NumComp>
@@ -1211,7 +1172,15 @@ namespace sibr
 		m_Depth = (uint)images.size();
 		m_Flags = flags;
 		createArray(compression);
-		sendArray(images);
+
+		BlockCompression::Format format;
+		if (std::is_same<T_Type, unsigned char>::value && BlockCompression::fromGLFormat(compression, format)) {
+			sendCompressedArray(images, format, compression);
+		}
+		else {
+			// Let the driver compress the data.
+			sendArray(images);
+		}
 	}
 
 	template<typename T_Type, unsigned int T_NumComp> template<typename ImageType>
@@ -1272,26 +1241,7 @@ namespace sibr
 			m_H = maxSize[1];
 		}
 
-		glBindTexture(GL_TEXTURE_2D_ARRAY, m_Handle);
-
-		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-		glPixelStorei(GL_PACK_ALIGNMENT, 1);
-
-		std::vector<ImageType> tmp;
-		std::vector<const ImageType*> imagesPtrToSend = applyFlipAndResize(images, tmp, m_W, m_H, slices);
-
-		for (int i = 0; i < numSlices; ++i) {
-			glTexSubImage3D(GL_TEXTURE_2D_ARRAY,
-				0,
-				0, 0, slices[i],
-				m_W,
-				m_H,
-				1, // one slice at a time
-				ImgTypeInfo::format,
-				ImgTypeInfo::type,
-				ImgTypeInfo::data(*imagesPtrToSend[slices[i]])
-			);
-		}
+		sendSlices(images, slices, 0, m_W, m_H);
 		CHECK_GL_ERROR;
 	}
 
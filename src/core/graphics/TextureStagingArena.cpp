@@ -0,0 +1,224 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#include "core/graphics/TextureStagingArena.hpp"
+#include "core/graphics/Image.hpp"
+#include "core/system/SimpleTimer.hpp"
+#include "core/system/TaskScheduler.hpp"
+
+#include <cstring>
+
+namespace sibr
+{
+	TextureStagingArena::TextureStagingArena(size_t batchBytes, uint numBuffers)
+		: _batchBytes(std::max<size_t>(batchBytes, 1)), _numBuffers(std::max(numBuffers, 2u))
+	{
+	}
+
+	TextureStagingArena::~TextureStagingArena()
+	{
+		release();
+	}
+
+	TextureStagingArena & TextureStagingArena::shared()
+	{
+		// Never destroyed: the GL context is usually gone when static objects are.
+		static TextureStagingArena * arena = new TextureStagingArena();
+		return *arena;
+	}
+
+	void TextureStagingArena::uploadSlices(GLuint texture, GLint level, const std::vector<cv::Mat> & sources, const std::vector<int> & slices,
+		uint tw, uint th, GLenum format, GLenum type, bool flip, bool swizzle)
+	{
+		if (slices.empty()) {
+			return;
+		}
+		const size_t sliceBytes = size_t(tw) * size_t(th) * sources[slices[0]].elemSize();
+		const size_t slicesPerBatch = std::max<size_t>(1, _batchBytes / sliceBytes);
+		const bool persistent = reserve(slicesPerBatch * sliceBytes);
+
+		glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+		std::vector<int> batch;
+		for (size_t start = 0; start < slices.size(); start += slicesPerBatch) {
+			batch.assign(slices.begin() + start, slices.begin() + std::min(start + slicesPerBatch, slices.size()));
+
+			const uchar * base = nullptr;
+			Buffer * buffer = nullptr;
+			if (persistent) {
+				buffer = &_buffers[_nextBuffer];
+				_nextBuffer = (_nextBuffer + 1) % uint(_buffers.size());
+				// The GPU copies the previous batches from the other buffers meanwhile.
+				waitFor(*buffer);
+				transformSlices(sources, batch, buffer->mapped, tw, th, flip, swizzle);
+				glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer->pbo);
+			} else {
+				_cpuArena.resize(batch.size() * sliceBytes);
+				transformSlices(sources, batch, _cpuArena.data(), tw, th, flip, swizzle);
+				base = _cpuArena.data();
+			}
+
+			// Consecutive slices are sent in a single call.
+			for (size_t i = 0; i < batch.size();) {
+				size_t j = i + 1;
+				while (j < batch.size() && batch[j] == batch[j - 1] + 1) {
+					++j;
+				}
+				const size_t offset = i * sliceBytes;
+				glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, batch[i], tw, th, GLsizei(j - i), format, type,
+					buffer ? reinterpret_cast<const void*>(offset) : base + offset);
+				i = j;
+			}
+
+			if (buffer) {
+				glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+				buffer->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+				// Start the copy now, before the next batch is prepared.
+				glFlush();
+			}
+		}
+		CHECK_GL_ERROR;
+	}
+
+	void TextureStagingArena::release()
+	{
+		for (Buffer & buffer : _buffers) {
+			waitFor(buffer);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.pbo);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			glDeleteBuffers(1, &buffer.pbo);
+		}
+		_buffers.clear();
+		_bufferBytes = 0;
+		_nextBuffer = 0;
+		_cpuArena.clear();
+		_cpuArena.shrink_to_fit();
+	}
+
+	bool TextureStagingArena::reserve(size_t bytes)
+	{
+		if (!GLEW_ARB_buffer_storage) {
+			return false;
+		}
+		if (!_buffers.empty() && bytes <= _bufferBytes) {
+			return true;
+		}
+		release();
+
+		const GLbitfield mapFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		_buffers.resize(_numBuffers);
+		for (Buffer & buffer : _buffers) {
+			glGenBuffers(1, &buffer.pbo);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.pbo);
+			glBufferStorage(GL_PIXEL_UNPACK_BUFFER, GLsizeiptr(bytes), nullptr, mapFlags);
+			buffer.mapped = static_cast<uchar*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, GLsizeiptr(bytes), mapFlags));
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			if (!buffer.mapped) {
+				SIBR_WRG << "[TextureStagingArena] Unable to map a staging buffer of " << bytes << " bytes, using regular uploads." << std::endl;
+				release();
+				return false;
+			}
+		}
+		_bufferBytes = bytes;
+		CHECK_GL_ERROR;
+		return true;
+	}
+
+	void TextureStagingArena::waitFor(Buffer & buffer)
+	{
+		if (!buffer.fence) {
+			return;
+		}
+		GLenum status;
+		do {
+			status = glClientWaitSync(buffer.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+		} while (status == GL_TIMEOUT_EXPIRED);
+		glDeleteSync(buffer.fence);
+		buffer.fence = 0;
+	}
+
+	void TextureStagingArena::transformSlice(const cv::Mat & src, cv::Mat & dst, bool flip, bool swizzle)
+	{
+		if (src.size() != dst.size()) {
+			// dst already has the right size and type, the result is written in place.
+			cv::resize(src, dst, dst.size(), 0, 0, cv::INTER_LINEAR);
+			if (flip) {
+				cv::flip(dst, dst, 0);
+			}
+		} else if (flip) {
+			cv::flip(src, dst, 0);
+		} else {
+			src.copyTo(dst);
+		}
+		if (swizzle && (dst.channels() == 3 || dst.channels() == 4)) {
+			cv::cvtColor(dst, dst, dst.channels() == 3 ? cv::COLOR_RGB2BGR : cv::COLOR_RGBA2BGRA);
+		}
+	}
+
+	void TextureStagingArena::transformSlices(const std::vector<cv::Mat> & sources, const std::vector<int> & slices, uchar * dst,
+		uint tw, uint th, bool flip, bool swizzle)
+	{
+		if (slices.empty()) {
+			return;
+		}
+		const int type = sources[slices[0]].type();
+		const size_t sliceBytes = size_t(tw) * size_t(th) * CV_ELEM_SIZE(type);
+		sibr::parallelFor(0, int(slices.size()), [&](int i) {
+			cv::Mat slice(int(th), int(tw), type, dst + size_t(i) * sliceBytes);
+			transformSlice(sources[slices[i]], slice, flip, swizzle);
+		}, 1);
+	}
+
+	void TextureStagingArena::benchmarkTransform(uint numImages, uint w, uint h, uint tw, uint th)
+	{
+		std::vector<ImageRGB> images(numImages);
+		std::vector<cv::Mat> sources(numImages);
+		std::vector<int> slices(numImages);
+		for (uint i = 0; i < numImages; ++i) {
+			cv::Mat3b random(int(h), int(w));
+			cv::randu(random, cv::Scalar::all(0), cv::Scalar::all(255));
+			images[i].fromOpenCV(random);
+			sources[i] = images[i].toOpenCV();
+			slices[i] = int(i);
+		}
+
+		// Previous behavior: serial resize and flip, each in a new image.
+		Timer timer(true);
+		std::vector<ImageRGB> tmp(numImages);
+		for (uint i = 0; i < numImages; ++i) {
+			tmp[i] = images[i].resized(int(tw), int(th));
+			tmp[i] = tmp[i].clone();
+			tmp[i].flipH();
+		}
+		const double serialTime = timer.deltaTimeFromLastTic<Timer::micro>() * 1e-3;
+
+		std::vector<uchar> arena(size_t(numImages) * tw * th * 3);
+		timer.tic();
+		transformSlices(sources, slices, arena.data(), tw, th, true, false);
+		const double arenaTime = timer.deltaTimeFromLastTic<Timer::micro>() * 1e-3;
+
+		size_t mismatches = 0;
+		const size_t sliceBytes = size_t(tw) * th * 3;
+		for (uint i = 0; i < numImages; ++i) {
+			mismatches += std::memcmp(tmp[i].data(), arena.data() + i * sliceBytes, sliceBytes) != 0 ? 1 : 0;
+		}
+
+		const double megabytes = double(arena.size()) / (1024.0 * 1024.0);
+		SIBR_LOG << "[TextureStagingArena] " << numImages << " images " << w << "x" << h << " to " << tw << "x" << th << ": serial "
+			<< serialTime << "ms, arena " << arenaTime << "ms (" << megabytes / std::max(arenaTime * 1e-3, 1e-9) << "MB/s), "
+			<< mismatches << " mismatches." << std::endl;
+	}
+
+} // namespace sibr
@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+# include "core/graphics/Config.hpp"
+
+namespace sibr
+{
+	/** \brief Staging memory used to prepare and upload texture array slices.
+	* Slices are flipped, resized and optionally swizzled in parallel, directly into a ring of persistently
+	* mapped pixel unpack buffers. Slices are processed in batches: while the GPU copies a batch from one
+	* buffer, the next batch is prepared in another one. Buffers are kept between uploads and grow on demand.
+	* When persistent mapping is not supported, a CPU arena is used with regular uploads instead.
+	* \warning Upload functions must be called from the thread owning the OpenGL context.
+	* \ingroup sibr_graphics
+	*/
+	class SIBR_GRAPHICS_EXPORT TextureStagingArena
+	{
+		SIBR_DISALLOW_COPY(TextureStagingArena);
+
+	public:
+
+		/** Constructor, no memory is allocated until the first upload.
+		\param batchBytes size of each staging buffer
+		\param numBuffers number of buffers in the ring, at least 2 to overlap preparation and copies
+		*/
+		explicit TextureStagingArena(size_t batchBytes = 64 * 1024 * 1024, uint numBuffers = 3);
+
+		/** Destructor, frees the GPU buffers. */
+		~TextureStagingArena();
+
+		/** \return the arena shared by all texture arrays of the current context. */
+		static TextureStagingArena & shared();
+
+		/** Prepare and upload slices of a 2D texture array.
+		\param texture the texture array handle
+		\param level the mip level to update
+		\param sources the source images, indexed by slice, only the ones listed in slices are read
+		\param slices the slices to update
+		\param tw the slices width
+		\param th the slices height
+		\param format the GL pixel format of the sources
+		\param type the GL component type of the sources
+		\param flip flip the images vertically
+		\param swizzle swap the first and third channels
+		*/
+		void uploadSlices(GLuint texture, GLint level, const std::vector<cv::Mat> & sources, const std::vector<int> & slices,
+			uint tw, uint th, GLenum format, GLenum type, bool flip, bool swizzle);
+
+		/** Free all buffers, for instance once a scene has been loaded. */
+		void release();
+
+		/** Prepare a slice: resize it to the destination size, flip and swizzle it.
+		\param src the source image
+		\param dst the destination, preallocated with the target size and type
+		\param flip flip the image vertically
+		\param swizzle swap the first and third channels
+		*/
+		static void transformSlice(const cv::Mat & src, cv::Mat & dst, bool flip, bool swizzle);
+
+		/** Prepare slices in parallel into contiguous memory.
+		\param sources the source images
+		\param slices the indices of the sources to process, in order
+		\param dst destination memory, of at least slices.size() times the size of a slice
+		\param tw the slices width
+		\param th the slices height
+		\param flip flip the images vertically
+		\param swizzle swap the first and third channels
+		*/
+		static void transformSlices(const std::vector<cv::Mat> & sources, const std::vector<int> & slices, uchar * dst,
+			uint tw, uint th, bool flip, bool swizzle);
+
+		/** Compare the serial per-image preparation previously done before uploads against the parallel arena one, on the CPU only.
+		\param numImages number of random images
+		\param w source width
+		\param h source height
+		\param tw slices width
+		\param th slices height
+		*/
+		static void benchmarkTransform(uint numImages = 200, uint w = 1920, uint h = 1080, uint tw = 1280, uint th = 720);
+
+	private:
+
+		/** Staging buffer, mapped for the whole lifetime of the arena. */
+		struct Buffer {
+			GLuint pbo = 0; ///< Buffer handle.
+			uchar * mapped = nullptr; ///< Persistent mapping.
+			GLsync fence = 0; ///< Signaled when the GPU is done reading the buffer.
+		};
+
+		/** Make sure each buffer can hold a given number of bytes.
+		\param bytes the minimal size
+		\return false if persistent buffers are not available
+		*/
+		bool reserve(size_t bytes);
+
+		/** Wait until the GPU is done with a buffer.
+		\param buffer the buffer
+		*/
+		static void waitFor(Buffer & buffer);
+
+		size_t _batchBytes; ///< Target size of a batch.
+		size_t _bufferBytes = 0; ///< Current size of each buffer.
+		uint _numBuffers; ///< Number of buffers in the ring.
+		std::vector<Buffer> _buffers; ///< Buffers ring.
+		uint _nextBuffer = 0; ///< Next buffer to use.
+		std::vector<uchar> _cpuArena; ///< Fallback staging memory.
+	};
+
+} // namespace sibr
@@ -31,6 +31,7 @@
 # define SIBR_CLAMP_UVS					(1<<10)
 # define SIBR_CLAMP_TO_BORDER			(1<<11)
 # define SIBR_FLIP_TEXTURE				(1<<12)
+# define SIBR_SWIZZLE_BGR				(1<<13)
 
 # define SIBR_COMPILE_FORCE_SAMPLING_LINEAR	0
 
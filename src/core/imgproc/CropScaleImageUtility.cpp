@@ -30,14 +30,14 @@ namespace sibr {
 		return pathToImgs;
 	}
 
-	void CropScaleImageUtility::logExecution(const sibr::Vector2i & originalResolution, unsigned nrImages, long long elapsedTime, bool wasTransformed, const char* log_file_name)
+	void CropScaleImageUtility::logExecution(const sibr::Vector2i & originalResolution, unsigned nrImages, long long elapsedTime, bool wasTransformed, const char* log_file_name, double imagesPerSecond)
 	{
 		// check if file exists
 		const bool isEmptyFile = !sibr::fileExists(log_file_name);
 		std::ofstream outputFile(log_file_name, std::ios::app);
 
 		if (isEmptyFile) {
-			outputFile << "date\t\t\tresolution\tnrImgs\telapsedTime\twas transformed?\n";
+			outputFile << "date\t\t\tresolution\tnrImgs\telapsedTime\twas transformed?\timgs/s\n";
 		}
 
 		time_t now = std::time(nullptr);
@@ -53,7 +53,7 @@ namespace sibr {
 		dateSS << "[" << 1900 + ltm.tm_year << "/" << 1 + ltm.tm_mon << "/" << ltm.tm_mday << "] "
 			<< ltm.tm_hour << ":" << ltm.tm_min << ":" << ltm.tm_sec;
 
-		outputFile << dateSS.str() << "\t" << originalResolution[0] << "x" << originalResolution[1] << "\t\t" << nrImages << "\t" << elapsedTime << "\t" << wasTransformed << "\n";
+		outputFile << dateSS.str() << "\t" << originalResolution[0] << "x" << originalResolution[1] << "\t\t" << nrImages << "\t" << elapsedTime << "\t" << wasTransformed << "\t" << imagesPerSecond << "\n";
 
 		outputFile.close();
 	}
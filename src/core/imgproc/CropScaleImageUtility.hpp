@@ -51,8 +51,9 @@ namespace sibr {
 		 * \param elapsedTime the time taken by the processing
 		 * \param wasTransformed was transforamtion applied
 		 * \param log_file_name the destination file path
+		 * \param imagesPerSecond the processing throughput, if known
 		 */
-		void logExecution(const sibr::Vector2i & resolution, unsigned nrImages, long long elapsedTime, bool wasTransformed, const char* log_file_name);
+		void logExecution(const sibr::Vector2i & resolution, unsigned nrImages, long long elapsedTime, bool wasTransformed, const char* log_file_name, double imagesPerSecond = 0.0);
 		
 		/**
 		 * Save a list of images to a list_images.txt file, where each image has a line "name w h".
@@ -11,6 +11,7 @@
 
 
 #include "DistordCropUtility.hpp"
+#include "ImagePipeline.hpp"
 
 namespace sibr {
 	
@@ -20,6 +21,29 @@ namespace sibr {
 		return c.squaredNorm() < threshold_black_color;
 	}
 
+	std::vector<uchar> DistordCropUtility::backgroundMask(const cv::Mat & img, const Vector3i & backgroundColor, int threshold_black_color, bool bgrOrder) {
+		if (img.type() != CV_8UC3) {
+			SIBR_ERR << "[distordCrop] Expected a 8UC3 image." << std::endl;
+		}
+		const int c0 = bgrOrder ? backgroundColor[2] : backgroundColor[0];
+		const int c1 = backgroundColor[1];
+		const int c2 = bgrOrder ? backgroundColor[0] : backgroundColor[2];
+
+		std::vector<uchar> mask(size_t(img.cols) * size_t(img.rows));
+		for (int y = 0; y < img.rows; ++y) {
+			const uchar * src = img.ptr<uchar>(y);
+			uchar * dst = &mask[size_t(y) * img.cols];
+			// No branch and no early exit, so that the compiler vectorizes the loop.
+			for (int x = 0; x < img.cols; ++x) {
+				const int d0 = int(src[3 * x]) - c0;
+				const int d1 = int(src[3 * x + 1]) - c1;
+				const int d2 = int(src[3 * x + 2]) - c2;
+				dst[x] = uchar(d0 * d0 + d1 * d1 + d2 * d2 < threshold_black_color);
+			}
+		}
+		return mask;
+	}
+
 
 	bool DistordCropUtility::is_number(const std::string& s)
 	{
@@ -64,58 +88,62 @@ namespace sibr {
 
 
 	DistordCropUtility::Bounds DistordCropUtility::getBounds(const sibr::ImageRGB & img, Vector3i backgroundColor, int threshold_black_color, int thinest_bounding_box_size, float toleranceFactor) {
-		int w = img.w() - 1;
-		int h = img.h() - 1;
-
-		sibr::Array2d<bool> wasVisited(img.w(), img.h(), false);
-		sibr::Array2d<bool> isBlack(img.w(), img.h(), false);
-		std::priority_queue<sibr::Vector2i> pixelsQueue;
-
-		//init with boundary pixel (set initial pixelQueue)
-		// add first row and last row of pixels to the pixelsQueue (if they are black) and marked them as visited
-		for (int x = 0; x<w; ++x) {
-			addPixelToQueue(sibr::Vector2i(x, 0), img, pixelsQueue, wasVisited, backgroundColor, threshold_black_color);
-			addPixelToQueue(sibr::Vector2i(x, h - 1), img, pixelsQueue, wasVisited, backgroundColor, threshold_black_color);
-		}
+		return getBounds(img.toOpenCV(), backgroundColor, threshold_black_color, thinest_bounding_box_size, toleranceFactor, false);
+	}
 
-		// add left col and right col of pixels to the pixelsQueue (if they are black) and marked them as visited
-		for (int y = 0; y<h; ++y) {
-			addPixelToQueue(sibr::Vector2i(0, y), img, pixelsQueue, wasVisited, backgroundColor, threshold_black_color);
-			addPixelToQueue(sibr::Vector2i(w - 1, y), img, pixelsQueue, wasVisited, backgroundColor, threshold_black_color);
-		}
+	DistordCropUtility::Bounds DistordCropUtility::getBounds(const cv::Mat & img, Vector3i backgroundColor, int threshold_black_color, int thinest_bounding_box_size, float toleranceFactor, bool bgrOrder) {
+		const int w = img.cols;
+		const int h = img.rows;
+
+		// 1 for pixels of the background color, set to 2 once reached from the boundaries.
+		std::vector<uchar> mask = backgroundMask(img, backgroundColor, threshold_black_color, bgrOrder);
+		std::vector<int> pixelsStack;
+		const auto addPixel = [&](int id) {
+			if (mask[id] == 1) {
+				mask[id] = 2;
+				pixelsStack.push_back(id);
+			}
+		};
 
-		//neighbors shifts
-		sibr::Vector2i shiftsArray[4] = { sibr::Vector2i(1,0), sibr::Vector2i(-1,0), sibr::Vector2i(0,-1), sibr::Vector2i(0,1) };
-		std::vector<sibr::Vector2i> shifts(shiftsArray, shiftsArray + sizeof(shiftsArray) / sizeof(sibr::Vector2i));
+		//init with boundary pixels
+		for (int x = 0; x < w; ++x) {
+			addPixel(x);
+			addPixel((h - 1) * w + x);
+		}
+		for (int y = 0; y < h; ++y) {
+			addPixel(y * w);
+			addPixel(y * w + w - 1);
+		}
 
 		//find all black pixels linked to the boundaries
-		while (pixelsQueue.size() > 0) {
-			sibr::Vector2i currentPix = pixelsQueue.top();
-			pixelsQueue.pop();
-			// if it was in the queue, then it was black
-			isBlack(currentPix.x(), currentPix.y()) = true;
-
-			for (auto & shift : shifts) {
-				sibr::Vector2i newPos = currentPix + shift;
-				if (img.isInRange(newPos.x(), newPos.y())) {
-					addPixelToQueue(newPos, img, pixelsQueue, wasVisited, backgroundColor, threshold_black_color);
-				}
-			}
+		while (!pixelsStack.empty()) {
+			const int id = pixelsStack.back();
+			pixelsStack.pop_back();
+			const int x = id % w;
+			const int y = id / w;
+			if (x > 0) { addPixel(id - 1); }
+			if (x < w - 1) { addPixel(id + 1); }
+			if (y > 0) { addPixel(id - w); }
+			if (y < h - 1) { addPixel(id + w); }
+		}
 
+		sibr::Array2d<bool> isBlack(w, h, false);
+		for (int id = 0; id < w * h; ++id) {
+			isBlack[id] = mask[id] == 2;
 		}
 
 		//find maximal bounding box not containing black pixels
-		DistordCropUtility::Bounds bounds(img);
+		DistordCropUtility::Bounds bounds(sibr::Vector2i(w, h));
 		findBounds(isBlack, bounds, thinest_bounding_box_size);
 
-		bounds.xRatio = bounds.xMax / (float)img.w() - 0.5f;
-		bounds.yRatio = bounds.yMax / (float)img.h() - 0.5f;
+		bounds.xRatio = bounds.xMax / (float)w - 0.5f;
+		bounds.yRatio = bounds.yMax / (float)h - 0.5f;
 
 		int proposedWidth = bounds.xMax - bounds.xMin;
 		int proposedHeight = bounds.yMax - bounds.yMin;
 
-		bounds.width = int(float(int(img.w()) - proposedWidth) * toleranceFactor + float(proposedWidth));
-		bounds.height = int(float(int(img.h()) - proposedHeight) * toleranceFactor + float(proposedHeight));
+		bounds.width = int(float(w - proposedWidth) * toleranceFactor + float(proposedWidth));
+		bounds.height = int(float(h - proposedHeight) * toleranceFactor + float(proposedHeight));
 
 		return bounds;
 	}
@@ -123,45 +151,38 @@ namespace sibr {
 
 	sibr::Vector2i DistordCropUtility::calculateAvgResolution(const std::vector<Path>& imagePaths, std::vector<sibr::Vector2i> & resolutions, const int batch_size)
 	{
-		const int nrBatches = static_cast<int>(ceil((float)(imagePaths.size()) / batch_size));
-		resolutions.resize(imagePaths.size());
-		std::vector<std::pair<std::pair<long, long>, unsigned>> sumAndNrItems(nrBatches);
-
-		for (int batchId = 0; batchId < nrBatches; batchId++) {
+		// images that fail to load keep a null resolution, they are not averaged and are excluded afterwards
+		resolutions.assign(imagePaths.size(), sibr::Vector2i(0, 0));
 
-			const int nrItems = (batchId != nrBatches - 1) ? batch_size : ((nrBatches * batch_size != int(imagePaths.size())) ? (int(imagePaths.size()) - (batch_size * batchId)) : batch_size);
-			long sumOfWidths = 0;
-			long sumOfHeights = 0;
-
-			std::vector<sibr::ImageRGB> chunkOfInputImages(nrItems);
-
-#pragma omp parallel for
-			for (int localImgIndex = 0; localImgIndex < nrItems; localImgIndex++) {
-				unsigned globalImgIndex = (batchId * batch_size) + localImgIndex;
-				chunkOfInputImages.at(localImgIndex).load(imagePaths.at(globalImgIndex).string(), false);
-
-#pragma omp critical
-				{
-					sumOfWidths += long(chunkOfInputImages[localImgIndex].w());
-					sumOfHeights += long(chunkOfInputImages[localImgIndex].h());
-					resolutions[localImgIndex].x() = chunkOfInputImages[localImgIndex].w();
-					resolutions[localImgIndex].y() = chunkOfInputImages[localImgIndex].h();
-				}
-			}
-			std::pair<long, long> sums(sumOfWidths, sumOfHeights);
-			std::pair<std::pair<long, long>, unsigned> batch(sums, nrItems);
-			sumAndNrItems[batchId] = batch;
+		std::vector<std::string> names;
+		for (const Path & path : imagePaths) {
+			names.push_back(path.string());
 		}
 
+		ImagePipeline pipeline(0, 0, 1, size_t(batch_size));
+		const ImagePipeline::Stats stats = pipeline.run(names,
+			[](ImagePipeline::Item & item) {
+				item.image = cv::imread(item.name, cv::IMREAD_COLOR);
+				return !item.image.empty();
+			},
+			[&](ImagePipeline::Item & item) {
+				resolutions[item.id] = sibr::Vector2i(item.image.cols, item.image.rows);
+				return true;
+			},
+			[](ImagePipeline::Item &) { return true; }
+		);
+		stats.log("distordCrop");
+
 		long sumOfWidth = 0;
 		long sumOfHeight = 0;
-		for (unsigned i = 0; i < sumAndNrItems.size(); i++) {
-			sumOfWidth += sumAndNrItems[i].first.first;
-			sumOfHeight += sumAndNrItems[i].first.second;
+		for (const sibr::Vector2i & res : resolutions) {
+			sumOfWidth += long(res.x());
+			sumOfHeight += long(res.y());
 		}
 
-		const long globalAvgWidth = sumOfWidth / long(imagePaths.size());
-		const long globalAvgHeight = sumOfHeight / long(imagePaths.size());
+		const long nrImages = std::max(long(1), long(stats.numItems));
+		const long globalAvgWidth = sumOfWidth / nrImages;
+		const long globalAvgHeight = sumOfHeight / nrImages;
 
 		return sibr::Vector2i(int(globalAvgWidth), int(globalAvgHeight));
 	}
@@ -203,30 +224,34 @@ namespace sibr {
 
 		// compute bounding boxes for all non-discarded images
 		std::vector<Bounds> allBounds(imagePaths.size());
-
-		const int nrBatches = static_cast<int>(ceil((float)(imagePaths.size()) / batch_size));
-
-		// processs batches sequentially (we don't want to run out of memory)
-		for (int batchId = 0; batchId < nrBatches; batchId++) {
-
-			const int nrItems = (batchId != nrBatches - 1) ? batch_size : ((nrBatches * batch_size != int(imagePaths.size())) ? (int(imagePaths.size()) - (batch_size * batchId)) : batch_size);
-
-			std::vector<sibr::ImageRGB> chunkOfInputImages(nrItems);
-
-			// load images in parallel (OpenMP 2.0 doesn't allow unsigned int as index. must be signed integral type)
-#pragma omp parallel for
-			for (int localImgIndex = 0; localImgIndex < nrItems; localImgIndex++) {
-				const uint globalImgIndex = uint((batchId * batch_size) + localImgIndex);
-				// if cam was discarded, do nothing
-				if (std::find(preExcludedCams.begin(), preExcludedCams.end(), globalImgIndex) == preExcludedCams.end()) {
-					// only now load the img
-					chunkOfInputImages.at(localImgIndex).load(imagePaths.at(globalImgIndex).string(), false);
-					allBounds.at(globalImgIndex) = getBounds(chunkOfInputImages.at(localImgIndex), backgroundColor, threshold_black_color, thinest_bounding_box_size, toleranceFactor);
-
-				}
+		std::vector<char> wasProcessed(imagePaths.size(), 0);
+
+		std::vector<std::string> names;
+		std::vector<uint> nameToImage;
+		for (uint i = 0; i < uint(imagePaths.size()); ++i) {
+			if (std::find(preExcludedCams.begin(), preExcludedCams.end(), i) == preExcludedCams.end()) {
+				names.push_back(imagePaths[i].string());
+				nameToImage.push_back(i);
 			}
 		}
 
+		// decoding and bounds estimation overlap, at most batch_size decoded images are waiting in memory
+		ImagePipeline pipeline(0, 0, 1, size_t(batch_size));
+		const ImagePipeline::Stats stats = pipeline.run(names,
+			[](ImagePipeline::Item & item) {
+				item.image = cv::imread(item.name, cv::IMREAD_COLOR);
+				return !item.image.empty();
+			},
+			[&](ImagePipeline::Item & item) {
+				const uint globalImgIndex = nameToImage[item.id];
+				allBounds[globalImgIndex] = getBounds(item.image, backgroundColor, threshold_black_color, thinest_bounding_box_size, toleranceFactor, true);
+				wasProcessed[globalImgIndex] = 1;
+				return true;
+			},
+			[](ImagePipeline::Item &) { return true; }
+		);
+		stats.log("distordCrop");
+
 		Bounds finalBounds(resolutions.at(0));
 
 		int im_id = 0;
@@ -239,7 +264,8 @@ namespace sibr {
 		int minHeight = -1;
 
 		for (auto & bounds : allBounds) {
-			bool wasPreExcluded = std::find(preExcludedCams.begin(), preExcludedCams.end(), im_id) != preExcludedCams.end();
+			// images that could not be loaded are excluded too
+			bool wasPreExcluded = !wasProcessed[im_id];
 
 			if (!wasPreExcluded && bounds.xRatio > threshold_ratio_bounding_box_size && bounds.yRatio > threshold_ratio_bounding_box_size) {
 				// get global x and y ratios
@@ -275,17 +301,29 @@ namespace sibr {
 
 	sibr::Vector2i DistordCropUtility::findMinImageSize(const Path & root, const std::vector<Path>& imagePaths)
 	{
-		std::vector<sibr::ImageRGB> inputImgs(imagePaths.size());
-		std::vector<sibr::Vector2i> imSizes(imagePaths.size());
+		std::vector<sibr::Vector2i> imSizes(imagePaths.size(), sibr::Vector2i(std::numeric_limits<int>::max(), std::numeric_limits<int>::max()));
 
 		std::cout << "[distordCrop] loading input images : " << std::flush;
 
-#pragma omp parallel for
-		for (int id = 0; id < (int)inputImgs.size(); ++id) {
-			inputImgs.at(id).load(imagePaths.at(id).string(), false);
-			imSizes[id] = inputImgs[id].size().cast<int>();
+		std::vector<std::string> names;
+		for (const Path & path : imagePaths) {
+			names.push_back(path.string());
 		}
 
+		ImagePipeline pipeline;
+		const ImagePipeline::Stats stats = pipeline.run(names,
+			[](ImagePipeline::Item & item) {
+				item.image = cv::imread(item.name, cv::IMREAD_COLOR);
+				return !item.image.empty();
+			},
+			[&](ImagePipeline::Item & item) {
+				imSizes[item.id] = sibr::Vector2i(item.image.cols, item.image.rows);
+				return true;
+			},
+			[](ImagePipeline::Item &) { return true; }
+		);
+		stats.log("distordCrop");
+
 		sibr::Vector2i minSize = imSizes[0];
 		for (const auto & size : imSizes) {
 			minSize = minSize.cwiseMin(size);
@@ -89,6 +89,16 @@ namespace sibr {
 		 */
 		bool isBlack(const sibr::Vector3ub & pixelColor, Vector3i backgroundColor, int threshold_black_color);
 
+		/** Classify all pixels of an image at once: a pixel is marked if it is close to a reference color (as in isBlack).
+		 * Each row is processed by a branchless loop on the raw 8-bit data, vectorized by the compiler.
+		 *\param img a 8UC3 image
+		 *\param backgroundColor the reference color, in RGB order
+		 *\param threshold_black_color the tolerance threshold
+		 *\param bgrOrder is the image stored in BGR order (as decoded by OpenCV)
+		 *\return a row-major mask of img.cols*img.rows values, 1 for pixels close to the reference color, 0 otherwise
+		 */
+		static std::vector<uchar> backgroundMask(const cv::Mat & img, const Vector3i & backgroundColor, int threshold_black_color, bool bgrOrder = false);
+
 		/*
 		* Check if a file name is made out only of digits and not letters (like texture file names).
 		* \param s the filename to test
@@ -127,11 +137,22 @@ namespace sibr {
 		 */
 		Bounds getBounds(const sibr::ImageRGB & img, Vector3i backgroundColor, int threshold_black_color, int thinest_bounding_box_size, float toleranceFactor);
 
+		/** Estimate a region of an image so that no pixels of a reference color are contained in it, without converting the image.
+		 *\param img a 8UC3 image, as decoded by OpenCV
+		 *\param backgroundColor the reference color, in RGB order
+		 *\param threshold_black_color the color tolerance threshold
+		 *\param thinest_bounding_box_size minimum size of the bounds along any dimension
+		 *\param toleranceFactor Additional tolerance factor: if set to 0 the bounds will be tight, if set to 1 it will cover the full image.
+		 *\param bgrOrder is the image stored in BGR order
+		 *\return the estimated region boundaries
+		 */
+		Bounds getBounds(const cv::Mat & img, Vector3i backgroundColor, int threshold_black_color, int thinest_bounding_box_size, float toleranceFactor, bool bgrOrder);
+
 		/**
-		 * Estimate the average resolution of a set of images quickly using multithread to speed up the required loading.
+		 * Estimate the average resolution of a set of images quickly, decoding images on a staged pipeline.
 		 * \param imagePaths list of paths to the images
 		 * \param resolutions will contain each image resolution
-		 * \param batch_size number of images loaded per thread internally
+		 * \param batch_size maximal number of decoded images waiting to be processed
 		 * \return the average resolution
 		 */
 		sibr::Vector2i calculateAvgResolution(const std::vector< Path > & imagePaths, std::vector<sibr::Vector2i> & resolutions, const int batch_size = 150);
@@ -143,7 +164,7 @@ namespace sibr {
 		 * \param resolutions will contain the image resolutions
 		 * \param avgWidth average image width, if 0 will be recomputed (slow for large datasets)
 		 * \param avgHeight average image height, if 0 will be recomputed (slow for large datasets)
-		 * \param batch_size batch size for multithreaded image loading
+		 * \param batch_size maximal number of decoded images waiting to be processed
 		 * \param resolutionThreshold ratio of the minimum allowed dimensions over the average image dimensions
 		 * \param threshold_ratio_bounding_box_size maximum change in aspect ratio
 		 * \param backgroundColor the reference background color
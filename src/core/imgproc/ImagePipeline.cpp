@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#include "ImagePipeline.hpp"
+
+#include <core/system/BoundedQueue.hpp>
+#include <core/system/SimpleTimer.hpp>
+
+#include <atomic>
+#include <thread>
+
+namespace sibr {
+
+	void ImagePipeline::Stats::log(const std::string & label) const
+	{
+		SIBR_LOG << "[" << label << "] " << numItems << " images in " << seconds << "s ("
+			<< itemsPerSecond() << " images/s), " << numFailed << " failed. Time per stage (summed over threads): read "
+			<< readSeconds << "s, process " << processSeconds << "s, write " << writeSeconds << "s." << std::endl;
+	}
+
+	ImagePipeline::ImagePipeline(uint numReaders, uint numWorkers, uint numWriters, size_t queueSize)
+		: _queueSize(queueSize)
+	{
+		const uint numCores = std::max(1u, std::thread::hardware_concurrency());
+		// By default, compute gets most of the cores, I/O threads mostly wait on the codecs.
+		_numReaders = numReaders > 0 ? numReaders : std::max(1u, numCores / 4);
+		_numWriters = numWriters > 0 ? numWriters : std::max(1u, numCores / 4);
+		_numWorkers = numWorkers > 0 ? numWorkers : std::max(1u, numCores - numCores / 4);
+	}
+
+	ImagePipeline::Stats ImagePipeline::run(const std::vector<std::string> & names, const StageFunction & read, const StageFunction & process, const StageFunction & write) const
+	{
+		BoundedQueue<Item> decoded(_queueSize);
+		BoundedQueue<Item> processed(_queueSize);
+
+		std::atomic<size_t> nextInput(0);
+		std::atomic<size_t> numDone(0), numFailed(0);
+		std::atomic<long long> readTime(0), processTime(0), writeTime(0);
+		std::atomic<uint> activeReaders(_numReaders), activeWorkers(_numWorkers);
+
+		// Time a stage call and accumulate it, in microseconds.
+		auto timed = [](const StageFunction & f, Item & item, std::atomic<long long> & total) {
+			Timer timer(true);
+			const bool ok = f(item);
+			total += (long long)timer.deltaTimeFromLastTic<Timer::micro>();
+			return ok;
+		};
+
+		Timer timer(true);
+		std::vector<std::thread> threads;
+
+		for (uint t = 0; t < _numReaders; ++t) {
+			threads.emplace_back([&]() {
+				size_t id;
+				while ((id = nextInput++) < names.size()) {
+					Item item;
+					item.id = id;
+					item.name = names[id];
+					if (!timed(read, item, readTime)) {
+						++numFailed;
+						continue;
+					}
+					decoded.push(std::move(item));
+				}
+				if (--activeReaders == 0) {
+					decoded.close();
+				}
+			});
+		}
+
+		for (uint t = 0; t < _numWorkers; ++t) {
+			threads.emplace_back([&]() {
+				Item item;
+				while (decoded.pop(item)) {
+					if (!timed(process, item, processTime)) {
+						++numFailed;
+						continue;
+					}
+					// Release the input as soon as possible to bound memory.
+					item.image.release();
+					processed.push(std::move(item));
+				}
+				if (--activeWorkers == 0) {
+					processed.close();
+				}
+			});
+		}
+
+		for (uint t = 0; t < _numWriters; ++t) {
+			threads.emplace_back([&]() {
+				Item item;
+				while (processed.pop(item)) {
+					if (timed(write, item, writeTime)) {
+						++numDone;
+					} else {
+						++numFailed;
+					}
+				}
+			});
+		}
+
+		for (std::thread & thread : threads) {
+			thread.join();
+		}
+
+		Stats stats;
+		stats.numItems = numDone;
+		stats.numFailed = numFailed;
+		stats.seconds = timer.deltaTimeFromLastTic<Timer::micro>() * 1e-6;
+		stats.readSeconds = readTime * 1e-6;
+		stats.processSeconds = processTime * 1e-6;
+		stats.writeSeconds = writeTime * 1e-6;
+		return stats;
+	}
+
+}
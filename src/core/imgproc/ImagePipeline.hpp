@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+#include "Config.hpp"
+
+#include <opencv2/core.hpp>
+#include <functional>
+
+
+namespace sibr {
+
+	/** \brief Staged image processing pipeline for batch tools.
+	* Reader threads decode images, worker threads process them and writer threads encode the results,
+	* the stages being connected by bounded queues so that decoding, processing and encoding overlap
+	* while the number of images in memory stays bounded.
+	* \ingroup sibr_imgproc
+	*/
+	class SIBR_IMGPROC_EXPORT ImagePipeline
+	{
+	public:
+
+		/** An image travelling through the pipeline. */
+		struct Item {
+			size_t id = 0; ///< Index of the image in the input list.
+			std::string name; ///< Input name, as given to run.
+			cv::Mat image; ///< Decoded image, filled by the read stage.
+			std::vector<cv::Mat> outputs; ///< Processed images, filled by the process stage.
+		};
+
+		/** Stage function, returning false if the item should be dropped. */
+		using StageFunction = std::function<bool(Item & item)>;
+
+		/** Execution statistics. */
+		struct SIBR_IMGPROC_EXPORT Stats {
+			size_t numItems = 0; ///< Number of items that went through all stages.
+			size_t numFailed = 0; ///< Number of items dropped by a stage.
+			double seconds = 0.0; ///< Wall-clock duration.
+			double readSeconds = 0.0; ///< Time spent in the read stage, summed over threads.
+			double processSeconds = 0.0; ///< Time spent in the process stage, summed over threads.
+			double writeSeconds = 0.0; ///< Time spent in the write stage, summed over threads.
+
+			/** \return the throughput in images per second. */
+			double itemsPerSecond() const { return seconds > 0.0 ? double(numItems) / seconds : 0.0; }
+
+			/** Print the statistics to the log.
+			\param label name of the processing
+			*/
+			void log(const std::string & label) const;
+		};
+
+		/** Constructor.
+		\param numReaders number of decoding threads, 0 for automatic
+		\param numWorkers number of processing threads, 0 for automatic
+		\param numWriters number of encoding threads, 0 for automatic
+		\param queueSize maximal number of images waiting between two stages
+		*/
+		ImagePipeline(uint numReaders = 0, uint numWorkers = 0, uint numWriters = 0, size_t queueSize = 8);
+
+		/** Process a list of inputs. Each stage function can be called concurrently from several threads.
+		\param names the inputs, typically file paths
+		\param read decode item.name into item.image
+		\param process fill item.outputs from item.image
+		\param write encode item.outputs
+		\return execution statistics
+		*/
+		Stats run(const std::vector<std::string> & names, const StageFunction & read, const StageFunction & process, const StageFunction & write) const;
+
+	private:
+		uint _numReaders; ///< Number of decoding threads.
+		uint _numWorkers; ///< Number of processing threads.
+		uint _numWriters; ///< Number of encoding threads.
+		size_t _queueSize; ///< Capacity of the inter-stage queues.
+	};
+
+}
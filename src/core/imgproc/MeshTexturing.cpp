@@ -13,12 +13,19 @@
 #include "MeshTexturing.hpp"
 #include "PoissonReconstruction.hpp"
 #include <core/system/LoadingProgress.hpp>
+#include <core/system/SimpleTimer.hpp>
+#include <core/system/TaskScheduler.hpp>
+#include <core/system/Utils.hpp>
+
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <mutex>
+#include <sstream>
 
 namespace sibr {
 
 	MeshTexturing::MeshTexturing(unsigned int sideSize) :
-		_accum(sideSize, sideSize, Vector3f(0.0f, 0.0f, 0.0f)),
-		_mask(sideSize, sideSize, 0)
+		_sideSize(sideSize)
 	{
 
 	}
@@ -41,11 +48,10 @@ namespace sibr {
 		const int verticesCount = int(_mesh->vertices().size());
 		std::vector<sibr::Vector3f> uvVertices(verticesCount);
 
-#pragma omp parallel for
-		for (int vid = 0; vid < verticesCount; ++vid) {
+		sibr::parallelFor(0, verticesCount, [&](int vid) {
 			const sibr::Vector2f & uvs = _mesh->texCoords()[vid];
 			uvVertices[vid] = sibr::Vector3f(uvs[0], uvs[1], 0.0f);
-		}
+		});
 		Mesh uvMesh(false);
 		uvMesh.vertices(uvVertices);
 		uvMesh.triangles(_mesh->triangles());
@@ -74,6 +80,83 @@ namespace sibr {
 		normal = (wCoord * normals[tri[0]] + uCoord * normals[tri[1]] + vCoord * normals[tri[2]]).normalized();
 	}
 
+	bool MeshTexturing::shadeTexel(int px, int py, const std::vector<InputCamera::Ptr> & cameras, const std::vector<sibr::ImageRGB::Ptr> & images, const float sampleRatio, sibr::Vector3f & color) {
+
+		struct SampleInfos {
+			sibr::Vector3f color;
+			float weight;
+		};
+
+		// Check if we fall inside a triangle in the UV map.
+		RayHit hit;
+		const bool hasHit = sampleNeighborhood(px, py, hit);
+
+		// We really have no triangle in the neighborhood to use, skip.
+		if (!hasHit) {
+			return false;
+		}
+
+		// Need the smooth position and normal in the initial mesh.
+		sibr::Vector3f vertex, normal;
+		interpolate(hit, vertex, normal);
+
+		sibr::Vector3f avgColor(0.0f, 0.0f, 0.0f);
+		float totalWeight = 0.0f;
+
+		std::vector<SampleInfos> samples;
+
+		for (int cid = 0; cid < cameras.size(); ++cid) {
+			const auto & cam = cameras[cid];
+			if (!cam->frustumTest(vertex)) {
+				continue;
+			}
+
+			// Check for occlusions.
+			sibr::Vector3f occDir = (vertex - cam->position());
+			const float dist = occDir.norm();
+			if (dist > 0.0f) {
+				occDir /= dist;
+			}
+			const RayHit hitOcc = _worldRaycaster.intersect(Ray(cam->position(), occDir));
+			if (hitOcc.hitSomething() && (hitOcc.dist() + 0.0001f) < dist) {
+				continue;
+			}
+
+			// Reproject, read color.
+			const sibr::Vector2f pos = cam->projectImgSpaceInvertY(vertex).xy();
+			const sibr::Vector3f col = images[cid]->bilinear(pos).cast<float>().xyz();
+			// Angle-based weight for now.
+			const float angleWeight = std::max(-occDir.dot(normal), 0.0f);
+			const float weight = angleWeight;
+			samples.emplace_back();
+			samples.back().color = col;
+			samples.back().weight = weight;
+		}
+		if (samples.empty()) {
+			return false;
+		}
+
+		std::sort(samples.begin(), samples.end(), [](const SampleInfos & a, const SampleInfos & b)
+		{
+			return a.weight > b.weight;
+		});
+
+		// Re-weight and accumulate the samples.
+		// The code is written this way to support 'best sampleRatio of all samples' approaches.
+		for (int i = 0; i < sampleRatio * samples.size(); ++i) {
+			float w = samples[i].weight;
+			w = w * w;
+			totalWeight += w;
+			avgColor += w * samples[i].color;
+		}
+
+		if (totalWeight > 0.0f) {
+			color = avgColor / totalWeight;
+			return true;
+		}
+		return false;
+	}
+
 	void MeshTexturing::reproject(const std::vector<InputCamera::Ptr> & cameras, const std::vector<sibr::ImageRGB::Ptr> & images, const float sampleRatio) {
 		// We need a mesh for reprojection.
 		if (!_mesh) {
@@ -81,12 +164,10 @@ namespace sibr {
 			return;
 		}
 
-
-		struct SampleInfos {
-			sibr::Vector3f color;
-			float weight;
-		};
-
+		if (_accum.w() != _sideSize) {
+			_accum = sibr::ImageRGB32F(_sideSize, _sideSize, Vector3f(0.0f, 0.0f, 0.0f));
+			_mask = sibr::ImageL8(_sideSize, _sideSize, 0);
+		}
 
 		const int w = _accum.w();
 		const int h = _accum.h();
@@ -94,85 +175,141 @@ namespace sibr {
 		sibr::LoadingProgress			progress(h, "[Texturing] Gathering color samples from cameras" );
 		SIBR_LOG << "[Texturing] Gathering color samples from " << cameras.size() << " cameras ..." << std::endl;
 
-#pragma omp parallel for
-		for (int py = 0; py < h; ++py) {
+		sibr::parallelFor(0, h, [&](int py) {
 			for (int px = 0; px < w; ++px) {
-				// Check if we fall inside a triangle in the UV map.
-				RayHit hit;
-				const bool hasHit = sampleNeighborhood(px, py, hit);
-
-				// We really have no triangle in the neighborhood to use, skip.
-				if (!hasHit) {
-					continue;
+				sibr::Vector3f color;
+				if (shadeTexel(px, py, cameras, images, sampleRatio, color)) {
+					_accum(px, py) = color;
+					_mask(px, py)[0] = 255;
 				}
+			}
+			if( (py % 1000) == 0 )
+				progress.walk(1000);
+		}, 1);
+	}
 
-				// Need the smooth position and normal in the initial mesh.
-				sibr::Vector3f vertex, normal;
-				interpolate(hit, vertex, normal);
+	uint MeshTexturing::reprojectTiles(const std::vector<InputCamera::Ptr> & cameras, const std::vector<sibr::ImageRGB::Ptr> & images, const std::string & directory, uint tileSize, uint options, const float sampleRatio) {
+		// We need a mesh for reprojection.
+		if (!_mesh) {
+			SIBR_WRG << "[Texturing] No mesh available." << std::endl;
+			return 0;
+		}
+		if (options & Options::POISSON_FILL) {
+			SIBR_WRG << "[Texturing] Poisson filling is not supported when texturing by tiles, ignoring." << std::endl;
+		}
 
-				sibr::Vector3f avgColor(0.0f, 0.0f, 0.0f);
-				float totalWeight = 0.0f;
+		const int size = int(_sideSize);
+		const int tile = int(std::max(std::min(tileSize, _sideSize), 1u));
+		const int tilesPerSide = (size + tile - 1) / tile;
+		const bool flip = (options & Options::FLIP_VERTICAL) != 0;
+		const int halo = (options & Options::FLOOD_FILL) ? std::max(tile / 8, 16) : 0;
+
+		// Refuse to mix tiles generated with other parameters.
+		makeDirectory(directory);
+		const std::string indexPath = directory + "/tiles.txt";
+		std::stringstream indexContent;
+		indexContent << "size " << size << "\n" << "tile " << tile << "\n" << "grid " << tilesPerSide << " " << tilesPerSide << "\n" << "options " << options << "\n";
+		if (fileExists(indexPath)) {
+			std::ifstream indexFile(indexPath);
+			std::stringstream existing;
+			existing << indexFile.rdbuf();
+			if (existing.str() != indexContent.str()) {
+				SIBR_WRG << "[Texturing] " << directory << " contains tiles generated with other parameters." << std::endl;
+				return 0;
+			}
+		} else {
+			std::ofstream indexFile(indexPath);
+			indexFile << indexContent.str();
+		}
 
-				std::vector<SampleInfos> samples;
+		SIBR_LOG << "[Texturing] Gathering color samples from " << cameras.size() << " cameras in " << tilesPerSide * tilesPerSide << " tiles of " << tile << "x" << tile << "..." << std::endl;
+		if (options & Options::FLOOD_FILL) {
+			SIBR_LOG << "[Texturing] Flood filling each tile with a " << halo << " texels margin..." << std::endl;
+		}
 
-				for (int cid = 0; cid < cameras.size(); ++cid) {
-					const auto & cam = cameras[cid];
-					if (!cam->frustumTest(vertex)) {
-						continue;
-					}
+		const int tilesCount = tilesPerSide * tilesPerSide;
+		int tilesDone = 0;
+		int tilesSkipped = 0;
+		sibr::Timer totalTimer(true);
+
+		// Tiles can have very different costs, distribute them one at a time.
+		std::mutex countersMutex;
+		sibr::parallelFor(0, tilesCount, [&](int tid) {
+			const int row = tid / tilesPerSide;
+			const int col = tid % tilesPerSide;
+			const std::string tileName = "tile_" + std::to_string(row) + "_" + std::to_string(col);
+			const std::string tilePath = directory + "/" + tileName + ".png";
+			if (fileExists(tilePath)) {
+				std::lock_guard<std::mutex> lock(countersMutex);
+				++tilesSkipped;
+				return;
+			}
 
-					// Check for occlusions.
-					sibr::Vector3f occDir = (vertex - cam->position());
-					const float dist = occDir.norm();
-					if (dist > 0.0f) {
-						occDir /= dist;
-					}
-					const RayHit hitOcc = _worldRaycaster.intersect(Ray(cam->position(), occDir));
-					if (hitOcc.hitSomething() && (hitOcc.dist() + 0.0001f) < dist) {
-						continue;
+			sibr::Timer timer(true);
+			// Tiles are defined in the final image space, the vertical flip is applied texel by texel.
+			// When flood filling, texels around the tile are shaded too, so that holes on its border are filled as in the full texture.
+			const int x0 = col * tile;
+			const int y0 = row * tile;
+			const int tw = std::min(tile, size - x0);
+			const int th = std::min(tile, size - y0);
+			const int ex0 = std::max(x0 - halo, 0);
+			const int ey0 = std::max(y0 - halo, 0);
+			const int ew = std::min(x0 + tw + halo, size) - ex0;
+			const int eh = std::min(y0 + th + halo, size) - ey0;
+			sibr::ImageRGB32F accum(ew, eh, Vector3f(0.0f, 0.0f, 0.0f));
+			sibr::ImageL8 mask(ew, eh, 0);
+			for (int ty = 0; ty < eh; ++ty) {
+				const int py = flip ? (size - 1 - (ey0 + ty)) : (ey0 + ty);
+				for (int tx = 0; tx < ew; ++tx) {
+					sibr::Vector3f color;
+					if (shadeTexel(ex0 + tx, py, cameras, images, sampleRatio, color)) {
+						accum(tx, ty) = color;
+						mask(tx, ty)[0] = 255;
 					}
-
-					// Reproject, read color.
-					const sibr::Vector2f pos = cam->projectImgSpaceInvertY(vertex).xy();
-					const sibr::Vector3f col = images[cid]->bilinear(pos).cast<float>().xyz();
-					// Angle-based weight for now.
-					const float angleWeight = std::max(-occDir.dot(normal), 0.0f);
-					const float weight = angleWeight;
-					//avgColor += weight * col;
-					//totalWeight += weight;
-					samples.emplace_back();
-					samples.back().color = col;
-					samples.back().weight = weight;
-				}
-				if (samples.empty()) {
-					continue;
-				}
-				
-				std::sort(samples.begin(), samples.end(), [](const SampleInfos & a, const SampleInfos & b)
-				{
-					return a.weight > b.weight;
-				});
-
-				// Re-weight and accumulate the samples.
-				// The code is written this way to support 'best sampleRatio of all samples' approaches.
-				for(int i = 0; i < sampleRatio * samples.size(); ++i) {
-					float w = samples[i].weight;
-					w = w * w;
-					totalWeight += w;
-					avgColor += w * samples[i].color;
 				}
+			}
 
-				if (totalWeight > 0.0f) {
-					_accum(px, py) = avgColor / totalWeight;
-					_mask(px, py)[0] = 255;
-				}
+			// A tile without any covered texel has nothing to fill from, and stays black.
+			const cv::Rect crop(x0 - ex0, y0 - ey0, tw, th);
+			cv::Mat3f output;
+			if ((options & Options::FLOOD_FILL) && cv::countNonZero(mask.toOpenCV()) > 0) {
+				output = floodFill(accum, mask, false)->toOpenCV()(crop);
+			} else {
+				output = accum.toOpenCV()(crop);
 			}
-			if( (py % 1000) == 0 )
-				progress.walk(1000);
-		}
+			ImageRGB result;
+			result.fromOpenCV(cv::Mat3b(output));
+
+			// Write to a temporary file first, so that an interrupted run never leaves a truncated tile behind.
+			const std::string tempPath = directory + "/" + tileName + ".tmp.png";
+			if (!cv::imwrite(tempPath, result.toOpenCVBGR())) {
+				SIBR_WRG << "[Texturing] Unable to write tile " << tempPath << "." << std::endl;
+				return;
+			}
+			boost::system::error_code ec;
+			boost::filesystem::rename(tempPath, tilePath, ec);
+			if (ec) {
+				SIBR_WRG << "[Texturing] Unable to write tile " << tilePath << ": " << ec.message() << std::endl;
+				return;
+			}
+
+			const double seconds = timer.deltaTimeFromLastTic<Timer::micro>() * 1e-6;
+			std::lock_guard<std::mutex> lock(countersMutex);
+			++tilesDone;
+			SIBR_LOG << "[Texturing] Tile (" << row << ", " << col << ") done in " << seconds << "s ("
+				<< tilesDone + tilesSkipped << "/" << tilesCount << ")." << std::endl;
+		}, 1);
+
+		SIBR_LOG << "[Texturing] " << tilesDone << " tiles generated, " << tilesSkipped << " already available, in "
+			<< totalTimer.deltaTimeFromLastTic<Timer::micro>() * 1e-6 << "s." << std::endl;
+		return uint(tilesDone + tilesSkipped);
 	}
 
 	sibr::ImageRGB::Ptr MeshTexturing::getTexture(uint options) const {
+		if (_accum.w() != _sideSize) {
+			SIBR_WRG << "[Texturing] No reprojection done." << std::endl;
+			return ImageRGB::Ptr(new ImageRGB(_sideSize, _sideSize, Vector3ub(0, 0, 0)));
+		}
 
 		ImageRGB32F output;
 		if (options & Options::FLOOD_FILL) {
@@ -222,8 +359,8 @@ namespace sibr {
 	bool MeshTexturing::hitTest(int px, int py, RayHit & finalHit)
 	{
 		// From the UVs find the world space position.
-		const float u = (float(px) + 0.5f) / float(_accum.w());
-		const float v = (float(py) + 0.5f) / float(_accum.h());
+		const float u = (float(px) + 0.5f) / float(_sideSize);
+		const float v = (float(py) + 0.5f) / float(_sideSize);
 		// Spawn a ray from (u,v,0) in the z direction.
 		const RayHit hit = _uvsRaycaster.intersect(Ray({ u, v, 1.0f }, { 0.0f,0.0f,-1.0f }));
 		if (hit.hitSomething()) {
@@ -17,6 +17,7 @@
 #include <core/graphics/Mesh.hpp>
 #include <core/assets/InputCamera.hpp>
 #include "core/raycaster/Raycaster.hpp"
+#include "core/system/TaskScheduler.hpp"
 
 
 namespace sibr {
@@ -38,7 +39,7 @@ namespace sibr {
 			POISSON_FILL = 4 ///< Perform poisson filling (slow).
 		};
 
-		/** Constructor.
+		/** Constructor. The accumulation buffers are only allocated by reproject.
 		* \param sideSize dimension of the texture
 		*/
 		MeshTexturing(unsigned int sideSize);
@@ -56,6 +57,21 @@ namespace sibr {
 		*/
 		void reproject(const std::vector<InputCamera::Ptr> & cameras, const std::vector<sibr::ImageRGB::Ptr> & images, const float sampleRatio = 1.0);
 
+		/** Reproject a set of images tile by tile, without ever allocating the full texture map.
+		* Tiles are processed in parallel and written to disk as soon as they are done, as tile_<row>_<col>.png
+		* in the output directory, row 0 being the top of the final texture map. A tiles.txt file stores the texture and tile sizes.
+		* Existing tiles are skipped, so an interrupted run can be resumed with the same parameters.
+		* \param cameras the cameras poses
+		* \param images the images to reproject
+		* \param directory the output directory
+		* \param tileSize dimension of a tile
+		* \param options the options to apply to each tile (POISSON_FILL is not supported, FLOOD_FILL is applied per tile)
+		* \param sampleRatio ratio of the best samples to use for each texel
+		* \return the number of tiles that are available in the directory
+		*/
+		uint reprojectTiles(const std::vector<InputCamera::Ptr> & cameras, const std::vector<sibr::ImageRGB::Ptr> & images,
+			const std::string & directory, uint tileSize = 2048, uint options = NONE, const float sampleRatio = 1.0);
+
 		/** Get the final result. 
 		* \param options the options to apply to the generated texture map.
 		*/
@@ -63,15 +79,18 @@ namespace sibr {
 
 		/** Performs flood fill of an image, following a mask.
 		* \param image the image to fill
-		* \param mask mask where the zeros regions will be filled
+		* \param mask mask where the zeros regions will be filled, should contain at least one non zero pixel
+		* \param verbose log the filling
 		* \return the filled image.
 		*/
 		template<typename T_Type, unsigned int T_NumComp>
-		static typename Image< T_Type, T_NumComp>::Ptr floodFill(const Image<T_Type, T_NumComp> & image, const sibr::ImageL8 & mask) {
+		static typename Image< T_Type, T_NumComp>::Ptr floodFill(const Image<T_Type, T_NumComp> & image, const sibr::ImageL8 & mask, bool verbose = true) {
 
 			typename Image< T_Type, T_NumComp>::Ptr filled(new Image< T_Type, T_NumComp>(image.w(), image.h()));
 
-			SIBR_LOG << "[Texturing] Flood filling..." << std::endl;
+			if (verbose) {
+				SIBR_LOG << "[Texturing] Flood filling..." << std::endl;
+			}
 			// Perform filling.
 			// We need the empty pixels marked as non zeros, and the filled marked as zeros.
 			cv::Mat1b flipMask = mask.toOpenCV().clone();
@@ -85,8 +104,7 @@ namespace sibr {
 			// Build a pixel ID to source pixel table, using the pixels in the mask.
 			const sibr::Vector2i basePos(-1, -1);
 			std::vector<sibr::Vector2i> colorTable(flipMask.rows*flipMask.cols, basePos);
-#pragma omp parallel
-			for (int py = 0; py < flipMask.rows; ++py) {
+			sibr::parallelFor(0, flipMask.rows, [&](int py) {
 				for (int px = 0; px < flipMask.cols; ++px) {
 					if (flipMask(py, px) != 0) {
 						continue;
@@ -94,11 +112,10 @@ namespace sibr {
 					const int label = labels(py, px);
 					colorTable[label] = { px,py };
 				}
-			}
+			});
 
 			// Now we can turn the label image into a color image again.
-#pragma omp parallel
-			for (int py = 0; py < flipMask.rows; ++py) {
+			sibr::parallelFor(0, flipMask.rows, [&](int py) {
 				for (int px = 0; px < flipMask.cols; ++px) {
 					// Don't touch existing pixels.
 					if (flipMask(py, px) == 0) {
@@ -108,7 +125,7 @@ namespace sibr {
 					const int label = labels(py, px);
 					filled(px, py) = image(colorTable[label]);
 				}
-			}
+			});
 			return filled;
 		}
 
@@ -122,6 +139,18 @@ namespace sibr {
 
 	private:
 
+		/** Compute the color of a texel by blending the images that see the corresponding mesh point.
+		* \param px pixel x coordinate
+		* \param py pixel y coordinate
+		* \param cameras the cameras poses
+		* \param images the images to reproject
+		* \param sampleRatio ratio of the best samples to use
+		* \param color will contain the texel color
+		* \return true if the texel is covered by the mesh and seen by at least one camera.
+		*/
+		bool shadeTexel(int px, int py, const std::vector<InputCamera::Ptr> & cameras, const std::vector<sibr::ImageRGB::Ptr> & images,
+			const float sampleRatio, sibr::Vector3f & color);
+
 		/** Test if the UV-space mesh covers a pixel of the texture map.
 		* \param px pixel x coordinate
 		* \param py pixel y coordinate
@@ -145,6 +174,7 @@ namespace sibr {
 		*/
 		void interpolate(const sibr::RayHit & hit, sibr::Vector3f & vertex, sibr::Vector3f & normal) const;
 
+		unsigned int _sideSize; ///< Dimension of the texture map.
 		sibr::ImageRGB32F _accum; ///< Color accumulator.
 		sibr::ImageL8 _mask; ///< Mask indicating which regions of the texture map have been covered.
 
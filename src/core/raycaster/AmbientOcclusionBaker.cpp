@@ -0,0 +1,342 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#include "core/raycaster/AmbientOcclusionBaker.hpp"
+#include "core/system/SimpleTimer.hpp"
+#include "core/system/TaskScheduler.hpp"
+
+#include <random>
+#include <numeric>
+
+namespace sibr
+{
+	namespace {
+
+		/** Jittered stratified cosine-weighted directions around +Z, each round is a full stratification of the hemisphere. */
+		std::vector<Vector3f> stratifiedDirections(uint strata, uint rounds)
+		{
+			std::mt19937 generator(42);
+			std::uniform_real_distribution<float> jitter(0.0f, 1.0f);
+			const uint perRound = strata * strata;
+			std::vector<Vector3f> directions(size_t(perRound) * rounds);
+			for (uint r = 0; r < rounds; ++r) {
+				for (uint i = 0; i < strata; ++i) {
+					for (uint j = 0; j < strata; ++j) {
+						const float u1 = (float(i) + jitter(generator)) / float(strata);
+						const float u2 = (float(j) + jitter(generator)) / float(strata);
+						const float radius = std::sqrt(u1);
+						const float phi = float(SIBR_2PI) * u2;
+						directions[size_t(r) * perRound + i * strata + j] = Vector3f(radius * std::cos(phi), radius * std::sin(phi), std::sqrt(std::max(0.0f, 1.0f - u1)));
+					}
+				}
+			}
+			return directions;
+		}
+
+		/** Orthonormal basis around a unit normal, without singularity (Duff et al. 2017). */
+		void tangentFrame(const Vector3f & n, Vector3f & t, Vector3f & b)
+		{
+			const float sign = n[2] >= 0.0f ? 1.0f : -1.0f;
+			const float a = -1.0f / (sign + n[2]);
+			const float c = n[0] * n[1] * a;
+			t = Vector3f(1.0f + sign * n[0] * n[0] * a, sign * c, -sign * n[0]);
+			b = Vector3f(c, sign + n[1] * n[1] * a, -n[1]);
+		}
+
+		/** Per point rotation of the shared directions around the normal, from an integer hash of the point index. */
+		float rotationAngle(uint id)
+		{
+			id ^= id >> 16;
+			id *= 0x7feb352du;
+			id ^= id >> 15;
+			id *= 0x846ca68bu;
+			id ^= id >> 16;
+			return float(id) * float(SIBR_2PI / 4294967296.0);
+		}
+	}
+
+	AmbientOcclusionBaker::AmbientOcclusionBaker(const Mesh & mesh, bool doubleSided)
+	{
+		_mesh.reset(new Mesh(false));
+		_mesh->vertices(mesh.vertices());
+		_mesh->triangles(mesh.triangles());
+		if (mesh.hasTexCoords()) {
+			_mesh->texCoords(mesh.texCoords());
+		}
+		if (mesh.hasNormals()) {
+			_mesh->normals(mesh.normals());
+		}
+		else {
+			_mesh->generateNormals();
+		}
+
+		// Our version of Embree being compiled with backface culling, we have to 'duplicate and flip' the mesh.
+		if (doubleSided) {
+			Mesh doubleMesh(false);
+			doubleMesh.vertices(_mesh->vertices());
+			doubleMesh.triangles(_mesh->triangles());
+			doubleMesh.merge(_mesh->invertedFacesMesh());
+			_raycaster.addMesh(doubleMesh);
+		}
+		else {
+			_raycaster.addMesh(*_mesh);
+		}
+		_diagonal = std::max(_mesh->getBoundingBox().diagonal().norm(), 1e-6f);
+	}
+
+	std::vector<float> AmbientOcclusionBaker::bakeVertices(const Options & options, Stats * stats)
+	{
+		return bake(_mesh->vertices(), _mesh->normals(), options, stats);
+	}
+
+	std::vector<float> AmbientOcclusionBaker::bake(const std::vector<Vector3f> & positions, const std::vector<Vector3f> & normals, const Options & options, Stats * stats)
+	{
+		const size_t count = positions.size();
+		const uint strata = std::max(options.strata, 1u);
+		const uint perRound = strata * strata;
+		const uint rounds = std::max(options.maxRounds, 1u);
+		const float offset = options.bias * _diagonal;
+		const std::vector<Vector3f> directions = stratifiedDirections(strata, rounds);
+
+		// Per point frame, rotated by a random angle around the normal.
+		std::vector<Vector3f> frames(3 * count);
+		sibr::parallelFor(0, int(count), [&](int pid) {
+			const float length = normals[pid].norm();
+			const Vector3f n = length > 0.0f ? Vector3f(normals[pid] / length) : Vector3f(0.0f, 0.0f, 1.0f);
+			Vector3f t, b;
+			tangentFrame(n, t, b);
+			const float angle = rotationAngle(uint(pid));
+			const float cosA = std::cos(angle);
+			const float sinA = std::sin(angle);
+			frames[3 * pid + 0] = cosA * t + sinA * b;
+			frames[3 * pid + 1] = -sinA * t + cosA * b;
+			frames[3 * pid + 2] = n;
+		}, 256);
+
+		std::vector<uint> hits(count, 0);
+		std::vector<uint> samples(count, 0);
+		std::vector<uint> active(count);
+		std::iota(active.begin(), active.end(), 0u);
+
+		// Enough points per stream query to amortize its cost, while keeping the blocks small for load balancing.
+		const int blockSize = int(std::max(1u, 1024u / perRound));
+		Stats localStats;
+		Timer timer(true);
+		for (uint r = 0; r < rounds && !active.empty(); ++r) {
+			const Vector3f * roundDirections = &directions[size_t(r) * perRound];
+			const int blockCount = int((active.size() + blockSize - 1) / blockSize);
+
+			sibr::parallelFor(0, blockCount, [&](int bid) {
+				const size_t begin = size_t(bid) * blockSize;
+				const size_t end = std::min(begin + blockSize, active.size());
+				const size_t rayCount = (end - begin) * perRound;
+				std::vector<Vector3f> origins(rayCount);
+				std::vector<Vector3f> rayDirections(rayCount);
+				std::vector<uint8_t> occluded(rayCount);
+				for (size_t k = begin; k < end; ++k) {
+					const uint pid = active[k];
+					const Vector3f & t = frames[3 * pid + 0];
+					const Vector3f & b = frames[3 * pid + 1];
+					const Vector3f & n = frames[3 * pid + 2];
+					const Vector3f origin = positions[pid] + offset * n;
+					for (uint s = 0; s < perRound; ++s) {
+						const Vector3f & d = roundDirections[s];
+						const size_t rid = (k - begin) * perRound + s;
+						origins[rid] = origin;
+						rayDirections[rid] = d[0] * t + d[1] * b + d[2] * n;
+					}
+				}
+				_raycaster.hitSomethingStream(origins.data(), rayDirections.data(), rayCount, occluded.data(), 0.0f, options.maxDistance);
+				for (size_t k = begin; k < end; ++k) {
+					const uint pid = active[k];
+					for (uint s = 0; s < perRound; ++s) {
+						hits[pid] += occluded[(k - begin) * perRound + s];
+					}
+					samples[pid] += perRound;
+				}
+			}, 1);
+			localStats.rays += active.size() * perRound;
+
+			// Keep the points whose estimate is not precise enough yet.
+			if (options.tolerance > 0.0f && r + 1 >= options.minRounds && r + 1 < rounds) {
+				size_t kept = 0;
+				for (const uint pid : active) {
+					const double p = double(hits[pid] + 1) / double(samples[pid] + 2);
+					if (std::sqrt(p * (1.0 - p) / double(samples[pid])) >= options.tolerance) {
+						active[kept++] = pid;
+					}
+				}
+				localStats.converged += active.size() - kept;
+				active.resize(kept);
+			}
+		}
+		localStats.seconds = timer.deltaTimeFromLastTic<Timer::micro>() * 1e-6;
+
+		std::vector<float> ao(count, 1.0f);
+		double totalSamples = 0.0;
+		double totalVariance = 0.0;
+		for (size_t pid = 0; pid < count; ++pid) {
+			if (samples[pid] == 0) {
+				continue;
+			}
+			const double p = double(hits[pid]) / double(samples[pid]);
+			ao[pid] = float(1.0 - p);
+			totalSamples += samples[pid];
+			totalVariance += p * (1.0 - p) / double(samples[pid]);
+		}
+		localStats.averageSamples = count > 0 ? totalSamples / double(count) : 0.0;
+		localStats.averageVariance = count > 0 ? totalVariance / double(count) : 0.0;
+		if (stats) {
+			*stats = localStats;
+		}
+		return ao;
+	}
+
+	ImageL32F::Ptr AmbientOcclusionBaker::bakeTexture(uint resolution, const Options & options, bool flipVertical, Stats * stats)
+	{
+		if (!_mesh->hasTexCoords()) {
+			SIBR_WRG << "[AmbientOcclusionBaker] The mesh has no UVs, cannot bake a texture." << std::endl;
+			return nullptr;
+		}
+		const int size = int(resolution);
+		const Mesh::Vertices & vertices = _mesh->vertices();
+		const Mesh::Normals & normals = _mesh->normals();
+		const Mesh::UVs & uvs = _mesh->texCoords();
+
+		// Rasterize the triangles in UV space, at texel centers.
+		std::vector<int> texelToSample(size_t(size) * size, -1);
+		std::vector<Vector3f> positions;
+		std::vector<Vector3f> texelNormals;
+		for (const Vector3u & tri : _mesh->triangles()) {
+			const Vector2f a = uvs[tri[0]] * float(size);
+			const Vector2f b = uvs[tri[1]] * float(size);
+			const Vector2f c = uvs[tri[2]] * float(size);
+			const float area = (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]);
+			if (std::abs(area) < 1e-12f) {
+				continue;
+			}
+			const int minX = std::max(0, int(std::floor(std::min({ a[0], b[0], c[0] }))));
+			const int maxX = std::min(size - 1, int(std::ceil(std::max({ a[0], b[0], c[0] }))));
+			const int minY = std::max(0, int(std::floor(std::min({ a[1], b[1], c[1] }))));
+			const int maxY = std::min(size - 1, int(std::ceil(std::max({ a[1], b[1], c[1] }))));
+			for (int y = minY; y <= maxY; ++y) {
+				for (int x = minX; x <= maxX; ++x) {
+					const Vector2f p(float(x) + 0.5f, float(y) + 0.5f);
+					const float wa = ((b[0] - p[0]) * (c[1] - p[1]) - (b[1] - p[1]) * (c[0] - p[0])) / area;
+					const float wb = ((c[0] - p[0]) * (a[1] - p[1]) - (c[1] - p[1]) * (a[0] - p[0])) / area;
+					const float wc = 1.0f - wa - wb;
+					if (wa < -1e-5f || wb < -1e-5f || wc < -1e-5f) {
+						continue;
+					}
+					int & sid = texelToSample[size_t(y) * size + x];
+					if (sid < 0) {
+						sid = int(positions.size());
+						positions.emplace_back();
+						texelNormals.emplace_back();
+					}
+					positions[sid] = wa * vertices[tri[0]] + wb * vertices[tri[1]] + wc * vertices[tri[2]];
+					texelNormals[sid] = wa * normals[tri[0]] + wb * normals[tri[1]] + wc * normals[tri[2]];
+				}
+			}
+		}
+
+		const std::vector<float> values = bake(positions, texelNormals, options, stats);
+
+		ImageL32F::Ptr texture(new ImageL32F(resolution, resolution, 0.0f));
+		std::vector<uint8_t> filled(texelToSample.size(), 0);
+		for (int y = 0; y < size; ++y) {
+			for (int x = 0; x < size; ++x) {
+				const int sid = texelToSample[size_t(y) * size + x];
+				if (sid >= 0) {
+					(*texture)(x, y)[0] = values[sid];
+					filled[size_t(y) * size + x] = 1;
+				}
+			}
+		}
+
+		// Extend the charts by a few texels, so that bilinear filtering does not fetch empty texels at seams.
+		const int gutter = 4;
+		for (int pass = 0; pass < gutter; ++pass) {
+			std::vector<uint8_t> previous = filled;
+			sibr::parallelFor(0, size, [&](int y) {
+				for (int x = 0; x < size; ++x) {
+					if (previous[size_t(y) * size + x]) {
+						continue;
+					}
+					float sum = 0.0f;
+					int weight = 0;
+					for (int dy = -1; dy <= 1; ++dy) {
+						for (int dx = -1; dx <= 1; ++dx) {
+							const int nx = x + dx;
+							const int ny = y + dy;
+							if (nx >= 0 && ny >= 0 && nx < size && ny < size && previous[size_t(ny) * size + nx]) {
+								sum += (*texture)(nx, ny)[0];
+								++weight;
+							}
+						}
+					}
+					if (weight > 0) {
+						(*texture)(x, y)[0] = sum / float(weight);
+						filled[size_t(y) * size + x] = 1;
+					}
+				}
+			});
+		}
+
+		if (flipVertical) {
+			texture->flipH();
+		}
+		return texture;
+	}
+
+	std::function<Mesh::Colors(MaterialMesh &, const int)> AmbientOcclusionBaker::aoFunction(const Options & options)
+	{
+		return [options](MaterialMesh & mesh, const int samples) {
+			Options meshOptions = options;
+			meshOptions.maxDistance = mesh.ambientOcclusion().AttenuationDistance;
+			const uint perRound = std::max(options.strata, 1u) * std::max(options.strata, 1u);
+			meshOptions.maxRounds = std::max(1u, (uint(std::max(samples, 1)) + perRound - 1) / perRound);
+
+			AmbientOcclusionBaker baker(mesh);
+			const std::vector<float> ao = baker.bakeVertices(meshOptions);
+			Mesh::Colors colors(ao.size());
+			for (size_t vid = 0; vid < ao.size(); ++vid) {
+				colors[vid] = Vector3f(ao[vid], ao[vid], ao[vid]);
+			}
+			return colors;
+		};
+	}
+
+	void AmbientOcclusionBaker::benchmark(const Mesh & mesh, uint maxRounds)
+	{
+		AmbientOcclusionBaker baker(mesh);
+		Options options;
+		options.maxDistance = 0.1f * baker._diagonal;
+		options.tolerance = 0.0f;
+		for (uint rounds = 1; rounds <= maxRounds; rounds *= 2) {
+			options.maxRounds = rounds;
+			Stats stats;
+			baker.bakeVertices(options, &stats);
+			SIBR_LOG << "[AmbientOcclusionBaker] " << rounds * options.strata * options.strata << " samples: "
+				<< double(stats.rays) / std::max(stats.seconds, 1e-9) << " rays/s, variance " << stats.averageVariance << "." << std::endl;
+		}
+
+		options.maxRounds = maxRounds;
+		options.tolerance = Options().tolerance;
+		Stats stats;
+		baker.bakeVertices(options, &stats);
+		SIBR_LOG << "[AmbientOcclusionBaker] Early stop at " << options.tolerance << ": " << stats.averageSamples << " samples on average, "
+			<< stats.converged << "/" << mesh.vertices().size() << " converged, " << double(stats.rays) / std::max(stats.seconds, 1e-9)
+			<< " rays/s, variance " << stats.averageVariance << ", " << stats.seconds << "s." << std::endl;
+	}
+
+} // namespace sibr
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+# include <functional>
+# include "core/raycaster/Config.hpp"
+# include "core/raycaster/Raycaster.hpp"
+# include "core/graphics/MaterialMesh.hpp"
+# include "core/graphics/Image.hpp"
+
+namespace sibr
+{
+	/** \brief Bake ambient occlusion on the vertices or in a texture atlas of a mesh.
+	* Cosine-weighted hemisphere directions are stratified once for all points, and rotated around the normal at each point
+	* to avoid banding. Rays are traced by rounds, with one Embree stream query per block of points on all cores, and a point
+	* stops receiving samples once the standard error of its estimate is below a tolerance.
+	* An AO value is the fraction of unoccluded rays within a maximum distance (1 when fully visible).
+	* \ingroup sibr_raycaster
+	*/
+	class SIBR_RAYCASTER_EXPORT AmbientOcclusionBaker
+	{
+		SIBR_CLASS_PTR(AmbientOcclusionBaker);
+
+	public:
+
+		/** Baking options. */
+		struct Options {
+			uint strata = 4; ///< Number of strata along each dimension of the hemisphere, a round traces strata*strata rays per point.
+			uint maxRounds = 16; ///< Maximum number of rounds.
+			uint minRounds = 2; ///< Minimum number of rounds before testing convergence.
+			float maxDistance = 1.0f; ///< Occluders farther than this distance are ignored.
+			float tolerance = 0.01f; ///< Standard error of the AO estimate below which a point is converged, 0 to disable the early stop.
+			float bias = 1e-4f; ///< Ray origin offset along the normal, relative to the bounding box diagonal.
+		};
+
+		/** Baking statistics. */
+		struct Stats {
+			size_t rays = 0; ///< Number of rays traced.
+			double seconds = 0.0; ///< Tracing time.
+			double averageSamples = 0.0; ///< Average number of samples per point.
+			double averageVariance = 0.0; ///< Average variance of the AO estimates.
+			size_t converged = 0; ///< Number of points that stopped before the maximum number of rounds.
+		};
+
+		/** Constructor, builds the Embree scene.
+		\param mesh the occluding geometry, also the mesh to bake
+		\param doubleSided should back faces occlude too (our Embree build culls back faces)
+		*/
+		AmbientOcclusionBaker(const Mesh & mesh, bool doubleSided = true);
+
+		/** Bake per vertex ambient occlusion.
+		\param options the baking options
+		\param stats optional baking statistics
+		\return the AO value of each vertex
+		*/
+		std::vector<float> bakeVertices(const Options & options = Options(), Stats * stats = nullptr);
+
+		/** Bake ambient occlusion in the UV atlas of the mesh. Texels outside of the atlas are filled from their neighbours, to avoid seams.
+		\param resolution the texture side size
+		\param options the baking options
+		\param flipVertical should the first row be at v=1, as expected for images saved on disk
+		\param stats optional baking statistics
+		\return the AO texture, or nullptr if the mesh has no UVs
+		*/
+		ImageL32F::Ptr bakeTexture(uint resolution, const Options & options = Options(), bool flipVertical = true, Stats * stats = nullptr);
+
+		/** Bake ambient occlusion at arbitrary surface points.
+		\param positions the points
+		\param normals the unit normals at the points
+		\param options the baking options
+		\param stats optional baking statistics
+		\return the AO value of each point
+		*/
+		std::vector<float> bake(const std::vector<Vector3f> & positions, const std::vector<Vector3f> & normals, const Options & options = Options(), Stats * stats = nullptr);
+
+		/** Generate a function that can be passed to MaterialMesh::aoFunction. The attenuation distance of the mesh
+		AO options is used as the maximum distance, and the requested number of samples as the maximum sample count.
+		\param options the baking options
+		\return the AO function, storing the result in all color channels
+		*/
+		static std::function<Mesh::Colors(MaterialMesh &, const int)> aoFunction(const Options & options = Options());
+
+		/** Log the ray throughput and the AO variance against the sample count, with and without early stop.
+		\param mesh the mesh to bake
+		\param maxRounds the maximum number of rounds tested
+		*/
+		static void benchmark(const Mesh & mesh, uint maxRounds = 32);
+
+	private:
+
+		Mesh::Ptr _mesh; ///< The baked mesh, with normals.
+		Raycaster _raycaster; ///< The occluding geometry.
+		float _diagonal = 1.0f; ///< Bounding box diagonal of the mesh.
+	};
+
+} // namespace sibr
@@ -13,6 +13,7 @@
 #include <boost/filesystem/path.hpp>
 #include <core/system/Vector.hpp>
 #include "core/raycaster/CameraRaycaster.hpp"
+#include "core/system/TaskScheduler.hpp"
 
 
 namespace sibr
@@ -59,8 +60,7 @@ namespace sibr
 
 		nearsFars.resize(cams.size());
 
-		#pragma omp parallel for
-		for (int cam_id = 0; cam_id < (int)cams.size(); ++cam_id) {
+		sibr::parallelFor(0, (int)cams.size(), [&](int cam_id) {
 			sibr::InputCamera & cam = *cams[cam_id];
 
 			sibr::Vector3f dx, dy, upLeftOffset;
@@ -101,7 +101,7 @@ namespace sibr
 			nearsFars[cam_id] = sibr::Vector2f(znear, zfar);
 
 			std::cout << cam_id << " " << std::flush;
-		}
+		}, 1);
 		std::cout << " done." << std::endl;
 
 		
@@ -112,7 +112,115 @@ namespace sibr {
 		return false;
 	}
 
-	std::vector<std::vector<bool>> Intersector2D::frustrumQuadsIntersect(std::vector<quad> & quads, const std::vector<InputCamera::Ptr> & cams)
+	namespace {
+
+		/** Frustum planes outcode of a clip space position, one bit per plane the position is outside of. */
+		int frustumOutcode(const Eigen::Vector4f & p)
+		{
+			int code = 0;
+			for (int axis = 0; axis < 3; ++axis) {
+				code |= (p[axis] < -p[3] ? 1 : 0) << (2 * axis);
+				code |= (p[axis] > p[3] ? 1 : 0) << (2 * axis + 1);
+			}
+			return code;
+		}
+
+		/** Test if a clip space triangle covers part of the frustum, clipping it against all planes (Sutherland-Hodgman). */
+		bool clippedTriangleIsVisible(const Eigen::Vector4f & a, const Eigen::Vector4f & b, const Eigen::Vector4f & c)
+		{
+			std::vector<Eigen::Vector4f> polygon = { a, b, c };
+			std::vector<Eigen::Vector4f> clipped;
+			for (int plane = 0; plane < 6 && polygon.size() >= 3; ++plane) {
+				const int axis = plane / 2;
+				const float side = (plane % 2 == 0) ? 1.0f : -1.0f;
+				clipped.clear();
+				for (size_t i = 0; i < polygon.size(); ++i) {
+					const Eigen::Vector4f & p0 = polygon[i];
+					const Eigen::Vector4f & p1 = polygon[(i + 1) % polygon.size()];
+					const float d0 = p0[3] + side * p0[axis];
+					const float d1 = p1[3] + side * p1[axis];
+					if (d0 >= 0.0f) {
+						clipped.push_back(p0);
+					}
+					if ((d0 >= 0.0f) != (d1 >= 0.0f)) {
+						clipped.push_back(p0 + (d0 / (d0 - d1)) * (p1 - p0));
+					}
+				}
+				polygon.swap(clipped);
+			}
+			if (polygon.size() < 3) {
+				return false;
+			}
+			// Reject polygons degenerated to a segment or a point on screen, they are not rasterized.
+			float area = 0.0f;
+			for (size_t i = 0; i < polygon.size(); ++i) {
+				const Eigen::Vector4f & p0 = polygon[i];
+				const Eigen::Vector4f & p1 = polygon[(i + 1) % polygon.size()];
+				if (p0[3] <= 0.0f || p1[3] <= 0.0f) {
+					continue;
+				}
+				area += (p0[0] / p0[3]) * (p1[1] / p1[3]) - (p1[0] / p1[3]) * (p0[1] / p0[3]);
+			}
+			return std::abs(area) > 1e-12f;
+		}
+	}
+
+	std::vector<std::vector<bool>> Intersector2D::frustrumQuadsIntersect(const std::vector<quad> & quads, const std::vector<InputCamera::Ptr> & cams)
+	{
+		std::vector<std::vector<bool>> result(cams.size(), std::vector<bool>(quads.size(), false));
+		const int quadsCount = int(quads.size());
+
+		// Homogeneous positions of all quads vertices, transformed at once for each camera.
+		Eigen::Matrix<float, 4, Eigen::Dynamic> points(4, 4 * quadsCount);
+		for (int q = 0; q < quadsCount; ++q) {
+			points.col(4 * q + 0) << quads[q].q1, 1.0f;
+			points.col(4 * q + 1) << quads[q].q2, 1.0f;
+			points.col(4 * q + 2) << quads[q].q3, 1.0f;
+			points.col(4 * q + 3) << quads[q].q4, 1.0f;
+		}
+
+		// Same triangles as the ones rasterized by frustrumQuadsIntersectGL.
+		const int triangles[4][3] = { { 0, 1, 2 }, { 0, 2, 3 }, { 1, 2, 3 }, { 0, 1, 3 } };
+
+#pragma omp parallel for schedule(dynamic)
+		for (int c = 0; c < int(cams.size()); ++c) {
+			const Eigen::Matrix4f viewproj = cams[c]->viewproj();
+			const Eigen::Matrix<float, 4, Eigen::Dynamic> clip = viewproj * points;
+			std::vector<bool> & visible = result[c];
+
+			for (int q = 0; q < quadsCount; ++q) {
+				int codes[4];
+				int allOutside = ~0;
+				bool oneInside = false;
+				for (int k = 0; k < 4; ++k) {
+					codes[k] = frustumOutcode(clip.col(4 * q + k));
+					allOutside &= codes[k];
+					oneInside = oneInside || codes[k] == 0;
+				}
+				// All vertices outside of the same plane.
+				if (allOutside != 0) {
+					continue;
+				}
+				// A vertex inside the frustum is covered by one of the triangles.
+				if (oneInside) {
+					visible[q] = true;
+					continue;
+				}
+				for (int t = 0; t < 4 && !visible[q]; ++t) {
+					const int i0 = 4 * q + triangles[t][0];
+					const int i1 = 4 * q + triangles[t][1];
+					const int i2 = 4 * q + triangles[t][2];
+					if ((codes[triangles[t][0]] & codes[triangles[t][1]] & codes[triangles[t][2]]) != 0) {
+						continue;
+					}
+					visible[q] = clippedTriangleIsVisible(clip.col(i0), clip.col(i1), clip.col(i2));
+				}
+			}
+		}
+		return result;
+	}
+
+	std::vector<std::vector<bool>> Intersector2D::frustrumQuadsIntersectGL(std::vector<quad> & quads, const std::vector<InputCamera::Ptr> & cams)
 	{
 		std::clock_t previous;
 		double duration;
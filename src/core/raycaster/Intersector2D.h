@@ -130,13 +130,25 @@ namespace sibr {
 			sibr::Vector2f q1_0, sibr::Vector2f q1_1, sibr::Vector2f q1_2, sibr::Vector2f q1_3);
 
 		/**
-		Perform multiple quads/camera frusta intersections at once.
+		Perform multiple quads/camera frusta intersections at once, analytically on the CPU.
+		Each quad is tested as the four triangles of its vertices (as rendered by frustrumQuadsIntersectGL): vertices are
+		transformed to clip space for all quads at once, trivially accepted or rejected with their frustum outcodes, and the remaining
+		triangles are clipped against the frustum planes. Cameras are processed in parallel, no OpenGL context is needed.
+		\param quads an array of quads to test against each camera frustum.
+		\param cams an array of cameras against which frusta the intersections tests should be performed.
+		\return a double-array of booleans denoting, for each camera, for each quad, if the quad intersects the frustum volume.
+		*/
+		static std::vector<std::vector<bool>> frustrumQuadsIntersect(const std::vector<quad> & quads, const std::vector<InputCamera::Ptr> & cams);
+
+		/**
+		Perform multiple quads/camera frusta intersections at once, by rasterizing each quad in a low resolution render target.
 		\warning Requires an existing and current OpenGL context.
 		\param quads an array of quads to test against each camera frustum.
 		\param cams an array of cameras against which frusta the intersections tests should be performed.
 		\return a double-array of booleans denoting, for each camera, for each quad, if the quad intersects the frustum volume.
+		\note The results can differ from frustrumQuadsIntersect for quads covering no pixel center of the render target.
 		*/
-		static std::vector<std::vector<bool>> frustrumQuadsIntersect(std::vector<quad> & quads, const std::vector<InputCamera::Ptr> & cams);
+		static std::vector<std::vector<bool>> frustrumQuadsIntersectGL(std::vector<quad> & quads, const std::vector<InputCamera::Ptr> & cams);
 
 	};
 
@@ -15,8 +15,12 @@
 #include "Config.hpp"
 
 #include "core/system/Vector.hpp"
+#include "core/system/SimpleTimer.hpp"
+#include "core/system/TaskScheduler.hpp"
 #include "nanoflann/nanoflann.hpp"
 
+#include <random>
+
 namespace sibr { 
 
 	/**
@@ -24,6 +28,9 @@ namespace sibr {
 	 * \brief Represent a 3D hierachical query structure baked by a nanoflann KdTree.
 	 * \note With the default L2 distance, all distances and radii are expected to be 
 	 * the squared values (this is a nanoflann constraint). For other metrics, use the distance directly.
+	 * The tree can either own a copy of the points, or reference points owned by the caller (no copy, see the pointer constructor).
+	 * For per-point work on large point sets, prefer the batched knnBatch and radiusBatch queries, that run in parallel and write
+	 * in flat preallocated outputs without any allocation.
 	 * \ingroup sibr_raycaster
 	 */
 	template <typename num_t = double, class Distance = nanoflann::metric_L2>
@@ -47,9 +54,24 @@ namespace sibr {
 		 */
 		KdTree(const std::vector<Vector3X> & positions, size_t leafMaxSize = 10);
 
+		/**
+		 * Constructor.
+		 * The KdTree only references the positions, that must stay alive and unchanged while the tree is used.
+		 * \param positions pointer to the 3D points
+		 * \param count the number of points
+		 * \param leafMaxSize maximum number of points per leaf
+		 */
+		KdTree(const Vector3X * positions, size_t count, size_t leafMaxSize = 10);
+
 		/** Destructor. */
 		~KdTree();
 
+		/** Copy is forbidden, the index references the points. */
+		KdTree(const KdTree &) = delete;
+
+		/** Copy is forbidden, the index references the points. */
+		KdTree & operator=(const KdTree &) = delete;
+
 		/** Get the closest point stored in the KdTree for the specified distance
 		* \param pos the reference point
 		* \param distanceSq will contain the squared distance from pos to the closest point in the tree.
@@ -72,6 +94,38 @@ namespace sibr {
 		 */
 		void getNeighbors(const Vector3X & pos, double maxDistanceSq, bool sorted, Results & idDistSqs) const;
 
+		/** Get the k closest points of many reference points, in parallel.
+		 * Outputs are flat arrays with k slots per query, sorted by ascending distance. If fewer than k points are found, the remaining
+		 * slots are left untouched.
+		 * \param queries the reference points
+		 * \param queryCount the number of reference points
+		 * \param k the number of neighbours to query
+		 * \param outIds will contain the indices of the neighbours, must hold queryCount*k values
+		 * \param outDistSqs will contain the squared distances of the neighbours, must hold queryCount*k values
+		 * \param outCounts optional, will contain the number of neighbours found for each query, must hold queryCount values
+		 * \param eps approximation factor, neighbours are at most (1+eps) farther than the true ones (0 for exact queries)
+		 */
+		void knnBatch(const Vector3X * queries, size_t queryCount, size_t k, size_t * outIds, num_t * outDistSqs, size_t * outCounts = nullptr, float eps = 0.0f) const;
+
+		/** Get the points in a sphere around many reference points, in parallel.
+		 * At most maxNeighbors points are returned for each query, the closest ones, sorted by ascending distance.
+		 * \param queries the reference points
+		 * \param queryCount the number of reference points
+		 * \param maxDistanceSq the squared sphere radius
+		 * \param maxNeighbors the maximum number of points per query
+		 * \param outIds will contain the indices of the neighbours, must hold queryCount*maxNeighbors values
+		 * \param outDistSqs will contain the squared distances of the neighbours, must hold queryCount*maxNeighbors values
+		 * \param outCounts will contain the number of neighbours found for each query, must hold queryCount values
+		 * \param eps approximation factor (0 for exact queries)
+		 */
+		void radiusBatch(const Vector3X * queries, size_t queryCount, num_t maxDistanceSq, size_t maxNeighbors, size_t * outIds, num_t * outDistSqs, size_t * outCounts, float eps = 0.0f) const;
+
+		/** Log the throughput of single and batched queries, exact and approximate, on random points.
+		 * \param pointCount the number of points
+		 * \param k the number of neighbours to query
+		 */
+		static void benchmark(size_t pointCount = 1000000, size_t k = 16);
+
 		/// Interface expected by nanoflann for an adapter.
 		const self_t & derived() const {
 			return *this;
@@ -84,7 +138,7 @@ namespace sibr {
 
 		/// Interface: Must return the number of data points
 		inline size_t kdtree_get_point_count() const {
-			return _points.size();
+			return _count;
 		}
 
 		/// Interface: Returns the dim'th component of the idx'th point in the class:
@@ -100,13 +154,68 @@ namespace sibr {
 
 	private:
 
-		const std::vector<Vector3X> _points;
+		/** Bounded sorted result set, writing directly in the caller output (nanoflann result set interface). */
+		class BoundedResultSet
+		{
+		public:
+			BoundedResultSet(size_t * ids, num_t * distSqs, size_t capacity, num_t maxDistanceSq)
+				: _ids(ids), _distSqs(distSqs), _capacity(capacity), _maxDistanceSq(maxDistanceSq) {}
+
+			size_t size() const { return _size; }
+
+			bool full() const { return _size == _capacity; }
+
+			bool addPoint(num_t distSq, size_t id) {
+				size_t i = _size;
+				for (; i > 0 && _distSqs[i - 1] > distSq; --i) {
+					if (i < _capacity) {
+						_distSqs[i] = _distSqs[i - 1];
+						_ids[i] = _ids[i - 1];
+					}
+				}
+				if (i < _capacity) {
+					_distSqs[i] = distSq;
+					_ids[i] = id;
+				}
+				if (_size < _capacity) {
+					++_size;
+				}
+				return true;
+			}
+
+			num_t worstDist() const { return _capacity > 0 && full() ? _distSqs[_capacity - 1] : _maxDistanceSq; }
+
+		private:
+			size_t * _ids;
+			num_t * _distSqs;
+			size_t _capacity;
+			num_t _maxDistanceSq;
+			size_t _size = 0;
+		};
+
+		void buildIndex(size_t leafMaxSize);
+
+		std::vector<Vector3X> _ownedPoints; ///< Copy of the points, if owned by the tree.
+		const Vector3X * _points; ///< The points.
+		size_t _count; ///< Number of points.
 		index_t * _index;
 	};
 
 	template <typename num_t, class Distance>
-	KdTree<num_t, Distance>::KdTree(const std::vector<Vector3X>& positions, size_t leafMaxSize) : _points(positions) {
-		if(positions.empty()) {
+	KdTree<num_t, Distance>::KdTree(const std::vector<Vector3X>& positions, size_t leafMaxSize) : _ownedPoints(positions) {
+		_points = _ownedPoints.data();
+		_count = _ownedPoints.size();
+		buildIndex(leafMaxSize);
+	}
+
+	template <typename num_t, class Distance>
+	KdTree<num_t, Distance>::KdTree(const Vector3X * positions, size_t count, size_t leafMaxSize) : _points(positions), _count(count) {
+		buildIndex(leafMaxSize);
+	}
+
+	template <typename num_t, class Distance>
+	void KdTree<num_t, Distance>::buildIndex(size_t leafMaxSize) {
+		if(_count == 0) {
 			SIBR_ERR << "[KdTree] Trying to build a Kd-Tree from an empty list of points." << std::endl;
 		}
 		_index = new index_t(3, *this, nanoflann::KDTreeSingleIndexAdaptorParams(leafMaxSize));
@@ -142,6 +251,80 @@ namespace sibr {
 		_index->radiusSearch(&pos[0], float(maxDistanceSq), idDistSqs, nanoflann::SearchParams(32, 0.0f, sorted));
 	}
 
+	template <typename num_t, class Distance>
+	void KdTree<num_t, Distance>::knnBatch(const Vector3X * queries, size_t queryCount, size_t k, size_t * outIds, num_t * outDistSqs, size_t * outCounts, float eps) const {
+		if(k == 0) {
+			if(outCounts) {
+				std::fill(outCounts, outCounts + queryCount, size_t(0));
+			}
+			return;
+		}
+		const nanoflann::SearchParams params(32, eps);
+		sibr::parallelFor(0, int(queryCount), [&](int q) {
+			BoundedResultSet resultSet(outIds + size_t(q) * k, outDistSqs + size_t(q) * k, k, std::numeric_limits<num_t>::max());
+			_index->findNeighbors(resultSet, &queries[q][0], params);
+			if(outCounts) {
+				outCounts[q] = resultSet.size();
+			}
+		}, 256);
+	}
+
+	template <typename num_t, class Distance>
+	void KdTree<num_t, Distance>::radiusBatch(const Vector3X * queries, size_t queryCount, num_t maxDistanceSq, size_t maxNeighbors, size_t * outIds, num_t * outDistSqs, size_t * outCounts, float eps) const {
+		if(maxNeighbors == 0) {
+			std::fill(outCounts, outCounts + queryCount, size_t(0));
+			return;
+		}
+		const nanoflann::SearchParams params(32, eps);
+		sibr::parallelFor(0, int(queryCount), [&](int q) {
+			BoundedResultSet resultSet(outIds + size_t(q) * maxNeighbors, outDistSqs + size_t(q) * maxNeighbors, maxNeighbors, maxDistanceSq);
+			_index->findNeighbors(resultSet, &queries[q][0], params);
+			outCounts[q] = resultSet.size();
+		}, 256);
+	}
+
+	template <typename num_t, class Distance>
+	void KdTree<num_t, Distance>::benchmark(size_t pointCount, size_t k) {
+		std::mt19937 generator(42);
+		std::uniform_real_distribution<num_t> uniform(num_t(0), num_t(1));
+		std::vector<Vector3X> points(pointCount);
+		for(Vector3X & point : points) {
+			point = Vector3X(uniform(generator), uniform(generator), uniform(generator));
+		}
+
+		Timer timer(true);
+		const self_t tree(points.data(), points.size());
+		const double buildTime = timer.deltaTimeFromLastTic<Timer::micro>() * 1e-6;
 
-} /*namespace sibr*/ 
+		// Per-point queries, as done by the callers before batching.
+		timer.tic();
+		Results results;
+		for(const Vector3X & point : points) {
+			tree.getClosest(point, k, results);
+		}
+		const double singleTime = timer.deltaTimeFromLastTic<Timer::micro>() * 1e-6;
+
+		std::vector<size_t> ids(pointCount * k);
+		std::vector<num_t> distSqs(pointCount * k);
+		std::vector<size_t> counts(pointCount);
+		timer.tic();
+		tree.knnBatch(points.data(), pointCount, k, ids.data(), distSqs.data(), counts.data());
+		const double batchTime = timer.deltaTimeFromLastTic<Timer::micro>() * 1e-6;
+
+		timer.tic();
+		tree.knnBatch(points.data(), pointCount, k, ids.data(), distSqs.data(), counts.data(), 0.5f);
+		const double approximateTime = timer.deltaTimeFromLastTic<Timer::micro>() * 1e-6;
+
+		// Radius of a sphere containing k points on average.
+		const num_t radius = std::cbrt(num_t(3 * k) / (num_t(4 * SIBR_PI) * num_t(pointCount)));
+		timer.tic();
+		tree.radiusBatch(points.data(), pointCount, radius * radius, 2 * k, ids.data(), distSqs.data(), counts.data());
+		const double radiusTime = timer.deltaTimeFromLastTic<Timer::micro>() * 1e-6;
+
+		const auto rate = [pointCount](double seconds) { return double(pointCount) / std::max(seconds, 1e-9); };
+		SIBR_LOG << "[KdTree] " << pointCount << " points, built in " << buildTime << "s, " << k << "-NN queries/s: single "
+			<< rate(singleTime) << ", batched " << rate(batchTime) << ", approximate " << rate(approximateTime)
+			<< ", radius " << rate(radiusTime) << "." << std::endl;
+	}
 
+} /*namespace sibr*/
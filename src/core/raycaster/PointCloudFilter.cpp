@@ -0,0 +1,197 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#include "core/raycaster/PointCloudFilter.hpp"
+#include "core/raycaster/KdTree.hpp"
+
+namespace sibr
+{
+	bool PointCloudFilter::Options::enabled() const
+	{
+		return statisticalNeighbors > 0 || densityRadius > 0.0f || minOpacity > 0.0f || maxScale > 0.0f;
+	}
+
+	std::vector<uint8_t> PointCloudFilter::statisticalOutliers(const std::vector<Vector3f> & points, uint k, float stdRatio, size_t chunkSize)
+	{
+		std::vector<uint8_t> keep(points.size(), 1);
+		if (points.size() < 2 || k == 0) {
+			return keep;
+		}
+		const KdTree<float> tree(points.data(), points.size());
+		// The closest point is the query itself.
+		const size_t neighbors = std::min(size_t(k) + 1, points.size());
+		chunkSize = std::max(chunkSize, size_t(1));
+
+		std::vector<float> meanDistances(points.size(), 0.0f);
+		std::vector<size_t> ids(std::min(chunkSize, points.size()) * neighbors);
+		std::vector<float> distSqs(ids.size());
+		std::vector<size_t> counts(std::min(chunkSize, points.size()));
+		for (size_t begin = 0; begin < points.size(); begin += chunkSize) {
+			const size_t count = std::min(chunkSize, points.size() - begin);
+			tree.knnBatch(points.data() + begin, count, neighbors, ids.data(), distSqs.data(), counts.data());
+#pragma omp parallel for
+			for (int q = 0; q < int(count); ++q) {
+				float sum = 0.0f;
+				for (size_t n = 1; n < counts[q]; ++n) {
+					sum += std::sqrt(distSqs[size_t(q) * neighbors + n]);
+				}
+				meanDistances[begin + q] = counts[q] > 1 ? sum / float(counts[q] - 1) : 0.0f;
+			}
+		}
+
+		double sum = 0.0;
+		double sumSq = 0.0;
+		const int pointCount = int(points.size());
+#pragma omp parallel for reduction(+:sum,sumSq)
+		for (int pid = 0; pid < pointCount; ++pid) {
+			sum += meanDistances[pid];
+			sumSq += double(meanDistances[pid]) * meanDistances[pid];
+		}
+		const double mean = sum / double(pointCount);
+		const double deviation = std::sqrt(std::max(0.0, sumSq / double(pointCount) - mean * mean));
+		const float threshold = float(mean + double(stdRatio) * deviation);
+
+#pragma omp parallel for
+		for (int pid = 0; pid < pointCount; ++pid) {
+			keep[pid] = meanDistances[pid] <= threshold ? 1 : 0;
+		}
+		return keep;
+	}
+
+	std::vector<uint8_t> PointCloudFilter::densityFilter(const std::vector<Vector3f> & points, float radius, uint minNeighbors, size_t chunkSize)
+	{
+		std::vector<uint8_t> keep(points.size(), 1);
+		if (points.empty() || radius <= 0.0f) {
+			return keep;
+		}
+		const KdTree<float> tree(points.data(), points.size());
+		// The query itself is in its neighbourhood, and we can stop as soon as enough neighbours are found.
+		const size_t neighbors = size_t(minNeighbors) + 1;
+		chunkSize = std::max(chunkSize, size_t(1));
+
+		std::vector<size_t> ids(std::min(chunkSize, points.size()) * neighbors);
+		std::vector<float> distSqs(ids.size());
+		std::vector<size_t> counts(std::min(chunkSize, points.size()));
+		for (size_t begin = 0; begin < points.size(); begin += chunkSize) {
+			const size_t count = std::min(chunkSize, points.size() - begin);
+			tree.radiusBatch(points.data() + begin, count, radius * radius, neighbors, ids.data(), distSqs.data(), counts.data());
+#pragma omp parallel for
+			for (int q = 0; q < int(count); ++q) {
+				keep[begin + q] = counts[q] >= neighbors ? 1 : 0;
+			}
+		}
+		return keep;
+	}
+
+	void PointCloudFilter::pruneSplats(const float * opacities, const float * scales, float minOpacity, float maxScale, std::vector<uint8_t> & keep)
+	{
+		const int count = int(keep.size());
+#pragma omp parallel for
+		for (int pid = 0; pid < count; ++pid) {
+			if (opacities && minOpacity > 0.0f && opacities[pid] < minOpacity) {
+				keep[pid] = 0;
+			}
+			if (scales && maxScale > 0.0f) {
+				const float * scale = scales + 3 * size_t(pid);
+				if (std::max(scale[0], std::max(scale[1], scale[2])) > maxScale) {
+					keep[pid] = 0;
+				}
+			}
+		}
+	}
+
+	std::vector<uint8_t> PointCloudFilter::filter(const std::vector<Vector3f> & points, const float * opacities, const float * scales, const Options & options)
+	{
+		std::vector<uint8_t> keep(points.size(), 1);
+		if (points.empty() || !options.enabled()) {
+			return keep;
+		}
+
+		float maxScale = 0.0f;
+		if (options.maxScale > 0.0f) {
+			Eigen::AlignedBox3f box;
+			for (const Vector3f & point : points) {
+				box.extend(point);
+			}
+			maxScale = options.maxScale * box.diagonal().norm();
+		}
+		pruneSplats(opacities, scales, options.minOpacity, maxScale, keep);
+
+		if (options.statisticalNeighbors > 0 || options.densityRadius > 0.0f) {
+			// Spatial filters only see the splats that survived pruning.
+			std::vector<uint> remaining;
+			remaining.reserve(points.size());
+			for (size_t pid = 0; pid < points.size(); ++pid) {
+				if (keep[pid]) {
+					remaining.push_back(uint(pid));
+				}
+			}
+			std::vector<Vector3f> positions(remaining.size());
+			for (size_t rid = 0; rid < remaining.size(); ++rid) {
+				positions[rid] = points[remaining[rid]];
+			}
+
+			std::vector<uint8_t> spatialKeep(positions.size(), 1);
+			if (options.statisticalNeighbors > 0) {
+				spatialKeep = statisticalOutliers(positions, options.statisticalNeighbors, options.statisticalStdRatio, options.chunkSize);
+			}
+			if (options.densityRadius > 0.0f) {
+				const std::vector<uint8_t> denseKeep = densityFilter(positions, options.densityRadius, options.densityMinNeighbors, options.chunkSize);
+				for (size_t rid = 0; rid < positions.size(); ++rid) {
+					spatialKeep[rid] = spatialKeep[rid] && denseKeep[rid];
+				}
+			}
+			for (size_t rid = 0; rid < remaining.size(); ++rid) {
+				keep[remaining[rid]] = spatialKeep[rid];
+			}
+		}
+
+		size_t kept = 0;
+		for (const uint8_t flag : keep) {
+			kept += flag;
+		}
+		SIBR_LOG << "[PointCloudFilter] Kept " << kept << "/" << points.size() << " points." << std::endl;
+		return keep;
+	}
+
+	size_t PointCloudFilter::filter(Mesh & mesh, const Options & options)
+	{
+		if (!mesh.triangles().empty()) {
+			SIBR_WRG << "[PointCloudFilter] The mesh has triangles, only point clouds can be filtered." << std::endl;
+			return 0;
+		}
+		const std::vector<uint8_t> keep = filter(mesh.vertices(), nullptr, nullptr, options);
+		const size_t count = mesh.vertices().size();
+
+		Mesh::Vertices vertices = mesh.vertices();
+		compact(vertices, keep);
+		if (mesh.hasColors()) {
+			Mesh::Colors colors = mesh.colors();
+			compact(colors, keep);
+			mesh.colors(colors);
+		}
+		if (mesh.hasNormals()) {
+			Mesh::Normals normals = mesh.normals();
+			compact(normals, keep);
+			mesh.normals(normals);
+		}
+		if (mesh.hasTexCoords()) {
+			Mesh::UVs uvs = mesh.texCoords();
+			compact(uvs, keep);
+			mesh.texCoords(uvs);
+		}
+		const size_t removed = count - vertices.size();
+		mesh.vertices(vertices);
+		return removed;
+	}
+
+} // namespace sibr
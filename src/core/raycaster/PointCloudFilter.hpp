@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+# include <vector>
+# include "core/raycaster/Config.hpp"
+# include "core/system/Vector.hpp"
+# include "core/graphics/Mesh.hpp"
+
+namespace sibr
+{
+	/** \brief Remove floaters from point clouds and Gaussian splats before rendering.
+	* Three filters are available: statistical outlier removal (points whose mean distance to their k nearest neighbours is far above
+	* the average), density filtering (points with too few neighbours in a radius), and splat pruning (low opacity or oversized splats).
+	* Neighbourhood queries are batched on a KdTree referencing the positions, and processed by chunks so that the query
+	* buffers stay bounded. Only positions are needed in memory, other attributes can be streamed by the caller using the keep mask.
+	* \ingroup sibr_raycaster
+	*/
+	class SIBR_RAYCASTER_EXPORT PointCloudFilter
+	{
+	public:
+
+		/** Filtering options, each filter is disabled by default. */
+		struct Options {
+			uint statisticalNeighbors = 0; ///< Number of neighbours for statistical outlier removal, 0 to disable.
+			float statisticalStdRatio = 2.0f; ///< Points with a mean neighbour distance above mean+ratio*stddev are removed.
+			float densityRadius = 0.0f; ///< Radius of the density filter, 0 to disable.
+			uint densityMinNeighbors = 4; ///< Minimum number of neighbours in the radius.
+			float minOpacity = 0.0f; ///< Splats with a lower opacity are removed, 0 to disable.
+			float maxScale = 0.0f; ///< Splats with a scale larger than this ratio of the scene bounding box diagonal are removed, 0 to disable.
+			size_t chunkSize = size_t(1) << 20; ///< Number of neighbourhood queries per chunk.
+
+			/** \return true if at least one filter is enabled */
+			bool enabled() const;
+		};
+
+		/** Compute which points pass statistical outlier removal.
+		\param points the positions
+		\param k the number of neighbours
+		\param stdRatio the standard deviation multiplier
+		\param chunkSize the number of queries per chunk
+		\return for each point, 1 if it is kept
+		*/
+		static std::vector<uint8_t> statisticalOutliers(const std::vector<Vector3f> & points, uint k, float stdRatio, size_t chunkSize = size_t(1) << 20);
+
+		/** Compute which points have enough neighbours in a radius.
+		\param points the positions
+		\param radius the neighbourhood radius
+		\param minNeighbors the minimum number of neighbours, excluding the point itself
+		\param chunkSize the number of queries per chunk
+		\return for each point, 1 if it is kept
+		*/
+		static std::vector<uint8_t> densityFilter(const std::vector<Vector3f> & points, float radius, uint minNeighbors, size_t chunkSize = size_t(1) << 20);
+
+		/** Remove low opacity or oversized splats from a keep mask.
+		\param opacities the activated opacities, one per splat
+		\param scales the activated scales, three per splat
+		\param minOpacity the minimum opacity, 0 to disable
+		\param maxScale the maximum scale along any axis, 0 to disable
+		\param keep the keep mask, updated in place
+		*/
+		static void pruneSplats(const float * opacities, const float * scales, float minOpacity, float maxScale, std::vector<uint8_t> & keep);
+
+		/** Apply all enabled filters: splats are pruned first, then the spatial filters are computed on the remaining points.
+		\param points the positions
+		\param opacities optional activated opacities, one per point
+		\param scales optional activated scales, three per point
+		\param options the filtering options
+		\return for each point, 1 if it is kept
+		*/
+		static std::vector<uint8_t> filter(const std::vector<Vector3f> & points, const float * opacities, const float * scales, const Options & options);
+
+		/** Remove the points of a point cloud mesh (without triangles), keeping their attributes.
+		\param mesh the point cloud
+		\param options the filtering options
+		\return the number of removed points
+		*/
+		static size_t filter(Mesh & mesh, const Options & options);
+
+		/** Keep the values of an array with a non-zero mask entry, preserving their order.
+		\param values the array to compact, with the same size as the mask
+		\param keep the keep mask
+		\return the number of values kept
+		*/
+		template<typename T>
+		static size_t compact(std::vector<T> & values, const std::vector<uint8_t> & keep);
+	};
+
+	template<typename T>
+	size_t PointCloudFilter::compact(std::vector<T> & values, const std::vector<uint8_t> & keep)
+	{
+		size_t kept = 0;
+		for (size_t i = 0; i < values.size(); ++i) {
+			if (keep[i]) {
+				if (kept != i) {
+					values[kept] = values[i];
+				}
+				++kept;
+			}
+		}
+		values.resize(kept);
+		return kept;
+	}
+
+} // namespace sibr
@@ -97,14 +97,47 @@ namespace sibr
 		return addGenericMesh(mesh, RTC_BUILD_QUALITY_LOW);
 	}
 
+	namespace {
+
+		/** Fill the vertex and index buffers of an Embree triangle geometry. */
+		void fillTriangleGeometry(RTCGeometry geom_0, const sibr::Mesh& mesh)
+		{
+			const sibr::Mesh::Vertices& vertices = mesh.vertices();
+			const sibr::Mesh::Triangles& triangles = mesh.triangles();
+
+			struct Vertex { float x, y, z, a; };
+			struct Triangle { int v0, v1, v2; };
+
+			{ // Fill vertices of the geometry
+				Vertex* vert = (Vertex*)rtcSetNewGeometryBuffer(geom_0, RTC_BUFFER_TYPE_VERTEX, 0, RTC_FORMAT_FLOAT3, 4 * sizeof(float), vertices.size());
+				for (uint i = 0; i < mesh.vertices().size(); ++i)
+				{
+					vert[i].x = vertices[i][0];
+					vert[i].y = vertices[i][1];
+					vert[i].z = vertices[i][2];
+					vert[i].a = 1.f;
+				}
+
+			}
+
+			{ // Fill triangle indices of the geometry
+				Triangle* tri = (Triangle*)rtcSetNewGeometryBuffer(geom_0, RTC_BUFFER_TYPE_INDEX, 0, RTC_FORMAT_UINT3, 3 * sizeof(int), triangles.size());
+				for (uint i = 0; i < triangles.size(); ++i)
+				{
+					tri[i].v0 = triangles[i][0];
+					tri[i].v1 = triangles[i][1];
+					tri[i].v2 = triangles[i][2];
+				}
+
+			}
+		}
+	}
+
 	Raycaster::geomId	Raycaster::addGenericMesh(const sibr::Mesh& mesh, RTCBuildQuality type)
 	{
 		if (init() == false)
 			return Raycaster::InvalidGeomId;
 
-		const sibr::Mesh::Vertices& vertices = mesh.vertices();
-		const sibr::Mesh::Triangles& triangles = mesh.triangles();
-
 		RTCGeometry geom_0 = rtcNewGeometry(*g_device.get(), RTC_GEOMETRY_TYPE_TRIANGLE); // EMBREE_FIXME: check if geometry gets properly committed
 		rtcSetGeometryBuildQuality(geom_0, type);
 		rtcSetGeometryTimeStepCount(geom_0, 1);
@@ -116,31 +149,7 @@ namespace sibr
 			return Raycaster::InvalidGeomId;
 		}
 
-		struct Vertex { float x, y, z, a; };
-		struct Triangle { int v0, v1, v2; };
-
-		{ // Fill vertices of the geometry
-			Vertex* vert = (Vertex*)rtcSetNewGeometryBuffer(geom_0, RTC_BUFFER_TYPE_VERTEX, 0, RTC_FORMAT_FLOAT3, 4 * sizeof(float), vertices.size());
-			for (uint i = 0; i < mesh.vertices().size(); ++i)
-			{
-				vert[i].x = vertices[i][0];
-				vert[i].y = vertices[i][1];
-				vert[i].z = vertices[i][2];
-				vert[i].a = 1.f;
-			}
-
-		}
-
-		{ // Fill triangle indices of the geometry
-			Triangle* tri = (Triangle*)rtcSetNewGeometryBuffer(geom_0, RTC_BUFFER_TYPE_INDEX, 0, RTC_FORMAT_UINT3, 3 * sizeof(int), triangles.size());
-			for (uint i = 0; i < triangles.size(); ++i)
-			{
-				tri[i].v0 = triangles[i][0];
-				tri[i].v1 = triangles[i][1];
-				tri[i].v2 = triangles[i][2];
-			}
-
-		}
+		fillTriangleGeometry(geom_0, mesh);
 
 		rtcCommitGeometry(geom_0);
 
@@ -150,6 +159,47 @@ namespace sibr
 		return id;
 	}
 
+	std::vector<Raycaster::geomId>	Raycaster::addInstances(const sibr::MeshInstances& instances)
+	{
+		std::vector<geomId> ids;
+		if (init() == false)
+			return ids;
+
+		// One scene per shared mesh, built once and referenced by all its instances.
+		std::vector<RTCScene> meshScenes(instances.meshes().size());
+		for (size_t mid = 0; mid < meshScenes.size(); ++mid)
+		{
+			meshScenes[mid] = rtcNewScene(*g_device.get());
+			RTCGeometry geom = rtcNewGeometry(*g_device.get(), RTC_GEOMETRY_TYPE_TRIANGLE);
+			rtcSetGeometryBuildQuality(geom, RTC_BUILD_QUALITY_HIGH);
+			rtcSetGeometryTimeStepCount(geom, 1);
+			fillTriangleGeometry(geom, *instances.meshes()[mid]);
+			rtcCommitGeometry(geom);
+			rtcAttachGeometry(meshScenes[mid], geom);
+			rtcReleaseGeometry(geom);
+			rtcCommitScene(meshScenes[mid]);
+		}
+
+		ids.reserve(instances.instances().size());
+		for (const sibr::MeshInstances::Instance& instance : instances.instances())
+		{
+			RTCGeometry geom = rtcNewGeometry(*g_device.get(), RTC_GEOMETRY_TYPE_INSTANCE);
+			rtcSetGeometryInstancedScene(geom, meshScenes[instance.mesh]);
+			rtcSetGeometryTimeStepCount(geom, 1);
+			rtcSetGeometryTransform(geom, 0, RTC_FORMAT_FLOAT4X4_COLUMN_MAJOR, instance.toWorld.data());
+			rtcCommitGeometry(geom);
+			ids.push_back(rtcAttachGeometry(*_scene.get(), geom));
+			rtcReleaseGeometry(geom);
+		}
+
+		// Instances keep a reference to the scenes they use.
+		for (RTCScene meshScene : meshScenes)
+			rtcReleaseScene(meshScene);
+
+		rtcCommitScene(*_scene.get());
+		return ids;
+	}
+
 	// xform a mesh by transformation matrix "mat". Note that the original positions
 	// are always stored in mesh.vertices -- we only xform the vertices in the embree buffer
 	void	Raycaster::xformRtcMeshOnly(sibr::Mesh& mesh, geomId mesh_id, sibr::Matrix4f& mat, sibr::Vector3f& centerPt, float& maxlen)
@@ -215,6 +265,41 @@ namespace sibr
 		return ray.tfar < 0.0f;
 	}
 
+	void	Raycaster::hitSomethingStream(const sibr::Vector3f* origins, const sibr::Vector3f* directions, size_t count, uint8_t* occluded, float minDist, float maxDist)
+	{
+		assert(minDist >= 0.f);
+
+		std::vector<RTCRay> rays(count);
+		for (size_t r = 0; r < count; ++r) {
+			RTCRay& ray = rays[r];
+			ray.org_x = origins[r][0];
+			ray.org_y = origins[r][1];
+			ray.org_z = origins[r][2];
+			ray.dir_x = directions[r][0];
+			ray.dir_y = directions[r][1];
+			ray.dir_z = directions[r][2];
+			ray.tnear = minDist;
+			ray.tfar = maxDist;
+			ray.time = 0.0f;
+			ray.mask = uint(-1);
+			ray.id = uint(r);
+			ray.flags = 0;
+		}
+
+		if (init() == false)
+			SIBR_ERR << "cannot initialize embree, failed cast rays." << std::endl;
+		else if (count > 0)
+		{
+			RTCIntersectContext context;
+			rtcInitIntersectContext(&context);
+			rtcOccluded1M(*_scene.get(), &context, rays.data(), uint(count), sizeof(RTCRay));
+		}
+
+		for (size_t r = 0; r < count; ++r) {
+			occluded[r] = rays[r].tfar < 0.0f ? 1 : 0;
+		}
+	}
+
 	std::array<bool, 8>	Raycaster::hitSomething8(const std::array<Ray, 8> & inray, float minDist)
 	{
 		assert(minDist >= 0.f);
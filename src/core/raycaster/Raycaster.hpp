@@ -20,6 +20,7 @@
 # pragma warning(pop)
 
 # include <core/graphics/Mesh.hpp>
+# include <core/graphics/MeshInstances.hpp>
 # include <core/system/Matrix.hpp>
 # include "core/raycaster/Config.hpp"
 # include "core/raycaster/Ray.hpp"
@@ -79,6 +80,13 @@ namespace sibr
 		/// \return the mesh ID or Raycaster::InvalidGeomId if it fails.
 		geomId	addGenericMesh( const sibr::Mesh& mesh, RTCBuildQuality type );
 
+		/// Add instances of shared meshes: each mesh is built once in its own Embree scene, referenced by one Embree instance per transformation.
+		/// Hits on an instance report the instance ID in RayHit::Primitive::instID, and the triangle ID in the corresponding shared mesh.
+		/// \note The hit normal is expressed in the shared mesh frame.
+		/// \param instances the shared meshes and their instances
+		/// \return the ID of each instance, in order
+		std::vector<geomId>	addInstances( const sibr::MeshInstances& instances );
+
 		/// Transform the vertices of a mesh by applying a sibr::Matrix4f mat.
 		/// \note The original positions are always stored *unchanged* in mesh.vertices -- we only xform the vertices in the embree buffer
 		/// \param mesh the mesh to transform
@@ -117,6 +125,16 @@ namespace sibr
 		/// \return a list of boolean denoting if intersections happened
 		std::array<bool, 8>	hitSomething8(const std::array<Ray, 8>& inray, float minDist = 0.f);
 
+		/// Test occlusion for a batch of rays with a single Embree stream query, faster than individual casts for large incoherent batches (ambient occlusion, shadows).
+		/// Can be called concurrently from several threads.
+		/// \param origins the ray origins
+		/// \param directions the ray directions
+		/// \param count the number of rays
+		/// \param occluded will be set to 1 for each ray that hit something, 0 otherwise
+		/// \param minDist Any intersection closer than minDist from the ray origin will be ignored. Useful to avoid self intersections.
+		/// \param maxDist Any intersection farther than maxDist from the ray origin will be ignored.
+		void	hitSomethingStream(const sibr::Vector3f* origins, const sibr::Vector3f* directions, size_t count, uint8_t* occluded, float minDist = 0.f, float maxDist = RayHit::InfinityDist);
+
 		/// Disable geometry to avoid raycasting against it (eg background when only intersecting a foreground object).
 		/// \param id the mesh to disable
 		/// \todo Untested.
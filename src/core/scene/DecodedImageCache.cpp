@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#include "core/scene/DecodedImageCache.hpp"
+
+namespace sibr
+{
+	DecodedImageCache::DecodedImageCache(const Loader & loader, size_t capacity)
+		: _loader(loader), _capacity(std::max<size_t>(1, capacity))
+	{
+		_thread = std::thread(&DecodedImageCache::run, this);
+	}
+
+	DecodedImageCache::~DecodedImageCache()
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_stop = true;
+		}
+		_hasWork.notify_all();
+		_thread.join();
+	}
+
+	void DecodedImageCache::request(const std::vector<uint> & cameras)
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_pending.clear();
+			for (uint cam : cameras) {
+				if (_entries.count(cam) == 0) {
+					_pending.push_back(cam);
+				}
+			}
+		}
+		_hasWork.notify_one();
+	}
+
+	ImageRGB::Ptr DecodedImageCache::get(uint camera)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		auto entry = _entries.find(camera);
+		if (entry == _entries.end()) {
+			return ImageRGB::Ptr();
+		}
+		_lru.splice(_lru.begin(), _lru, entry->second.lruPos);
+		return entry->second.image;
+	}
+
+	ImageRGB::Ptr DecodedImageCache::getBlocking(uint camera)
+	{
+		ImageRGB::Ptr image = get(camera);
+		if (image) {
+			return image;
+		}
+		// The decoding thread might be working on it too, decoding twice is cheaper than waiting for the whole queue.
+		image = _loader(camera);
+		if (image) {
+			std::lock_guard<std::mutex> lock(_mutex);
+			insert(camera, image);
+		}
+		return image;
+	}
+
+	size_t DecodedImageCache::size() const
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _entries.size();
+	}
+
+	size_t DecodedImageCache::pending() const
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _pending.size();
+	}
+
+	void DecodedImageCache::run()
+	{
+		while (true) {
+			uint camera;
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_hasWork.wait(lock, [this] { return _stop || !_pending.empty(); });
+				if (_stop) {
+					return;
+				}
+				camera = _pending.front();
+				_pending.pop_front();
+				if (_entries.count(camera) > 0) {
+					continue;
+				}
+			}
+
+			// Decode without holding the lock, the render thread keeps querying the cache.
+			const ImageRGB::Ptr image = _loader(camera);
+			if (!image) {
+				SIBR_WRG << "[DecodedImageCache] Unable to decode image of camera " << camera << "." << std::endl;
+				continue;
+			}
+			std::lock_guard<std::mutex> lock(_mutex);
+			insert(camera, image);
+		}
+	}
+
+	void DecodedImageCache::insert(uint camera, const ImageRGB::Ptr & image)
+	{
+		auto entry = _entries.find(camera);
+		if (entry != _entries.end()) {
+			entry->second.image = image;
+			_lru.splice(_lru.begin(), _lru, entry->second.lruPos);
+			return;
+		}
+		_lru.push_front(camera);
+		_entries[camera] = { image, _lru.begin() };
+		while (_entries.size() > _capacity) {
+			_entries.erase(_lru.back());
+			_lru.pop_back();
+		}
+	}
+
+} // namespace sibr
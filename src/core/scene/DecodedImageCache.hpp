@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+#include "core/scene/Config.hpp"
+#include "core/graphics/Image.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace sibr
+{
+	/** \brief Least recently used cache of decoded input images, filled by a background decoding thread.
+	* Requests are asynchronous: each call to request replaces the pending list, so that stale prefetches
+	* from previous frames do not delay the images needed now.
+	* \ingroup sibr_scene
+	*/
+	class SIBR_SCENE_EXPORT DecodedImageCache
+	{
+		SIBR_CLASS_PTR(DecodedImageCache);
+
+	public:
+
+		/** Decode the image of a camera, called from the decoding thread. Can return a null pointer on failure. */
+		typedef std::function<ImageRGB::Ptr(uint)> Loader;
+
+		/** Constructor, starts the decoding thread.
+		\param loader the decoding function
+		\param capacity maximal number of images kept in memory
+		*/
+		DecodedImageCache(const Loader & loader, size_t capacity);
+
+		/** Destructor, stops the decoding thread. */
+		~DecodedImageCache();
+
+		/** Replace the pending decoding requests.
+		\param cameras the cameras to decode, by decreasing priority
+		*/
+		void request(const std::vector<uint> & cameras);
+
+		/** Get an image if it has already been decoded, without blocking.
+		\param camera the camera index
+		\return the image or a null pointer
+		*/
+		ImageRGB::Ptr get(uint camera);
+
+		/** Get an image, decoding it on the calling thread if needed.
+		\param camera the camera index
+		\return the image or a null pointer if decoding failed
+		*/
+		ImageRGB::Ptr getBlocking(uint camera);
+
+		/** \return the number of cached images. */
+		size_t size() const;
+
+		/** \return the number of pending requests. */
+		size_t pending() const;
+
+	private:
+
+		/** Decoding thread loop. */
+		void run();
+
+		/** Insert a decoded image and evict the least recently used ones, the mutex must be locked.
+		\param camera the camera index
+		\param image the decoded image
+		*/
+		void insert(uint camera, const ImageRGB::Ptr & image);
+
+		/** Cache entry. */
+		struct Entry {
+			ImageRGB::Ptr image; ///< Decoded image.
+			std::list<uint>::iterator lruPos; ///< Position in the LRU list.
+		};
+
+		Loader _loader; ///< Decoding function.
+		size_t _capacity; ///< Maximal number of entries.
+		std::unordered_map<uint, Entry> _entries; ///< Decoded images.
+		std::list<uint> _lru; ///< Cached cameras, most recently used first.
+		std::deque<uint> _pending; ///< Cameras waiting to be decoded.
+		bool _stop = false; ///< Should the thread stop.
+		mutable std::mutex _mutex; ///< Protect the entries and requests.
+		std::condition_variable _hasWork; ///< Signaled when requests are added.
+		std::thread _thread; ///< Decoding thread.
+	};
+
+} // namespace sibr
@@ -15,6 +15,7 @@
 #include "core/scene/Config.hpp"
 #include "core/scene/IParseData.hpp"
 #include "core/graphics/Mesh.hpp"
+#include "core/graphics/Camera.hpp"
 
 namespace sibr {
 	/**
@@ -32,6 +33,21 @@ namespace sibr {
 		virtual const Mesh&											proxy(void) const = 0;
 		virtual const Mesh::Ptr										proxyPtr(void) const = 0;
 
+		/** Load the levels of detail saved next to the proxy (see MeshSimplifier::saveLODs).
+		\param basePath the proxy path without extension
+		\return the number of levels loaded
+		*/
+		virtual size_t												loadLODs(const std::string & basePath) = 0;
+		/** \return the number of available levels of detail */
+		virtual size_t												lodCount(void) const = 0;
+		/** Get the coarsest version of the proxy whose error stays under a pixel threshold for a viewpoint.
+		\param eye the viewpoint
+		\param viewportHeight the height of the viewport in pixels
+		\param pixelError the maximum error in pixels, 0 to always use the full resolution proxy
+		\return the proxy or one of its levels of detail
+		*/
+		virtual const Mesh&											proxyLOD(const Camera & eye, float viewportHeight, float pixelError) const = 0;
+
 	protected:
 		IProxyMesh() {};
 
@@ -0,0 +1,369 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#include "core/scene/InputCameraIndex.hpp"
+#include "core/system/SimpleTimer.hpp"
+
+#include <map>
+#include <random>
+
+namespace sibr
+{
+	namespace {
+
+		/** Keep the candidates with the highest scores, the worst kept one being on top of a min-heap. */
+		class BoundedHeap
+		{
+		public:
+			explicit BoundedHeap(size_t capacity) : _capacity(capacity) {
+				_items.reserve(capacity);
+			}
+
+			/** \return true if capacity candidates are kept. */
+			bool full() const { return _capacity > 0 && _items.size() >= _capacity; }
+
+			/** \return the lowest kept score. */
+			float worst() const { return _items.front().first; }
+
+			/** Offer a candidate, kept if it is better than the worst one when full. */
+			void push(float score, uint id) {
+				if (_capacity == 0) {
+					return;
+				}
+				if (_items.size() < _capacity) {
+					_items.emplace_back(score, id);
+					std::push_heap(_items.begin(), _items.end(), compare);
+				} else if (score > worst()) {
+					std::pop_heap(_items.begin(), _items.end(), compare);
+					_items.back() = std::make_pair(score, id);
+					std::push_heap(_items.begin(), _items.end(), compare);
+				}
+			}
+
+			/** Extract the candidates, best first. */
+			void sorted(std::vector<uint> & out) {
+				std::sort_heap(_items.begin(), _items.end(), compare);
+				out.clear();
+				for (const auto & item : _items) {
+					out.push_back(item.second);
+				}
+				_items.clear();
+			}
+
+		private:
+			static bool compare(const std::pair<float, uint> & a, const std::pair<float, uint> & b) { return a.first > b.first; }
+
+			size_t _capacity;
+			std::vector<std::pair<float, uint>> _items;
+		};
+
+	}
+
+	InputCameraIndex::InputCameraIndex(const std::vector<InputCamera::Ptr> & cameras, int binsPerFace)
+		: _cameras(cameras), _binsPerFace(std::max(1, binsPerFace))
+	{
+		for (const auto & cam : cameras) {
+			_positions.push_back(cam->position());
+			_directions.push_back(cam->dir().normalized());
+		}
+		build();
+	}
+
+	InputCameraIndex::InputCameraIndex(const std::vector<Vector3f> & positions, const std::vector<Vector3f> & directions, int binsPerFace)
+		: _positions(positions), _directions(directions), _binsPerFace(std::max(1, binsPerFace))
+	{
+		if (positions.size() != directions.size()) {
+			SIBR_ERR << "[InputCameraIndex] Positions and directions counts differ." << std::endl;
+		}
+		build();
+	}
+
+	void InputCameraIndex::build()
+	{
+		if (_positions.empty()) {
+			return;
+		}
+		_tree.reset(new KdTree<float>(std::vector<KdTree<float>::Vector3X>(_positions.begin(), _positions.end())));
+
+		_bins.assign(6 * _binsPerFace * _binsPerFace, DirectionBin());
+		for (uint id = 0; id < uint(_directions.size()); ++id) {
+			_bins[binIndex(_directions[id])].cameras.push_back(id);
+		}
+		for (DirectionBin & bin : _bins) {
+			if (bin.cameras.empty()) {
+				continue;
+			}
+			Vector3f sum(0.0f, 0.0f, 0.0f);
+			for (uint id : bin.cameras) {
+				sum += _directions[id];
+			}
+			bin.axis = sum.norm() > 0.0f ? Vector3f(sum.normalized()) : _directions[bin.cameras[0]];
+			float minCos = 1.0f;
+			for (uint id : bin.cameras) {
+				minCos = std::min(minCos, bin.axis.dot(_directions[id]));
+			}
+			bin.halfAngle = std::acos(sibr::clamp(minCos, -1.0f, 1.0f));
+		}
+	}
+
+	int InputCameraIndex::binIndex(const Vector3f & direction) const
+	{
+		const Vector3f a = direction.cwiseAbs();
+		if (a.maxCoeff() <= 0.0f) {
+			return 0;
+		}
+		int face;
+		float u, v;
+		if (a.x() >= a.y() && a.x() >= a.z()) {
+			face = direction.x() > 0.0f ? 0 : 1;
+			u = direction.y() / a.x();
+			v = direction.z() / a.x();
+		} else if (a.y() >= a.z()) {
+			face = direction.y() > 0.0f ? 2 : 3;
+			u = direction.x() / a.y();
+			v = direction.z() / a.y();
+		} else {
+			face = direction.z() > 0.0f ? 4 : 5;
+			u = direction.x() / a.z();
+			v = direction.y() / a.z();
+		}
+		const int i = sibr::clamp(int((0.5f * u + 0.5f) * _binsPerFace), 0, _binsPerFace - 1);
+		const int j = sibr::clamp(int((0.5f * v + 0.5f) * _binsPerFace), 0, _binsPerFace - 1);
+		return (face * _binsPerFace + j) * _binsPerFace + i;
+	}
+
+	void InputCameraIndex::closestByDistance(const Vector3f & position, size_t count, std::vector<uint> & out, bool activeOnly) const
+	{
+		out.clear();
+		if (count == 0 || !_tree) {
+			return;
+		}
+		const KdTree<float>::Vector3X pos = position;
+		KdTree<float>::Results results;
+		// Grow the query until enough active cameras are found.
+		for (size_t query = std::min(count, size()); ; query = std::min(2 * query, size())) {
+			_tree->getClosest(pos, query, results);
+			out.clear();
+			for (const auto & result : results) {
+				if (!activeOnly || isActive(uint(result.first))) {
+					out.push_back(uint(result.first));
+					if (out.size() == count) {
+						return;
+					}
+				}
+			}
+			if (query == size()) {
+				return;
+			}
+		}
+	}
+
+	void InputCameraIndex::closestByAngle(const Vector3f & direction, size_t count, std::vector<uint> & out) const
+	{
+		out.clear();
+		if (count == 0 || _bins.empty()) {
+			return;
+		}
+
+		// Visit bins by increasing lower bound on the angle to their members.
+		std::vector<std::pair<float, int>> order;
+		for (int b = 0; b < int(_bins.size()); ++b) {
+			if (!_bins[b].cameras.empty()) {
+				const float angle = std::acos(sibr::clamp(direction.dot(_bins[b].axis), -1.0f, 1.0f));
+				order.emplace_back(std::max(0.0f, angle - _bins[b].halfAngle), b);
+			}
+		}
+		std::sort(order.begin(), order.end());
+
+		// The angle ordering is the cosine ordering, no acos per camera.
+		BoundedHeap heap(count);
+		for (const auto & bin : order) {
+			if (heap.full() && std::cos(bin.first) <= heap.worst()) {
+				break;
+			}
+			for (uint id : _bins[bin.second].cameras) {
+				if (isActive(id)) {
+					heap.push(direction.dot(_directions[id]), id);
+				}
+			}
+		}
+		heap.sorted(out);
+	}
+
+	void InputCameraIndex::bestAngleOverDistance(const Vector3f & position, const Vector3f & direction, size_t count, std::vector<uint> & out)
+	{
+		out.clear();
+		if (count == 0 || !_tree) {
+			_previous.clear();
+			return;
+		}
+
+		const auto score = [&](uint id, float & s) {
+			if (!isActive(id)) {
+				return false;
+			}
+			const float cosAngle = direction.dot(_directions[id]);
+			// reject back facing
+			if (cosAngle <= 0.001f) {
+				return false;
+			}
+			s = cosAngle / std::max((_positions[id] - position).norm(), 1e-6f);
+			return true;
+		};
+
+		// cos(angle)/distance <= 1/distance: once count candidates with a score above s are known,
+		// the best cameras all lie in a sphere of radius 1/s. The previous selection usually gives a tight s.
+		float bound = 0.0f;
+		{
+			BoundedHeap heap(count);
+			float s;
+			for (uint id : _previous) {
+				if (id < size() && score(id, s)) {
+					heap.push(s, id);
+				}
+			}
+			if (heap.full()) {
+				bound = heap.worst();
+			}
+		}
+
+		KdTree<float>::Results results;
+		const KdTree<float>::Vector3X pos = position;
+		if (bound <= 0.0f) {
+			for (size_t query = std::min(size(), std::max<size_t>(4 * count, 32)); ; query = std::min(2 * query, size())) {
+				_tree->getClosest(pos, query, results);
+				BoundedHeap heap(count);
+				float s;
+				for (const auto & result : results) {
+					if (score(uint(result.first), s)) {
+						heap.push(s, uint(result.first));
+					}
+				}
+				if (heap.full()) {
+					bound = heap.worst();
+					break;
+				}
+				if (query == size()) {
+					// Less than count valid cameras, all of them have been found.
+					heap.sorted(out);
+					_previous = out;
+					return;
+				}
+			}
+		}
+
+		const double radius = 1.0 / double(bound) * (1.0 + 1e-4);
+		_tree->getNeighbors(pos, radius * radius, false, results);
+		BoundedHeap heap(count);
+		float s;
+		for (const auto & result : results) {
+			if (score(uint(result.first), s)) {
+				heap.push(s, uint(result.first));
+			}
+		}
+		heap.sorted(out);
+		_previous = out;
+	}
+
+	void InputCameraIndex::selectULR(const Vector3f & position, const Vector3f & direction, size_t numDist, size_t numAngle, std::vector<uint> & out) const
+	{
+		std::vector<uint> byAngle;
+		closestByDistance(position, numDist, out);
+		closestByAngle(direction, numAngle, byAngle);
+		out.insert(out.end(), byAngle.begin(), byAngle.end());
+		std::sort(out.begin(), out.end());
+		out.erase(std::unique(out.begin(), out.end()), out.end());
+	}
+
+	void InputCameraIndex::benchmark(size_t numCameras, size_t numQueries, size_t count)
+	{
+		std::mt19937 rng(42);
+		std::uniform_real_distribution<float> uniform(-50.0f, 50.0f);
+		std::normal_distribution<float> normal;
+
+		std::vector<Vector3f> positions(numCameras), directions(numCameras);
+		for (size_t i = 0; i < numCameras; ++i) {
+			positions[i] = Vector3f(uniform(rng), uniform(rng), uniform(rng));
+			directions[i] = Vector3f(normal(rng), normal(rng), normal(rng)).normalized();
+		}
+
+		Timer timer(true);
+		InputCameraIndex index(positions, directions);
+		const double buildTime = timer.deltaTimeFromLastTic<Timer::micro>() * 1e-3;
+
+		// Linear scans, as previously done by the ULR views.
+		const auto linearULR = [&](const Vector3f & pos, const Vector3f & dir, std::vector<uint> & out) {
+			std::multimap<float, uint> distMap, dang;
+			for (uint i = 0; i < uint(numCameras); ++i) {
+				distMap.insert(std::make_pair(sibr::distance(positions[i], pos), i));
+				dang.insert(std::make_pair(std::acos(sibr::clamp(directions[i].dot(dir), -1.0f, 1.0f)), i));
+			}
+			out.clear();
+			auto d_it = distMap.begin();
+			for (size_t i = 0; d_it != distMap.end() && i < count; ++d_it, ++i) {
+				out.push_back(d_it->second);
+			}
+			auto a_it = dang.begin();
+			for (size_t i = 0; a_it != dang.end() && i < count; ++a_it, ++i) {
+				out.push_back(a_it->second);
+			}
+			std::sort(out.begin(), out.end());
+			out.erase(std::unique(out.begin(), out.end()), out.end());
+		};
+		const auto linearAngleOverDistance = [&](const Vector3f & pos, const Vector3f & dir, std::vector<uint> & out) {
+			std::vector<std::pair<float, uint>> all;
+			for (uint i = 0; i < uint(numCameras); ++i) {
+				const float cosAngle = directions[i].dot(dir);
+				if (cosAngle > 0.001f) {
+					all.emplace_back(-cosAngle / std::max((positions[i] - pos).norm(), 1e-6f), i);
+				}
+			}
+			std::sort(all.begin(), all.end());
+			out.clear();
+			for (size_t i = 0; i < std::min(count, all.size()); ++i) {
+				out.push_back(all[i].second);
+			}
+		};
+
+		double linearULRTime = 0.0, indexULRTime = 0.0, linearAngDistTime = 0.0, indexAngDistTime = 0.0;
+		size_t mismatchULR = 0, mismatchAngDist = 0;
+		std::vector<uint> expected, result;
+		for (size_t q = 0; q < numQueries; ++q) {
+			// Smooth circular path looking roughly at the center, as an interactive session would.
+			const float t = 0.01f * float(q);
+			const Vector3f pos(30.0f * std::cos(t), 5.0f * std::sin(3.0f * t), 30.0f * std::sin(t));
+			const Vector3f dir = (Vector3f(0.0f, 0.0f, 0.0f) - pos).normalized();
+
+			timer.tic();
+			linearULR(pos, dir, expected);
+			linearULRTime += timer.deltaTimeFromLastTic<Timer::micro>();
+			timer.tic();
+			index.selectULR(pos, dir, count, count, result);
+			indexULRTime += timer.deltaTimeFromLastTic<Timer::micro>();
+			mismatchULR += (result != expected) ? 1 : 0;
+
+			timer.tic();
+			linearAngleOverDistance(pos, dir, expected);
+			linearAngDistTime += timer.deltaTimeFromLastTic<Timer::micro>();
+			timer.tic();
+			index.bestAngleOverDistance(pos, dir, count, result);
+			indexAngDistTime += timer.deltaTimeFromLastTic<Timer::micro>();
+			mismatchAngDist += (result != expected) ? 1 : 0;
+		}
+
+		const double toMs = 1e-3 / double(std::max<size_t>(1, numQueries));
+		SIBR_LOG << "[InputCameraIndex] " << numCameras << " cameras, " << numQueries << " queries, " << count << " cameras per criterion, index built in " << buildTime << "ms." << std::endl;
+		SIBR_LOG << "[InputCameraIndex] ULR selection: linear " << linearULRTime * toMs << "ms, index " << indexULRTime * toMs << "ms per query, " << mismatchULR << " mismatches." << std::endl;
+		SIBR_LOG << "[InputCameraIndex] Angle/distance selection: linear " << linearAngDistTime * toMs << "ms, index " << indexAngDistTime * toMs << "ms per query, " << mismatchAngDist << " mismatches." << std::endl;
+	}
+
+} // namespace sibr
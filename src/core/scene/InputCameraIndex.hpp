@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+#include "core/scene/Config.hpp"
+#include "core/assets/InputCamera.hpp"
+#include "core/raycaster/KdTree.hpp"
+
+namespace sibr
+{
+	/** \brief Spatial index over input cameras, used to select the cameras to blend without scanning all of them each frame.
+	* Positions are stored in a k-d tree, viewing directions are binned on the faces of a cube, each bin keeping a bounding cone.
+	* Queries keep the k best candidates in bounded heaps and stop as soon as the remaining cameras cannot improve the selection.
+	* The combined angle/distance query reuses the previous selection as a starting bound (frame-to-frame coherence).
+	* Activation flags are read at query time, but the index must be rebuilt if input cameras move.
+	* \ingroup sibr_scene
+	*/
+	class SIBR_SCENE_EXPORT InputCameraIndex
+	{
+		SIBR_CLASS_PTR(InputCameraIndex);
+
+	public:
+
+		/** Constructor.
+		\param cameras the input cameras
+		\param binsPerFace number of direction bins along each side of a cube face
+		*/
+		InputCameraIndex(const std::vector<InputCamera::Ptr> & cameras, int binsPerFace = 4);
+
+		/** Constructor from raw camera poses, all cameras being considered active.
+		\param positions cameras positions
+		\param directions cameras normalized viewing directions
+		\param binsPerFace number of direction bins along each side of a cube face
+		*/
+		InputCameraIndex(const std::vector<Vector3f> & positions, const std::vector<Vector3f> & directions, int binsPerFace = 4);
+
+		/** Find the cameras closest to a position.
+		\param position the reference position
+		\param count number of cameras to select
+		\param out will contain the camera indices, closest first
+		\param activeOnly skip inactive cameras
+		*/
+		void closestByDistance(const Vector3f & position, size_t count, std::vector<uint> & out, bool activeOnly = true) const;
+
+		/** Find the cameras whose viewing direction is the closest to a direction.
+		\param direction the reference normalized direction
+		\param count number of cameras to select
+		\param out will contain the camera indices, smallest angle first
+		*/
+		void closestByAngle(const Vector3f & direction, size_t count, std::vector<uint> & out) const;
+
+		/** Find the front-facing cameras maximizing cos(angle)/distance with respect to a viewpoint.
+		The selection of the previous call is used to bound the search.
+		\param position the viewpoint position
+		\param direction the viewpoint normalized direction
+		\param count number of cameras to select
+		\param out will contain the camera indices, best first
+		*/
+		void bestAngleOverDistance(const Vector3f & position, const Vector3f & direction, size_t count, std::vector<uint> & out);
+
+		/** Classic ULR selection: the union of the closest cameras in distance and in angle, sorted by index.
+		\param position the viewpoint position
+		\param direction the viewpoint normalized direction
+		\param numDist number of cameras selected by distance
+		\param numAngle number of cameras selected by angle
+		\param out will contain the camera indices
+		*/
+		void selectULR(const Vector3f & position, const Vector3f & direction, size_t numDist, size_t numAngle, std::vector<uint> & out) const;
+
+		/** \return the number of indexed cameras. */
+		size_t size() const { return _positions.size(); }
+
+		/** Compare the index against linear scans on synthetic cameras and log timings and mismatches.
+		\param numCameras number of random cameras
+		\param numQueries number of viewpoints, along a smooth path
+		\param count number of cameras selected per query
+		*/
+		static void benchmark(size_t numCameras = 100000, size_t numQueries = 1000, size_t count = 16);
+
+	private:
+
+		/** Direction bin, the members directions are contained in a cone. */
+		struct DirectionBin {
+			Vector3f axis = Vector3f(0.0f, 0.0f, 1.0f); ///< Cone axis.
+			float halfAngle = 0.0f; ///< Cone half angle, in radians.
+			std::vector<uint> cameras; ///< Cameras in the bin.
+		};
+
+		/** Build the k-d tree and the direction bins. */
+		void build();
+
+		/** \return the index of the bin containing a direction.
+		\param direction normalized direction
+		*/
+		int binIndex(const Vector3f & direction) const;
+
+		/** \return true if a camera can be selected.
+		\param id camera index
+		*/
+		bool isActive(uint id) const { return _cameras.empty() || _cameras[id]->isActive(); }
+
+		std::vector<InputCamera::Ptr> _cameras; ///< Cameras, empty when built from raw poses.
+		std::vector<Vector3f> _positions; ///< Cameras positions.
+		std::vector<Vector3f> _directions; ///< Cameras viewing directions.
+		std::shared_ptr<KdTree<float>> _tree; ///< Positions tree.
+		int _binsPerFace; ///< Direction bins resolution.
+		std::vector<DirectionBin> _bins; ///< Direction bins, face-major.
+		std::vector<uint> _previous; ///< Previous bestAngleOverDistance selection.
+	};
+
+} // namespace sibr
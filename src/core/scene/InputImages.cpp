@@ -11,6 +11,7 @@
 
 
 #include "InputImages.hpp"
+#include "core/system/TaskScheduler.hpp"
 
 
 namespace sibr
@@ -22,8 +23,8 @@ namespace sibr
 
 		if (data->imgInfos().empty() == false)
 		{
-//			#pragma omp parallel for
-			for (int i = 0; i < data->imgInfos().size(); ++i) {
+			// One image per task, decoding times vary a lot.
+			sibr::parallelFor(0, int(data->imgInfos().size()), [&](int i) {
 				if (data->activeImages()[i]) {
 					_inputImages[i] = std::make_shared<ImageRGB>();
 					_inputImages[i]->load(data->imgPath() + "/" + data->imgInfos().at(i).filename, false);
@@ -31,7 +32,7 @@ namespace sibr
 				else {
 					_inputImages[i] = std::make_shared<ImageRGB>(16,16, 0);
 				}
-			}
+			}, 1);
 									
 		}
 		else
@@ -55,15 +56,14 @@ namespace sibr
 	{
 		_inputImages.resize(data->imgInfos().size());
 
-		#pragma omp parallel for
-		for (int i = 0; i < data->imgInfos().size(); ++i) {
+		sibr::parallelFor(0, int(data->imgInfos().size()), [&](int i) {
 			if (data->activeImages()[i]) {
 				std::string imgPath = data->basePathName()+ "/images/" + prefix + sibr::imageIdToString(i) + postfix;
 				if (!_inputImages[i]->load(imgPath, false)) {
 					SIBR_WRG << "could not load input image : " << imgPath << std::endl;
 				}
 			}
-		}
+		}, 1);
 	}
 
 
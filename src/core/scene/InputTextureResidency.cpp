@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#include "core/scene/InputTextureResidency.hpp"
+#include "core/system/TaskScheduler.hpp"
+
+namespace sibr
+{
+	namespace {
+
+		/** Wrap a loader so that the decoded images have a given size, resizing on the decoding thread. */
+		DecodedImageCache::Loader resizingLoader(const DecodedImageCache::Loader & loader, uint w, uint h)
+		{
+			return [loader, w, h](uint camera) {
+				ImageRGB::Ptr image = loader(camera);
+				if (image && (image->w() != w || image->h() != h)) {
+					image = ImageRGB::Ptr(new ImageRGB(image->resized(int(w), int(h))));
+				}
+				return image;
+			};
+		}
+
+	}
+
+	InputTextureResidency::InputTextureResidency(const std::vector<InputCamera::Ptr> & cameras, const DecodedImageCache::Loader & loader,
+		uint w, uint h, uint numSlots, uint tailWidth, size_t cacheSize, uint flags)
+		: _cameras(cameras), _index(cameras), _policy(cameras.size(), numSlots),
+		_cache(resizingLoader(loader, w, h), cacheSize > 0 ? cacheSize : 2 * size_t(numSlots)),
+		_slotReady(numSlots, false), _readySlots(cameras.size(), -1)
+	{
+		// The tails are always resident: decode everything once and keep a small version with its mipmaps.
+		const uint tailHeight = std::max(1u, uint(std::round(float(tailWidth) * float(h) / float(std::max(1u, w)))));
+		const DecodedImageCache::Loader tailLoader = resizingLoader(loader, tailWidth, tailHeight);
+		std::vector<ImageRGB::Ptr> tails(cameras.size());
+		sibr::parallelFor(0, int(cameras.size()), [&](int i) {
+			tails[i] = tailLoader(uint(i));
+			if (!tails[i]) {
+				tails[i] = ImageRGB::Ptr(new ImageRGB(tailWidth, tailHeight, ImageRGB::Pixel(0, 0, 0)));
+			}
+		}, 1);
+		_tails.reset(new Texture2DArrayRGB(tails, tailWidth, tailHeight, flags | SIBR_GPU_AUTOGEN_MIPMAP));
+
+		// Slices are updated individually, mipmaps would have to be regenerated for the whole array.
+		_slices.reset(new Texture2DArrayRGB(w, h, numSlots, flags & ~SIBR_GPU_AUTOGEN_MIPMAP));
+
+		SIBR_LOG << "[InputTextureResidency] " << cameras.size() << " cameras, " << numSlots << " slices of " << w << "x" << h
+			<< ", tails of " << tailWidth << "x" << tailHeight << "." << std::endl;
+	}
+
+	void InputTextureResidency::update(const std::vector<uint> & selected, const sibr::Camera & eye)
+	{
+		_selected = selected;
+		std::sort(_selected.begin(), _selected.end());
+		const auto isSelected = [this](uint cam) { return std::binary_search(_selected.begin(), _selected.end(), cam); };
+
+		// Predict the cameras selected a few frames ahead with the same kind of criterion.
+		_predictor.update(eye.position(), eye.dir());
+		std::vector<uint> prefetch;
+		Vector3f predictedPos, predictedDir;
+		if (_numPrefetch > 0 && _predictor.predict(_lookahead, predictedPos, predictedDir)) {
+			const size_t count = std::max<size_t>(2, selected.size());
+			std::vector<uint> predicted;
+			_index.selectULR(predictedPos, predictedDir, count / 2, count - count / 2, predicted);
+			for (uint cam : predicted) {
+				if (prefetch.size() < _numPrefetch && !isSelected(cam)) {
+					prefetch.push_back(cam);
+				}
+			}
+		}
+
+		const TextureResidencyPolicy::Plan plan = _policy.update(selected, prefetch);
+		for (uint cam : plan.evicted) {
+			_readySlots[cam] = -1;
+		}
+		for (const TextureResidencyPolicy::Load & load : plan.loads) {
+			_slotReady[load.slot] = false;
+		}
+
+		// Cameras with a slot but no uploaded content, required ones first.
+		std::vector<uint> missing;
+		for (const std::vector<uint> * cams : { &selected, &prefetch }) {
+			for (uint cam : *cams) {
+				const int slot = cam < _readySlots.size() ? _policy.slot(cam) : -1;
+				if (slot >= 0 && !_slotReady[slot]) {
+					missing.push_back(cam);
+				}
+			}
+		}
+		_cache.request(missing);
+
+		// Upload what has been decoded, within the frame budget.
+		std::vector<ImageRGB::Ptr> images(_policy.numSlots());
+		std::vector<int> slots;
+		std::vector<uint> uploaded;
+		for (uint cam : missing) {
+			const bool mustWait = _blockOnMiss && isSelected(cam);
+			if (!mustWait && slots.size() >= _maxUploadsPerFrame) {
+				continue;
+			}
+			const ImageRGB::Ptr image = mustWait ? _cache.getBlocking(cam) : _cache.get(cam);
+			if (!image) {
+				continue;
+			}
+			const int slot = _policy.slot(cam);
+			images[slot] = image;
+			slots.push_back(slot);
+			uploaded.push_back(cam);
+		}
+		if (slots.empty()) {
+			return;
+		}
+		_slices->updateSlices(images, slots);
+		for (uint cam : uploaded) {
+			const int slot = _policy.slot(cam);
+			_slotReady[slot] = true;
+			_readySlots[cam] = slot;
+		}
+	}
+
+	DecodedImageCache::Loader InputTextureResidency::fileLoader(const std::vector<std::string> & paths)
+	{
+		return [paths](uint camera) {
+			ImageRGB::Ptr image(new ImageRGB());
+			if (camera >= paths.size() || paths[camera].empty() || !image->load(paths[camera], false)) {
+				return ImageRGB::Ptr();
+			}
+			return image;
+		};
+	}
+
+} // namespace sibr
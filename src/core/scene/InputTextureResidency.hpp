@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+#include "core/scene/Config.hpp"
+#include "core/scene/DecodedImageCache.hpp"
+#include "core/scene/InputCameraIndex.hpp"
+#include "core/scene/TextureResidencyPolicy.hpp"
+#include "core/graphics/Texture.hpp"
+#include "core/graphics/Camera.hpp"
+
+namespace sibr
+{
+	/** \brief Keep only the input images needed for rendering on the GPU, in a fixed pool of texture array slices.
+	* All images are also uploaded once at a low resolution with their mipmaps (the tails array), so that a camera
+	* whose full resolution image is not resident yet can still be sampled.
+	* Each frame, the selected cameras and the cameras predicted from the viewpoint motion are paged in by
+	* the TextureResidencyPolicy, decoded on a background thread by the DecodedImageCache, and uploaded with a bounded budget.
+	* Renderers look up the slot of a camera with cameraSlots(), -1 meaning that only the tail is available.
+	* \ingroup sibr_scene
+	*/
+	class SIBR_SCENE_EXPORT InputTextureResidency
+	{
+		SIBR_CLASS_PTR(InputTextureResidency);
+
+	public:
+
+		/** Constructor, uploads the tails and allocates the slices pool.
+		\param cameras the input cameras
+		\param loader decode the full image of a camera, will be called from several threads
+		\param w the slices width
+		\param h the slices height
+		\param numSlots the number of full resolution slices
+		\param tailWidth the width of the low resolution images
+		\param cacheSize the number of decoded images kept in memory, 0 to use twice the number of slots
+		\param flags texture options
+		*/
+		InputTextureResidency(const std::vector<InputCamera::Ptr> & cameras, const DecodedImageCache::Loader & loader,
+			uint w, uint h, uint numSlots, uint tailWidth = 128, size_t cacheSize = 0, uint flags = SIBR_GPU_LINEAR_SAMPLING);
+
+		/** Page in the cameras needed for a frame, and prefetch the ones needed soon.
+		\param selected the cameras used to render the frame, by decreasing priority
+		\param eye the current viewpoint, used to predict the next selections
+		*/
+		void update(const std::vector<uint> & selected, const sibr::Camera & eye);
+
+		/** \return the full resolution slices. */
+		const Texture2DArrayRGB::Ptr & slices() const { return _slices; }
+
+		/** \return the low resolution images of all cameras, with mipmaps. */
+		const Texture2DArrayRGB::Ptr & tails() const { return _tails; }
+
+		/** \return the slice of each camera, -1 if only the tail is available. */
+		const std::vector<int> & cameraSlots() const { return _readySlots; }
+
+		/** \return the residency policy, for statistics. */
+		const TextureResidencyPolicy & policy() const { return _policy; }
+
+		/** Maximal number of slices uploaded per frame, to bound frame time. */
+		uint & maxUploadsPerFrame() { return _maxUploadsPerFrame; }
+
+		/** Maximal number of cameras prefetched per frame, 0 to disable prefetching. */
+		uint & numPrefetch() { return _numPrefetch; }
+
+		/** Number of frames of motion extrapolated to prefetch. */
+		float & lookahead() { return _lookahead; }
+
+		/** Wait for the decoding of selected cameras instead of falling back to the tails. */
+		bool & blockOnMiss() { return _blockOnMiss; }
+
+		/** Create a loader reading images from disk.
+		\param paths the image files, one per camera, empty for cameras without image
+		\return the loader
+		*/
+		static DecodedImageCache::Loader fileLoader(const std::vector<std::string> & paths);
+
+	private:
+
+		std::vector<InputCamera::Ptr> _cameras; ///< Input cameras.
+		InputCameraIndex _index; ///< Used to predict the cameras selected in the next frames.
+		TextureResidencyPolicy _policy; ///< Slots allocation.
+		CameraMotionPredictor _predictor; ///< Viewpoint motion.
+		DecodedImageCache _cache; ///< Decoded images, at the slices resolution.
+		Texture2DArrayRGB::Ptr _slices; ///< Full resolution pool.
+		Texture2DArrayRGB::Ptr _tails; ///< Low resolution images.
+		std::vector<bool> _slotReady; ///< Has the image of the slot camera been uploaded.
+		std::vector<int> _readySlots; ///< Slot of each camera when uploaded, -1 otherwise.
+		std::vector<uint> _selected; ///< Last selection, sorted.
+		uint _maxUploadsPerFrame = 4;
+		uint _numPrefetch = 4;
+		float _lookahead = 8.0f;
+		bool _blockOnMiss = false;
+	};
+
+} // namespace sibr
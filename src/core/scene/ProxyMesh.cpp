@@ -32,6 +32,10 @@ namespace sibr {
 		if (!_proxy->hasNormals()) {
 			_proxy->generateNormals();
 		}
+		// Levels of detail generated by the simplifyMesh tool, if any.
+		if (loadLODs(removeExtension(data->meshPath())) > 0) {
+			SIBR_LOG << "Loaded " << _lods.size() << " levels of detail for the proxy." << std::endl;
+		}
 	}
 
 	void ProxyMesh::replaceProxy(Mesh::Ptr newProxy)
@@ -42,6 +46,7 @@ namespace sibr {
 		_proxy->colors(newProxy->colors());
 		_proxy->triangles(newProxy->triangles());
 		_proxy->texCoords(newProxy->texCoords());
+		_lods.clear();
 
 		// Used by inputImageRT init() and debug rendering
 		if (!_proxy->hasNormals())
@@ -54,6 +59,24 @@ namespace sibr {
 	void ProxyMesh::replaceProxyPtr(Mesh::Ptr newProxy)
 	{
 		_proxy = newProxy;
+		_lods.clear();
+	}
+
+	size_t ProxyMesh::loadLODs(const std::string & basePath)
+	{
+		_lods = MeshSimplifier::loadLODs(basePath);
+		for (MeshSimplifier::LOD & lod : _lods) {
+			if (!lod.mesh->hasNormals()) {
+				lod.mesh->generateNormals();
+			}
+		}
+		return _lods.size();
+	}
+
+	const Mesh & ProxyMesh::proxyLOD(const Camera & eye, float viewportHeight, float pixelError) const
+	{
+		const int level = MeshSimplifier::selectLOD(_lods, eye, viewportHeight, pixelError);
+		return level < 0 ? *_proxy : *_lods[level].mesh;
 	}
 
 
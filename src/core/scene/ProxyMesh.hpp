@@ -13,6 +13,7 @@
 #pragma once
 
 #include "core/scene/IProxyMesh.hpp"
+#include "core/graphics/MeshSimplifier.hpp"
 
 namespace sibr {
 	/**
@@ -31,10 +32,14 @@ namespace sibr {
 		bool												hasProxy(void) const;
 		const Mesh&											proxy(void) const;
 		const Mesh::Ptr										proxyPtr(void) const;
+		size_t												loadLODs(const std::string & basePath) override;
+		size_t												lodCount(void) const override;
+		const Mesh&											proxyLOD(const Camera & eye, float viewportHeight, float pixelError) const override;
 
 	protected:
 
 		Mesh::Ptr											_proxy;
+		std::vector<MeshSimplifier::LOD>					_lods; ///< Decimated versions of the proxy, from the finest to the coarsest.
 
 	};
 
@@ -53,4 +58,9 @@ namespace sibr {
 		return _proxy;
 	}
 
+	inline size_t											ProxyMesh::lodCount(void) const
+	{
+		return _lods.size();
+	}
+
 };
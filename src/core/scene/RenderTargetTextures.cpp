@@ -215,6 +215,28 @@ namespace sibr {
 		return _inputRGBArrayPtr;
 	}
 
+	void RGBInputTextureArray::initRGBTextureResidency(ICalibratedCameras::Ptr cams, IParseData::Ptr data, uint numSlots, int flags, bool force_aspect_ratio)
+	{
+		if (!isInit()) {
+			initSize(cams->inputCameras()[_initActiveCam]->w(), cams->inputCameras()[_initActiveCam]->h(), force_aspect_ratio);
+		}
+
+		// Inactive cameras have no path and keep a black tail.
+		std::vector<std::string> paths(data->imgInfos().size());
+		for (size_t i = 0; i < paths.size(); ++i) {
+			if (data->activeImages()[i]) {
+				paths[i] = data->imgPath() + "/" + data->imgInfos()[i].filename;
+			}
+		}
+		_inputRGBResidencyPtr.reset(new InputTextureResidency(cams->inputCameras(), InputTextureResidency::fileLoader(paths),
+			_width, _height, numSlots, 128, 0, uint(flags)));
+	}
+
+	const InputTextureResidency::Ptr & RGBInputTextureArray::getInputRGBResidencyPtr() const
+	{
+		return _inputRGBResidencyPtr;
+	}
+
 	void RenderTargetTextures::initializeDefaultRenderTargets(ICalibratedCameras::Ptr cams, IInputImages::Ptr imgs, IProxyMesh::Ptr proxies)
 	{
 		if (!isInit()) {
@@ -258,4 +280,13 @@ namespace sibr {
 		initRGBTextureArrays(imgs, textureFlags, force_aspect_ratio);
 		initDepthTextureArrays(cams, proxies, faceCull);
 	}
+
+	void RenderTargetTextures::initRGBResidencyAndDepthTextureArrays(ICalibratedCameras::Ptr cams, IParseData::Ptr data, IProxyMesh::Ptr proxies, uint numSlots, int textureFlags, bool faceCull, bool force_aspect_ratio)
+	{
+		if (!isInit()) {
+			initRenderTargetRes(cams);
+		}
+		initRGBTextureResidency(cams, data, numSlots, textureFlags, force_aspect_ratio);
+		initDepthTextureArrays(cams, proxies, faceCull);
+	}
 }
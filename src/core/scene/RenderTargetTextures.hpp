@@ -16,6 +16,8 @@
 #include "core/scene/ICalibratedCameras.hpp"
 #include "core/scene/IInputImages.hpp"
 #include "core/scene/IProxyMesh.hpp"
+#include "core/scene/IParseData.hpp"
+#include "core/scene/InputTextureResidency.hpp"
 #include "core/assets/Resources.hpp"
 # include "core/graphics/Shader.hpp"
 #include "core/graphics/Utils.hpp"
@@ -87,8 +89,21 @@ namespace sibr{
 		virtual void initRGBTextureArrays(IInputImages::Ptr imgs, int flags = 0, bool force_aspect_ratio=false);
 		const Texture2DArrayRGB::Ptr & getInputRGBTextureArrayPtr() const;
 
+		/** Keep only a fixed number of input images at full resolution on the GPU instead of all of them,
+		 * see InputTextureResidency. Images are decoded from disk when needed, they don't have to be loaded in the scene.
+		 * The residency must then be updated each frame with the selected cameras.
+		 * \param cams the input cameras
+		 * \param data the dataset, giving the images paths
+		 * \param numSlots the number of full resolution slices
+		 * \param flags texture options
+		 * \param force_aspect_ratio keep the aspect ratio of the images when computing the slices size
+		 */
+		virtual void initRGBTextureResidency(ICalibratedCameras::Ptr cams, IParseData::Ptr data, uint numSlots, int flags = 0, bool force_aspect_ratio = false);
+		const InputTextureResidency::Ptr & getInputRGBResidencyPtr() const;
+
 	protected:
 		Texture2DArrayRGB::Ptr _inputRGBArrayPtr;
+		InputTextureResidency::Ptr _inputRGBResidencyPtr;
 
 	};
 
@@ -111,6 +126,8 @@ namespace sibr{
 		virtual void initRGBandDepthTextureArrays(ICalibratedCameras::Ptr cams, IInputImages::Ptr imgs, IProxyMesh::Ptr proxies, int textureFlags, int texture_width, bool faceCull = true, bool force_aspect_ratio = false);
 		virtual void initRGBandDepthTextureArrays(ICalibratedCameras::Ptr cams, IInputImages::Ptr imgs, IProxyMesh::Ptr proxies, int textureFlags, bool faceCull = true, bool force_aspect_ratio=false);
 		virtual void initializeDefaultRenderTargets(ICalibratedCameras::Ptr cams, IInputImages::Ptr imgs, IProxyMesh::Ptr proxies);
+		/** Same as initRGBandDepthTextureArrays, but with the input images residency instead of the full RGB texture array, see initRGBTextureResidency. */
+		virtual void initRGBResidencyAndDepthTextureArrays(ICalibratedCameras::Ptr cams, IParseData::Ptr data, IProxyMesh::Ptr proxies, uint numSlots, int textureFlags, bool faceCull = true, bool force_aspect_ratio = false);
 
 	protected:
 		void initRenderTargetRes(ICalibratedCameras::Ptr cams);
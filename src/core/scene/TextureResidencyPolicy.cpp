@@ -0,0 +1,258 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#include "core/scene/TextureResidencyPolicy.hpp"
+#include "core/scene/InputCameraIndex.hpp"
+
+#include <random>
+
+namespace sibr
+{
+	void CameraMotionPredictor::update(const Vector3f & position, const Vector3f & direction)
+	{
+		if (_numPoses > 0) {
+			const Vector3f velocity = position - _position;
+			const Vector3f angularVelocity = direction - _direction;
+			// No history to smooth against for the first estimate.
+			const float s = _numPoses > 1 ? _smoothing : 0.0f;
+			_velocity = s * _velocity + (1.0f - s) * velocity;
+			_angularVelocity = s * _angularVelocity + (1.0f - s) * angularVelocity;
+		}
+		_position = position;
+		_direction = direction;
+		_numPoses = std::min(_numPoses + 1, 2);
+	}
+
+	bool CameraMotionPredictor::predict(float framesAhead, Vector3f & position, Vector3f & direction) const
+	{
+		if (_numPoses == 0) {
+			return false;
+		}
+		position = _position + framesAhead * _velocity;
+		direction = _direction + framesAhead * _angularVelocity;
+		const float norm = direction.norm();
+		direction = norm > 1e-6f ? Vector3f(direction / norm) : _direction;
+		return true;
+	}
+
+	void TextureResidencyPolicy::Stats::log(const std::string & label) const
+	{
+		SIBR_LOG << "[" << label << "] " << frames << " frames, hit rate " << 100.0 * hitRate() << "% (" << hits << "/" << requests
+			<< ", " << prefetchHits << " thanks to prefetch), " << loadsPerFrame() << " loads per frame, " << prefetches << " prefetches, "
+			<< evictions << " evictions, " << dropped << " dropped, " << inconsistencies << " inconsistent frames." << std::endl;
+	}
+
+	TextureResidencyPolicy::TextureResidencyPolicy(size_t numCameras, size_t numSlots)
+		: _cameraSlots(numCameras, -1), _slotCameras(numSlots, -1), _slotFrames(numSlots, 0), _slotPrefetched(numSlots, false), _lruPos(numSlots)
+	{
+		for (uint s = 0; s < uint(numSlots); ++s) {
+			_lruPos[s] = _lru.insert(_lru.end(), s);
+		}
+	}
+
+	TextureResidencyPolicy::Plan TextureResidencyPolicy::update(const std::vector<uint> & selected, const std::vector<uint> & prefetch)
+	{
+		Plan plan;
+		++_frame;
+		++_stats.frames;
+
+		// Touch all resident cameras first, so that loading the missing ones cannot evict them.
+		for (uint cam : selected) {
+			if (cam >= _cameraSlots.size()) {
+				continue;
+			}
+			++_stats.requests;
+			const int slot = _cameraSlots[cam];
+			if (slot >= 0) {
+				++_stats.hits;
+				if (_slotPrefetched[slot]) {
+					++_stats.prefetchHits;
+					_slotPrefetched[slot] = false;
+				}
+				touch(slot);
+			}
+		}
+
+		for (uint cam : selected) {
+			// Resident, or loaded for a previous occurrence.
+			if (cam >= _cameraSlots.size() || _cameraSlots[cam] >= 0) {
+				continue;
+			}
+			// Any camera not needed by this frame can be evicted.
+			const int slot = allocate(cam, 1, plan);
+			if (slot < 0) {
+				++_stats.dropped;
+				continue;
+			}
+			plan.loads.push_back({ cam, uint(slot), false });
+		}
+
+		for (uint cam : prefetch) {
+			if (cam >= _cameraSlots.size()) {
+				continue;
+			}
+			const int resident = _cameraSlots[cam];
+			if (resident >= 0) {
+				// Keep it around, it is expected soon.
+				touch(resident);
+				continue;
+			}
+			// Do not evict cameras used by the previous frame, they are likely to be needed again.
+			const int slot = allocate(cam, 2, plan);
+			if (slot < 0) {
+				break;
+			}
+			_slotPrefetched[slot] = true;
+			++_stats.prefetches;
+			plan.loads.push_back({ cam, uint(slot), true });
+		}
+		return plan;
+	}
+
+	bool TextureResidencyPolicy::isConsistent(const std::vector<uint> & selected) const
+	{
+		size_t numResident = 0;
+		for (size_t cam = 0; cam < _cameraSlots.size(); ++cam) {
+			const int slot = _cameraSlots[cam];
+			if (slot < 0) {
+				continue;
+			}
+			++numResident;
+			if (slot >= int(_slotCameras.size()) || _slotCameras[slot] != int(cam)) {
+				return false;
+			}
+		}
+		size_t numUsedSlots = 0;
+		for (int cam : _slotCameras) {
+			numUsedSlots += cam >= 0 ? 1 : 0;
+		}
+		if (numUsedSlots != numResident || _lru.size() != _slotCameras.size()) {
+			return false;
+		}
+		// Required cameras can only be missing if the pool is too small.
+		size_t numMissing = 0;
+		for (uint cam : selected) {
+			numMissing += (cam < _cameraSlots.size() && _cameraSlots[cam] < 0) ? 1 : 0;
+		}
+		return numMissing == 0 || selected.size() > _slotCameras.size();
+	}
+
+	void TextureResidencyPolicy::clear()
+	{
+		std::fill(_cameraSlots.begin(), _cameraSlots.end(), -1);
+		std::fill(_slotCameras.begin(), _slotCameras.end(), -1);
+		std::fill(_slotFrames.begin(), _slotFrames.end(), 0);
+		std::fill(_slotPrefetched.begin(), _slotPrefetched.end(), false);
+		_lru.clear();
+		for (uint s = 0; s < uint(_slotCameras.size()); ++s) {
+			_lruPos[s] = _lru.insert(_lru.end(), s);
+		}
+		_frame = 0;
+		_stats = Stats();
+	}
+
+	int TextureResidencyPolicy::allocate(uint camera, size_t minAge, Plan & plan)
+	{
+		if (_lru.empty()) {
+			return -1;
+		}
+		// Free slots are never touched, they stay at the back of the list.
+		const uint slot = _lru.back();
+		if (_slotCameras[slot] >= 0 && _frame - _slotFrames[slot] < minAge) {
+			return -1;
+		}
+		if (_slotCameras[slot] >= 0) {
+			const uint evicted = uint(_slotCameras[slot]);
+			_cameraSlots[evicted] = -1;
+			plan.evicted.push_back(evicted);
+			++_stats.evictions;
+		}
+		_slotCameras[slot] = int(camera);
+		_cameraSlots[camera] = int(slot);
+		_slotPrefetched[slot] = false;
+		touch(slot);
+		return int(slot);
+	}
+
+	void TextureResidencyPolicy::touch(uint slot)
+	{
+		_slotFrames[slot] = _frame;
+		_lru.splice(_lru.begin(), _lru, _lruPos[slot]);
+	}
+
+	TextureResidencyPolicy::Stats TextureResidencyPolicy::simulate(const std::vector<Vector3f> & positions, const std::vector<Vector3f> & directions,
+		const std::vector<Vector3f> & pathPositions, const std::vector<Vector3f> & pathDirections,
+		size_t numSlots, size_t count, size_t numPrefetch, float lookahead)
+	{
+		const InputCameraIndex index(positions, directions);
+		TextureResidencyPolicy policy(positions.size(), numSlots);
+		CameraMotionPredictor predictor;
+
+		const size_t numDist = count / 2;
+		const size_t numAngle = count - numDist;
+		std::vector<uint> selected, predicted, prefetch;
+		for (size_t f = 0; f < std::min(pathPositions.size(), pathDirections.size()); ++f) {
+			index.selectULR(pathPositions[f], pathDirections[f], numDist, numAngle, selected);
+			predictor.update(pathPositions[f], pathDirections[f]);
+
+			prefetch.clear();
+			Vector3f predictedPos, predictedDir;
+			if (numPrefetch > 0 && predictor.predict(lookahead, predictedPos, predictedDir)) {
+				index.selectULR(predictedPos, predictedDir, numDist, numAngle, predicted);
+				for (uint cam : predicted) {
+					if (prefetch.size() < numPrefetch && std::find(selected.begin(), selected.end(), cam) == selected.end()) {
+						prefetch.push_back(cam);
+					}
+				}
+			}
+
+			policy.update(selected, prefetch);
+			if (!policy.isConsistent(selected)) {
+				++policy._stats.inconsistencies;
+			}
+		}
+		return policy.stats();
+	}
+
+	bool TextureResidencyPolicy::benchmark(size_t numCameras, size_t numFrames, size_t numSlots, size_t count)
+	{
+		std::mt19937 rng(42);
+		std::uniform_real_distribution<float> jitter(-1.0f, 1.0f);
+
+		// Dense capture ring, all cameras looking roughly at the center.
+		std::vector<Vector3f> positions(numCameras), directions(numCameras);
+		for (size_t i = 0; i < numCameras; ++i) {
+			const float a = 2.0f * float(M_PI) * float(i) / float(std::max<size_t>(1, numCameras));
+			positions[i] = Vector3f((10.0f + jitter(rng)) * std::cos(a), jitter(rng), (10.0f + jitter(rng)) * std::sin(a));
+			directions[i] = (Vector3f(jitter(rng), jitter(rng), jitter(rng)) - positions[i]).normalized();
+		}
+
+		// Orbit inside the ring with a varying speed, as an interactive session would.
+		std::vector<Vector3f> pathPositions(numFrames), pathDirections(numFrames);
+		for (size_t f = 0; f < numFrames; ++f) {
+			const float t = float(f) / float(std::max<size_t>(1, numFrames));
+			const float a = 3.0f * float(M_PI) * t + 0.3f * std::sin(12.0f * float(M_PI) * t);
+			pathPositions[f] = Vector3f(7.0f * std::cos(a), 0.5f * std::sin(5.0f * a), 7.0f * std::sin(a));
+			pathDirections[f] = (-pathPositions[f]).normalized();
+		}
+
+		const Stats noPrefetch = simulate(positions, directions, pathPositions, pathDirections, numSlots, count, 0);
+		const Stats withPrefetch = simulate(positions, directions, pathPositions, pathDirections, numSlots, count, count / 2);
+		SIBR_LOG << "[TextureResidencyPolicy] " << numCameras << " cameras, " << numSlots << " slots, " << count << " cameras per frame." << std::endl;
+		noPrefetch.log("TextureResidencyPolicy, no prefetch");
+		withPrefetch.log("TextureResidencyPolicy, prefetch");
+
+		return noPrefetch.inconsistencies == 0 && withPrefetch.inconsistencies == 0
+			&& (numSlots < count || (noPrefetch.dropped == 0 && withPrefetch.dropped == 0));
+	}
+
+} // namespace sibr
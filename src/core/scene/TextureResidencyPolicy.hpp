@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+#include "core/scene/Config.hpp"
+#include "core/system/Vector.hpp"
+
+#include <list>
+
+namespace sibr
+{
+	/** \brief Extrapolate the viewpoint motion to anticipate which input cameras will be needed.
+	* Velocities are smoothed exponentially to be robust to jittery interactive navigation.
+	* \ingroup sibr_scene
+	*/
+	class SIBR_SCENE_EXPORT CameraMotionPredictor
+	{
+	public:
+
+		/** Constructor.
+		\param smoothing weight of the previous velocity estimate, in [0,1)
+		*/
+		explicit CameraMotionPredictor(float smoothing = 0.5f) : _smoothing(smoothing) {}
+
+		/** Register the pose of the current frame.
+		\param position the viewpoint position
+		\param direction the viewpoint normalized direction
+		*/
+		void update(const Vector3f & position, const Vector3f & direction);
+
+		/** Predict a future pose.
+		\param framesAhead number of frames to extrapolate
+		\param position will contain the predicted position
+		\param direction will contain the predicted normalized direction
+		\return false if no pose has been registered yet
+		*/
+		bool predict(float framesAhead, Vector3f & position, Vector3f & direction) const;
+
+		/** Forget the motion history, for instance after a teleport. */
+		void reset() { _numPoses = 0; }
+
+	private:
+		float _smoothing; ///< Velocity smoothing factor.
+		int _numPoses = 0; ///< Number of registered poses, saturated at 2.
+		Vector3f _position = Vector3f(0.0f, 0.0f, 0.0f); ///< Last position.
+		Vector3f _direction = Vector3f(0.0f, 0.0f, -1.0f); ///< Last direction.
+		Vector3f _velocity = Vector3f(0.0f, 0.0f, 0.0f); ///< Smoothed position velocity, per frame.
+		Vector3f _angularVelocity = Vector3f(0.0f, 0.0f, 0.0f); ///< Smoothed direction velocity, per frame.
+	};
+
+	/** \brief CPU policy deciding which input images are resident in a fixed pool of GPU texture slots.
+	* Each frame, the cameras selected for rendering are made resident first, then the prefetch candidates
+	* fill the slots that are not needed by the current frame. Victims are picked in least recently used order.
+	* No GPU resource is involved, so the policy can be evaluated on simulated camera paths.
+	* \ingroup sibr_scene
+	*/
+	class SIBR_SCENE_EXPORT TextureResidencyPolicy
+	{
+		SIBR_CLASS_PTR(TextureResidencyPolicy);
+
+	public:
+
+		/** A camera image to upload in a slot. */
+		struct Load {
+			uint camera; ///< Camera index.
+			uint slot; ///< Destination slot.
+			bool prefetch; ///< Was it loaded ahead of time.
+		};
+
+		/** Changes to apply to the slots pool for a frame. */
+		struct Plan {
+			std::vector<Load> loads; ///< Images to upload, required ones first.
+			std::vector<uint> evicted; ///< Cameras that lost their slot.
+		};
+
+		/** Residency statistics, accumulated over frames. */
+		struct Stats {
+			size_t frames = 0; ///< Number of updates.
+			size_t requests = 0; ///< Number of required cameras over all frames.
+			size_t hits = 0; ///< Required cameras that were already resident.
+			size_t prefetchHits = 0; ///< Hits on cameras brought in by prefetch.
+			size_t prefetches = 0; ///< Prefetch loads.
+			size_t evictions = 0; ///< Evicted cameras.
+			size_t dropped = 0; ///< Required cameras that could not fit in the pool.
+			size_t inconsistencies = 0; ///< Frames where the slots mapping was invalid, should stay at zero.
+
+			/** \return the fraction of required cameras already resident. */
+			double hitRate() const { return requests > 0 ? double(hits) / double(requests) : 1.0; }
+
+			/** \return the average number of loads per frame. */
+			double loadsPerFrame() const { return frames > 0 ? double(requests - hits + prefetches) / double(frames) : 0.0; }
+
+			/** Log the statistics.
+			\param label a name for the run
+			*/
+			void log(const std::string & label) const;
+		};
+
+		/** Constructor.
+		\param numCameras the number of input cameras
+		\param numSlots the number of slots in the pool
+		*/
+		TextureResidencyPolicy(size_t numCameras, size_t numSlots);
+
+		/** Make the cameras of the current frame resident and prefetch others if possible.
+		\param selected the cameras needed for the current frame, by decreasing priority
+		\param prefetch the cameras likely to be needed soon, by decreasing priority
+		\return the loads and evictions to apply
+		*/
+		Plan update(const std::vector<uint> & selected, const std::vector<uint> & prefetch = {});
+
+		/** \return the slot of a camera, or -1 if it is not resident.
+		\param camera the camera index
+		*/
+		int slot(uint camera) const { return _cameraSlots[camera]; }
+
+		/** \return the camera stored in a slot, or -1 if the slot is free.
+		\param slot the slot index
+		*/
+		int camera(uint slot) const { return _slotCameras[slot]; }
+
+		/** \return the slot of each camera, -1 if not resident. */
+		const std::vector<int> & cameraSlots() const { return _cameraSlots; }
+
+		/** \return the number of slots. */
+		size_t numSlots() const { return _slotCameras.size(); }
+
+		/** \return the accumulated statistics. */
+		const Stats & stats() const { return _stats; }
+
+		/** Check that the cameras and slots mappings agree and that the required cameras are resident.
+		\param selected the cameras required by the last update
+		\return true if the state is valid
+		*/
+		bool isConsistent(const std::vector<uint> & selected) const;
+
+		/** Evict all cameras and reset the statistics. */
+		void clear();
+
+		/** Replay a camera path and evaluate the policy, selecting cameras with the ULR criterion as the views do.
+		\param positions input cameras positions
+		\param directions input cameras normalized viewing directions
+		\param pathPositions viewpoint positions along the path
+		\param pathDirections viewpoint normalized directions along the path
+		\param numSlots number of slots in the pool
+		\param count number of cameras selected per frame
+		\param numPrefetch maximal number of cameras prefetched per frame, 0 to disable prefetching
+		\param lookahead number of frames of motion extrapolation used to prefetch
+		\return the statistics of the run
+		*/
+		static Stats simulate(const std::vector<Vector3f> & positions, const std::vector<Vector3f> & directions,
+			const std::vector<Vector3f> & pathPositions, const std::vector<Vector3f> & pathDirections,
+			size_t numSlots, size_t count, size_t numPrefetch, float lookahead = 8.0f);
+
+		/** Simulate an orbit around synthetic cameras with and without prefetching, log and check the results.
+		\param numCameras number of input cameras, on a ring looking at the center
+		\param numFrames number of frames of the orbit
+		\param numSlots number of slots in the pool
+		\param count number of cameras selected per frame
+		\return true if all the invariants of the policy held
+		*/
+		static bool benchmark(size_t numCameras = 2000, size_t numFrames = 2000, size_t numSlots = 48, size_t count = 12);
+
+	private:
+
+		/** Find a slot for a camera, evicting the least recently used one if needed.
+		\param camera the camera index
+		\param minAge minimal number of frames since the last use of an evicted camera
+		\param plan will receive the eviction
+		\return the slot, or -1 if no slot is old enough
+		*/
+		int allocate(uint camera, size_t minAge, Plan & plan);
+
+		/** Mark a slot as used in the current frame.
+		\param slot the slot index
+		*/
+		void touch(uint slot);
+
+		std::vector<int> _cameraSlots; ///< Slot of each camera, -1 if not resident.
+		std::vector<int> _slotCameras; ///< Camera in each slot, -1 if free.
+		std::vector<size_t> _slotFrames; ///< Last frame each slot was used.
+		std::vector<bool> _slotPrefetched; ///< Slot loaded by prefetch and not used yet.
+		std::list<uint> _lru; ///< Slots, most recently used first.
+		std::vector<std::list<uint>::iterator> _lruPos; ///< Position of each slot in the list.
+		size_t _frame = 0; ///< Current frame.
+		Stats _stats; ///< Accumulated statistics.
+	};
+
+} // namespace sibr
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+# include <condition_variable>
+# include <deque>
+# include <mutex>
+
+# include "core/system/Config.hpp"
+
+namespace sibr
+{
+	/** Thread-safe FIFO queue with a maximal capacity, used to connect producer and consumer threads.
+	 Producers block when the queue is full, consumers block when it is empty.
+	 Once closed, pushing fails and consumers drain the remaining elements before pop returns false.
+	 \ingroup sibr_system
+	*/
+	template<typename T>
+	class BoundedQueue
+	{
+	public:
+
+		/** Constructor.
+		\param capacity maximal number of elements stored at the same time
+		*/
+		explicit BoundedQueue(size_t capacity = 16) : _capacity(capacity > 0 ? capacity : 1) {}
+
+		/** Push an element, blocking while the queue is full.
+		\param value the element to push
+		\return false if the queue has been closed
+		*/
+		bool push(T && value) {
+			std::unique_lock<std::mutex> lock(_mutex);
+			_notFull.wait(lock, [this] { return _closed || _items.size() < _capacity; });
+			if (_closed) {
+				return false;
+			}
+			_items.push_back(std::move(value));
+			lock.unlock();
+			_notEmpty.notify_one();
+			return true;
+		}
+
+		/** Pop an element, blocking while the queue is empty and not closed.
+		\param value will contain the popped element
+		\return false if the queue is closed and empty
+		*/
+		bool pop(T & value) {
+			std::unique_lock<std::mutex> lock(_mutex);
+			_notEmpty.wait(lock, [this] { return _closed || !_items.empty(); });
+			if (_items.empty()) {
+				return false;
+			}
+			value = std::move(_items.front());
+			_items.pop_front();
+			lock.unlock();
+			_notFull.notify_one();
+			return true;
+		}
+
+		/** Close the queue: wake up all waiting threads, no element can be pushed anymore. */
+		void close() {
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_closed = true;
+			}
+			_notEmpty.notify_all();
+			_notFull.notify_all();
+		}
+
+		/** \return the number of elements currently stored. */
+		size_t size() const {
+			std::lock_guard<std::mutex> lock(_mutex);
+			return _items.size();
+		}
+
+	private:
+		std::deque<T> _items; ///< Stored elements.
+		size_t _capacity; ///< Maximal number of elements.
+		bool _closed = false; ///< Has the queue been closed.
+		mutable std::mutex _mutex; ///< Protect the elements.
+		std::condition_variable _notEmpty; ///< Signaled when an element is pushed.
+		std::condition_variable _notFull; ///< Signaled when an element is popped.
+	};
+
+} // namespace sibr
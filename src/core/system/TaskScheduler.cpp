@@ -0,0 +1,504 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#include "core/system/TaskScheduler.hpp"
+#include "core/system/SimpleTimer.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace sibr
+{
+	namespace
+	{
+		thread_local TaskScheduler * t_scheduler = nullptr; ///< Scheduler owning the current worker thread.
+		thread_local uint t_workerId = 0; ///< Index of the current worker thread.
+		thread_local TaskScheduler::Priority t_priority = TaskScheduler::Priority::Normal; ///< Priority of the current thread.
+
+		/** Some floating point work for the benchmarks. */
+		float benchmarkWork(int i, int iterations)
+		{
+			float value = float(i);
+			for (int it = 0; it < iterations; ++it) {
+				value = std::sqrt(value * value + 1.0f) * 0.5f;
+			}
+			return value;
+		}
+	}
+
+	TaskScheduler::ScopedPriority::ScopedPriority(Priority priority) : _previous(t_priority)
+	{
+		t_priority = priority;
+	}
+
+	TaskScheduler::ScopedPriority::~ScopedPriority()
+	{
+		t_priority = _previous;
+	}
+
+	TaskScheduler & TaskScheduler::get()
+	{
+		// Never destroyed: the workers may already be terminated when static objects are destroyed at exit.
+		static TaskScheduler * scheduler = new TaskScheduler();
+		return *scheduler;
+	}
+
+	TaskScheduler::TaskScheduler(uint threadCount) : _queued(0), _sleeping(0), _nextVictim(0)
+	{
+		if (threadCount == 0) {
+			// hardware_concurrency can return 0 when unknown.
+			threadCount = std::max(2u, std::thread::hardware_concurrency()) - 1u;
+		}
+		for (uint id = 0; id < threadCount; ++id) {
+			_queues.emplace_back(new WorkQueue());
+		}
+		for (uint id = 0; id < threadCount; ++id) {
+			_workers.emplace_back(&TaskScheduler::workerLoop, this, id);
+		}
+	}
+
+	TaskScheduler::~TaskScheduler()
+	{
+		{
+			std::lock_guard<std::mutex> lock(_sleepMutex);
+			_stop = true;
+		}
+		_wakeUp.notify_all();
+		for (std::thread & worker : _workers) {
+			worker.join();
+		}
+	}
+
+	void TaskScheduler::submit(Task task)
+	{
+		submit(std::move(task), t_priority);
+	}
+
+	void TaskScheduler::submit(Task task, Priority priority)
+	{
+		WorkQueue & queue = t_scheduler == this ? *_queues[t_workerId] : _shared;
+		{
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			queue.tasks[int(priority)].push_back({ std::move(task), priority });
+		}
+		_queued.fetch_add(1);
+		// A worker going to sleep increments _sleeping before checking _queued, so one of the two sees the other.
+		if (_sleeping.load() > 0) {
+			{
+				std::lock_guard<std::mutex> lock(_sleepMutex);
+			}
+			_wakeUp.notify_one();
+		}
+	}
+
+	bool TaskScheduler::pop(Entry & entry, Priority minimum)
+	{
+		const bool isWorker = t_scheduler == this;
+		const uint workerCount = uint(_queues.size());
+		const uint firstVictim = isWorker ? t_workerId + 1 : _nextVictim.fetch_add(1);
+		for (int p = 0; p <= int(minimum); ++p) {
+			// Newest task of our own deque, for locality.
+			if (isWorker) {
+				WorkQueue & own = *_queues[t_workerId];
+				std::lock_guard<std::mutex> lock(own.mutex);
+				if (!own.tasks[p].empty()) {
+					entry = std::move(own.tasks[p].back());
+					own.tasks[p].pop_back();
+					_queued.fetch_sub(1);
+					return true;
+				}
+			}
+			{
+				std::lock_guard<std::mutex> lock(_shared.mutex);
+				if (!_shared.tasks[p].empty()) {
+					entry = std::move(_shared.tasks[p].front());
+					_shared.tasks[p].pop_front();
+					_queued.fetch_sub(1);
+					return true;
+				}
+			}
+			// Oldest task of another deque, usually the largest part of the work left.
+			for (uint v = 0; v < workerCount; ++v) {
+				const uint victim = (firstVictim + v) % workerCount;
+				if (isWorker && victim == t_workerId) {
+					continue;
+				}
+				WorkQueue & other = *_queues[victim];
+				std::lock_guard<std::mutex> lock(other.mutex);
+				if (!other.tasks[p].empty()) {
+					entry = std::move(other.tasks[p].front());
+					other.tasks[p].pop_front();
+					_queued.fetch_sub(1);
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	bool TaskScheduler::runOne(Priority minimum)
+	{
+		Entry entry;
+		if (!pop(entry, minimum)) {
+			return false;
+		}
+		// Tasks submitted by the task inherit its priority.
+		const Priority previous = t_priority;
+		t_priority = entry.priority;
+		try {
+			entry.task();
+		}
+		catch (const std::exception & e) {
+			SIBR_WRG << "[TaskScheduler] Exception raised by a task: " << e.what() << std::endl;
+		}
+		catch (...) {
+			SIBR_WRG << "[TaskScheduler] Exception raised by a task." << std::endl;
+		}
+		t_priority = previous;
+		return true;
+	}
+
+	void TaskScheduler::workerLoop(uint id)
+	{
+		t_scheduler = this;
+		t_workerId = id;
+		while (true) {
+			if (runOne(Priority::Low)) {
+				continue;
+			}
+			std::unique_lock<std::mutex> lock(_sleepMutex);
+			_sleeping.fetch_add(1);
+			_wakeUp.wait(lock, [this]() { return _stop || _queued.load() > 0; });
+			_sleeping.fetch_sub(1);
+			if (_stop && _queued.load() == 0) {
+				return;
+			}
+		}
+	}
+
+	void TaskScheduler::waitUntil(const std::function<bool()> & done)
+	{
+		const Priority minimum = t_priority;
+		int idle = 0;
+		while (!done()) {
+			// Lower priority tasks are only run when nothing more urgent is queued: the awaited task may be one of them,
+			// and the workers may all be waiting too.
+			if (runOne(minimum) || (minimum != Priority::Low && runOne(Priority::Low))) {
+				idle = 0;
+			}
+			else if (++idle < 64) {
+				std::this_thread::yield();
+			}
+			else {
+				std::this_thread::sleep_for(std::chrono::microseconds(50));
+			}
+		}
+	}
+
+	void TaskScheduler::parallelForChunks(int begin, int end, int grain, const std::function<void(int, int)> & body)
+	{
+		if (end <= begin) {
+			return;
+		}
+		const int count = end - begin;
+		const int threads = int(threadCount()) + 1;
+		if (grain <= 0) {
+			grain = std::max(1, count / (4 * threads));
+		}
+		const int chunkCount = int((int64_t(count) + grain - 1) / grain);
+		if (chunkCount == 1) {
+			body(begin, end);
+			return;
+		}
+
+		std::atomic<int> nextChunk(0);
+		const auto work = [&]() {
+			int chunk;
+			while ((chunk = nextChunk.fetch_add(1)) < chunkCount) {
+				const int chunkBegin = begin + int(std::min(int64_t(chunk) * grain, int64_t(count)));
+				const int chunkEnd = begin + int(std::min(int64_t(chunk + 1) * grain, int64_t(count)));
+				body(chunkBegin, chunkEnd);
+			}
+		};
+		// Helpers that start late find no chunk left and return immediately.
+		TaskGroup group(*this);
+		const int helpers = std::min(threads, chunkCount) - 1;
+		for (int h = 0; h < helpers; ++h) {
+			group.run(work);
+		}
+		work();
+		group.wait();
+	}
+
+	TaskScheduler::Priority TaskScheduler::currentPriority()
+	{
+		return t_priority;
+	}
+
+	TaskGroup::TaskGroup(TaskScheduler & scheduler) : _scheduler(scheduler), _pending(0)
+	{
+	}
+
+	TaskGroup::~TaskGroup()
+	{
+		// Tasks reference the group, exceptions are dropped as destructors cannot throw.
+		_scheduler.waitUntil([this]() { return _pending.load() == 0; });
+	}
+
+	void TaskGroup::run(TaskScheduler::Task task)
+	{
+		_pending.fetch_add(1);
+		_scheduler.submit([this, task]() {
+			try {
+				task();
+			}
+			catch (...) {
+				std::lock_guard<std::mutex> lock(_exceptionMutex);
+				if (!_exception) {
+					_exception = std::current_exception();
+				}
+			}
+			// Last access to the group, which can be destroyed as soon as the counter reaches zero.
+			_pending.fetch_sub(1);
+		});
+	}
+
+	void TaskGroup::wait()
+	{
+		_scheduler.waitUntil([this]() { return _pending.load() == 0; });
+		std::exception_ptr exception;
+		{
+			std::lock_guard<std::mutex> lock(_exceptionMutex);
+			std::swap(exception, _exception);
+		}
+		if (exception) {
+			std::rethrow_exception(exception);
+		}
+	}
+
+	TaskGraph::NodeId TaskGraph::add(TaskScheduler::Task task)
+	{
+		_nodes.emplace_back();
+		_nodes.back().task = std::move(task);
+		return _nodes.size() - 1;
+	}
+
+	void TaskGraph::precede(NodeId before, NodeId after)
+	{
+		SIBR_ASSERT(before < _nodes.size() && after < _nodes.size());
+		_nodes[before].successors.push_back(after);
+		++_nodes[after].predecessors;
+	}
+
+	void TaskGraph::run(TaskScheduler & scheduler)
+	{
+		const size_t nodeCount = _nodes.size();
+		// Check that all tasks can be reached before starting any of them.
+		std::vector<int> remaining(nodeCount);
+		std::vector<NodeId> roots;
+		std::vector<NodeId> stack;
+		for (NodeId id = 0; id < nodeCount; ++id) {
+			remaining[id] = _nodes[id].predecessors;
+			if (remaining[id] == 0) {
+				roots.push_back(id);
+			}
+		}
+		stack = roots;
+		size_t reached = 0;
+		while (!stack.empty()) {
+			const NodeId id = stack.back();
+			stack.pop_back();
+			++reached;
+			for (const NodeId next : _nodes[id].successors) {
+				if (--remaining[next] == 0) {
+					stack.push_back(next);
+				}
+			}
+		}
+		if (reached != nodeCount) {
+			SIBR_ERR << "[TaskGraph] The task graph has a cycle." << std::endl;
+		}
+
+		std::unique_ptr<std::atomic<int>[]> counters(new std::atomic<int>[nodeCount]);
+		for (NodeId id = 0; id < nodeCount; ++id) {
+			counters[id].store(_nodes[id].predecessors);
+		}
+		TaskGroup group(scheduler);
+		std::function<void(NodeId)> launch = [&](NodeId id) {
+			group.run([&, id]() {
+				if (_nodes[id].task) {
+					_nodes[id].task();
+				}
+				for (const NodeId next : _nodes[id].successors) {
+					if (counters[next].fetch_sub(1) == 1) {
+						launch(next);
+					}
+				}
+			});
+		};
+		for (const NodeId id : roots) {
+			launch(id);
+		}
+		group.wait();
+	}
+
+	void TaskScheduler::benchmark(uint taskCount)
+	{
+		TaskScheduler & scheduler = get();
+		Timer timer;
+		const auto elapsedMs = [&timer]() { return timer.deltaTimeFromLastTic<Timer::micro>() * 1e-3; };
+		SIBR_LOG << "[TaskScheduler] Benchmark with " << scheduler.threadCount() << " workers." << std::endl;
+
+		// Submission and completion overhead.
+		std::atomic<int> counter(0);
+		timer.tic();
+		{
+			TaskGroup group(scheduler);
+			for (uint t = 0; t < taskCount; ++t) {
+				group.run([&counter]() { counter.fetch_add(1, std::memory_order_relaxed); });
+			}
+			group.wait();
+		}
+		double time = elapsedMs();
+		SIBR_LOG << "[TaskScheduler] Empty tasks from one thread: " << 1e6 * time / taskCount << "ns per task." << std::endl;
+
+		// Recursive splitting, the workers steal subtrees from each other.
+		std::function<void(uint)> split = [&](uint count) {
+			if (count <= 1) {
+				counter.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+			TaskGroup group(scheduler);
+			group.run([&split, count]() { split(count / 2); });
+			split(count - count / 2);
+			group.wait();
+		};
+		timer.tic();
+		split(taskCount);
+		time = elapsedMs();
+		SIBR_LOG << "[TaskScheduler] Recursive tasks: " << 1e6 * time / taskCount << "ns per task." << std::endl;
+
+		// Flat loops, for several grain sizes.
+		const int loopSize = 1 << 22;
+		const int iterations = 16;
+		std::vector<float> values(loopSize);
+		timer.tic();
+		for (int i = 0; i < loopSize; ++i) {
+			values[i] = benchmarkWork(i, iterations);
+		}
+		const double serialTime = elapsedMs();
+		SIBR_LOG << "[TaskScheduler] Serial loop: " << serialTime << "ms." << std::endl;
+		for (const int grain : { 0, 16, 1024, 65536 }) {
+			timer.tic();
+			parallelFor(0, loopSize, [&values, iterations](int i) { values[i] = benchmarkWork(i, iterations); }, grain, scheduler);
+			time = elapsedMs();
+			SIBR_LOG << "[TaskScheduler] parallelFor, grain " << grain << ": " << time << "ms (x" << serialTime / time << ")." << std::endl;
+		}
+#ifdef _OPENMP
+		timer.tic();
+#pragma omp parallel for
+		for (int i = 0; i < loopSize; ++i) {
+			values[i] = benchmarkWork(i, iterations);
+		}
+		time = elapsedMs();
+		SIBR_LOG << "[TaskScheduler] OpenMP loop: " << time << "ms (x" << serialTime / time << ")." << std::endl;
+#endif
+
+		// Nested loops with an unbalanced inner loop.
+		const int outerSize = 64;
+		const int innerSize = loopSize / outerSize;
+		timer.tic();
+		parallelFor(0, outerSize, [&](int o) {
+			const int innerCount = innerSize * (o % 4 + 1) / 4;
+			parallelFor(0, innerCount, [&values, o, innerSize, iterations](int i) {
+				values[o * innerSize + i] = benchmarkWork(i, iterations);
+			}, 256, scheduler);
+		}, 1, scheduler);
+		time = elapsedMs();
+		SIBR_LOG << "[TaskScheduler] Nested parallelFor: " << time << "ms." << std::endl;
+#ifdef _OPENMP
+		timer.tic();
+#pragma omp parallel for
+		for (int o = 0; o < outerSize; ++o) {
+			const int innerCount = innerSize * (o % 4 + 1) / 4;
+#pragma omp parallel for
+			for (int i = 0; i < innerCount; ++i) {
+				values[o * innerSize + i] = benchmarkWork(i, iterations);
+			}
+		}
+		time = elapsedMs();
+		SIBR_LOG << "[TaskScheduler] Nested OpenMP loops: " << time << "ms." << std::endl;
+#endif
+
+		// Layers of tasks, each depending on two tasks of the previous layer.
+		const int width = 16;
+		const int depth = std::max(1, int(taskCount) / (16 * width));
+		TaskGraph graph;
+		for (int d = 0; d < depth; ++d) {
+			for (int w = 0; w < width; ++w) {
+				const TaskGraph::NodeId id = graph.add([&values, d, w, width, iterations]() {
+					values[d * width + w] = benchmarkWork(d + w, 64 * iterations);
+				});
+				if (d > 0) {
+					graph.precede(id - width, id);
+					graph.precede(id - width + (w + 1) % width - w, id);
+				}
+			}
+		}
+		timer.tic();
+		graph.run(scheduler);
+		time = elapsedMs();
+		SIBR_LOG << "[TaskScheduler] Task graph of " << graph.size() << " tasks: " << 1e3 * time / double(graph.size()) << "us per task." << std::endl;
+
+		// Futures.
+		const uint futureCount = std::max(1u, taskCount / 10);
+		std::vector<TaskFuture<float>> futures(futureCount);
+		timer.tic();
+		for (uint f = 0; f < futureCount; ++f) {
+			futures[f] = async([f, iterations]() { return benchmarkWork(int(f), iterations); }, scheduler);
+		}
+		float sum = 0.0f;
+		for (TaskFuture<float> & future : futures) {
+			sum += future.get();
+		}
+		time = elapsedMs();
+		SIBR_LOG << "[TaskScheduler] Futures: " << 1e6 * time / futureCount << "ns per future (" << sum << ")." << std::endl;
+
+		// Interactive loop while the workers are busy with background tasks.
+		{
+			const uint backgroundCount = 8 * (scheduler.threadCount() + 1);
+			std::vector<float> backgroundValues(backgroundCount);
+			TaskGroup background(scheduler);
+			{
+				ScopedPriority priority(Priority::Low);
+				for (uint t = 0; t < backgroundCount; ++t) {
+					background.run([&backgroundValues, t, iterations]() {
+						float value = 0.0f;
+						for (int i = 0; i < (1 << 16); ++i) {
+							value += benchmarkWork(i, iterations);
+						}
+						backgroundValues[t] = value;
+					});
+				}
+			}
+			{
+				ScopedPriority priority(Priority::High);
+				timer.tic();
+				parallelFor(0, innerSize, [&values, iterations](int i) { values[i] = benchmarkWork(i, iterations); }, 1024, scheduler);
+				time = elapsedMs();
+			}
+			SIBR_LOG << "[TaskScheduler] High priority loop under background load: " << time << "ms." << std::endl;
+			background.wait();
+		}
+	}
+
+} // namespace sibr
@@ -0,0 +1,346 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+# include <atomic>
+# include <condition_variable>
+# include <deque>
+# include <exception>
+# include <functional>
+# include <future>
+# include <memory>
+# include <mutex>
+# include <thread>
+# include <vector>
+
+# include "core/system/Config.hpp"
+
+namespace sibr
+{
+	/** \brief Pool of worker threads with one task deque per worker, shared by the whole application.
+	* Tasks submitted from a worker go to its own deque and are popped in LIFO order, idle workers steal the oldest tasks of the
+	* other deques. Tasks submitted from other threads go to a shared queue. Threads waiting for tasks (TaskGroup::wait,
+	* TaskFuture::get, parallelFor) execute pending tasks meanwhile, so nested parallel sections neither deadlock nor oversubscribe.
+	* Each task has a priority inherited from the thread that submitted it (see ScopedPriority): higher priority tasks are always
+	* picked first, so that interactive work is not delayed by background loading.
+	*
+	* Code Example:
+	\code
+	// Process all items, by chunks of at least 16 items.
+	sibr::parallelFor(0, int(items.size()), [&](int i) { process(items[i]); }, 16);
+
+	// Decode in the background, without delaying the UI tasks.
+	sibr::TaskFuture<ImageRGB::Ptr> image;
+	{
+		TaskScheduler::ScopedPriority priority(TaskScheduler::Priority::Low);
+		image = sibr::async([&]() { return decode(path); });
+	}
+	\endcode
+	* \ingroup sibr_system
+	*/
+	class SIBR_SYSTEM_EXPORT TaskScheduler
+	{
+	public:
+
+		typedef std::function<void()> Task;
+
+		/** Task priorities, from the most to the least urgent. */
+		enum class Priority : int {
+			High = 0, ///< Interactive work, such as the tasks of the rendering loop.
+			Normal = 1, ///< Default priority.
+			Low = 2 ///< Background work, such as prefetching or preprocessing.
+		};
+
+		/** Set the priority of the tasks submitted by the current thread for the lifetime of the object. */
+		class SIBR_SYSTEM_EXPORT ScopedPriority
+		{
+		public:
+			/** Constructor.
+			\param priority the priority of the tasks submitted in the scope
+			*/
+			explicit ScopedPriority(Priority priority);
+
+			/** Destructor, restores the previous priority. */
+			~ScopedPriority();
+
+			/// Deleted copy constructor.
+			ScopedPriority(const ScopedPriority&) = delete;
+
+			/// Deleted copy operator.
+			ScopedPriority& operator=(const ScopedPriority&) = delete;
+
+		private:
+			Priority _previous; ///< Priority to restore.
+		};
+
+		/** \return the scheduler shared by the application, using all the hardware threads */
+		static TaskScheduler & get();
+
+		/** Constructor, starts the workers.
+		\param threadCount the number of worker threads, 0 to use one less than the hardware threads as the waiting threads help too
+		*/
+		explicit TaskScheduler(uint threadCount = 0);
+
+		/** Destructor, executes the remaining tasks and stops the workers. */
+		~TaskScheduler();
+
+		/// Deleted copy constructor.
+		TaskScheduler(const TaskScheduler&) = delete;
+
+		/// Deleted copy operator.
+		TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+		/** \return the number of worker threads */
+		uint threadCount() const { return uint(_workers.size()); }
+
+		/** Submit a task, with the priority of the current thread. Exceptions escaping the task are logged.
+		\param task the task
+		*/
+		void submit(Task task);
+
+		/** Submit a task with a given priority. Exceptions escaping the task are logged.
+		\param task the task
+		\param priority the task priority
+		*/
+		void submit(Task task, Priority priority);
+
+		/** Execute pending tasks until a condition is met. Tasks with a lower priority than the current thread are only executed
+		when no task of its priority or higher is queued.
+		\param done the condition, tested between tasks
+		*/
+		void waitUntil(const std::function<bool()> & done);
+
+		/** Run a range of iterations split in chunks, on the calling thread and the workers. Chunks are distributed dynamically.
+		\param begin the first iteration
+		\param end the iteration after the last one
+		\param grain the minimum number of iterations per chunk, 0 to split the range in a few chunks per thread
+		\param body the function processing the iterations in [chunkBegin, chunkEnd)
+		*/
+		void parallelForChunks(int begin, int end, int grain, const std::function<void(int, int)> & body);
+
+		/** \return the priority of the tasks submitted by the current thread */
+		static Priority currentPriority();
+
+		/** Log the scheduling overhead and the throughput of parallel loops, nested loops, task graphs and futures,
+		compared to OpenMP when available.
+		\param taskCount the number of tasks used for the overhead measurements
+		*/
+		static void benchmark(uint taskCount = 100000);
+
+	private:
+
+		static const int PriorityCount = 3; ///< Number of priority levels.
+
+		/** Queued task. */
+		struct Entry {
+			Task task; ///< The task.
+			Priority priority; ///< Its priority.
+		};
+
+		/** Task deques, one per priority. */
+		struct WorkQueue {
+			std::mutex mutex; ///< Deques lock.
+			std::deque<Entry> tasks[PriorityCount]; ///< Tasks per priority.
+		};
+
+		/** Worker thread loop.
+		\param id the worker index
+		*/
+		void workerLoop(uint id);
+
+		/** Pop a task, from the deque of the current worker, then the shared queue, then the other workers.
+		\param entry will contain the task
+		\param minimum the lowest priority accepted
+		\return true if a task was found
+		*/
+		bool pop(Entry & entry, Priority minimum);
+
+		/** Pop and execute a task.
+		\param minimum the lowest priority accepted
+		\return true if a task was executed
+		*/
+		bool runOne(Priority minimum);
+
+		std::vector<std::unique_ptr<WorkQueue>> _queues; ///< Per worker deques.
+		WorkQueue _shared; ///< Tasks submitted from other threads.
+		std::vector<std::thread> _workers; ///< Worker threads.
+		std::atomic<int> _queued; ///< Number of queued tasks.
+		std::atomic<int> _sleeping; ///< Number of workers waiting for tasks.
+		std::atomic<uint> _nextVictim; ///< Rotating first victim for threads that are not workers.
+		std::mutex _sleepMutex; ///< Lock for sleeping workers.
+		std::condition_variable _wakeUp; ///< Signaled when tasks are submitted.
+		bool _stop = false; ///< Should the workers stop when the queues are empty.
+	};
+
+	/** \brief Set of tasks that can be waited for together. The destructor waits for all tasks.
+	* \ingroup sibr_system
+	*/
+	class SIBR_SYSTEM_EXPORT TaskGroup
+	{
+	public:
+
+		/** Constructor.
+		\param scheduler the scheduler executing the tasks
+		*/
+		explicit TaskGroup(TaskScheduler & scheduler = TaskScheduler::get());
+
+		/** Destructor, waits for the remaining tasks. */
+		~TaskGroup();
+
+		/// Deleted copy constructor.
+		TaskGroup(const TaskGroup&) = delete;
+
+		/// Deleted copy operator.
+		TaskGroup& operator=(const TaskGroup&) = delete;
+
+		/** Submit a task in the group, with the priority of the current thread. Can be called from the tasks of the group.
+		\param task the task
+		*/
+		void run(TaskScheduler::Task task);
+
+		/** Wait for all tasks of the group, executing pending tasks meanwhile. The first exception raised by a task is rethrown. */
+		void wait();
+
+		/** \return the scheduler executing the tasks */
+		TaskScheduler & scheduler() { return _scheduler; }
+
+	private:
+		TaskScheduler & _scheduler; ///< Executing scheduler.
+		std::atomic<int> _pending; ///< Number of tasks not completed yet.
+		std::mutex _exceptionMutex; ///< Lock for the exception.
+		std::exception_ptr _exception; ///< First exception raised by a task.
+	};
+
+	/** \brief Tasks with dependencies. A task starts once all its predecessors are completed.
+	* The graph can be run several times.
+	* \ingroup sibr_system
+	*/
+	class SIBR_SYSTEM_EXPORT TaskGraph
+	{
+	public:
+
+		typedef size_t NodeId;
+
+		/** Add a task to the graph.
+		\param task the task
+		\return the task node
+		*/
+		NodeId add(TaskScheduler::Task task);
+
+		/** Add a dependency between two tasks.
+		\param before the task that has to complete first
+		\param after the task that depends on it
+		*/
+		void precede(NodeId before, NodeId after);
+
+		/** Run all tasks and wait for their completion. Tasks depending on a task that raised an exception are skipped,
+		and the first exception is rethrown. A graph with a cycle is an error.
+		\param scheduler the scheduler executing the tasks
+		*/
+		void run(TaskScheduler & scheduler = TaskScheduler::get());
+
+		/** \return the number of tasks */
+		size_t size() const { return _nodes.size(); }
+
+	private:
+
+		/** Graph node. */
+		struct Node {
+			TaskScheduler::Task task; ///< The task.
+			std::vector<NodeId> successors; ///< Tasks depending on this one.
+			int predecessors = 0; ///< Number of tasks this one depends on.
+		};
+
+		std::vector<Node> _nodes; ///< Graph nodes.
+	};
+
+	/** \brief Result of a task submitted with async. Waiting for the result executes pending tasks.
+	* \ingroup sibr_system
+	*/
+	template<typename T>
+	class TaskFuture
+	{
+	public:
+
+		/** Default constructor, without result. */
+		TaskFuture() {}
+
+		/** Constructor.
+		\param future the task result
+		\param ready flag set once the result is available
+		\param scheduler the scheduler executing the task
+		*/
+		TaskFuture(std::future<T> && future, const std::shared_ptr<std::atomic<bool>> & ready, TaskScheduler & scheduler)
+			: _future(std::move(future)), _ready(ready), _scheduler(&scheduler) {}
+
+		/** \return true if the future refers to a task */
+		bool valid() const { return _future.valid(); }
+
+		/** \return true if the result is available */
+		bool ready() const { return _ready && _ready->load(); }
+
+		/** Wait for the result, executing pending tasks meanwhile, and return it. Exceptions raised by the task are rethrown.
+		Can only be called once.
+		\return the task result
+		*/
+		T get() {
+			const std::shared_ptr<std::atomic<bool>> ready = _ready;
+			_scheduler->waitUntil([&ready]() { return ready->load(); });
+			return _future.get();
+		}
+
+	private:
+		std::future<T> _future; ///< Task result.
+		std::shared_ptr<std::atomic<bool>> _ready; ///< Set once the result is available.
+		TaskScheduler * _scheduler = nullptr; ///< Executing scheduler.
+	};
+
+	/** Run a function asynchronously, with the priority of the current thread.
+	\param func the function
+	\param scheduler the scheduler executing the function
+	\return the future result
+	\ingroup sibr_system
+	*/
+	template<typename Function>
+	auto async(Function func, TaskScheduler & scheduler = TaskScheduler::get()) -> TaskFuture<decltype(func())>
+	{
+		typedef decltype(func()) Result;
+		const auto task = std::make_shared<std::packaged_task<Result()>>(std::move(func));
+		const auto ready = std::make_shared<std::atomic<bool>>(false);
+		std::future<Result> future = task->get_future();
+		scheduler.submit([task, ready]() {
+			(*task)();
+			ready->store(true);
+		});
+		return TaskFuture<Result>(std::move(future), ready, scheduler);
+	}
+
+	/** Run the iterations of a loop in parallel, on the calling thread and the scheduler workers. Can be nested.
+	\param begin the first iteration
+	\param end the iteration after the last one
+	\param func the function called for each iteration
+	\param grain the minimum number of iterations per chunk, 0 to split the range in a few chunks per thread
+	\param scheduler the scheduler executing the iterations
+	\ingroup sibr_system
+	*/
+	template<typename Function>
+	void parallelFor(int begin, int end, const Function & func, int grain = 0, TaskScheduler & scheduler = TaskScheduler::get())
+	{
+		scheduler.parallelForChunks(begin, end, grain, [&func](int chunkBegin, int chunkEnd) {
+			for (int i = chunkBegin; i < chunkEnd; ++i) {
+				func(i);
+			}
+		});
+	}
+
+} // namespace sibr
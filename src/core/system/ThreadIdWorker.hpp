@@ -44,6 +44,9 @@ namespace sibr
 		if (t.joinable())
 		t.join();
 
+	 New code should rather use sibr::parallelFor or a TaskGroup, that share the TaskScheduler workers
+	 instead of starting threads.
+
 	 \ingroup sibr_system
 	*/
 	class /*SIBR_SYSTEM_EXPORT*/ ThreadIdWorker : public std::thread
@@ -94,7 +97,7 @@ namespace sibr
 	}
 
 	inline ThreadIdWorker::ThreadIdWorker( TaskIds& ids, std::function<bool(uint)> func )
-		: std::thread( [this, &ids, &func]() { taskPuller(ids, std::move(func)); } ) {
+		: std::thread( [this, &ids, func]() { taskPuller(ids, func); } ) {
 	}
 
 	inline ThreadIdWorker& ThreadIdWorker::operator =( ThreadIdWorker&& other ) noexcept {
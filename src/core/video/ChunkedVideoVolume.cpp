@@ -0,0 +1,355 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#include "ChunkedVideoVolume.hpp"
+
+#include <core/system/String.hpp>
+#include <core/system/Utils.hpp>
+#include <core/system/TaskScheduler.hpp>
+
+#include <boost/filesystem.hpp>
+
+namespace sibr
+{
+	namespace
+	{
+		/** Temporal expansion to an exact number of frames: frame k of the decimated volume is frame 2k of the result,
+		the other frames are interpolated with the same kernel as pyrDownTemporal (resizing would drift on odd lengths).
+		\param down the decimated volume
+		\param l number of frames of the result, at most 2*down.l
+		\return the expanded volume
+		*/
+		Volume3f pyrUpTemporalExact(const Volume3f & down, int l)
+		{
+			Volume3f out(l, down.w, down.h, 0);
+			for (int f = 0; f < down.l && 2 * f < l; ++f) {
+				down.frame(f).copyTo(out.frame(2 * f));
+			}
+			out.temporalBlur(2.0f);
+			return out;
+		}
+
+		/** View a float frame as a 8UC3 frame four times wider, to store it in a ChunkedVideoVolume.
+		\param frame the float frame
+		\return a header on the frame data
+		*/
+		cv::Mat asBytes(const cv::Mat & frame)
+		{
+			return cv::Mat(frame.rows, 4 * frame.cols, CV_8UC3, frame.data);
+		}
+
+		/** View the frames of a volume stored with asBytes as float frames.
+		\param bytes the stored volume, four times wider
+		\return a volume sharing the data
+		*/
+		Volume3f asFloats(const Volume3u & bytes)
+		{
+			return Volume3f(cv::Mat(bytes.l, bytes.w * bytes.h * 3 / 4, CV_32FC1, bytes.mat.data), bytes.w / 4, bytes.h);
+		}
+	}
+
+	const size_t ChunkedVideoVolume::defaultMemoryBudget = size_t(1) << 30;
+
+	ChunkedVideoVolume::ChunkedVideoVolume(int w, int h, int chunkLength, const std::string & cachePath)
+		: _w(w), _h(h), _chunkLength(std::max(chunkLength, 2)), _path(cachePath)
+	{
+		// Even chunks keep the frame parity when decimating temporally.
+		_chunkLength += _chunkLength % 2;
+
+		if (_path.empty()) {
+			_temporary = true;
+			_path = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("sibr_volume_%%%%-%%%%-%%%%-%%%%.raw")).string();
+		} else {
+			makeDirectory(parentDirectory(_path));
+		}
+
+		_writer.open(_path, std::ios::binary | std::ios::trunc);
+		if (!_writer.is_open()) {
+			SIBR_ERR << "[ChunkedVideoVolume] Could not create backing file " << _path << std::endl;
+		}
+	}
+
+	ChunkedVideoVolume::Ptr ChunkedVideoVolume::fromVideo(sibr::Video & vid, int chunkLength, const std::string & cachePath, int starting_frame, int ending_frame)
+	{
+		const int w = vid.getResolution()[0];
+		const int h = vid.getResolution()[1];
+		if (ending_frame < 0) {
+			ending_frame = vid.getNumFrames() - 1;
+		}
+
+		Ptr volume(new ChunkedVideoVolume(w, h, chunkLength, cachePath));
+		cv::Mat frame(h, w, CV_8UC3);
+		vid.setCurrentFrame(starting_frame);
+		for (int t = starting_frame; t <= ending_frame; ++t) {
+			vid.getCVvideo() >> frame;
+			if (frame.empty()) {
+				SIBR_WRG << "[ChunkedVideoVolume] Video " << vid.getFilepath() << " ended at frame " << t << std::endl;
+				break;
+			}
+			volume->appendFrame(frame);
+		}
+		vid.setCurrentFrame(0);
+		return volume;
+	}
+
+	ChunkedVideoVolume::~ChunkedVideoVolume()
+	{
+		_writer.close();
+		if (_temporary) {
+			boost::system::error_code ec;
+			boost::filesystem::remove(_path, ec);
+		}
+	}
+
+	void ChunkedVideoVolume::appendFrame(const cv::Mat & frame)
+	{
+		if (frame.cols != _w || frame.rows != _h || frame.type() != CV_8UC3) {
+			SIBR_ERR << "[ChunkedVideoVolume] Expected a " << _w << "x" << _h << " 8UC3 frame." << std::endl;
+		}
+		if (frame.isContinuous()) {
+			_writer.write(reinterpret_cast<const char*>(frame.data), frameBytes());
+		} else {
+			for (int i = 0; i < _h; ++i) {
+				_writer.write(reinterpret_cast<const char*>(frame.ptr(i)), size_t(_w) * 3);
+			}
+		}
+		++_l;
+	}
+
+	void ChunkedVideoVolume::appendFrames(const Volume3u & volume)
+	{
+		for (int t = 0; t < volume.l; ++t) {
+			appendFrame(volume.frame(t));
+		}
+	}
+
+	Volume3u ChunkedVideoVolume::loadFrames(int t_start, int t_end) const
+	{
+		t_start = sibr::clamp(t_start, 0, _l);
+		t_end = sibr::clamp(t_end, t_start, _l);
+
+		flush();
+		Volume3u out(t_end - t_start, _w, _h);
+		std::ifstream reader(_path, std::ios::binary);
+		reader.seekg(std::streamoff(t_start) * std::streamoff(frameBytes()));
+		// The rows of a volume are contiguous, read all frames at once.
+		reader.read(reinterpret_cast<char*>(out.mat.data), std::streamsize(out.l) * std::streamsize(frameBytes()));
+		return out;
+	}
+
+	Volume3u ChunkedVideoVolume::loadChunk(int c, int halo, int & t_start) const
+	{
+		t_start = std::max(0, c * _chunkLength - halo);
+		const int t_end = std::min(_l, (c + 1) * _chunkLength + halo);
+		return loadFrames(t_start, t_end);
+	}
+
+	cv::Mat ChunkedVideoVolume::loadBand(int i_start, int i_end, int t_start, int t_end) const
+	{
+		if (t_end < 0) {
+			t_end = _l;
+		}
+		flush();
+		return readBand(i_start, i_end, t_start, t_end);
+	}
+
+	cv::Mat ChunkedVideoVolume::readBand(int i_start, int i_end, int t_start, int t_end) const
+	{
+		const size_t rowBytes = size_t(_w) * 3;
+		const size_t bandBytes = size_t(i_end - i_start) * rowBytes;
+
+		cv::Mat band(t_end - t_start, int(bandBytes), CV_8UC1);
+		std::ifstream reader(_path, std::ios::binary);
+		for (int t = t_start; t < t_end; ++t) {
+			reader.seekg(std::streamoff(t) * std::streamoff(frameBytes()) + std::streamoff(i_start) * std::streamoff(rowBytes));
+			reader.read(reinterpret_cast<char*>(band.ptr(t - t_start)), bandBytes);
+		}
+		return band;
+	}
+
+	void ChunkedVideoVolume::forEachChunk(const ChunkFunction & f, int halo) const
+	{
+		for (int c = 0; c < numChunks(); ++c) {
+			int t_start;
+			const Volume3u chunk = loadChunk(c, halo, t_start);
+			f(t_start, chunk);
+		}
+	}
+
+	void ChunkedVideoVolume::forEachBand(const BandFunction & f, size_t memoryBudget) const
+	{
+		if (_l == 0) {
+			return;
+		}
+		// The calling thread processes bands too.
+		const int numThreads = int(TaskScheduler::get().threadCount()) + 1;
+		const size_t bytesPerRow = size_t(_l) * size_t(_w) * 3;
+		const size_t bytesPerThread = memoryBudget / size_t(numThreads);
+		const int bandHeight = sibr::clamp(int(bytesPerThread / std::max(bytesPerRow, size_t(1))), 1, _h);
+		const int numBands = (_h + bandHeight - 1) / bandHeight;
+
+		// The writer is shared, flush it once before reading concurrently.
+		flush();
+		sibr::parallelFor(0, numBands, [&](int b) {
+			const int i_start = b * bandHeight;
+			const int i_end = std::min(_h, i_start + bandHeight);
+			const cv::Mat band = readBand(i_start, i_end, 0, _l);
+			f(i_start, i_end, band);
+		}, 1);
+	}
+
+	cv::Mat3b ChunkedVideoVolume::median(size_t memoryBudget) const
+	{
+		cv::Mat3b out(_h, _w);
+		forEachBand([&](int i_start, int i_end, const cv::Mat & band) {
+			// Gather each temporal sequence from the band directly, a transposed copy would double its memory.
+			std::vector<uchar> values(_l);
+			for (int i = i_start; i < i_end; ++i) {
+				for (int j = 0; j < _w; ++j) {
+					for (int c = 0; c < 3; ++c) {
+						const int col = 3 * ((i - i_start) * _w + j) + c;
+						for (int t = 0; t < _l; ++t) {
+							values[t] = band.ptr<uchar>(t)[col];
+						}
+						std::nth_element(values.begin(), values.begin() + _l / 2, values.end());
+						out(i, j)[c] = values[_l / 2];
+					}
+				}
+			}
+		}, memoryBudget);
+		return out;
+	}
+
+	cv::Mat3b ChunkedVideoVolume::backgroundImage(int numBins, size_t memoryBudget) const
+	{
+		cv::Mat3b out(_h, _w);
+		forEachBand([&](int i_start, int i_end, const cv::Mat & band) {
+			std::vector<sibr::Vector3ub> values(_l);
+			for (int i = i_start; i < i_end; ++i) {
+				for (int j = 0; j < _w; ++j) {
+					const int col = 3 * ((i - i_start) * _w + j);
+					for (int t = 0; t < _l; ++t) {
+						const uchar * px = band.ptr<uchar>(t) + col;
+						values[t] = sibr::Vector3ub(px[0], px[1], px[2]);
+					}
+					TimeHistogram histo = TimeHistogram(0, 255, numBins);
+					histo.addValues(values);
+					const sibr::Vector3ub mode = histo.getBinMiddle(histo.getHMode());
+					out(i, j) = cv::Vec3b(mode[0], mode[1], mode[2]);
+				}
+			}
+		}, memoryBudget);
+		return out;
+	}
+
+	void ChunkedVideoVolume::meanVariance(cv::Mat & outMean, cv::Mat & outVariance) const
+	{
+		if (_l == 0) {
+			return;
+		}
+		cv::Mat3d sum = cv::Mat3d::zeros(_h, _w), sumSq = cv::Mat3d::zeros(_h, _w);
+		forEachChunk([&](int, const Volume3u & chunk) {
+			sibr::parallelFor(0, _h, [&](int i) {
+				for (int t = 0; t < chunk.l; ++t) {
+					const cv::Vec3b * src = chunk.frame(t).ptr<cv::Vec3b>(i);
+					cv::Vec3d * s = sum.ptr<cv::Vec3d>(i);
+					cv::Vec3d * sq = sumSq.ptr<cv::Vec3d>(i);
+					for (int j = 0; j < _w; ++j) {
+						for (int c = 0; c < 3; ++c) {
+							const double v = src[j][c];
+							s[j][c] += v;
+							sq[j][c] += v * v;
+						}
+					}
+				}
+			});
+		});
+
+		const cv::Mat mean = sum / double(_l);
+		cv::Mat var = cv::min(255.0 * 255.0, cv::max(0.0, sumSq / double(_l) - mean.mul(mean)));
+		cv::sqrt(var, var);
+		var *= 5.0;
+		mean.convertTo(outMean, CV_8UC3);
+		var.convertTo(outVariance, CV_8UC3);
+	}
+
+	std::vector<ChunkedVideoVolume::Ptr> ChunkedVideoVolume::laplacianPyramidTemporal(uint numLevels, const std::string & outputDir) const
+	{
+		if (numLevels == 0) {
+			numLevels = optimal_num_levels(_l);
+		}
+		// Support of the temporal blur applied when going down then up one level, in frames of the finer level.
+		const int halo = 8;
+
+		auto levelPath = [&](const std::string & name) {
+			return outputDir.empty() ? std::string() : outputDir + "/" + name + ".raw";
+		};
+
+		std::vector<Ptr> out;
+		// Intermediate low-pass levels are kept in float, stored as frames four times wider, to avoid quantizing them at each level.
+		Ptr down;
+		for (uint lvl = 0; lvl + 1 < numLevels; ++lvl) {
+			const ChunkedVideoVolume & current = down ? *down : *this;
+			Ptr laplacian(new ChunkedVideoVolume(_w, _h, _chunkLength, levelPath("level_" + std::to_string(lvl))));
+			Ptr nextDown(new ChunkedVideoVolume(4 * _w, _h, _chunkLength));
+
+			for (int c = 0; c < current.numChunks(); ++c) {
+				int t_start;
+				const Volume3u chunk = current.loadChunk(c, halo, t_start);
+				const int c_start = c * current.chunkLength();
+				const int c_end = std::min(current.l(), c_start + current.chunkLength());
+
+				Volume3f chunk_f = down ? asFloats(chunk).clone() : chunk.convertTo<float>();
+				Volume3f chunk_down = chunk_f.pyrDownTemporal();
+				Volume3f chunk_up = pyrUpTemporalExact(chunk_down, chunk_f.l);
+				chunk_f.substract(chunk_up);
+				chunk_f.shift(128);
+
+				// Only keep the frames of the chunk itself, the halo is recomputed by the neighbouring chunks.
+				const Volume3u lap = chunk_f.convertTo<uchar>();
+				for (int t = c_start; t < c_end; ++t) {
+					laplacian->appendFrame(lap.frame(t - t_start));
+				}
+
+				// Chunks and halos start on even frames: decimated frame k of the chunk is frame t_start/2 + k of the next level.
+				for (int t = c_start / 2; t < (c_end + 1) / 2; ++t) {
+					nextDown->appendFrame(asBytes(chunk_down.frame(t - t_start / 2)));
+				}
+			}
+
+			out.push_back(laplacian);
+			down = nextDown;
+		}
+
+		// Residual low-pass level, quantized once.
+		Ptr residual(new ChunkedVideoVolume(_w, _h, _chunkLength, levelPath("level_" + std::to_string(out.size()))));
+		if (down) {
+			down->forEachChunk([&](int, const Volume3u & chunk) {
+				residual->appendFrames(asFloats(chunk).convertTo<uchar>());
+			});
+		} else {
+			forEachChunk([&](int, const Volume3u & chunk) {
+				residual->appendFrames(chunk);
+			});
+		}
+		out.push_back(residual);
+		return out;
+	}
+
+	void ChunkedVideoVolume::flush() const
+	{
+		if (_writer.is_open()) {
+			_writer.flush();
+		}
+	}
+
+ } // namespace sibr
@@ -0,0 +1,193 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+#include "Config.hpp"
+
+#include <core/video/Video.hpp>
+#include <core/video/VideoUtils.hpp>
+
+#include <fstream>
+
+namespace sibr
+{
+
+	/** Out-of-core video volume, stored frame after frame in a raw file on disk.
+	* Only the temporal chunks or spatial bands currently processed are loaded in memory,
+	* which allows to process clips that do not fit in RAM with a bounded memory footprint.
+	* Per-pixel statistics (median, background, mean/variance) are computed on horizontal
+	* bands of the frames in parallel, temporal filtering (pyramids) is applied chunk by chunk
+	* with an overlap between consecutive chunks.
+	* \ingroup sibr_video
+	*/
+	class SIBR_VIDEO_EXPORT ChunkedVideoVolume
+	{
+		SIBR_CLASS_PTR(ChunkedVideoVolume);
+		SIBR_DISALLOW_COPY(ChunkedVideoVolume);
+
+	public:
+
+		/** Function called on each temporal chunk.
+		\param t_start index of the first frame of the chunk, halo included
+		\param chunk the chunk frames
+		*/
+		using ChunkFunction = std::function<void(int t_start, const Volume3u & chunk)>;
+
+		/** Function called on each spatial band, possibly concurrently.
+		\param i_start first row of the band
+		\param i_end row after the last row of the band
+		\param band the band data, one row per frame, stored as RGBRGB... linearly
+		*/
+		using BandFunction = std::function<void(int i_start, int i_end, const cv::Mat & band)>;
+
+		/** Constructor. Create an empty volume, frames have to be appended.
+		\param w frames width
+		\param h frames height
+		\param chunkLength number of frames per temporal chunk
+		\param cachePath path of the backing file, a temporary file deleted at destruction is used if empty
+		*/
+		ChunkedVideoVolume(int w, int h, int chunkLength = 64, const std::string & cachePath = "");
+
+		/** Create a volume by streaming a section of a video to disk, one frame at a time.
+		\param vid the video to read
+		\param chunkLength number of frames per temporal chunk
+		\param cachePath path of the backing file, a temporary file deleted at destruction is used if empty
+		\param starting_frame index of the first frame to extract
+		\param ending_frame index of the last frame to extract, or -1 for the last frame of the video
+		\return the volume
+		*/
+		static Ptr fromVideo(sibr::Video & vid, int chunkLength = 64, const std::string & cachePath = "", int starting_frame = 0, int ending_frame = -1);
+
+		/// Destructor. Remove the backing file if temporary.
+		~ChunkedVideoVolume();
+
+		/** Append a frame at the end of the volume.
+		\param frame a 8UC3 frame of the volume resolution
+		*/
+		void appendFrame(const cv::Mat & frame);
+
+		/** Append all frames of an in-memory volume.
+		\param volume the frames to append, of the volume resolution
+		*/
+		void appendFrames(const Volume3u & volume);
+
+		/** \return the frames width. */
+		int w() const { return _w; }
+
+		/** \return the frames height. */
+		int h() const { return _h; }
+
+		/** \return the number of frames. */
+		int l() const { return _l; }
+
+		/** \return the number of frames per chunk. */
+		int chunkLength() const { return _chunkLength; }
+
+		/** \return the number of temporal chunks. */
+		int numChunks() const { return (_l + _chunkLength - 1) / _chunkLength; }
+
+		/** \return the path to the backing file. */
+		const std::string & cachePath() const { return _path; }
+
+		/** Load a range of frames in memory.
+		\param t_start first frame
+		\param t_end frame after the last frame
+		\return the frames
+		*/
+		Volume3u loadFrames(int t_start, int t_end) const;
+
+		/** Load a temporal chunk in memory, with additional frames on both sides.
+		\param c the chunk index
+		\param halo number of additional frames before and after the chunk, clamped to the volume extent
+		\param t_start will contain the index of the first loaded frame
+		\return the frames
+		*/
+		Volume3u loadChunk(int c, int halo, int & t_start) const;
+
+		/** Load a band of rows for a range of frames.
+		\param i_start first row
+		\param i_end row after the last row
+		\param t_start first frame
+		\param t_end frame after the last frame, or -1 for all frames
+		\return the band data, one row per frame, stored as RGBRGB... linearly
+		*/
+		cv::Mat loadBand(int i_start, int i_end, int t_start = 0, int t_end = -1) const;
+
+		/** Call a function on each temporal chunk, sequentially.
+		\param f the function to call
+		\param halo number of additional frames loaded before and after each chunk
+		*/
+		void forEachChunk(const ChunkFunction & f, int halo = 0) const;
+
+		/** Call a function on horizontal bands covering the frames, in parallel.
+		Band height is chosen so that all bands processed at the same time fit in the memory budget.
+		\param f the function to call
+		\param memoryBudget maximal number of bytes of frame data loaded at the same time
+		*/
+		void forEachBand(const BandFunction & f, size_t memoryBudget = defaultMemoryBudget) const;
+
+		/** Compute the per-pixel temporal median.
+		\param memoryBudget maximal number of bytes of frame data loaded at the same time
+		\return the median image
+		*/
+		cv::Mat3b median(size_t memoryBudget = defaultMemoryBudget) const;
+
+		/** Compute the background image as the per-pixel mode of a color histogram, as in VideoUtils::getBackgroundImage.
+		\param numBins number of bins per channel
+		\param memoryBudget maximal number of bytes of frame data loaded at the same time
+		\return the background image
+		*/
+		cv::Mat3b backgroundImage(int numBins = 50, size_t memoryBudget = defaultMemoryBudget) const;
+
+		/** Compute the per-pixel temporal mean and standard deviation, streaming over chunks.
+		\param outMean will contain the mean image (8UC3)
+		\param outVariance will contain the standard deviation image scaled by 5 (8UC3), as in VideoUtils::getMeanVariance
+		*/
+		void meanVariance(cv::Mat & outMean, cv::Mat & outVariance) const;
+
+		/** Build a temporal Laplacian pyramid, each level being stored out-of-core.
+		Levels are stored as in laplacianPyramid, shifted by 128, the last level contains the residual low-pass volume.
+		Intermediate low-pass volumes are kept in float, only the stored levels are quantized.
+		\param numLevels number of levels, or 0 to go down to a single frame
+		\param outputDir directory where the levels are stored, temporary files are used if empty
+		\return the pyramid levels
+		*/
+		std::vector<Ptr> laplacianPyramidTemporal(uint numLevels = 0, const std::string & outputDir = "") const;
+
+		static const size_t defaultMemoryBudget; ///< Default memory budget for band processing (1GB).
+
+	private:
+
+		/** \return the size of a frame in bytes. */
+		size_t frameBytes() const { return size_t(_w) * size_t(_h) * 3; }
+
+		/** Make sure all appended frames have been written to the backing file. */
+		void flush() const;
+
+		/** Read a band of rows from the backing file, without flushing pending frames, so that it can be called concurrently.
+		\param i_start first row
+		\param i_end row after the last row
+		\param t_start first frame
+		\param t_end frame after the last frame
+		\return the band data, one row per frame
+		*/
+		cv::Mat readBand(int i_start, int i_end, int t_start, int t_end) const;
+
+		int _w = 0, _h = 0, _l = 0; ///< Volume dimensions.
+		int _chunkLength = 64; ///< Number of frames per temporal chunk.
+		std::string _path; ///< Backing file path.
+		bool _temporary = false; ///< Should the backing file be deleted.
+		mutable std::ofstream _writer; ///< Output stream for appended frames.
+	};
+
+ } // namespace sibr
@@ -15,6 +15,14 @@
 #include "Config.hpp"
 
 #include <core/video/Video.hpp>
+#include <core/system/SimpleTimer.hpp>
+#include <core/system/TaskScheduler.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
 
 namespace sibr
 {
@@ -50,6 +58,9 @@ namespace sibr
 	};
 
 
+	template<typename T, uint N>
+	class AsyncMultipleVideoDecoder;
+
 	/** Batch decoding of multiple videos at the same time, stored in a texture array.
 	* \ingroup sibr_video
 	*/
@@ -58,11 +69,25 @@ namespace sibr
 		using TexArray = sibr::Texture2DArray<T,N>;
 		using TexArrayPtr = typename TexArray::Ptr;
 
+		/** Decode the videos asynchronously from now on: each video is decoded by its own thread, and update
+		only uploads the next frame once all videos have decoded it, without blocking.
+		\param videos the video players, they should not be used by anyone else while decoding
+		\param ringSize the number of frames that can be prefetched for each video
+		\note Must be called from the thread owning the OpenGL context.
+		*/
+		void enableAsync(const std::vector<sibr::VideoPlayer::Ptr> & videos, uint ringSize = 4) {
+			asyncDecoder.reset(new AsyncMultipleVideoDecoder<T, N>(videos, ringSize));
+		}
+
 		/** Update a set of video players to the next frame.
 		\param videos the video players to udpate
-		\note Internally calls both updateCPU and updateGPU.
+		\note Internally calls both updateCPU and updateGPU. In asynchronous mode, the videos are ignored and the next decoded frame is uploaded if available.
 		*/
 		void update(const std::vector<sibr::VideoPlayer::Ptr> & videos) {
+			if (asyncDecoder) {
+				asyncDecoder->update();
+				return;
+			}
 			updateCPU(videos);
 			updateGPU(videos);
 
@@ -114,11 +139,12 @@ namespace sibr
 		TexArrayPtr & getLoadingTexArray() { return loadingTexArray ? ping : pong; }
 
 		/** \return the current display texture array. */
-		const TexArrayPtr & getDisplayTexArray() const { return displayTexArray ? ping : pong; }
+		const TexArrayPtr & getDisplayTexArray() const { return asyncDecoder ? asyncDecoder->getDisplayTexArray() : (displayTexArray ? ping : pong); }
 
 		bool first = true; ///< First frame.
 		int loadingTexArray = 1, displayTexArray = 1; ///< Texture indices.
 		TexArrayPtr ping, pong; ///< Textures.
+		std::shared_ptr<AsyncMultipleVideoDecoder<T, N>> asyncDecoder; ///< Asynchronous decoder, if enabled.
 	};
 
 
@@ -134,9 +160,13 @@ namespace sibr
 		/** Update a set of video players to the next frame.
 		\param videos the video players list
 		\param slices the indices of the videos to update
-		\note Internally calls both updateCPU and updateGPU.
+		\note Internally calls both updateCPU and updateGPU. In asynchronous mode, all videos are decoded and the next decoded frame is uploaded if available.
 		*/
 		void update(const std::vector<sibr::VideoPlayer::Ptr> & videos, const std::vector<int> & slices) {
+			if (this->asyncDecoder) {
+				this->asyncDecoder->update();
+				return;
+			}
 			updateCPU(videos, slices);
 			updateGPU(videos, slices);
 
@@ -154,10 +184,9 @@ namespace sibr
 		\param slices the indices of the videos to update
 		*/
 		void updateCPU(const std::vector<sibr::VideoPlayer::Ptr> & videos, const std::vector<int> & slices) {
-#pragma omp parallel for num_threads(4)
-			for (int i = 0; i < (int)slices.size(); ++i) {
+			sibr::parallelFor(0, (int)slices.size(), [&](int i) {
 				videos[slices[i]]->updateCPU();
-			}
+			}, 1);
 		}
 
 		/** Upload the next frame to the GPU for a set of video players.
@@ -169,15 +198,13 @@ namespace sibr
 			int numSlices = (int)slices.size();
 
 			std::vector<cv::Mat> frames(numVids);
-			for (int s = 0; s < numSlices; ++s) {
+			sibr::parallelFor(0, numSlices, [&](int s) {
 				if (std::is_same_v<T, uchar> && N == 3) {
 					frames[slices[s]] = videos[slices[s]]->getCurrentFrame();
 				} else {
-					std::vector<cv::Mat> cs;
-					cv::split(videos[slices[s]]->getCurrentFrame(), cs);
-					frames[slices[s]] = cs[0];
+					cv::extractChannel(videos[slices[s]]->getCurrentFrame(), frames[slices[s]], 0);
 				}
-			} 
+			}, 1);
 
 			if (!getLoadingTexArray().get()) {
 				getLoadingTexArray() = TexArrayPtr(new TexArray((uint)videos.size(), SIBR_GPU_LINEAR_SAMPLING));
@@ -189,6 +216,121 @@ namespace sibr
 
 	};
 
+	/** Asynchronous batch decoding of multiple synchronized videos, stored in a texture array.
+	* Each video is decoded by its own thread, which prefetches frames into a ring of slots
+	* living in a persistently mapped pixel unpack buffer. Channel extraction is performed at decode time.
+	* Streams are synchronized on the frame index of their player: the render thread waits for all streams
+	* to provide the same frame, skipping the frames of streams that are behind, uploads each layer from the
+	* buffer to the loading texture array and swaps the display/loading indices.
+	* At the end of a video, the stream seeks back to the first frame if repeating, or stops and the playback is finished.
+	* \note All videos are resized to the resolution of the first one.
+	* \ingroup sibr_video
+	*/
+	template<typename T, uint N>
+	class AsyncMultipleVideoDecoder {
+		SIBR_DISALLOW_COPY(AsyncMultipleVideoDecoder);
+	public:
+		using TexArray = sibr::Texture2DArray<T, N>;
+		using TexArrayPtr = typename TexArray::Ptr;
+
+		/** Constructor. Start one decoding thread per video.
+		\param videos the video players to decode, they should not be used by anyone else while decoding
+		\param ringSize the number of frames that can be prefetched for each video
+		\param repeat should the videos restart from the first frame when reaching their end
+		\note Must be called from the thread owning the OpenGL context.
+		*/
+		AsyncMultipleVideoDecoder(const std::vector<sibr::VideoPlayer::Ptr> & videos, uint ringSize = 4, bool repeat = true);
+
+		/// Destructor. Stop the decoding threads and release the GPU buffers.
+		~AsyncMultipleVideoDecoder();
+
+		/** Upload the next synchronized frame if all videos have decoded it.
+		\param wait if true, block until the frame is available
+		\return true if a new frame has been uploaded and is now displayed.
+		*/
+		bool update(bool wait = false);
+
+		/** \return the current display texture array. */
+		const TexArrayPtr & getDisplayTexArray() const { return _displayTexArray ? _ping : _pong; }
+
+		/** \return the index of the frame currently displayed, or -1 if no frame has been displayed yet. */
+		int displayedFrame() const { return _displayedFrame; }
+
+		/** \return the number of frames displayed per second since the decoder creation. */
+		double sustainedFramerate() const;
+
+		/** \return true if a non repeating stream has reached its end and all its frames have been displayed. */
+		bool finished() const { return _finished; }
+
+	private:
+
+		/** Status of a slot in a stream ring. */
+		enum SlotState { FREE, READY, IN_FLIGHT };
+
+		/** Per video decoding state. */
+		struct Stream {
+			sibr::VideoPlayer::Ptr video; ///< The video.
+			std::vector<int64_t> slotKeys; ///< Loop count (high bits) and player frame index (low bits) of the frame stored in each slot.
+			std::vector<SlotState> slotStates; ///< Status of each slot.
+			uint readSlot = 0; ///< Next slot to display.
+			bool ended = false; ///< The decoding thread has stopped at the end of the video.
+			std::thread thread; ///< Decoding thread.
+		};
+
+		/** A frame uploaded to the GPU whose slots can't be reused before the copy is complete. */
+		struct PendingUpload {
+			std::vector<uint> slots; ///< The slot of each stream.
+			GLsync fence; ///< GPU fence signaled once the copy is done.
+		};
+
+		/** Decoding loop for a stream.
+		\param sid the stream index
+		*/
+		void decodeLoop(size_t sid);
+
+		/** \return a header pointing to the mapped memory for a given stream and slot.
+		\param sid the stream index
+		\param slot the slot index
+		*/
+		cv::Mat slotMat(size_t sid, uint slot);
+
+		/** Check if all streams have decoded the same frame, giving back the slots of the streams that are behind.
+		\param slots will contain the slot of each stream holding the frame
+		\return true if the frame is available
+		\note Must be called with the lock held.
+		*/
+		bool alignStreams(std::vector<uint> & slots);
+
+		/** Give back to the decoders the slots of frames whose upload is complete.
+		\param wait wait for the oldest pending upload
+		\note Must be called without the lock held.
+		*/
+		void releaseUploadedSlots(bool wait);
+
+		/** \return the current loading texture array. */
+		TexArrayPtr & getLoadingTexArray() { return _loadingTexArray ? _ping : _pong; }
+
+		std::vector<Stream> _streams; ///< Decoding state of each video.
+		uint _ringSize; ///< Number of slots per video.
+		uint _w = 0, _h = 0; ///< Frame resolution.
+		size_t _frameBytes = 0; ///< Size of a frame in bytes.
+		GLuint _pbo = 0; ///< Persistent pixel unpack buffer.
+		uchar * _mapped = nullptr; ///< Mapped pixel unpack buffer, laid out as slot-major then stream.
+		std::deque<PendingUpload> _pending; ///< Uploads in flight.
+		bool _repeat = true; ///< Restart the videos when reaching their end.
+		bool _finished = false; ///< A stream has ended and all its frames have been displayed.
+		int _displayedFrame = -1; ///< Frame currently displayed.
+		size_t _uploadedCount = 0; ///< Number of frames displayed.
+		sibr::Timer _timer; ///< Timer for framerate statistics.
+		bool _first = true; ///< First frame.
+		int _loadingTexArray = 1, _displayTexArray = 1; ///< Texture indices.
+		TexArrayPtr _ping, _pong; ///< Textures.
+		std::mutex _mutex; ///< Protect the slots states.
+		std::condition_variable _slotFreed; ///< Signaled when slots are given back to decoders.
+		std::condition_variable _slotReady; ///< Signaled when a decoder has filled a slot.
+		std::atomic<bool> _stop; ///< Request the decoding threads to stop.
+	};
+
 
 	// --- TYPEDEFS ----------------
 
@@ -199,6 +341,8 @@ namespace sibr
 	using MultipleVideoDecoder3u = MultipleVideoDecoder<uchar, 3>;
 	using MultipleVideoDecoderArray1u = MultipleVideoDecoderArray<uchar, 1>;
 	using MultipleVideoDecoderArray3u = MultipleVideoDecoderArray<uchar, 3>;
+	using AsyncMultipleVideoDecoder1u = AsyncMultipleVideoDecoder<uchar, 1>;
+	using AsyncMultipleVideoDecoder3u = AsyncMultipleVideoDecoder<uchar, 3>;
 
 	// --- IMPLEMENTATION ----------------
 
@@ -240,4 +384,270 @@ namespace sibr
 		}
 	}
 
+	template<typename T, uint N>
+	AsyncMultipleVideoDecoder<T, N>::AsyncMultipleVideoDecoder(const std::vector<sibr::VideoPlayer::Ptr> & videos, uint ringSize, bool repeat)
+		: _streams(videos.size()), _ringSize(std::max(ringSize, 2u)), _repeat(repeat), _stop(false)
+	{
+		if (videos.empty()) {
+			SIBR_WRG << "[AsyncMultipleVideoDecoder] No video to decode." << std::endl;
+			return;
+		}
+
+		const sibr::Vector2i & res = videos[0]->getResolution();
+		_w = (uint)res[0];
+		_h = (uint)res[1];
+		_frameBytes = size_t(_w) * size_t(_h) * N * sizeof(T);
+
+		// One persistent coherent buffer holding all the rings, written directly by the decoding threads.
+		const GLsizeiptr totalBytes = GLsizeiptr(_frameBytes * _streams.size() * _ringSize);
+		const GLbitfield mapFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glGenBuffers(1, &_pbo);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _pbo);
+		glBufferStorage(GL_PIXEL_UNPACK_BUFFER, totalBytes, nullptr, mapFlags);
+		_mapped = static_cast<uchar*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, totalBytes, mapFlags));
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		CHECK_GL_ERROR;
+
+		_ping.reset(new TexArray(_w, _h, (uint)_streams.size(), SIBR_GPU_LINEAR_SAMPLING));
+		_pong.reset(new TexArray(_w, _h, (uint)_streams.size(), SIBR_GPU_LINEAR_SAMPLING));
+
+		for (size_t sid = 0; sid < _streams.size(); ++sid) {
+			Stream & stream = _streams[sid];
+			stream.video = videos[sid];
+			stream.slotKeys.resize(_ringSize, -1);
+			stream.slotStates.resize(_ringSize, FREE);
+		}
+		for (size_t sid = 0; sid < _streams.size(); ++sid) {
+			_streams[sid].thread = std::thread(&AsyncMultipleVideoDecoder<T, N>::decodeLoop, this, sid);
+		}
+		_timer.tic();
+	}
+
+	template<typename T, uint N>
+	AsyncMultipleVideoDecoder<T, N>::~AsyncMultipleVideoDecoder()
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_stop = true;
+		}
+		_slotFreed.notify_all();
+		for (Stream & stream : _streams) {
+			if (stream.thread.joinable()) {
+				stream.thread.join();
+			}
+		}
+		// All uploads are complete after glFinish, release their fences.
+		glFinish();
+		releaseUploadedSlots(false);
+
+		if (_pbo) {
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _pbo);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			glDeleteBuffers(1, &_pbo);
+		}
+	}
+
+	template<typename T, uint N>
+	bool AsyncMultipleVideoDecoder<T, N>::update(bool wait)
+	{
+		if (_streams.empty() || !_mapped || _finished) {
+			return false;
+		}
+
+		releaseUploadedSlots(false);
+
+		std::vector<uint> slots(_streams.size());
+		int64_t key = 0;
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			while (!alignStreams(slots) && !_finished) {
+				if (!wait) {
+					return false;
+				}
+				if (!_pending.empty()) {
+					// The decoders may be waiting for slots still read by the GPU: wait for the oldest upload instead of a decoder.
+					lock.unlock();
+					releaseUploadedSlots(true);
+					lock.lock();
+				} else {
+					_slotReady.wait(lock);
+				}
+			}
+			if (_finished) {
+				return false;
+			}
+			for (size_t sid = 0; sid < _streams.size(); ++sid) {
+				Stream & stream = _streams[sid];
+				stream.slotStates[slots[sid]] = IN_FLIGHT;
+				stream.readSlot = (slots[sid] + 1) % _ringSize;
+			}
+			key = _streams[0].slotKeys[slots[0]];
+		}
+		_slotFreed.notify_all();
+
+		// Each layer is read from the slot of its stream, the unpack state is restored afterwards.
+		GLint previousAlignment = 4;
+		glGetIntegerv(GL_UNPACK_ALIGNMENT, &previousAlignment);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, getLoadingTexArray()->handle());
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _pbo);
+		for (size_t sid = 0; sid < _streams.size(); ++sid) {
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, (GLint)sid, _w, _h, 1,
+				GLFormat<T, N>::format, GLType<T>::type,
+				reinterpret_cast<const void*>((size_t(slots[sid]) * _streams.size() + sid) * _frameBytes));
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, previousAlignment);
+		_pending.push_back({ slots, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) });
+		CHECK_GL_ERROR;
+
+		_displayedFrame = int(key & 0xffffffff);
+		++_uploadedCount;
+
+		_loadingTexArray = (_loadingTexArray + 1) % 2;
+		if (_first) {
+			_first = false;
+		} else {
+			_displayTexArray = (_displayTexArray + 1) % 2;
+		}
+		return true;
+	}
+
+	template<typename T, uint N>
+	double AsyncMultipleVideoDecoder<T, N>::sustainedFramerate() const
+	{
+		const double elapsed = _timer.deltaTimeFromLastTic<Timer::micro>() / 1000000.0;
+		return elapsed > 0.0 ? double(_uploadedCount) / elapsed : 0.0;
+	}
+
+	template<typename T, uint N>
+	void AsyncMultipleVideoDecoder<T, N>::decodeLoop(size_t sid)
+	{
+		Stream & stream = _streams[sid];
+		uint slot = 0;
+		int64_t loop = 0;
+		int lastFrame = -1;
+		while (true) {
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_slotFreed.wait(lock, [&] { return _stop || stream.slotStates[slot] == FREE; });
+				if (_stop) {
+					return;
+				}
+			}
+
+			bool decoded = stream.video->updateCPU();
+			if (!decoded && _repeat) {
+				stream.video->setCurrentFrame(0);
+				decoded = stream.video->updateCPU();
+			}
+			// The player position is the index of the next frame, it goes back when the player restarts the video.
+			const int frame = decoded ? stream.video->getCurrentFrameNumber() - 1 : -1;
+			if (decoded && frame <= lastFrame) {
+				decoded = _repeat;
+				++loop;
+			}
+			if (!decoded) {
+				// End of the video or decoding error: stop the stream, its remaining frames can still be displayed.
+				SIBR_LOG << "[AsyncMultipleVideoDecoder] End of " << stream.video->getFilepath() << " after frame " << lastFrame << "." << std::endl;
+				{
+					std::lock_guard<std::mutex> lock(_mutex);
+					stream.ended = true;
+				}
+				_slotReady.notify_all();
+				return;
+			}
+
+			lastFrame = frame;
+
+			cv::Mat fitted = stream.video->getCurrentFrame();
+			cv::Mat dst = slotMat(sid, slot);
+			if (fitted.size() != dst.size()) {
+				cv::resize(fitted, fitted, dst.size());
+			}
+			if (fitted.channels() == int(N)) {
+				fitted.copyTo(dst);
+			} else {
+				// Same convention as MultipleVideoDecoder: keep the first channel.
+				cv::extractChannel(fitted, dst, 0);
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				stream.slotKeys[slot] = (loop << 32) | int64_t(frame);
+				stream.slotStates[slot] = READY;
+			}
+			_slotReady.notify_all();
+			slot = (slot + 1) % _ringSize;
+		}
+	}
+
+	template<typename T, uint N>
+	cv::Mat AsyncMultipleVideoDecoder<T, N>::slotMat(size_t sid, uint slot)
+	{
+		uchar * data = _mapped + (size_t(slot) * _streams.size() + sid) * _frameBytes;
+		return cv::Mat(int(_h), int(_w), CV_MAKETYPE(cv::DataType<T>::depth, int(N)), data);
+	}
+
+	template<typename T, uint N>
+	bool AsyncMultipleVideoDecoder<T, N>::alignStreams(std::vector<uint> & slots)
+	{
+		while (true) {
+			int64_t target = -1;
+			for (const Stream & stream : _streams) {
+				if (stream.slotStates[stream.readSlot] != READY) {
+					// A stream that has stopped will never provide the frame.
+					_finished = _finished || stream.ended;
+					return false;
+				}
+				target = std::max(target, stream.slotKeys[stream.readSlot]);
+			}
+			bool aligned = true;
+			for (Stream & stream : _streams) {
+				if (stream.slotKeys[stream.readSlot] < target) {
+					// This stream is behind (its player skipped a frame elsewhere), drop its frame.
+					stream.slotStates[stream.readSlot] = FREE;
+					stream.readSlot = (stream.readSlot + 1) % _ringSize;
+					aligned = false;
+				}
+			}
+			if (aligned) {
+				for (size_t sid = 0; sid < _streams.size(); ++sid) {
+					slots[sid] = _streams[sid].readSlot;
+				}
+				return true;
+			}
+			_slotFreed.notify_all();
+		}
+	}
+
+	template<typename T, uint N>
+	void AsyncMultipleVideoDecoder<T, N>::releaseUploadedSlots(bool wait)
+	{
+		bool released = false;
+		while (!_pending.empty()) {
+			PendingUpload & upload = _pending.front();
+			// When waiting, only block on the oldest upload, the following ones are released if already complete.
+			const GLuint64 timeout = wait && !released ? GL_TIMEOUT_IGNORED : 0;
+			const GLenum status = glClientWaitSync(upload.fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+			if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+				break;
+			}
+			glDeleteSync(upload.fence);
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				for (size_t sid = 0; sid < _streams.size(); ++sid) {
+					_streams[sid].slotStates[upload.slots[sid]] = FREE;
+				}
+			}
+			_pending.pop_front();
+			released = true;
+		}
+		if (released) {
+			_slotFreed.notify_all();
+		}
+	}
+
  } // namespace sibr
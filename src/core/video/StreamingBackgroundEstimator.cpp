@@ -0,0 +1,271 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#include "StreamingBackgroundEstimator.hpp"
+#include "core/system/TaskScheduler.hpp"
+
+#include <cstring>
+
+namespace sibr
+{
+	namespace
+	{
+		/** Decode a section of a video and pass each frame to a function.
+		\param vid the video
+		\param time_skiped_begin time to skip at the beginning of the video, in seconds
+		\param time_skiped_end time to skip at the end of the video, in seconds
+		\param f the function
+		*/
+		void forEachFrame(sibr::Video & vid, float time_skiped_begin, float time_skiped_end, const std::function<void(const cv::Mat &)> & f)
+		{
+			// Same frame range as Video::getVolume.
+			const int starting_frame = (int)(time_skiped_begin * vid.getFrameRate());
+			const int ending_frame = vid.getNumFrames() - (int)(time_skiped_end * vid.getFrameRate()) - 1;
+
+			cv::Mat frame;
+			vid.setCurrentFrame(starting_frame);
+			for (int t = starting_frame; t <= ending_frame; ++t) {
+				vid.getCVvideo() >> frame;
+				if (frame.empty()) {
+					break;
+				}
+				f(frame);
+			}
+			vid.setCurrentFrame(0);
+		}
+	}
+
+	StreamingBackgroundEstimator::StreamingBackgroundEstimator(int w, int h, int numBins, int numColors, int firstRow, int numRows)
+		: _w(w), _h(h)
+	{
+		_firstRow = sibr::clamp(firstRow, 0, _h);
+		_numRows = numRows < 0 ? _h - _firstRow : std::min(numRows, _h - _firstRow);
+		_numBins = sibr::clamp(numBins, 1, 256);
+		_numColors = std::max(1, numColors);
+
+		// Same bins as TimeHistogram(0, 255, numBins).
+		const double scaling = _numBins / 255.0;
+		const double bin_range = 255.0 / _numBins;
+		for (int v = 0; v < 256; ++v) {
+			_binOf[v] = (uchar)sibr::clamp((int)(scaling * v), 0, _numBins - 1);
+		}
+		_binMiddle.resize(_numBins);
+		for (int b = 0; b < _numBins; ++b) {
+			_binMiddle[b] = (uchar)sibr::clamp((int)(bin_range * (b + 0.5)), 0, 255);
+		}
+
+		_colors.assign(size_t(_w) * size_t(_numRows) * _numColors, 0);
+		_counts.assign(size_t(_w) * size_t(_numRows) * _numColors, 0);
+	}
+
+	void StreamingBackgroundEstimator::addFrame(const cv::Mat & frame)
+	{
+		if (frame.cols != _w || frame.rows != _h || frame.type() != CV_8UC3) {
+			SIBR_ERR << "[StreamingBackgroundEstimator] Expected a " << _w << "x" << _h << " 8UC3 frame." << std::endl;
+		}
+
+		const uint32_t numBins = uint32_t(_numBins);
+		const int numColors = _numColors;
+		sibr::parallelFor(0, _numRows, [&](int i) {
+			const uchar * src = frame.ptr<uchar>(_firstRow + i);
+			for (int j = 0; j < _w; ++j) {
+				const uint32_t color = (uint32_t(_binOf[src[3 * j]]) * numBins + _binOf[src[3 * j + 1]]) * numBins + _binOf[src[3 * j + 2]];
+				const size_t pixel = (size_t(i) * _w + j) * numColors;
+				uint32_t * colors = &_colors[pixel];
+				uint16_t * counts = &_counts[pixel];
+
+				// Misra-Gries update: count the color if it is tracked or if a slot is free, otherwise decrement all counts.
+				int slot = -1;
+				int freeSlot = -1;
+				for (int k = 0; k < numColors; ++k) {
+					if (counts[k] == 0) {
+						if (freeSlot < 0) {
+							freeSlot = k;
+						}
+					} else if (colors[k] == color) {
+						slot = k;
+						break;
+					}
+				}
+
+				if (slot >= 0) {
+					if (counts[slot] == std::numeric_limits<uint16_t>::max()) {
+						for (int k = 0; k < numColors; ++k) {
+							counts[k] >>= 1;
+						}
+					}
+					++counts[slot];
+				} else if (freeSlot >= 0) {
+					colors[freeSlot] = color;
+					counts[freeSlot] = 1;
+				} else {
+					for (int k = 0; k < numColors; ++k) {
+						--counts[k];
+					}
+				}
+			}
+		});
+		++_numFrames;
+	}
+
+	void StreamingBackgroundEstimator::addVideo(sibr::Video & vid, float time_skiped_begin, float time_skiped_end)
+	{
+		forEachFrame(vid, time_skiped_begin, time_skiped_end, [this](const cv::Mat & frame) { addFrame(frame); });
+	}
+
+	cv::Mat3b StreamingBackgroundEstimator::mode() const
+	{
+		cv::Mat3b out(_numRows, _w);
+		const int numBins = _numBins;
+		sibr::parallelFor(0, _numRows, [&](int i) {
+			for (int j = 0; j < _w; ++j) {
+				const size_t pixel = (size_t(i) * _w + j) * _numColors;
+				const uint32_t * colors = &_colors[pixel];
+				const uint16_t * counts = &_counts[pixel];
+
+				int best = 0;
+				for (int k = 1; k < _numColors; ++k) {
+					if (counts[k] > counts[best] || (counts[k] == counts[best] && counts[k] > 0 && colors[k] < colors[best])) {
+						best = k;
+					}
+				}
+				const uint32_t color = colors[best];
+				out(i, j) = cv::Vec3b(
+					_binMiddle[color / (numBins * numBins)],
+					_binMiddle[(color / numBins) % numBins],
+					_binMiddle[color % numBins]);
+			}
+		});
+		return out;
+	}
+
+	void StreamingBackgroundEstimator::clear()
+	{
+		std::fill(_counts.begin(), _counts.end(), uint16_t(0));
+		_numFrames = 0;
+	}
+
+	StreamingMedianEstimator::StreamingMedianEstimator(int w, int h, int firstRow, int numRows)
+		: _w(w), _h(h)
+	{
+		_firstRow = sibr::clamp(firstRow, 0, _h);
+		_numRows = numRows < 0 ? _h - _firstRow : std::min(numRows, _h - _firstRow);
+
+		const size_t numValues = size_t(_w) * size_t(_numRows) * 3;
+		_counts.assign(numValues * NumBins, 0);
+		_bins.assign(numValues, 0);
+		_ranks.assign(numValues, 0);
+	}
+
+	void StreamingMedianEstimator::addFrame(const cv::Mat & frame)
+	{
+		if (frame.cols != _w || frame.rows != _h || frame.type() != CV_8UC3) {
+			SIBR_ERR << "[StreamingMedianEstimator] Expected a " << _w << "x" << _h << " 8UC3 frame." << std::endl;
+		}
+		if (_pass >= 2) {
+			SIBR_WRG << "[StreamingMedianEstimator] Both passes are already completed, frame ignored." << std::endl;
+			return;
+		}
+		if (_numFrames == std::numeric_limits<uint16_t>::max()) {
+			if (_pass == 0) {
+				SIBR_WRG << "[StreamingMedianEstimator] At most " << _numFrames << " frames are supported, frame ignored." << std::endl;
+			}
+			return;
+		}
+
+		const int rowValues = 3 * _w;
+		const bool coarse = _pass == 0;
+		sibr::parallelFor(0, _numRows, [&](int i) {
+			const uchar * src = frame.ptr<uchar>(_firstRow + i);
+			const size_t rowStart = size_t(i) * rowValues;
+			uint16_t * rowCounts = &_counts[rowStart * NumBins];
+			if (coarse) {
+				for (int v = 0; v < rowValues; ++v) {
+					++rowCounts[v * NumBins + (src[v] >> 4)];
+				}
+			} else {
+				// Only the values falling in the coarse bin of the median matter.
+				const uchar * rowBins = &_bins[rowStart];
+				for (int v = 0; v < rowValues; ++v) {
+					if ((src[v] >> 4) == rowBins[v]) {
+						++rowCounts[v * NumBins + (src[v] & 15)];
+					}
+				}
+			}
+		});
+		++_numFrames;
+	}
+
+	void StreamingMedianEstimator::addVideo(sibr::Video & vid, float time_skiped_begin, float time_skiped_end)
+	{
+		forEachFrame(vid, time_skiped_begin, time_skiped_end, [this](const cv::Mat & frame) { addFrame(frame); });
+	}
+
+	void StreamingMedianEstimator::endPass()
+	{
+		if (_pass >= 2) {
+			return;
+		}
+		if (_pass == 1 && _numFrames != _coarseFrames) {
+			SIBR_WRG << "[StreamingMedianEstimator] The passes used " << _coarseFrames << " and " << _numFrames << " frames, the median is approximate." << std::endl;
+		}
+
+		// Same element as std::nth_element at L/2 in VideoUtils::getMedian.
+		const int median = _numFrames / 2;
+		const bool coarse = _pass == 0;
+		const int numValues = int(_bins.size());
+		sibr::parallelFor(0, numValues, [&](int v) {
+			const uint16_t * histo = &_counts[size_t(v) * NumBins];
+			const int rank = coarse ? median : _ranks[v];
+			int cumul = 0;
+			int bin = NumBins - 1;
+			for (int b = 0; b < NumBins; ++b) {
+				if (cumul + histo[b] > rank) {
+					bin = b;
+					break;
+				}
+				cumul += histo[b];
+			}
+			if (coarse) {
+				_bins[v] = uchar(bin);
+				_ranks[v] = uint16_t(rank - cumul);
+			} else {
+				_bins[v] = uchar(_bins[v] * NumBins + bin);
+			}
+		});
+
+		if (coarse) {
+			_coarseFrames = _numFrames;
+			std::fill(_counts.begin(), _counts.end(), uint16_t(0));
+		} else {
+			_counts.clear();
+			_counts.shrink_to_fit();
+			_ranks.clear();
+			_ranks.shrink_to_fit();
+		}
+		_numFrames = 0;
+		++_pass;
+	}
+
+	cv::Mat3b StreamingMedianEstimator::median() const
+	{
+		if (!done()) {
+			SIBR_ERR << "[StreamingMedianEstimator] The median is only available after both passes." << std::endl;
+		}
+		cv::Mat3b out(_numRows, _w);
+		for (int i = 0; i < _numRows; ++i) {
+			std::memcpy(out.ptr<uchar>(i), &_bins[size_t(i) * 3 * _w], 3 * _w);
+		}
+		return out;
+	}
+
+ } // namespace sibr
@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+#include "Config.hpp"
+
+#include <core/video/Video.hpp>
+
+namespace sibr
+{
+
+	/** Single-pass approximation of the per-pixel background color of a video over a band of rows, as the most frequent quantized RGB color.
+	* Colors are quantized jointly with the same bins as VideoUtils::getBackgroundImage (TimeHistogram), but instead of the full
+	* histogram each pixel only tracks numColors color bins (Misra-Gries summary), updated as frames are decoded.
+	* Memory is w*numRows*numColors*6 bytes whatever the number of frames.
+	* The result is exact only when a pixel takes at most numColors distinct quantized colors. Otherwise each count is under-estimated
+	* by up to numFrames/(numColors+1): a color more frequent than that is always tracked, but when the two most frequent colors
+	* are closer than this bound, the one returned can differ from getBackgroundImage.
+	* \ingroup sibr_video
+	*/
+	class SIBR_VIDEO_EXPORT StreamingBackgroundEstimator
+	{
+		SIBR_CLASS_PTR(StreamingBackgroundEstimator);
+
+	public:
+
+		/** Constructor.
+		\param w frames width
+		\param h frames height
+		\param numBins number of bins per channel, in [1,256]
+		\param numColors number of color bins tracked per pixel
+		\param firstRow first row of the band
+		\param numRows number of rows of the band, -1 for all rows after firstRow
+		*/
+		StreamingBackgroundEstimator(int w, int h, int numBins = 50, int numColors = 32, int firstRow = 0, int numRows = -1);
+
+		/** Accumulate a frame.
+		\param frame a 8UC3 frame of the full resolution
+		*/
+		void addFrame(const cv::Mat & frame);
+
+		/** Accumulate a section of a video, decoding one frame at a time.
+		\param vid the video, of the estimator resolution
+		\param time_skiped_begin time to skip at the beginning of the video, in seconds
+		\param time_skiped_end time to skip at the end of the video, in seconds
+		*/
+		void addVideo(sibr::Video & vid, float time_skiped_begin = 0, float time_skiped_end = 0);
+
+		/** \return the number of accumulated frames. */
+		int numFrames() const { return _numFrames; }
+
+		/** \return the mode of the band, a numRows x w image of the middle of the most populated color bin of each pixel
+		(the lowest bin on ties, as TimeHistogram::getHMode) */
+		cv::Mat3b mode() const;
+
+		/** \return the number of bytes used per pixel of the band
+		\param numColors number of color bins tracked per pixel
+		*/
+		static size_t bytesPerPixel(int numColors) { return size_t(numColors) * (sizeof(uint32_t) + sizeof(uint16_t)); }
+
+		/** Reset all pixels. */
+		void clear();
+
+	private:
+
+		int _w, _h; ///< Resolution.
+		int _firstRow, _numRows; ///< Rows of the band.
+		int _numBins; ///< Number of bins per channel.
+		int _numColors; ///< Number of color bins tracked per pixel.
+		int _numFrames = 0; ///< Number of accumulated frames.
+		uchar _binOf[256]; ///< Bin index of each 8-bit value.
+		std::vector<uchar> _binMiddle; ///< Value at the middle of each bin.
+		std::vector<uint32_t> _colors; ///< Tracked color bins, pixel-major, as (r*numBins+g)*numBins+b.
+		std::vector<uint16_t> _counts; ///< Count of each tracked color bin, 0 for an empty slot.
+	};
+
+	/** Exact per-pixel, per-channel median of a video over a band of rows, with the same result as VideoUtils::getMedian.
+	* Computed in two passes over the frames, with 16 bins per channel: the first pass finds the 16-values bin containing the median,
+	* the second one its position inside this bin. Memory is w*numRows*105 bytes whatever the number of frames, up to 65535 frames.
+	* Use several bands to bound the memory on large videos, see VideoUtils::getMedianStreaming.
+	* \ingroup sibr_video
+	*/
+	class SIBR_VIDEO_EXPORT StreamingMedianEstimator
+	{
+		SIBR_CLASS_PTR(StreamingMedianEstimator);
+
+	public:
+
+		/** Constructor.
+		\param w frames width
+		\param h frames height
+		\param firstRow first row of the band
+		\param numRows number of rows of the band, -1 for all rows after firstRow
+		*/
+		StreamingMedianEstimator(int w, int h, int firstRow = 0, int numRows = -1);
+
+		/** Accumulate a frame, in the current pass. All passes should be given the same frames.
+		\param frame a 8UC3 frame of the full resolution
+		*/
+		void addFrame(const cv::Mat & frame);
+
+		/** Accumulate a section of a video in the current pass, decoding one frame at a time.
+		\param vid the video, of the estimator resolution
+		\param time_skiped_begin time to skip at the beginning of the video, in seconds
+		\param time_skiped_end time to skip at the end of the video, in seconds
+		*/
+		void addVideo(sibr::Video & vid, float time_skiped_begin = 0, float time_skiped_end = 0);
+
+		/** End the current pass. */
+		void endPass();
+
+		/** \return true once both passes are completed */
+		bool done() const { return _pass == 2; }
+
+		/** \return the median of the band, a numRows x w image */
+		cv::Mat3b median() const;
+
+		/** \return the number of bytes used per pixel of the band */
+		static size_t bytesPerPixel() { return 3 * (NumBins * sizeof(uint16_t) + sizeof(uchar) + sizeof(uint16_t)); }
+
+	private:
+
+		static const int NumBins = 16; ///< Number of bins per channel and pass.
+
+		int _w, _h; ///< Resolution.
+		int _firstRow, _numRows; ///< Rows of the band.
+		int _pass = 0; ///< Current pass: 0 for the coarse bins, 1 for the values inside the median bin, 2 when done.
+		int _numFrames = 0; ///< Number of frames accumulated in the current pass.
+		int _coarseFrames = 0; ///< Number of frames accumulated in the first pass.
+		std::vector<uint16_t> _counts; ///< Histograms of the current pass, pixel-major then channel then bin.
+		std::vector<uchar> _bins; ///< Coarse bin of the median, then the median itself, per pixel channel.
+		std::vector<uint16_t> _ranks; ///< Rank of the median inside its coarse bin, per pixel channel.
+	};
+
+ } // namespace sibr
@@ -11,8 +11,10 @@
 
 
 #include "VideoUtils.hpp"
+#include "StreamingBackgroundEstimator.hpp"
 
 #include <core/graphics/Utils.hpp>
+#include <core/system/SimpleTimer.hpp>
 #include <algorithm>
 
 
@@ -412,6 +414,189 @@ namespace sibr {
 		return bg;
 	}
 
+	namespace
+	{
+		/** Maximum number of bands of the streaming estimators, each band decoding the video again. */
+		const int maxStreamingBands = 4;
+
+		/** Number of rows of the bands of a streaming estimator: all rows in a single band when the budget allows it,
+		otherwise as many rows as the budget allows, but never more than maxStreamingBands bands.
+		\param w frames width
+		\param h frames height
+		\param bytesPerPixel state size per pixel of the estimator
+		\param maxMemoryMB memory budget, in megabytes
+		\return the number of rows per band
+		*/
+		int streamingBandRows(int w, int h, size_t bytesPerPixel, int maxMemoryMB)
+		{
+			const size_t budget = size_t(std::max(1, maxMemoryMB)) * 1024 * 1024;
+			const int budgetRows = int(std::min(budget / (size_t(w) * bytesPerPixel), size_t(h)));
+			const int minRows = (h + maxStreamingBands - 1) / maxStreamingBands;
+			if (budgetRows < minRows) {
+				SIBR_WRG << "[VideoUtils] Streaming estimation needs " << size_t(w) * minRows * bytesPerPixel / (1024 * 1024)
+					<< "MB, more than the " << maxMemoryMB << "MB budget, to decode the video at most " << maxStreamingBands << " times." << std::endl;
+			}
+			return sibr::clamp(std::max(budgetRows, minRows), 1, h);
+		}
+	}
+
+	cv::Mat3b VideoUtils::getMedianStreaming(sibr::Video & vid, float time_skiped_begin, float time_skiped_end, int maxMemoryMB)
+	{
+		const int w = vid.getResolution()[0];
+		const int h = vid.getResolution()[1];
+		const int bandRows = streamingBandRows(w, h, StreamingMedianEstimator::bytesPerPixel(), maxMemoryMB);
+
+		cv::Mat3b median(h, w);
+		for (int firstRow = 0; firstRow < h; firstRow += bandRows) {
+			StreamingMedianEstimator estimator(w, h, firstRow, bandRows);
+			while (!estimator.done()) {
+				estimator.addVideo(vid, time_skiped_begin, time_skiped_end);
+				estimator.endPass();
+			}
+			const cv::Mat3b band = estimator.median();
+			band.copyTo(median.rowRange(firstRow, firstRow + band.rows));
+		}
+		return median;
+	}
+
+	cv::Mat3b VideoUtils::getBackgroundImageStreaming(sibr::Video & vid, int numBins, float time_skip_begin, float time_skip_end, int numColors, int maxMemoryMB)
+	{
+		const int w = vid.getResolution()[0];
+		const int h = vid.getResolution()[1];
+		const int bandRows = streamingBandRows(w, h, StreamingBackgroundEstimator::bytesPerPixel(numColors), maxMemoryMB);
+
+		cv::Mat3b background(h, w);
+		for (int firstRow = 0; firstRow < h; firstRow += bandRows) {
+			StreamingBackgroundEstimator estimator(w, h, numBins, numColors, firstRow, bandRows);
+			estimator.addVideo(vid, time_skip_begin, time_skip_end);
+			const cv::Mat3b band = estimator.mode();
+			band.copyTo(background.rowRange(firstRow, firstRow + band.rows));
+		}
+		return background;
+	}
+
+	bool VideoUtils::checkStreaming(int numBins)
+	{
+		// Static background with random colors, covered 40% of the time by moving squares of random colors.
+		const int w = 64, h = 48, numFrames = 100;
+		cv::RNG rng(0x5EED);
+		cv::Mat3b background(h, w);
+		rng.fill(background, cv::RNG::UNIFORM, 0, 256);
+
+		// Two bands of rows, as with a small memory budget.
+		const int bandRows = h / 2;
+		std::vector<StreamingMedianEstimator> medians;
+		std::vector<StreamingBackgroundEstimator> modes;
+		for (int firstRow = 0; firstRow < h; firstRow += bandRows) {
+			medians.emplace_back(w, h, firstRow, bandRows);
+			modes.emplace_back(w, h, numBins, 32, firstRow, bandRows);
+		}
+
+		std::vector<cv::Mat3b> frames(numFrames);
+		for (int t = 0; t < numFrames; ++t) {
+			frames[t] = background.clone();
+			for (int i = 0; i < h; ++i) {
+				for (int j = 0; j < w; ++j) {
+					if ((i / 8 + j / 8 + t) % 5 < 2) {
+						frames[t](i, j) = cv::Vec3b(uchar(rng.uniform(0, 256)), uchar(rng.uniform(0, 256)), uchar(rng.uniform(0, 256)));
+					}
+				}
+			}
+			for (StreamingBackgroundEstimator & mode : modes) {
+				mode.addFrame(frames[t]);
+			}
+		}
+		for (StreamingMedianEstimator & median : medians) {
+			while (!median.done()) {
+				for (const cv::Mat3b & frame : frames) {
+					median.addFrame(frame);
+				}
+				median.endPass();
+			}
+		}
+
+		// The background is the majority value of each pixel, so it is the median. The mode is the middle of its bin.
+		cv::Mat3b expectedMode(h, w);
+		for (int i = 0; i < h; ++i) {
+			for (int j = 0; j < w; ++j) {
+				TimeHistogram histo(0, 255, numBins);
+				const cv::Vec3b & c = background(i, j);
+				histo.addValues({ sibr::Vector3ub(c[0], c[1], c[2]) });
+				const sibr::Vector3ub middle = histo.getBinMiddle(histo.getHMode());
+				expectedMode(i, j) = cv::Vec3b(middle[0], middle[1], middle[2]);
+			}
+		}
+
+		const auto countErrors = [](const cv::Mat3b & result, const cv::Mat3b & expected) {
+			int errors = 0;
+			for (int i = 0; i < result.rows; ++i) {
+				for (int j = 0; j < result.cols; ++j) {
+					errors += result(i, j) != expected(i, j) ? 1 : 0;
+				}
+			}
+			return errors;
+		};
+		int medianErrors = 0, modeErrors = 0;
+		for (size_t b = 0; b < medians.size(); ++b) {
+			const cv::Range rows(int(b) * bandRows, int(b + 1) * bandRows);
+			medianErrors += countErrors(medians[b].median(), background.rowRange(rows));
+			modeErrors += countErrors(modes[b].mode(), expectedMode.rowRange(rows));
+		}
+		SIBR_LOG << "[VideoUtils] Synthetic clip: " << medianErrors << " wrong median pixels, " << modeErrors
+			<< " wrong background pixels out of " << w * h << "." << std::endl;
+		return medianErrors == 0 && modeErrors == 0;
+	}
+
+	void VideoUtils::compareStreaming(sibr::Video & vid, int numBins, float time_skip_begin, float time_skip_end)
+	{
+		if (!checkStreaming(numBins)) {
+			SIBR_WRG << "[VideoUtils] Streaming estimators do not find the known median and background of the synthetic clip." << std::endl;
+		}
+
+		const int w = vid.getResolution()[0];
+		const int h = vid.getResolution()[1];
+		const int numFrames = vid.getNumFrames() - (int)(time_skip_begin * vid.getFrameRate()) - (int)(time_skip_end * vid.getFrameRate());
+		const double volumeMB = double(numFrames) * w * h * 3 / (1024.0 * 1024.0);
+
+		const auto compare = [](const std::string & name, const cv::Mat3b & reference, const cv::Mat3b & streaming,
+			double referenceTime, double streamingTime, double referenceMB, double streamingMB) {
+			cv::Mat3b diff;
+			cv::absdiff(reference, streaming, diff);
+			int identical = 0;
+			for (int i = 0; i < diff.rows; ++i) {
+				for (int j = 0; j < diff.cols; ++j) {
+					identical += diff(i, j) == cv::Vec3b(0, 0, 0) ? 1 : 0;
+				}
+			}
+			const cv::Scalar meanDiff = cv::mean(diff);
+			SIBR_LOG << "[VideoUtils] " << name << ": " << referenceTime << "s and " << referenceMB << "MB, streaming "
+				<< streamingTime << "s and " << streamingMB << "MB, " << 100.0 * identical / double(diff.total()) << "% identical pixels, mean difference "
+				<< (meanDiff[0] + meanDiff[1] + meanDiff[2]) / 3.0 << "." << std::endl;
+		};
+
+		const int maxMemoryMB = 1024;
+		const double medianMB = std::min(double(maxMemoryMB), double(w) * h * StreamingMedianEstimator::bytesPerPixel() / (1024.0 * 1024.0));
+		const double backgroundMB = std::min(double(maxMemoryMB), double(w) * h * StreamingBackgroundEstimator::bytesPerPixel(32) / (1024.0 * 1024.0));
+
+		sibr::Timer timer;
+		timer.tic();
+		const cv::Mat3b median = getMedian(vid, time_skip_begin, time_skip_end);
+		const double medianTime = timer.deltaTimeFromLastTic<Timer::micro>() / 1000000.0;
+		timer.tic();
+		const cv::Mat3b medianStreaming = getMedianStreaming(vid, time_skip_begin, time_skip_end, maxMemoryMB);
+		const double medianStreamingTime = timer.deltaTimeFromLastTic<Timer::micro>() / 1000000.0;
+		compare("Median", median, medianStreaming, medianTime, medianStreamingTime, volumeMB, medianMB);
+
+		// getBackgroundImage also holds the transposed volume.
+		timer.tic();
+		const cv::Mat3b background = getBackgroundImage(vid, numBins, time_skip_begin, time_skip_end);
+		const double backgroundTime = timer.deltaTimeFromLastTic<Timer::micro>() / 1000000.0;
+		timer.tic();
+		const cv::Mat3b backgroundStreaming = getBackgroundImageStreaming(vid, numBins, time_skip_begin, time_skip_end, 32, maxMemoryMB);
+		const double backgroundStreamingTime = timer.deltaTimeFromLastTic<Timer::micro>() / 1000000.0;
+		compare("Background", background, backgroundStreaming, backgroundTime, backgroundStreamingTime, 2.0 * volumeMB, backgroundMB);
+	}
+
 	void VideoUtils::getBackGroundVideo(sibr::Video & vid, PyramidLayer & out_mask, PyramidLayer & out_video, cv::Mat & out_img,
 		const sibr::ImageRGB & meanImg, int threshold, int numBins, float time_skip_begin, float time_skip_end)
 	{
@@ -1066,6 +1066,49 @@ namespace sibr {
 
 		static cv::Mat getBackgroundImage(sibr::Video & vid, int numBins = 50, float time_skip_begin = 0, float time_skip_end = 0);
 		static cv::Mat getBackgroundImage(const cv::Mat volume, int w, int h, int numBins = 50);
+
+		/** Median computed while decoding, with the same result as getMedian but without loading the video volume.
+		The exact median needs two decoding passes. All rows are processed at once when their state fits in the memory budget,
+		otherwise in bands of rows, each band decoding the video twice again. There are at most 4 bands, exceeding the budget if needed.
+		\param vid the video
+		\param time_skiped_begin time to skip at the beginning of the video, in seconds
+		\param time_skiped_end time to skip at the end of the video, in seconds
+		\param maxMemoryMB memory budget, in megabytes
+		\return the median image
+		*/
+		static cv::Mat3b getMedianStreaming(sibr::Video & vid, float time_skiped_begin = 0, float time_skiped_end = 0, int maxMemoryMB = 1024);
+
+		/** Approximation of getBackgroundImage computed while decoding, without loading the video volume: the most frequent quantized RGB color
+		is estimated from a bounded number of colors per pixel, see StreamingBackgroundEstimator for the error bounds.
+		All rows are processed in a single decoding pass when their state fits in the memory budget, otherwise in bands of rows,
+		each band decoding the video again. There are at most 4 bands, exceeding the budget if needed.
+		\param vid the video
+		\param numBins number of bins per channel
+		\param time_skip_begin time to skip at the beginning of the video, in seconds
+		\param time_skip_end time to skip at the end of the video, in seconds
+		\param numColors number of color bins tracked per pixel
+		\param maxMemoryMB memory budget, in megabytes
+		\return the background image
+		*/
+		static cv::Mat3b getBackgroundImageStreaming(sibr::Video & vid, int numBins = 50, float time_skip_begin = 0, float time_skip_end = 0,
+			int numColors = 32, int maxMemoryMB = 1024);
+
+		/** Check the streaming estimators on a synthetic clip with a known median and background: a static background
+		covered 40% of the time by moving squares of random colors. Log the number of wrong pixels.
+		\param numBins number of bins per channel for the background
+		\return true if both the median and the background are found for all pixels
+		*/
+		static bool checkStreaming(int numBins = 50);
+
+		/** Check the streaming estimators on a synthetic clip, then log the time, memory and differences of getMedianStreaming
+		and getBackgroundImageStreaming compared to getMedian and getBackgroundImage on a video.
+		\param vid the video
+		\param numBins number of bins per channel for the background images
+		\param time_skip_begin time to skip at the beginning of the video, in seconds
+		\param time_skip_end time to skip at the end of the video, in seconds
+		*/
+		static void compareStreaming(sibr::Video & vid, int numBins = 50, float time_skip_begin = 0, float time_skip_end = 0);
+
 		static void getBackGroundVideo(sibr::Video & vid, PyramidLayer & out_mask, PyramidLayer & out_video, cv::Mat & mask,
 			const sibr::ImageRGB & mean = {}, int threshold = 75, int numBins = 50, float time_skip_begin = 0, float time_skip_end = 0);
 
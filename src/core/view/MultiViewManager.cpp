@@ -85,6 +85,7 @@ namespace sibr
 	void MultiViewBase::onRender(Window& win)
 	{
 		// Render all views.
+		_capturedFrame = false;
 		for (auto & subview : _ibrSubViews) {
 			if (subview.second.view->active()) {
 
@@ -115,6 +116,10 @@ namespace sibr
 			subMultiView.second->onRender(win);
 		}
 
+		// Recording has stopped, retrieve the frames still in flight.
+		if (!_capturedFrame) {
+			collectFrames(0);
+		}
 
 	}
 
@@ -220,17 +225,12 @@ namespace sibr
 			subview.render(_renderingMode, renderViewport);
 
 			// Offline video dumping, continued. We ignore additional rendering as those often are GUI overlays.
+			// Readbacks are asynchronous, a frame is retrieved a few frames later.
 			if (subview.handler != NULL && (subview.handler->getCamera().needVideoSave() || subview.handler->getCamera().needSave())) {
-				
-				ImageRGB frame;
-
-				subview.rt->readBack(frame);
-				
-				if (subview.handler->getCamera().needSave()) {
-					frame.save(subview.handler->getCamera().savePath());
-				}
-				_videoFrames.push_back(frame.toOpenCVBGR());
-				
+				const sibr::Camera & camera = subview.handler->getCamera();
+				_pendingFrames.push_back({ subview.rt->requestReadBack(_frameReadback), camera.needSave() ? camera.savePath() : "" });
+				collectFrames(_frameReadback.numBuffers() - 1);
+				_capturedFrame = true;
 			}
 			
 			// Additional rendering.
@@ -329,6 +329,19 @@ namespace sibr
 		}
 	}
 
+	void MultiViewBase::collectFrames(size_t maxPending)
+	{
+		while (_pendingFrames.size() > maxPending) {
+			ImageRGB frame;
+			_frameReadback.retrieve(_pendingFrames.front().ticket, frame);
+			if (!_pendingFrames.front().savePath.empty()) {
+				frame.save(_pendingFrames.front().savePath);
+			}
+			_videoFrames.push_back(frame.toOpenCVBGR());
+			_pendingFrames.pop_front();
+		}
+	}
+
 	void MultiViewBase::captureView(const SubView & view, const std::string& path, const std::string & filename) {
 
 		const uint w = view.rt->w();
@@ -619,6 +632,7 @@ namespace sibr
 					std::string saveFile;
 					if (showFilePicker(saveFile, FilePickerMode::Save)) {
 						const std::string outputVideo = saveFile + ".mp4";
+						collectFrames(0);
 						if(!_videoFrames.empty()) {
 							SIBR_LOG << "Exporting video to : " << outputVideo << " ..." << std::flush;
 							FFVideoEncoder vdoEncoder(outputVideo, 30, Vector2i(_videoFrames[0].cols, _videoFrames[0].rows));
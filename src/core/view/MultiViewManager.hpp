@@ -14,6 +14,7 @@
 
 # include <type_traits>
 # include <chrono>
+# include <deque>
 
 # include "core/view/Config.hpp"
 # include "core/graphics/Window.hpp"
@@ -367,6 +368,17 @@ namespace sibr
 		 *\note if the filename is empty, the name of the view is used, with a timestamp appended.
 		 **/
 		static void captureView(const SubView & view, const std::string & path = "./screenshots/", const std::string & filename = "");
+
+		/** Retrieve the oldest captured frames, saving them and appending them to the video frames.
+		 *\param maxPending the number of most recent frames that can stay in flight
+		 **/
+		void collectFrames(size_t maxPending);
+
+		/** Frame captured during a path playback, waiting for its readback. */
+		struct PendingFrame {
+			AsyncReadback::Ticket ticket; ///< Readback ticket.
+			std::string savePath; ///< Image destination, empty if the frame is only used for the video.
+		};
 		
 		IRenderingMode::Ptr _renderingMode = nullptr; ///< Rendering mode.
 		std::map<std::string, BasicSubView> _subViews; ///< Regular subviews.
@@ -377,6 +389,9 @@ namespace sibr
 
 		std::string _exportPath; ///< Capture output path.
 		std::vector<cv::Mat> _videoFrames; ///< Video frames.
+		AsyncReadback _frameReadback; ///< Readback of captured frames.
+		std::deque<PendingFrame> _pendingFrames; ///< Captured frames still in flight.
+		bool _capturedFrame = false; ///< Whether a subview captured a frame during the current rendering.
 
 		std::chrono::time_point<std::chrono::steady_clock> _timeLastFrame; ///< Last frame time point.
 		float _deltaTime; ///< Elapsed time.
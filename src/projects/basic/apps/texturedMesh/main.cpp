@@ -16,6 +16,7 @@
 #include <projects/basic/renderer/TexturedMeshView.hpp>
 #include <core/scene/BasicIBRScene.hpp>
 #include <core/raycaster/Raycaster.hpp>
+#include <core/graphics/MeshInstances.hpp>
 #include <core/view/SceneDebugView.hpp>
 
 #define PROGRAM_NAME "sibr_texturedMesh_app"
@@ -29,7 +30,7 @@ const char* usage = ""
 struct TexturedMeshAppArgs :
 	virtual BasicIBRAppArgs {
 	Arg<std::string> textureImagePath = { "texture", "" ,"texture path"};
-	Arg<std::string> meshPath = { "mesh", "", "mesh path" };
+	Arg<std::string> meshPath = { "mesh", "", "mesh path, a Mitsuba XML scene keeps its repeated shapes shared for raycasting" };
 	Arg<bool> noScene = { "noScene" };
 };
 
@@ -136,7 +137,19 @@ int main( int ac, char** av )
 		}
 		*/
 
-		if (myArgs.noScene) {
+		// Mitsuba scenes are raycasted with shared instances, and flattened once for display.
+		MeshInstances::Ptr instances;
+		if (sibr::getExtension(myArgs.meshPath.get()) == "xml") {
+			meshPath = myArgs.meshPath;
+		}
+		if (sibr::getExtension(meshPath) == "xml") {
+			instances = MeshInstances::load(meshPath);
+			if (!instances) {
+				SIBR_ERR << "Unable to load the Mitsuba scene " << meshPath << std::endl;
+			}
+			scene->proxies()->replaceProxyPtr(instances->flatten(true));
+		}
+		else if (myArgs.noScene) {
 			Mesh::Ptr newMesh(new Mesh(true));
 			newMesh->load(meshPath);
 			scene->proxies()->replaceProxyPtr(newMesh);
@@ -157,7 +170,12 @@ int main( int ac, char** av )
 		// Raycaster.
 		std::shared_ptr<sibr::Raycaster> raycaster = std::make_shared<sibr::Raycaster>();
 		raycaster->init();
-		raycaster->addMesh(scene->proxies()->proxy());
+		if (instances) {
+			raycaster->addInstances(*instances);
+		}
+		else {
+			raycaster->addMesh(scene->proxies()->proxy());
+		}
 
 		// Camera handler for main view.
 		sibr::InteractiveCameraHandler::Ptr generalCamera(new InteractiveCameraHandler());
@@ -12,10 +12,13 @@
 
 
 #include <fstream>
+#include <numeric>
 #include <boost/filesystem.hpp>
 #include <core/system/Utils.hpp>
+#include <core/system/SimpleTimer.hpp>
 #include <opencv2/features2d/features2d.hpp>
 #include <opencv2/flann/flann.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
 #include <core/renderer/DepthRenderer.hpp>
 #include <core/graphics/Window.hpp>
 #include <core/scene/BasicIBRScene.hpp>
@@ -204,6 +207,96 @@ static void loadRawSynthetic(std::string pathSynthetic, std::vector<sibr::InputC
 }
 
 
+/** One level of the image matching pyramid: the spectrum of each channel, zero padded to a DFT size shared by the
+ reference and template images, and the integral image of the squared values summed over channels. */
+struct MatchLevel {
+	std::vector<cv::Mat> spectra;
+	cv::Mat sqIntegral;
+	cv::Size size;
+};
+
+/** DFT size used to match images of a given size at a pyramid factor. */
+cv::Size matchDftSize(const cv::Size& size, int factor)
+{
+	return cv::Size(cv::getOptimalDFTSize(size.width / factor), cv::getOptimalDFTSize(size.height / factor));
+}
+
+/** Build a pyramid level of a 3 channels image. Each texel averages a block of factor*factor pixels, so that the sum of squared
+ differences of block aligned windows at full resolution is at least factor*factor times the one of the level. */
+MatchLevel buildMatchLevel(const cv::Mat& image, int factor, const cv::Size& dftSize)
+{
+	cv::Mat values;
+	image.convertTo(values, CV_64FC3);
+	if (factor > 1) {
+		const cv::Size size(image.cols / factor, image.rows / factor);
+		cv::Mat reduced;
+		cv::resize(values(cv::Rect(0, 0, size.width * factor, size.height * factor)), reduced, size, 0, 0, cv::INTER_AREA);
+		values = reduced;
+	}
+
+	MatchLevel level;
+	level.size = values.size();
+	std::vector<cv::Mat> channels;
+	cv::split(values, channels);
+	cv::Mat squares = cv::Mat::zeros(level.size, CV_64F);
+	for (const cv::Mat& channel : channels) {
+		cv::Mat padded = cv::Mat::zeros(dftSize, CV_64F);
+		channel.copyTo(padded(cv::Rect(cv::Point(0, 0), level.size)));
+		cv::Mat spectrum;
+		cv::dft(padded, spectrum, 0, level.size.height);
+		level.spectra.push_back(spectrum);
+		squares += channel.mul(channel);
+	}
+	cv::integral(squares, level.sqIntegral, CV_64F);
+	return level;
+}
+
+/** Find the window of a reference level closest to a template level, in the sum of squared differences sense.
+ The cross term is obtained for all windows at once by correlation in the frequency domain, the window energies from the integral image.
+\param ref the reference level
+\param tmpl the template level, sharing the DFT size of the reference
+\param maxOffset the largest window top left corner
+\param step the offset step
+\param integer should the sums be rounded, for 8 bits images at full resolution, so that ties are resolved as in the spatial domain
+\param bestOffset will contain the top left corner of the best window, the first one in x then y order on ties
+\return the smallest sum of squared differences
+*/
+double bestWindowSSD(const MatchLevel& ref, const MatchLevel& tmpl, const cv::Point& maxOffset, int step, bool integer, cv::Point& bestOffset)
+{
+	cv::Mat crossSpectrum, product;
+	for (size_t c = 0; c < ref.spectra.size(); c++) {
+		cv::mulSpectrums(ref.spectra[c], tmpl.spectra[c], product, 0, true);
+		if (c == 0) {
+			crossSpectrum = product.clone();
+		}
+		else {
+			crossSpectrum += product;
+		}
+	}
+	cv::Mat correlation;
+	cv::idft(crossSpectrum, correlation, cv::DFT_SCALE | cv::DFT_REAL_OUTPUT);
+
+	const int tw = tmpl.size.width;
+	const int th = tmpl.size.height;
+	const cv::Mat& sq = ref.sqIntegral;
+	const double tmplEnergy = tmpl.sqIntegral.at<double>(th, tw);
+	double bestSSD = DBL_MAX;
+	for (int x = 0; x <= maxOffset.x; x += step) {
+		for (int y = 0; y <= maxOffset.y; y += step) {
+			const double windowEnergy = sq.at<double>(y + th, x + tw) - sq.at<double>(y, x + tw) - sq.at<double>(y + th, x) + sq.at<double>(y, x);
+			double ssd = std::max(0.0, windowEnergy - 2.0 * correlation.at<double>(y, x) + tmplEnergy);
+			if (integer) {
+				ssd = std::round(ssd);
+			}
+			if (ssd < bestSSD) {
+				bestSSD = ssd;
+				bestOffset = cv::Point(x, y);
+			}
+		}
+	}
+	return bestSSD;
+}
+
 int assignImages(
 	std::vector<sibr::ImageRGB::Ptr>& imgs2Align, std::vector<sibr::ImageRGB>& imgs2AlignSmall,
 	std::vector<sibr::ImageRGB::Ptr>& imgsRef, std::vector<sibr::ImageRGB>& imgsRefSmall,
@@ -212,6 +305,32 @@ int assignImages(
 {
 	int assignCnt = 0;
 	std::cout << "Assigning " << imgs2Align.size() << " cameras from the set to align to the fixed one: ";
+
+	// Each image is compared to the references for all the positions of a 6/8 window over +-1/8 of the image, in steps of 4 pixels.
+	// The sums of squared differences are computed coarse to fine: first on thumbnails averaging 4x4 blocks, that bound the distances
+	// of all the pairs from below, then at full resolution only for the pairs that can still be the best match or the median.
+	// The reference spectra are computed once for all images.
+	const int factor = 4;
+	const int refineBatch = 16;
+	const cv::Size refSize = imgsRefSmall.empty() ? cv::Size(0, 0) : cv::Size(imgsRefSmall[0].w(), imgsRefSmall[0].h());
+	const cv::Size fullDftSize = matchDftSize(refSize, 1);
+	const cv::Size thumbDftSize = matchDftSize(refSize, factor);
+	const cv::Point maxOffset(2 * (refSize.width / 8), 2 * (refSize.height / 8));
+	const cv::Point maxThumbOffset(maxOffset.x / factor, maxOffset.y / factor);
+
+	sibr::Timer timer;
+	timer.tic();
+	std::vector<MatchLevel> refLevels(imgsRefSmall.size());
+	std::vector<MatchLevel> refThumbs(imgsRefSmall.size());
+#pragma omp parallel for
+	for (int j = 0; j < int(imgsRefSmall.size()); j++) {
+		SIBR_ASSERT(imgsRefSmall[j].w() == refSize.width && imgsRefSmall[j].h() == refSize.height);
+		refLevels[j] = buildMatchLevel(imgsRefSmall[j].toOpenCV(), 1, fullDftSize);
+		refThumbs[j] = buildMatchLevel(imgsRefSmall[j].toOpenCV(), factor, thumbDftSize);
+	}
+	size_t pairCount = 0;
+	size_t refinedCount = 0;
+
 	//We then look for closest match and assign it only if the distance between the images is half the median distance
 	//This prevent issues in the case were a camera is missing from one set
 	for (int i = 0; i < imgs2Align.size(); i++) {
@@ -219,50 +338,77 @@ int assignImages(
 		std::cout << "Assigning camera " << i << ", ";
 
 		sibr::ImageRGB& im2Align = imgs2AlignSmall[i];
-		sibr::Vector2i pos2Align(resizeW / 2, im2Align.h() / 2);
-
-		double minImDist = DBL_MAX;
-		int bestIm = -1;
-
-		std::vector<double> dists;
-		std::cerr << "2 ALIGN TESTING " << std::endl;
+		SIBR_ASSERT(im2Align.w() == refSize.width && im2Align.h() == refSize.height);
 
 		cv::Rect centerROI(im2Align.w() / 8, im2Align.h() / 8, 6 * im2Align.w() / 8, 6 * im2Align.h() / 8);
+		const cv::Mat tmplImage = im2Align.toOpenCV()(centerROI);
+		const MatchLevel tmplLevel = buildMatchLevel(tmplImage, 1, fullDftSize);
+		const MatchLevel tmplThumb = buildMatchLevel(tmplImage, factor, thumbDftSize);
 
+		std::vector<int> candidates;
 		for (int j = 0; j < imgsRef.size(); j++) {
-			if (assignedCam.find(j) != assignedCam.end())
-				continue;
-
-			sibr::ImageRGB& imRef = imgsRefSmall[j];
-			double minDist = DBL_MAX;
-			int wIm = imRef.w();
-			int hIm = imRef.h();
-
-			for (int dx = -wIm / 8; dx <= wIm / 8; dx += 4) {
-				for (int dy = -hIm / 8; dy <= hIm / 8; dy += 4) {
-					cv::Rect shiftROI(dx + wIm / 8, dy + hIm / 8, 6 * wIm / 8, 6 * hIm / 8);
-					double d = cv::norm(imRef.toOpenCV()(shiftROI), im2Align.toOpenCV()(centerROI));
-					if (d < minDist)
-					{
-						minDist = d;
-					}
-				}
+			if (assignedCam.find(j) == assignedCam.end()) {
+				candidates.push_back(j);
 			}
+		}
+		const int candidateCount = int(candidates.size());
 
-			dists.push_back(minDist);
+		std::vector<double> bounds(candidateCount);
+#pragma omp parallel for
+		for (int c = 0; c < candidateCount; c++) {
+			cv::Point thumbOffset;
+			const double thumbSSD = bestWindowSSD(refThumbs[candidates[c]], tmplThumb, maxThumbOffset, 1, false, thumbOffset);
+			// Keep a margin for the rounding errors of the transforms.
+			bounds[c] = std::max(0.0, factor * std::sqrt(thumbSSD) * (1.0 - 1e-6) - 1e-6);
+		}
+		std::vector<int> order(candidateCount);
+		std::iota(order.begin(), order.end(), 0);
+		std::stable_sort(order.begin(), order.end(), [&bounds](int a, int b) { return bounds[a] < bounds[b]; });
+
+		// Refine the pairs by increasing bound, until all the remaining bounds are above the median of the refined distances:
+		// the remaining pairs can then be neither the best match nor change the median.
+		std::vector<double> dists(candidateCount, -1.0);
+		std::vector<cv::Point> offsets(candidateCount);
+		const int medianRank = candidateCount / 2;
+		double medianDist = 0.0;
+		int refined = 0;
+		int target = std::min(candidateCount, medianRank + 1);
+		while (refined < candidateCount) {
+#pragma omp parallel for
+			for (int r = refined; r < target; r++) {
+				const int c = order[r];
+				dists[c] = std::sqrt(bestWindowSSD(refLevels[candidates[c]], tmplLevel, maxOffset, 4, true, offsets[c]));
+			}
+			refined = target;
 
-			if (minDist < minImDist) {
-				minImDist = minDist;
-				bestIm = j;
+			std::vector<double> refinedDists(refined);
+			for (int r = 0; r < refined; r++) {
+				refinedDists[r] = dists[order[r]];
+			}
+			std::nth_element(refinedDists.begin(), refinedDists.begin() + medianRank, refinedDists.end());
+			medianDist = refinedDists[medianRank];
+			if (refined == candidateCount || medianDist <= bounds[order[refined]]) {
+				break;
+			}
+			target = std::min(candidateCount, refined + refineBatch);
+		}
+		pairCount += candidateCount;
+		refinedCount += refined;
 
-				//show(imRef);
-				//show(im2Align);
+		double minImDist = DBL_MAX;
+		int bestIm = -1;
+		cv::Point bestOffset;
+		for (int c = 0; c < candidateCount; c++) {
+			if (dists[c] >= 0.0 && dists[c] < minImDist) {
+				minImDist = dists[c];
+				bestIm = candidates[c];
+				bestOffset = offsets[c];
 			}
 		}
 
-		std::sort(dists.begin(), dists.end());
-		std::cerr << " SIZe " << dists.size() << " min " << minImDist << " half " << threshold * dists[dists.size() / 2] << std::endl;
-		if (dists.size() > 5 && minImDist < threshold * dists[dists.size() / 2]) {
+		std::cerr << " SIZe " << candidateCount << " min " << minImDist << " half " << threshold * medianDist;
+		std::cerr << " offset " << bestOffset.x - refSize.width / 8 << "," << bestOffset.y - refSize.height / 8 << std::endl;
+		if (candidateCount > 5 && minImDist < threshold * medianDist) {
 			alignCamToRef[i] = bestIm;
 			assignedCam.emplace(bestIm);
 			std::wcout << i << " -> " << bestIm << " -- " << cams2Align[i]->name().c_str() << " -> " << camsRef[bestIm]->name().c_str() << std::endl;
@@ -271,13 +417,19 @@ int assignImages(
 		else {
 			alignCamToRef[i] = -1;
 			std::wcout << i << " -> " << "Not assigned " << std::endl;
-			std::wcout << i << " BEST MATCH -> " << bestIm << " -- " << cams2Align[i]->name().c_str() << " -> " << camsRef[bestIm]->name().c_str() << std::endl;
+			if (bestIm >= 0) {
+				std::wcout << i << " BEST MATCH -> " << bestIm << " -- " << cams2Align[i]->name().c_str() << " -> " << camsRef[bestIm]->name().c_str() << std::endl;
+			}
 		}
 
 		//show(imgs2Align[i]);
 		//show(imgsRef[bestIm]);
 
 	}
+
+	const double seconds = timer.deltaTimeFromLastTic<sibr::Timer::micro>() * 1e-6;
+	SIBR_LOG << "Matched " << pairCount << " image pairs in " << seconds << "s (" << double(pairCount) / std::max(seconds, 1e-9)
+		<< " pairs/s), " << refinedCount << " refined at full resolution." << std::endl;
 	return assignCnt;
 }
 
@@ -11,6 +11,7 @@
 
 
 #include <core/imgproc/CropScaleImageUtility.hpp>
+#include <core/imgproc/ImagePipeline.hpp>
 #include <core/system/CommandLineArgs.hpp>
 
 
@@ -22,7 +23,6 @@ if scale down factor is also passed, after the image has been cropped, it will b
 const char* USAGE = "Usage: cropFromCenter --inputFile <path_to_input_file> --outputPath <path_to_output_folder> --avgResolution <width x height> --cropResolution <width x height> [--scaleDownFactor <alpha> --targetResolution <width x height>] \n";
 //const char* USAGE						= "Usage: cropFromCenter --inputFile <path_to_input_file> --outputPath <path_to_output_folder> --avgResolution <width x height> --cropResolution <widht x height> [--scaleDownFactor <alpha> --targetResolution <width x height>] \n";
 const char* TAG = "[cropFromCenter]";
-const unsigned PROCESSING_BATCH_SIZE = 150;
 const char* LOG_FILE_NAME = "cropFromCenter.log";
 const char* SCALED_DOWN_SUBFOLDER = "scaled";
 const char* SCALED_DOWN_FILENAME = "scale_factor.txt";
@@ -35,6 +35,9 @@ struct CropAppArgs :
 	sibr::Arg<sibr::Vector2i> cropResolutionArg = { "cropResolution",{ 0, 0 } };
 	sibr::Arg<float> scaleDownFactorArg = { "scaleDownFactor", 0.0f };
 	sibr::Arg<sibr::Vector2i> targetResolutionArg = { "targetResolution",{ 0, 0 } };
+	sibr::Arg<int> readersArg = { "readers", 0, "number of decoding threads (0 for automatic)" };
+	sibr::Arg<int> workersArg = { "workers", 0, "number of cropping/resizing threads (0 for automatic)" };
+	sibr::Arg<int> writersArg = { "writers", 0, "number of encoding threads (0 for automatic)" };
 };
 
 void printUsage()
@@ -118,63 +121,88 @@ int main(const int argc, const char** argv)
 	std::vector<sibr::CropScaleImageUtility::Image> listOfImages(pathToImgs.size());
 	std::vector<sibr::CropScaleImageUtility::Image> listOfImagesScaledDown(scaleDown ? pathToImgs.size() : 0);
 
-	// calculate nr batches
-	const int nrBatches = static_cast<int>(ceil((float)(pathToImgs.size()) / PROCESSING_BATCH_SIZE));
+	// Decoding, cropping/resizing and encoding run on separate threads, each image is decoded once and written in both sizes.
+	CropAppArgs myArgs;
+	sibr::ImagePipeline pipeline(myArgs.readersArg, myArgs.workersArg, myArgs.writersArg);
+
+	const auto outputName = [](const sibr::ImagePipeline::Item & item) {
+		std::stringstream ss;
+		ss << std::setfill('0') << std::setw(8) << item.id << boost::filesystem::path(item.name).extension().string();
+		return ss.str();
+	};
 
 	std::chrono::time_point <std::chrono::system_clock> start, end;
 	start = std::chrono::system_clock::now();
 
-	const int batchSize = int(PROCESSING_BATCH_SIZE);
-	// run batches sequentially
-	for (int batchId = 0; batchId < nrBatches; batchId++) {
-
-		const int nrItems = (batchId != nrBatches - 1) ? batchSize : ((nrBatches * batchSize != int(pathToImgs.size())) ? (int(pathToImgs.size()) - (batchSize * batchId)) : batchSize);
-
-		#pragma omp parallel for
-		for (int localImgIndex = 0; localImgIndex < nrItems; localImgIndex++) {
-
-			const int globalImgIndex = (batchId * batchSize) + localImgIndex;
-
-			// using next code will keep filename in output directory
-			boost::filesystem::path boostPath(pathToImgs[globalImgIndex]);
-			//std::string outputFileName = (outputFolder / boostPath.filename()).string();
-
-			std::stringstream ss;
-			ss << std::setfill('0') << std::setw(8) << globalImgIndex << boostPath.extension().string();
-			std::string outputFileName = (outputFolder / ss.str()).string();
-			std::string scaledDownOutputFileName = (scaledDownOutputFolder / ss.str()).string();
-
-			cv::Mat img = cv::imread(pathToImgs[globalImgIndex], 1);
-
-			cv::Rect areOfIntererst = cv::Rect((img.cols - cropResolution[0]) / 2, (img.rows - cropResolution[1]) / 2, cropResolution[0], cropResolution[1]);
-
-			cv::Mat croppedImg = img(areOfIntererst);
-
-			cv::imwrite(outputFileName, croppedImg);
-
-			listOfImages[globalImgIndex].filename = ss.str();
-			listOfImages[globalImgIndex].width = croppedImg.cols;
-			listOfImages[globalImgIndex].height = croppedImg.rows;
-
+	const sibr::ImagePipeline::Stats stats = pipeline.run(pathToImgs,
+		// Read.
+		[&](sibr::ImagePipeline::Item & item) {
+			item.image = cv::imread(item.name, cv::IMREAD_COLOR);
+			if (item.image.empty()) {
+				SIBR_WRG << TAG << " Unable to load " << item.name << "." << std::endl;
+				return false;
+			}
+			return true;
+		},
+		// Crop from center, then scale down the cropped region.
+		[&](sibr::ImagePipeline::Item & item) {
+			const cv::Mat & img = item.image;
+			if (img.cols < cropResolution[0] || img.rows < cropResolution[1]) {
+				SIBR_WRG << TAG << " " << item.name << " (" << img.cols << "x" << img.rows << ") is smaller than the crop resolution." << std::endl;
+				return false;
+			}
+			const cv::Rect areaOfInterest((img.cols - cropResolution[0]) / 2, (img.rows - cropResolution[1]) / 2, cropResolution[0], cropResolution[1]);
+			// The crop is a view on the decoded image, no copy.
+			item.outputs.push_back(img(areaOfInterest));
 			if (scaleDown) {
 				cv::Mat resizedImg;
-				cv::resize(croppedImg, resizedImg, resizedSize, 0, 0, cv::INTER_LINEAR);
-
-				cv::imwrite(scaledDownOutputFileName, resizedImg);
+				cv::resize(item.outputs[0], resizedImg, resizedSize, 0, 0, cv::INTER_LINEAR);
+				item.outputs.push_back(resizedImg);
+			}
+			return true;
+		},
+		// Write both sizes.
+		[&](sibr::ImagePipeline::Item & item) {
+			const std::string filename = outputName(item);
+			const cv::Mat & croppedImg = item.outputs[0];
+			if (!cv::imwrite((outputFolder / filename).string(), croppedImg)) {
+				SIBR_WRG << TAG << " Unable to write " << filename << "." << std::endl;
+				return false;
+			}
+			listOfImages[item.id].filename = filename;
+			listOfImages[item.id].width = croppedImg.cols;
+			listOfImages[item.id].height = croppedImg.rows;
 
-				listOfImagesScaledDown[globalImgIndex].filename	= ss.str();
-				listOfImagesScaledDown[globalImgIndex].width	= resizedImg.cols;
-				listOfImagesScaledDown[globalImgIndex].height	= resizedImg.rows;
+			if (scaleDown) {
+				const cv::Mat & resizedImg = item.outputs[1];
+				if (!cv::imwrite((scaledDownOutputFolder / filename).string(), resizedImg)) {
+					SIBR_WRG << TAG << " Unable to write scaled " << filename << "." << std::endl;
+					return false;
+				}
+				listOfImagesScaledDown[item.id].filename = filename;
+				listOfImagesScaledDown[item.id].width = resizedImg.cols;
+				listOfImagesScaledDown[item.id].height = resizedImg.rows;
 			}
+			return true;
 		}
-	}
+	);
 
 	end = std::chrono::system_clock::now();
 	auto elapsedTime = std::chrono::duration_cast<std::chrono::seconds>(end - start).count();
 
+	stats.log("cropFromCenter");
+
 	std::cout << TAG << " elapsed time=" << elapsedTime << "s.\n";
 
-	appUtility.logExecution(avgInitialResolution, int(pathToImgs.size()), elapsedTime, scaleDown, LOG_FILE_NAME);
+	appUtility.logExecution(avgInitialResolution, int(stats.numItems), elapsedTime, scaleDown, LOG_FILE_NAME, stats.itemsPerSecond());
+
+	// images that failed to load, crop or write have no entry
+	const auto removeFailed = [](std::vector<sibr::CropScaleImageUtility::Image> & images) {
+		images.erase(std::remove_if(images.begin(), images.end(),
+			[](const sibr::CropScaleImageUtility::Image & image) { return image.filename.empty(); }), images.end());
+	};
+	removeFailed(listOfImages);
+	removeFailed(listOfImagesScaledDown);
 
 	// write list_images.txt
 	appUtility.writeListImages((outputFolder / "list_images.txt").string(), listOfImages);
@@ -21,7 +21,7 @@ int thinest_bounding_box_size = 5;
 int threshold_bounding_box_size = 500;
 float threshold_ratio_bounding_box_size = 0.2f;
 
-const int PROCESSING_BATCH_SIZE = 150;	// process PROCESSING_BATCH_SIZE images together
+const int PROCESSING_BATCH_SIZE = 16;	// at most PROCESSING_BATCH_SIZE decoded images wait between the pipeline stages
 
 sibr::Vector3i backgroundColor = sibr::Vector3i(0, 0, 0);
 
@@ -0,0 +1,305 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+
+
+#include <core/system/Config.hpp>
+#include <core/graphics/Mesh.hpp>
+#include <core/raycaster/PointCloudFilter.hpp>
+#include <core/raycaster/KdTree.hpp>
+#include <core/system/CommandLineArgs.hpp>
+#include <core/system/String.hpp>
+#include <core/system/Utils.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+
+using namespace sibr;
+
+/** Options for point clouds and Gaussian splats floaters removal. */
+struct FilterPointsArgs : public AppArgs {
+	RequiredArg<std::string> path = { "path", "path to the point cloud (binary PLY of Gaussian splats, COLMAP points3D.txt/.bin, or any point cloud supported by Mesh)" };
+	RequiredArg<std::string> output = { "output", "path to the filtered point cloud, in the same format" };
+	Arg<int> neighbors = { "neighbors", 16, "number of neighbours for statistical outlier removal (0 to disable)" };
+	Arg<float> stdRatio = { "std-ratio", 2.0f, "points farther than mean+ratio*stddev from their neighbours are removed" };
+	Arg<float> radius = { "radius", 0.0f, "radius of the density filter (0 to disable)" };
+	Arg<int> minNeighbors = { "min-neighbors", 4, "minimum number of neighbours in the density filter radius" };
+	Arg<float> minOpacity = { "min-opacity", 0.0f, "splats with a lower opacity are removed" };
+	Arg<float> maxScale = { "max-scale", 0.0f, "splats larger than this ratio of the scene diagonal are removed (0 to disable)" };
+	Arg<int> chunk = { "chunk", 1 << 20, "number of points read and queried at once" };
+	Arg<bool> benchmark = { "benchmark", "measure the neighbour queries throughput on random points and exit" };
+};
+
+/** Filter a binary little endian PLY with float properties, such as Gaussian splats. Only positions, opacities and scales
+ are kept in memory, records are streamed by chunks from the input to the output. */
+bool filterBinaryPly(const std::string & path, const std::string & output, const PointCloudFilter::Options & options)
+{
+	std::ifstream input(path, std::ios_base::binary);
+	std::vector<std::string> header;
+	std::vector<std::string> properties;
+	size_t count = 0;
+	bool binary = false;
+	std::string line;
+	while (std::getline(input, line)) {
+		if (!line.empty() && line.back() == '\r') {
+			line.pop_back();
+		}
+		header.push_back(line);
+		std::istringstream stream(line);
+		std::string keyword, type, name;
+		stream >> keyword;
+		if (keyword == "format") {
+			stream >> type;
+			binary = type == "binary_little_endian";
+		}
+		else if (keyword == "element") {
+			stream >> type >> count;
+			if (type != "vertex") {
+				return false;
+			}
+		}
+		else if (keyword == "property") {
+			stream >> type >> name;
+			if (type != "float") {
+				return false;
+			}
+			properties.push_back(name);
+		}
+		else if (keyword == "end_header") {
+			break;
+		}
+	}
+	if (!binary || properties.empty()) {
+		return false;
+	}
+	const auto propertyId = [&properties](const std::string & name) {
+		const auto it = std::find(properties.begin(), properties.end(), name);
+		return it == properties.end() ? -1 : int(it - properties.begin());
+	};
+	const int xId = propertyId("x"), yId = propertyId("y"), zId = propertyId("z");
+	const int opacityId = propertyId("opacity");
+	const int scaleIds[3] = { propertyId("scale_0"), propertyId("scale_1"), propertyId("scale_2") };
+	const bool isSplat = opacityId >= 0 && scaleIds[0] >= 0 && scaleIds[1] >= 0 && scaleIds[2] >= 0;
+	if (xId < 0 || yId < 0 || zId < 0) {
+		return false;
+	}
+	const std::streamoff dataStart = input.tellg();
+	const size_t stride = properties.size();
+	const size_t chunk = std::max(options.chunkSize, size_t(1));
+
+	// First pass: read the attributes needed by the filters.
+	std::vector<Vector3f> positions(count);
+	std::vector<float> opacities(isSplat ? count : 0);
+	std::vector<float> scales(isSplat ? 3 * count : 0);
+	std::vector<float> records(chunk * stride);
+	for (size_t begin = 0; begin < count; begin += chunk) {
+		const size_t size = std::min(chunk, count - begin);
+		input.read((char*)records.data(), size * stride * sizeof(float));
+		if (!input) {
+			SIBR_ERR << "Truncated PLY file " << path << std::endl;
+			return false;
+		}
+		for (size_t i = 0; i < size; ++i) {
+			const float * record = &records[i * stride];
+			positions[begin + i] = Vector3f(record[xId], record[yId], record[zId]);
+			if (isSplat) {
+				// Same activations as the Gaussian viewer.
+				opacities[begin + i] = 1.0f / (1.0f + std::exp(-record[opacityId]));
+				for (int k = 0; k < 3; ++k) {
+					scales[3 * (begin + i) + k] = std::exp(record[scaleIds[k]]);
+				}
+			}
+		}
+	}
+	const std::vector<uint8_t> keep = PointCloudFilter::filter(positions, isSplat ? opacities.data() : nullptr, isSplat ? scales.data() : nullptr, options);
+	size_t kept = 0;
+	for (const uint8_t flag : keep) {
+		kept += flag;
+	}
+
+	// Second pass: copy the kept records.
+	std::ofstream out(output, std::ios_base::binary);
+	for (const std::string & headerLine : header) {
+		if (headerLine.compare(0, 14, "element vertex") == 0) {
+			out << "element vertex " << kept << "\n";
+		}
+		else {
+			out << headerLine << "\n";
+		}
+	}
+	input.clear();
+	input.seekg(dataStart);
+	for (size_t begin = 0; begin < count; begin += chunk) {
+		const size_t size = std::min(chunk, count - begin);
+		input.read((char*)records.data(), size * stride * sizeof(float));
+		size_t written = 0;
+		for (size_t i = 0; i < size; ++i) {
+			if (keep[begin + i]) {
+				std::copy(&records[i * stride], &records[(i + 1) * stride], &records[written * stride]);
+				++written;
+			}
+		}
+		out.write((const char*)records.data(), written * stride * sizeof(float));
+	}
+	SIBR_LOG << "Saved " << kept << "/" << count << " points to " << output << std::endl;
+	return true;
+}
+
+/** Filter a COLMAP points3D.txt file, streaming the kept lines to the output. */
+bool filterColmapText(const std::string & path, const std::string & output, const PointCloudFilter::Options & options)
+{
+	// Line: POINT3D_ID, X, Y, Z, R, G, B, ERROR, TRACK[] as (IMAGE_ID, POINT2D_IDX).
+	std::vector<Vector3f> positions;
+	std::vector<size_t> trackLengths;
+	{
+		std::ifstream input(path);
+		std::string line;
+		while (std::getline(input, line)) {
+			if (line.empty() || line[0] == '#') {
+				continue;
+			}
+			std::istringstream stream(line);
+			size_t id;
+			Vector3f position;
+			stream >> id >> position[0] >> position[1] >> position[2];
+			positions.push_back(position);
+			std::string token;
+			size_t tokenCount = 4;
+			while (stream >> token) {
+				++tokenCount;
+			}
+			trackLengths.push_back(tokenCount > 8 ? (tokenCount - 8) / 2 : 0);
+		}
+	}
+	const std::vector<uint8_t> keep = PointCloudFilter::filter(positions, nullptr, nullptr, options);
+	size_t kept = 0;
+	size_t keptTrackLengths = 0;
+	for (size_t pid = 0; pid < keep.size(); ++pid) {
+		if (keep[pid]) {
+			++kept;
+			keptTrackLengths += trackLengths[pid];
+		}
+	}
+
+	std::ifstream input(path);
+	std::ofstream out(output);
+	std::string line;
+	size_t pid = 0;
+	while (std::getline(input, line)) {
+		if (line.compare(0, 19, "# Number of points:") == 0) {
+			out << "# Number of points: " << kept << ", mean track length: " << (kept > 0 ? double(keptTrackLengths) / double(kept) : 0.0) << "\n";
+		}
+		else if (line.empty() || line[0] == '#') {
+			out << line << "\n";
+		}
+		else if (keep[pid++]) {
+			out << line << "\n";
+		}
+	}
+	SIBR_LOG << "Saved " << kept << "/" << keep.size() << " points to " << output << std::endl;
+	return true;
+}
+
+/** Filter a COLMAP points3D.bin file, streaming the kept records to the output. */
+bool filterColmapBinary(const std::string & path, const std::string & output, const PointCloudFilter::Options & options)
+{
+	// Record: id (uint64), xyz (3 double), rgb (3 uint8), error (double), track length (uint64), track (length * 2 int32).
+	const size_t fixedSize = 8 + 3 * 8 + 3 + 8 + 8;
+	std::vector<char> record;
+	const auto readRecord = [&record, fixedSize](std::ifstream & input) {
+		record.resize(fixedSize);
+		input.read(record.data(), fixedSize);
+		uint64_t trackLength;
+		std::memcpy(&trackLength, &record[fixedSize - 8], sizeof(trackLength));
+		record.resize(fixedSize + size_t(trackLength) * 8);
+		input.read(record.data() + fixedSize, size_t(trackLength) * 8);
+		return bool(input);
+	};
+
+	std::ifstream input(path, std::ios_base::binary);
+	uint64_t count = 0;
+	input.read((char*)&count, sizeof(count));
+	std::vector<Vector3f> positions(count);
+	for (uint64_t pid = 0; pid < count; ++pid) {
+		if (!readRecord(input)) {
+			SIBR_ERR << "Truncated COLMAP file " << path << std::endl;
+			return false;
+		}
+		double xyz[3];
+		std::memcpy(xyz, &record[8], sizeof(xyz));
+		positions[pid] = Vector3f(float(xyz[0]), float(xyz[1]), float(xyz[2]));
+	}
+	const std::vector<uint8_t> keep = PointCloudFilter::filter(positions, nullptr, nullptr, options);
+	uint64_t kept = 0;
+	for (const uint8_t flag : keep) {
+		kept += flag;
+	}
+
+	input.clear();
+	input.seekg(sizeof(count));
+	std::ofstream out(output, std::ios_base::binary);
+	out.write((const char*)&kept, sizeof(kept));
+	for (uint64_t pid = 0; pid < count; ++pid) {
+		readRecord(input);
+		if (keep[pid]) {
+			out.write(record.data(), record.size());
+		}
+	}
+	return true;
+}
+
+int main(int ac, char ** av){
+
+	CommandLineArgs::parseMainArgs(ac, av);
+	FilterPointsArgs args;
+	if (args.benchmark) {
+		KdTree<float>::benchmark();
+		return EXIT_SUCCESS;
+	}
+
+	PointCloudFilter::Options options;
+	options.statisticalNeighbors = uint(std::max(args.neighbors.get(), 0));
+	options.statisticalStdRatio = args.stdRatio;
+	options.densityRadius = args.radius;
+	options.densityMinNeighbors = uint(std::max(args.minNeighbors.get(), 0));
+	options.minOpacity = args.minOpacity;
+	options.maxScale = args.maxScale;
+	options.chunkSize = size_t(std::max(args.chunk.get(), 1));
+
+	const std::string path = args.path;
+	const std::string extension = sibr::getExtension(path);
+	sibr::makeDirectory(sibr::parentDirectory(args.output));
+
+	if (extension == "txt") {
+		return filterColmapText(path, args.output, options) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+	if (extension == "bin") {
+		return filterColmapBinary(path, args.output, options) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+	if (extension == "ply" && filterBinaryPly(path, args.output, options)) {
+		return EXIT_SUCCESS;
+	}
+
+	// Other point clouds are loaded in memory.
+	Mesh mesh(false);
+	if (!mesh.load(path)) {
+		SIBR_ERR << "Unable to load point cloud " << path << std::endl;
+		return EXIT_FAILURE;
+	}
+	const size_t removed = PointCloudFilter::filter(mesh, options);
+	mesh.save(args.output, true);
+	SIBR_LOG << "Removed " << removed << " points, saved to " << args.output.get() << std::endl;
+	return EXIT_SUCCESS;
+}
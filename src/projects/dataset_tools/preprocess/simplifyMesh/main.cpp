@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use 
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+
+
+#include <core/system/Config.hpp>
+#include <core/graphics/Mesh.hpp>
+#include <core/graphics/MeshSimplifier.hpp>
+#include <core/graphics/MeshOptimizer.hpp>
+#include <core/system/CommandLineArgs.hpp>
+
+
+using namespace sibr;
+
+/** Options for proxy levels of detail generation. */
+struct SimplifyMeshArgs : public AppArgs {
+	RequiredArg<std::string> path = { "path", "path to the mesh" };
+	Arg<std::string> output = { "output", "", "output path without extension, levels are saved as <output>_lod<i>.ply (defaults to the mesh path, so that they are loaded with the proxy)" };
+	Arg<int> levels = { "levels", 4, "number of levels of detail" };
+	Arg<float> ratio = { "ratio", 0.25f, "ratio of triangles kept from one level to the next" };
+	Arg<bool> benchmark = { "benchmark", "measure decimation speed and error on synthetic meshes and the input mesh, and vertex cache efficiency of the input mesh" };
+};
+
+int main(int ac, char ** av){
+
+	CommandLineArgs::parseMainArgs(ac, av);
+	SimplifyMeshArgs args;
+	std::string basePath = args.output;
+	if (basePath.empty()) {
+		basePath = sibr::removeExtension(args.path.get());
+	}
+	sibr::makeDirectory(sibr::parentDirectory(basePath));
+
+	Mesh mesh(false);
+	if (!mesh.load(args.path)) {
+		SIBR_ERR << "Unable to load mesh " << args.path.get() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	if (args.benchmark) {
+		MeshSimplifier::benchmark(&mesh);
+		MeshOptimizer::benchmark(mesh);
+		return EXIT_SUCCESS;
+	}
+
+	const auto lods = MeshSimplifier::generateLODs(mesh, uint(std::max(args.levels.get(), 1)), args.ratio);
+	MeshSimplifier::saveLODs(lods, basePath);
+	SIBR_LOG << "Saved " << lods.size() << " levels of detail to " << basePath << "_lods.txt" << std::endl;
+	return EXIT_SUCCESS;
+}
@@ -15,6 +15,7 @@
 #include "core/graphics/Image.hpp"
 #include "core/graphics/Mesh.hpp"
 #include "core/imgproc/MeshTexturing.hpp"
+#include "core/raycaster/AmbientOcclusionBaker.hpp"
 #include "core/scene/BasicIBRScene.hpp"
 
 using namespace sibr;
@@ -27,6 +28,10 @@ struct TexturingAppArgs : virtual BasicIBRAppArgs {
 	Arg<bool> flood_fill = { "flood", "perform flood fill" };
 	Arg<bool> poisson_fill = { "poisson", "perform Poisson filling (slow on large images)" };
 	Arg<float> samples = { "samples", 1.0, "%ge of total samples to be used for texturing" };
+	Arg<int> tile_size = { "tile-size", 0, "process the texture by tiles of this side, saved in the output directory (resumable)" };
+	Arg<int> ao_size = { "ao-size", 0, "also bake an ambient occlusion map of this side, saved as <output>_ao.png (ao.png in the output directory in tiled mode)" };
+	Arg<float> ao_distance = { "ao-distance", 0.1f, "occluders farther than this ratio of the mesh diagonal are ignored by the ambient occlusion" };
+	Arg<bool> benchmark_ao = { "benchmark-ao", "measure the ambient occlusion baking speed and variance on the mesh and exit" };
 };
 
 int main(int ac, char** av) {
@@ -41,6 +46,8 @@ int main(int ac, char** av) {
 		std::cout << "Usage: " << std::endl;
 		std::cout << "\tRequired: --path path/to/dataset --output path/to/output/file.png" << std::endl;
 		std::cout << "\tOptional: --size 8192 --flood (flood fill) --poisson (poisson fill)" << std::endl;
+		std::cout << "\tTiled mode: --tile-size 2048 --output path/to/output/directory" << std::endl;
+		std::cout << "\tAmbient occlusion: --ao-size 4096 --ao-distance 0.1" << std::endl;
 		return 0;
 	}
 
@@ -62,9 +69,34 @@ int main(int ac, char** av) {
 		scene.proxies()->replaceProxyPtr(customMesh);
 	}
 
+	if (args.benchmark_ao) {
+		AmbientOcclusionBaker::benchmark(scene.proxies()->proxy());
+		return 0;
+	}
+
+	// The AO map shares the UV atlas of the texture.
+	if (args.ao_size > 0) {
+		const sibr::Mesh & mesh = scene.proxies()->proxy();
+		AmbientOcclusionBaker::Options aoOptions;
+		aoOptions.maxDistance = args.ao_distance * mesh.getBoundingBox().diagonal().norm();
+		AmbientOcclusionBaker::Stats stats;
+		AmbientOcclusionBaker baker(mesh);
+		const sibr::ImageL32F::Ptr ao = baker.bakeTexture(uint(args.ao_size.get()), aoOptions, true, &stats);
+		if (ao) {
+			const std::string aoPath = args.tile_size > 0 ? args.output_path.get() + "/ao.png" : sibr::removeExtension(args.output_path.get()) + "_ao.png";
+			cv::Mat1b aoBytes;
+			ao->toOpenCV().convertTo(aoBytes, CV_8U, 255.0);
+			sibr::ImageL8 aoImage;
+			aoImage.fromOpenCV(aoBytes);
+			aoImage.save(aoPath);
+			SIBR_LOG << "[Texturing] Ambient occlusion baked in " << stats.seconds << "s, " << stats.averageSamples << " samples per texel on average." << std::endl;
+		} else {
+			SIBR_WRG << "[Texturing] The mesh has no UVs, no ambient occlusion map baked." << std::endl;
+		}
+	}
+
 	MeshTexturing texturer(args.output_size);
 	texturer.setMesh(scene.proxies()->proxyPtr());
-	texturer.reproject(scene.cameras()->inputCameras(), scene.images()->inputImages(), args.samples);
 
 	// Export options.
 	// UVs start at the bottom of the image, we have to flip.
@@ -76,6 +108,13 @@ int main(int ac, char** av) {
 		options = options | MeshTexturing::POISSON_FILL;
 	}
 
+	// Large textures can be generated tile by tile, with bounded memory.
+	if (args.tile_size > 0) {
+		texturer.reprojectTiles(scene.cameras()->inputCameras(), scene.images()->inputImages(), args.output_path, uint(args.tile_size.get()), options, args.samples);
+		return 0;
+	}
+
+	texturer.reproject(scene.cameras()->inputCameras(), scene.images()->inputImages(), args.samples);
 	sibr::ImageRGB::Ptr result = texturer.getTexture(options);
 	result->save(args.output_path);
 
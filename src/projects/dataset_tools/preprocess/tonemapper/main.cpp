@@ -15,6 +15,7 @@
 #include "core/graphics/Image.hpp"
 #include "core/graphics/Mesh.hpp"
 #include "core/imgproc/MeshTexturing.hpp"
+#include "core/imgproc/ImagePipeline.hpp"
 #include "core/scene/BasicIBRScene.hpp"
 
 using namespace sibr;
@@ -26,21 +27,79 @@ struct TonemapperAppArgs : virtual AppArgs {
 	Arg<std::string> outputExtension = { "ext", "png", "output files extension" };
 	Arg<float> exposure = { "exposure", 1.0f, "exposure value" };
 	Arg<float> gamma = { "gamma", 2.2f, "gamma value" };
+	Arg<std::string> tonemapOperator = { "operator", "exponential", "tonemapping operator: exponential (1-exp(-exposure*x)), reinhard (y/(1+y) with y=exposure*x) or linear (clamp(exposure*x))" };
+	Arg<int> readers = { "readers", 0, "number of decoding threads (0 for automatic)" };
+	Arg<int> workers = { "workers", 0, "number of tonemapping threads (0 for automatic)" };
+	Arg<int> writers = { "writers", 0, "number of encoding threads (0 for automatic)" };
 };
 
-void tonemap(const sibr::ImageRGB32F& hdrImg, sibr::ImageRGB& ldrImg, float exposure, float gamma) {
-	const cv::Mat & tonemaped = hdrImg.toOpenCV();
-	const cv::Mat exposed = -exposure * tonemaped;
-	cv::Mat tonemaped2;
-	cv::exp(exposed, tonemaped2);
-	tonemaped2 = cv::Scalar(1.0f, 1.0f, 1.0f) - tonemaped2;
-	if (gamma > 0.0f) {
-		cv::pow(tonemaped2, 1.0f / gamma, tonemaped2);
+/** Monotonic tonemapping curve followed by gamma correction and 8-bit quantization.
+* As the curve is monotonic, the 8-bit output of a value is the number of quantization
+* thresholds below it: the thresholds are precomputed once in HDR space by inverting the curve,
+* and each pixel is then mapped with a branchless binary search, without any transcendental function.
+* Exposure, curve, gamma and quantization are thus fused in a single pass over the image.
+*/
+class ToneCurve {
+public:
+	enum class Operator { EXPONENTIAL, REINHARD, LINEAR };
+
+	ToneCurve(Operator op, float exposure, float gamma) {
+		_thresholds[0] = -std::numeric_limits<float>::infinity();
+		for (int k = 1; k < 256; ++k) {
+			// Output k is reached when the tonemapped value is above (k-0.5)/255, as with rounding.
+			double t = (k - 0.5) / 255.0;
+			if (gamma > 0.0f) {
+				t = std::pow(t, double(gamma));
+			}
+			double x;
+			switch (op) {
+			case Operator::REINHARD:
+				x = t / (1.0 - t);
+				break;
+			case Operator::LINEAR:
+				x = t;
+				break;
+			case Operator::EXPONENTIAL:
+			default:
+				x = -std::log(1.0 - t);
+				break;
+			}
+			_thresholds[k] = float(x / double(exposure));
+		}
 	}
-	cv::Mat tonemapedRGB;
-	tonemaped2.convertTo(tonemapedRGB, CV_8UC3, 255.0f);
-	ldrImg.fromOpenCV(tonemapedRGB);
-}
+
+	/** Tonemap a row of values.
+	\param src HDR values
+	\param dst 8-bit output
+	\param count number of values
+	*/
+	void apply(const float * src, uchar * dst, int count) const {
+		for (int i = 0; i < count; ++i) {
+			const float v = src[i];
+			int pos = 0;
+			for (int step = 128; step > 0; step >>= 1) {
+				pos += (v >= _thresholds[pos + step]) ? step : 0;
+			}
+			dst[i] = uchar(pos);
+		}
+	}
+
+	/** Tonemap an image.
+	\param hdr a 32F image
+	\param ldr will contain the 8U image with the same number of channels
+	*/
+	void apply(const cv::Mat & hdr, cv::Mat & ldr) const {
+		ldr.create(hdr.size(), CV_MAKETYPE(CV_8U, hdr.channels()));
+		const int count = hdr.cols * hdr.channels();
+		for (int y = 0; y < hdr.rows; ++y) {
+			apply(hdr.ptr<float>(y), ldr.ptr<uchar>(y), count);
+		}
+	}
+
+private:
+	/// Entry k is the smallest HDR value mapped to k, entry 0 is unused. Padded so that the search never reads out of bounds.
+	float _thresholds[257];
+};
 
 int main(int ac, char** av) {
 
@@ -49,6 +108,12 @@ int main(int ac, char** av) {
 
 	TonemapperAppArgs args;
 
+	// The curve thresholds are divided by the exposure.
+	if (!(args.exposure > 0.0f)) {
+		SIBR_WRG << "Exposure should be positive, got " << args.exposure.get() << "." << std::endl;
+		return EXIT_FAILURE;
+	}
+
 	// Add the extension dot if needed.
 	std::string extension = args.outputExtension;
 	if (!extension.empty() && extension[0] != '.') {
@@ -66,19 +131,51 @@ int main(int ac, char** av) {
 		sibr::makeDirectory(outputPath);
 	}
 
+	ToneCurve::Operator op = ToneCurve::Operator::EXPONENTIAL;
+	const std::string opName = sibr::to_lower(args.tonemapOperator);
+	if (opName == "reinhard") {
+		op = ToneCurve::Operator::REINHARD;
+	} else if (opName == "linear") {
+		op = ToneCurve::Operator::LINEAR;
+	} else if (opName != "exponential") {
+		SIBR_WRG << "Unknown operator " << opName << ", using exponential." << std::endl;
+	}
+	const ToneCurve curve(op, args.exposure, args.gamma);
+
 	const auto files = sibr::listFiles(inputPath, false, false, { "exr" });
 
-	for (const auto& file : files) {
-		const std::string src = inputPath + "/" + file;
-		const std::string dst = outputPath + "/" + sibr::removeExtension(file) + extension;
+	// Decoding, tonemapping and encoding of different images overlap.
+	sibr::ImagePipeline pipeline(args.readers, args.workers, args.writers);
+	const sibr::ImagePipeline::Stats stats = pipeline.run(files,
+		[&](sibr::ImagePipeline::Item & item) {
+			item.image = cv::imread(inputPath + "/" + item.name, cv::IMREAD_UNCHANGED);
+			if (item.image.empty()) {
+				SIBR_WRG << "Could not load " << item.name << std::endl;
+				return false;
+			}
+			return true;
+		},
+		[&](sibr::ImagePipeline::Item & item) {
+			// Channels are processed independently, no need to swap to RGB.
+			cv::Mat hdr = item.image;
+			if (hdr.channels() == 1) {
+				cv::cvtColor(hdr, hdr, cv::COLOR_GRAY2BGR);
+			} else if (hdr.channels() == 4) {
+				cv::cvtColor(hdr, hdr, cv::COLOR_BGRA2BGR);
+			}
+			if (hdr.depth() != CV_32F) {
+				hdr.convertTo(hdr, CV_32F);
+			}
+			item.outputs.resize(1);
+			curve.apply(hdr, item.outputs[0]);
+			return true;
+		},
+		[&](sibr::ImagePipeline::Item & item) {
+			const std::string dst = outputPath + "/" + sibr::removeExtension(item.name) + extension;
+			return cv::imwrite(dst, item.outputs[0]);
+		});
 
-		sibr::ImageRGB32F hdrImg;
-		sibr::ImageRGB ldrImg;
-		hdrImg.load(src);
-		tonemap(hdrImg, ldrImg, args.exposure, args.gamma);
-		ldrImg.save(dst);
-	}
+	stats.log("Tonemapper");
 
 	return 0;
 }
-
@@ -14,6 +14,7 @@
 
 #include <core/system/Config.hpp>
 #include <core/graphics/Mesh.hpp>
+#include <core/graphics/MeshInstances.hpp>
 #include <core/assets/UVUnwrapper.hpp>
 #include <core/system/CommandLineArgs.hpp>
 
@@ -27,6 +28,9 @@ struct UVMapperArgs : public AppArgs {
 	Arg<int> size = { "size", 4096, "target UV map width (approx.)" };
 	Arg<bool> visu = { "visu", "save visualisation" };
 	Arg<std::string> textureName = { "texture-name", "TEXTURE_NAME_TO_PUT_IN_THE_FILE", "name of the texture to reference in the output mesh (Meshlab compatible)" };
+	Arg<int> clusterSize = { "cluster-size", 0, "unwrap clusters of at most this many triangles in parallel (0 to unwrap the whole mesh at once)" };
+	Arg<std::string> cache = { "cache", "", "directory where unwrapping results are cached" };
+	Arg<bool> benchmark = { "benchmark", "compare whole and partitioned unwrapping, the connected components used to partition the mesh, and instanced Mitsuba scenes loading" };
 };
 
 int main(int ac, char ** av){
@@ -47,8 +51,16 @@ int main(int ac, char ** av){
 		mesh.load(args.path);
 	}
 
+	if (args.benchmark) {
+		Mesh::benchmarkComponents();
+		MeshInstances::benchmark();
+		UVUnwrapper::benchmark(mesh, uint32_t(args.size));
+		return EXIT_SUCCESS;
+	}
+
 	UVUnwrapper unwrapper(mesh, uint32_t(args.size));
-	auto finalMesh = unwrapper.unwrap();
+	unwrapper.setCacheDirectory(args.cache);
+	auto finalMesh = args.clusterSize > 0 ? unwrapper.unwrapPartitioned(uint(args.clusterSize.get())) : unwrapper.unwrap();
 	finalMesh->save(outputFile, true, args.textureName);
 	
 	// Output debug vis.
@@ -211,8 +211,17 @@ int main(int ac, char** av)
 	const unsigned int sceneResWidth = usedResolution.x();
 	const unsigned int sceneResHeight = usedResolution.y();
 
+	// Optional floaters removal at load time.
+	PointCloudFilter::Options filterOptions;
+	filterOptions.statisticalNeighbors = uint(std::max(myArgs.filterNeighbors.get(), 0));
+	filterOptions.statisticalStdRatio = myArgs.filterStdRatio;
+	filterOptions.densityRadius = myArgs.filterRadius;
+	filterOptions.densityMinNeighbors = uint(std::max(myArgs.filterMinNeighbors.get(), 0));
+	filterOptions.minOpacity = myArgs.minOpacity;
+	filterOptions.maxScale = myArgs.maxScale;
+
 	// Create the ULR view.
-	GaussianView::Ptr	gaussianView(new GaussianView(scene, sceneResWidth, sceneResHeight, plyfile.c_str(), &messageRead, sh_degree, white_background, !myArgs.noInterop, device));
+	GaussianView::Ptr	gaussianView(new GaussianView(scene, sceneResWidth, sceneResHeight, plyfile.c_str(), &messageRead, sh_degree, white_background, !myArgs.noInterop, device, filterOptions));
 
 	// Raycaster.
 	std::shared_ptr<sibr::Raycaster> raycaster = std::make_shared<sibr::Raycaster>();
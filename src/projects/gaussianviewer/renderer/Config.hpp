@@ -50,6 +50,12 @@ namespace sibr {
 		Arg<bool> loadImages = { "load_images", "Whether or not to load images for scene overview."};
 		Arg<bool> noInterop = { "no_interop", "Don't try to use interop (may be required for unconventional OpenGL setups, like WSL)" };
 		Arg<std::string> imagesPath = { "images-path", "path to the dataset images" };
+		Arg<int> filterNeighbors = { "filter-neighbors", 0, "number of neighbours for statistical floaters removal at load time (0 to disable)" };
+		Arg<float> filterStdRatio = { "filter-std-ratio", 2.0f, "splats farther than mean+ratio*stddev from their neighbours are removed" };
+		Arg<float> filterRadius = { "filter-radius", 0.0f, "radius of the density filter applied at load time (0 to disable)" };
+		Arg<int> filterMinNeighbors = { "filter-min-neighbors", 4, "minimum number of neighbours in the density filter radius" };
+		Arg<float> minOpacity = { "min-opacity", 0.0f, "splats with a lower opacity are removed at load time" };
+		Arg<float> maxScale = { "max-scale", 0.0f, "splats larger than this ratio of the scene diagonal are removed at load time (0 to disable)" };
 	};
 
 }
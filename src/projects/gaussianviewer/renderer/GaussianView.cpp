@@ -315,7 +315,7 @@ std::function<char* (size_t N)> resizeFunctional(void** ptr, size_t& S) {
 	return lambda;
 }
 
-sibr::GaussianView::GaussianView(const sibr::BasicIBRScene::Ptr & ibrScene, uint render_w, uint render_h, const char* file, bool* messageRead, int sh_degree, bool white_bg, bool useInterop, int device) :
+sibr::GaussianView::GaussianView(const sibr::BasicIBRScene::Ptr & ibrScene, uint render_w, uint render_h, const char* file, bool* messageRead, int sh_degree, bool white_bg, bool useInterop, int device, const PointCloudFilter::Options& filter) :
 	_scene(ibrScene),
 	_dontshow(messageRead),
 	_sh_degree(sh_degree),
@@ -377,6 +377,30 @@ sibr::GaussianView::GaussianView(const sibr::BasicIBRScene::Ptr & ibrScene, uint
 		count = loadPly<3>(file, pos, shs, opacity, scale, rot, _scenemin, _scenemax);
 	}
 
+	// Remove floaters before the upload, the Morton order is preserved.
+	if (filter.enabled())
+	{
+		const std::vector<uint8_t> keep = PointCloudFilter::filter(pos, opacity.data(), (const float*)scale.data(), filter);
+		PointCloudFilter::compact(pos, keep);
+		PointCloudFilter::compact(rot, keep);
+		PointCloudFilter::compact(scale, keep);
+		PointCloudFilter::compact(opacity, keep);
+		PointCloudFilter::compact(shs, keep);
+		count = int(pos.size());
+
+		// The cropping box spans the remaining splats only.
+		if (!pos.empty())
+		{
+			_scenemin = sibr::Vector3f(FLT_MAX, FLT_MAX, FLT_MAX);
+			_scenemax = -_scenemin;
+			for (const Pos & p : pos)
+			{
+				_scenemin = _scenemin.cwiseMin(p);
+				_scenemax = _scenemax.cwiseMax(p);
+			}
+		}
+	}
+
 	_boxmin = _scenemin;
 	_boxmax = _scenemax;
 
@@ -21,6 +21,7 @@
 # include <core/renderer/PointBasedRenderer.hpp>
 # include <memory>
 # include <core/graphics/Texture.hpp>
+# include <core/raycaster/PointCloudFilter.hpp>
 #include <cuda_runtime.h>
 #include <cuda_gl_interop.h>
 #include <functional>
@@ -51,8 +52,9 @@ namespace sibr {
 		 * \param ibrScene The scene to use for rendering.
 		 * \param render_w rendering width
 		 * \param render_h rendering height
+		 * \param filter optional floaters filtering applied to the splats at load time
 		 */
-		GaussianView(const sibr::BasicIBRScene::Ptr& ibrScene, uint render_w, uint render_h, const char* file, bool* message_read, int sh_degree, bool white_bg = false, bool useInterop = true, int device = 0);
+		GaussianView(const sibr::BasicIBRScene::Ptr& ibrScene, uint render_w, uint render_h, const char* file, bool* message_read, int sh_degree, bool white_bg = false, bool useInterop = true, int device = 0, const PointCloudFilter::Options& filter = PointCloudFilter::Options());
 
 		/** Replace the current scene.
 		 *\param newScene the new scene to render */
@@ -18,11 +18,18 @@
 
 #include "projects/ulr/renderer/ULRView.hpp"
 #include <projects/ulr/renderer/ULRV2View.hpp>
+#include <projects/ulr/renderer/SoftVisibilityMaps.hpp>
 #include <projects/ulr/renderer/ULRV3View.hpp>
 
 #include <core/renderer/DepthRenderer.hpp>
 #include <core/raycaster/Raycaster.hpp>
 #include <core/view/SceneDebugView.hpp>
+#include <core/scene/InputCameraIndex.hpp>
+#include <core/scene/TextureResidencyPolicy.hpp>
+#include <core/graphics/TextureStagingArena.hpp>
+#include <core/graphics/BlockCompression.hpp>
+#include <core/graphics/AsyncReadback.hpp>
+#include <core/system/TaskScheduler.hpp>
 
 #define PROGRAM_NAME "sibr_ulrv2_app"
 using namespace sibr;
@@ -41,8 +48,39 @@ int main(int ac, char** av) {
 	// Parse Command-line Args
 	CommandLineArgs::parseMainArgs(ac, av);
 	ULRAppArgs myArgs;
+	Arg<int> benchmarkSelection = { "benchmark-selection", 0, "benchmark the camera selection index on this number of synthetic cameras and exit" };
+	Arg<bool> benchmarkResidency = { "benchmark-residency", "simulate the input images residency on an orbit around synthetic cameras and exit" };
+	Arg<bool> benchmarkStaging = { "benchmark-staging", "benchmark the resizing and flipping of input images before their upload and exit" };
+	Arg<bool> benchmarkCompression = { "benchmark-compression", "benchmark the block compression of input images and exit" };
+	Arg<bool> benchmarkSoftVisibility = { "benchmark-soft-visibility", "benchmark the batch generation of soft visibility maps (ULR v2) and exit" };
+	Arg<bool> benchmarkScheduler = { "benchmark-scheduler", "benchmark the task scheduler used by the parallel loops and exit" };
+	Arg<bool> benchmarkReadback = { "benchmark-readback", "benchmark the asynchronous readback of rendered frames and exit" };
 	myArgs.displayHelpIfRequired();
 
+	if (benchmarkSelection > 0) {
+		InputCameraIndex::benchmark(size_t(benchmarkSelection.get()));
+		return EXIT_SUCCESS;
+	}
+	if (benchmarkResidency) {
+		return TextureResidencyPolicy::benchmark() ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+	if (benchmarkStaging) {
+		TextureStagingArena::benchmarkTransform();
+		return EXIT_SUCCESS;
+	}
+	if (benchmarkCompression) {
+		BlockCompression::benchmark();
+		return EXIT_SUCCESS;
+	}
+	if (benchmarkScheduler) {
+		TaskScheduler::benchmark();
+		return EXIT_SUCCESS;
+	}
+	if (benchmarkSoftVisibility) {
+		SoftVisibilityMaps::benchmark();
+		return EXIT_SUCCESS;
+	}
+
 	if (myArgs.version == 2) {
 		return legacyV2main(myArgs);
 	}
@@ -63,7 +101,16 @@ int main(int ac, char** av) {
 	// Window setup
 	sibr::Window		window(PROGRAM_NAME, sibr::Vector2i(50, 50), myArgs, getResourcesDirectory() + "/ulr/" + PROGRAM_NAME + ".ini");
 
-	BasicIBRScene::Ptr		scene(new BasicIBRScene(myArgs, true));
+	if (benchmarkReadback) {
+		AsyncReadback::benchmark();
+		return EXIT_SUCCESS;
+	}
+
+	// With the input images residency, images are decoded from disk when needed instead of being loaded with the scene.
+	BasicIBRScene::SceneOptions sceneOpts;
+	sceneOpts.renderTargets = false;
+	sceneOpts.images = myArgs.residentImages <= 0;
+	BasicIBRScene::Ptr		scene(new BasicIBRScene(myArgs, sceneOpts));
 
 	// Setup the scene: load the proxy, create the texture arrays.
 	const uint flags = SIBR_GPU_LINEAR_SAMPLING | SIBR_FLIP_TEXTURE;
@@ -97,7 +144,11 @@ int main(int ac, char** av) {
 	const unsigned int sceneResHeight = usedResolution.y();
 
 	
-	scene->renderTargets()->initRGBandDepthTextureArrays(scene->cameras(), scene->images(), scene->proxies(), flags, true, myArgs.force_aspect_ratio);
+	if (myArgs.residentImages > 0) {
+		scene->renderTargets()->initRGBResidencyAndDepthTextureArrays(scene->cameras(), scene->data(), scene->proxies(), uint(myArgs.residentImages.get()), flags, true, myArgs.force_aspect_ratio);
+	} else {
+		scene->renderTargets()->initRGBandDepthTextureArrays(scene->cameras(), scene->images(), scene->proxies(), flags, true, myArgs.force_aspect_ratio);
+	}
 
 	// Create the ULR view.
 	ULRV3View::Ptr	ulrView(new ULRV3View(scene, sceneResWidth, sceneResHeight));
@@ -238,13 +289,13 @@ int legacyV2main(ULRAppArgs & myArgs)
 
 				depths3D[imId] = sibr::ImageL32F(w, h, 0);
 
-				for (int i = 0; i < w; i++) {
+				sibr::parallelFor(0, w, [&](int i) {
 					for (int j = 0; j < h; j++) {
 						sibr::Vector2i pixelPos(i, j);
 						sibr::Vector3f pos3dMesh(cam.unprojectImgSpaceInvertY(pixelPos, depthMapSIBR(i, j).x()));
 						depths3D[imId](i, j).x() = (camPos - pos3dMesh).norm();
 					}
-				}
+				});
 				//showFloat(depthMapSIBR);
 				//showFloat(depths3D[imId]);
 			}
@@ -273,20 +324,19 @@ int legacyV2main(ULRAppArgs & myArgs)
 		Texture2DArrayLum32F	soft_visibility_textures;
 		if (myArgs.softVisibility) {
 			int numImages = (int)scene->cameras()->inputCameras().size();
-			std::vector<sibr::ImageL32F>	softVisibilities(numImages);
+			std::vector<sibr::ImageL32F>	softVisibilities;
+			SoftVisibilityMaps::computeAll(depths3D, softVisibilities, 2.5f, myArgs.softVisibilityCache);
 
 			int wSoft = depths3D[0].w();
 			int hSoft = depths3D[0].h();
-#pragma omp parallel for
-			for (int imId = 0; imId < numImages; ++imId) {
-
-				sibr::ImageRGBA tempVisibility;
-				ulrView->computeVisibilityMap(depths3D[imId], tempVisibility);
-				softVisibilities[imId] = std::move(sibr::convertRGBAtoL32F(tempVisibility));
+			sibr::parallelFor(0, numImages, [&](int imId) {
+				if (softVisibilities[imId].w() == wSoft && softVisibilities[imId].h() == hSoft) {
+					return;
+				}
 				cv::Mat temp;
 				cv::resize(softVisibilities[imId].toOpenCV(), temp, cv::Size(wSoft, hSoft), 0, 0, cv::INTER_NEAREST);
 				softVisibilities[imId].fromOpenCV(temp);
-			}
+			}, 1);
 
 			soft_visibility_textures.createFromImages(softVisibilities, SIBR_GPU_LINEAR_SAMPLING | SIBR_FLIP_TEXTURE);
 
@@ -44,12 +44,14 @@ namespace sibr {
 		virtual BasicIBRAppArgs {
 		Arg<int> version = { "v", 3, "ULR implementation version" };
 		ArgSwitch softVisibility = { "soft-visibility", false, "generate and use soft visibility masks" };
+		Arg<std::string> softVisibilityCache = { "soft-visibility-cache", "", "directory where soft visibility masks are cached" };
 		Arg<bool> masks = { "masks" , "use binary masks" };
 		Arg<std::string> maskParams = { "masks-param" , "" };
 		Arg<std::string> maskParamsExtra = { "masks-param-extra" , "" };
 		Arg<bool> invert = { "invert", "invert the masks" };
 		Arg<bool> alphas = { "alphas", "" };
 		Arg<bool> poisson = { "poisson-blend", "apply Poisson-filling to the ULR result" };
+		Arg<int> residentImages = { "resident-images", 0, "number of input images kept on the GPU at full resolution, decoded from disk when needed (ULR v3 only), 0 to load all images" };
 	};
 
 }
@@ -0,0 +1,354 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#include <projects/ulr/renderer/SoftVisibilityMaps.hpp>
+#include <core/system/SimpleTimer.hpp>
+#include <core/system/TaskScheduler.hpp>
+#include <core/system/Utils.hpp>
+
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <random>
+#include <sstream>
+
+namespace sibr {
+
+	namespace {
+
+		/** Distance used for pixels without any edge. */
+		const float farDistance = 1e10f;
+
+		/** Magic string of the cache files. */
+		const char cacheMagic[8] = { 'S', 'I', 'B', 'R', 'S', 'V', 'M', '1' };
+
+		/** Fixed point scale of the cached distances. */
+		const float cacheScale = 32.0f;
+
+		/**
+		 * 1D squared distance transform of a sampled function (Felzenszwalb and Huttenlocher).
+		 * \param f the function values
+		 * \param n the number of samples
+		 * \param d will contain the squared distances
+		 * \param v scratch buffer of n parabola locations
+		 * \param z scratch buffer of n+1 parabola boundaries
+		 */
+		void distanceTransform1D(const double * f, int n, double * d, int * v, double * z)
+		{
+			int k = 0;
+			v[0] = 0;
+			z[0] = -std::numeric_limits<double>::infinity();
+			z[1] = std::numeric_limits<double>::infinity();
+			for (int q = 1; q < n; ++q) {
+				double s = ((f[q] + double(q) * q) - (f[v[k]] + double(v[k]) * v[k])) / (2.0 * (q - v[k]));
+				while (s <= z[k]) {
+					--k;
+					s = ((f[q] + double(q) * q) - (f[v[k]] + double(v[k]) * v[k])) / (2.0 * (q - v[k]));
+				}
+				++k;
+				v[k] = q;
+				z[k] = s;
+				z[k + 1] = std::numeric_limits<double>::infinity();
+			}
+			k = 0;
+			for (int q = 0; q < n; ++q) {
+				while (z[k + 1] < q) {
+					++k;
+				}
+				d[q] = double(q - v[k]) * (q - v[k]) + f[v[k]];
+			}
+		}
+
+		/** Hash a depth map content and the parameters used to process it. */
+		uint64_t contentHash(const sibr::ImageL32F & depthMap, float threshold)
+		{
+			uint64_t hash = 1469598103934665603ull;
+			const auto mix = [&hash](uint64_t value) {
+				hash ^= value;
+				hash *= 1099511628211ull;
+			};
+			uint32_t thresholdBits;
+			std::memcpy(&thresholdBits, &threshold, sizeof(float));
+			mix(thresholdBits);
+			mix(depthMap.w());
+			mix(depthMap.h());
+			const cv::Mat & pixels = depthMap.toOpenCV();
+			const size_t rowBytes = size_t(pixels.cols) * sizeof(float);
+			for (int y = 0; y < pixels.rows; ++y) {
+				const uchar * row = pixels.ptr<uchar>(y);
+				for (size_t x = 0; x + 8 <= rowBytes; x += 8) {
+					uint64_t value;
+					std::memcpy(&value, row + x, 8);
+					mix(value);
+				}
+				if (rowBytes % 8 != 0) {
+					uint32_t value;
+					std::memcpy(&value, row + rowBytes - 4, 4);
+					mix(value);
+				}
+			}
+			return hash;
+		}
+
+		/** Per-camera routine previously used by ULRV2View::computeVisibilityMap, kept as a reference. */
+		void referenceVisibilityMap(const sibr::ImageL32F & depthMap, sibr::ImageRGBA & out)
+		{
+			const float threshold_3d = 2.5f;
+			const std::vector<sibr::Vector2i> shifts = { { 1,0 },{ 0,1 },{ -1,0 },{ 0,-1 } };
+
+			sibr::ImageL8 edgeMap(depthMap.w(), depthMap.h(), 255);
+			for (uint i = 0; i < depthMap.h(); i++) {
+				for (uint j = 0; j < depthMap.w(); j++) {
+					sibr::Vector2i pos(j, i);
+					float currentDepth = depthMap(pos).x();
+					for (const auto & shift : shifts) {
+						Vector2i npos = pos + shift;
+						if (!depthMap.isInRange(npos)) { continue; }
+						if (std::abs(depthMap(npos).x() - currentDepth) > threshold_3d) {
+							edgeMap(pos).x() = 0;
+							break;
+						}
+					}
+				}
+			}
+
+			cv::Mat distance(depthMap.h(), depthMap.w(), CV_32FC1);
+			cv::distanceTransform(edgeMap.toOpenCVnonConst(), distance, cv::DIST_L2, cv::DIST_MASK_PRECISE);
+
+			sibr::ImageL32F outF;
+			outF.fromOpenCV(distance);
+			out = sibr::convertL32FtoRGBA(outF);
+		}
+
+	}
+
+	void SoftVisibilityMaps::computeEdges(const sibr::ImageL32F & depthMap, float threshold, sibr::ImageL8 & edges)
+	{
+		const int w = int(depthMap.w()), h = int(depthMap.h());
+		edges = sibr::ImageL8(uint(w), uint(h));
+		const cv::Mat & depth = depthMap.toOpenCV();
+		cv::Mat & dst = edges.toOpenCVnonConst();
+
+		// Discontinuities with the right and bottom neighbours, the bottom ones being reused for the next row.
+		std::vector<uchar> right(w, 0), above(w, 0), below(w, 0);
+		for (int y = 0; y < h; ++y) {
+			const float * row = depth.ptr<float>(y);
+			for (int x = 0; x < w - 1; ++x) {
+				right[x] = std::abs(row[x + 1] - row[x]) > threshold ? 1 : 0;
+			}
+			if (y + 1 < h) {
+				const float * next = depth.ptr<float>(y + 1);
+				for (int x = 0; x < w; ++x) {
+					below[x] = std::abs(next[x] - row[x]) > threshold ? 1 : 0;
+				}
+			} else {
+				std::fill(below.begin(), below.end(), uchar(0));
+			}
+
+			uchar * out = dst.ptr<uchar>(y);
+			out[0] = (right[0] | above[0] | below[0]) ? 0 : 255;
+			for (int x = 1; x < w; ++x) {
+				out[x] = (right[x] | right[x - 1] | above[x] | below[x]) ? 0 : 255;
+			}
+			std::swap(above, below);
+		}
+	}
+
+	void SoftVisibilityMaps::distanceTransform(const sibr::ImageL8 & edges, sibr::ImageL32F & distances)
+	{
+		const int w = int(edges.w()), h = int(edges.h());
+		const cv::Mat & src = edges.toOpenCV();
+
+		// Vertical pass: distance to the closest edge in each column, with a downward and an upward sweep over full rows.
+		cv::Mat1f column(h, w);
+		for (int y = 0; y < h; ++y) {
+			const uchar * in = src.ptr<uchar>(y);
+			float * out = column.ptr<float>(y);
+			const float * previous = y > 0 ? column.ptr<float>(y - 1) : nullptr;
+			for (int x = 0; x < w; ++x) {
+				const float fromAbove = previous ? std::min(previous[x] + 1.0f, farDistance) : farDistance;
+				out[x] = in[x] == 0 ? 0.0f : fromAbove;
+			}
+		}
+		for (int y = h - 2; y >= 0; --y) {
+			float * out = column.ptr<float>(y);
+			const float * next = column.ptr<float>(y + 1);
+			for (int x = 0; x < w; ++x) {
+				out[x] = std::min(out[x], next[x] + 1.0f);
+			}
+		}
+
+		// Horizontal pass: exact 1D transform of the squared column distances, row by row.
+		distances = sibr::ImageL32F(uint(w), uint(h));
+		cv::Mat & dst = distances.toOpenCVnonConst();
+		std::vector<double> f(w), d(w), z(w + 1);
+		std::vector<int> v(w);
+		for (int y = 0; y < h; ++y) {
+			const float * in = column.ptr<float>(y);
+			for (int x = 0; x < w; ++x) {
+				f[x] = double(in[x]) * double(in[x]);
+			}
+			distanceTransform1D(f.data(), w, d.data(), v.data(), z.data());
+			float * out = dst.ptr<float>(y);
+			for (int x = 0; x < w; ++x) {
+				out[x] = std::min(float(std::sqrt(d[x])), farDistance);
+			}
+		}
+	}
+
+	void SoftVisibilityMaps::compute(const sibr::ImageL32F & depthMap, sibr::ImageL32F & out, float threshold)
+	{
+		sibr::ImageL8 edges;
+		computeEdges(depthMap, threshold, edges);
+		distanceTransform(edges, out);
+	}
+
+	void SoftVisibilityMaps::computeAll(const std::vector<sibr::ImageL32F> & depthMaps, std::vector<sibr::ImageL32F> & out,
+		float threshold, const std::string & cacheDirectory)
+	{
+		out.resize(depthMaps.size());
+		if (!cacheDirectory.empty() && !directoryExists(cacheDirectory)) {
+			makeDirectory(cacheDirectory);
+		}
+
+		std::atomic<int> numCached(0);
+		sibr::parallelFor(0, int(depthMaps.size()), [&](int i) {
+			std::string path;
+			if (!cacheDirectory.empty()) {
+				std::stringstream name;
+				name << cacheDirectory << "/" << std::hex << std::setw(16) << std::setfill('0') << contentHash(depthMaps[i], threshold) << ".svm";
+				path = name.str();
+				if (loadCached(path, depthMaps[i].w(), depthMaps[i].h(), out[i])) {
+					++numCached;
+					return;
+				}
+			}
+			compute(depthMaps[i], out[i], threshold);
+			if (!path.empty()) {
+				saveCached(path, out[i]);
+			}
+		}, 1);
+
+		SIBR_LOG << "[SoftVisibilityMaps] " << depthMaps.size() << " soft visibility maps, " << numCached.load() << " loaded from the cache." << std::endl;
+	}
+
+	bool SoftVisibilityMaps::loadCached(const std::string & path, uint w, uint h, sibr::ImageL32F & out)
+	{
+		std::ifstream file(path, std::ios::binary);
+		if (!file) {
+			return false;
+		}
+		char magic[8];
+		uint32_t size[2] = { 0, 0 };
+		file.read(magic, sizeof(magic));
+		file.read(reinterpret_cast<char*>(size), sizeof(size));
+		if (!file || std::memcmp(magic, cacheMagic, sizeof(magic)) != 0 || size[0] != w || size[1] != h) {
+			SIBR_WRG << "[SoftVisibilityMaps] Invalid cache file " << path << "." << std::endl;
+			return false;
+		}
+
+		std::vector<uint16_t> values(size_t(w) * h);
+		file.read(reinterpret_cast<char*>(values.data()), std::streamsize(values.size() * sizeof(uint16_t)));
+		if (!file) {
+			return false;
+		}
+		out = sibr::ImageL32F(w, h);
+		cv::Mat & dst = out.toOpenCVnonConst();
+		for (int y = 0; y < int(h); ++y) {
+			float * row = dst.ptr<float>(y);
+			const uint16_t * in = values.data() + size_t(y) * w;
+			for (int x = 0; x < int(w); ++x) {
+				row[x] = float(in[x]) / cacheScale;
+			}
+		}
+		return true;
+	}
+
+	void SoftVisibilityMaps::saveCached(const std::string & path, const sibr::ImageL32F & map)
+	{
+		// Distances are only meaningful close to the edges, larger ones saturate.
+		std::vector<uint16_t> values(size_t(map.w()) * map.h());
+		const cv::Mat & src = map.toOpenCV();
+		for (int y = 0; y < int(map.h()); ++y) {
+			const float * row = src.ptr<float>(y);
+			uint16_t * out = values.data() + size_t(y) * map.w();
+			for (int x = 0; x < int(map.w()); ++x) {
+				out[x] = uint16_t(std::min(row[x] * cacheScale + 0.5f, 65535.0f));
+			}
+		}
+
+		std::ofstream file(path, std::ios::binary);
+		const uint32_t size[2] = { map.w(), map.h() };
+		file.write(cacheMagic, sizeof(cacheMagic));
+		file.write(reinterpret_cast<const char*>(size), sizeof(size));
+		file.write(reinterpret_cast<const char*>(values.data()), std::streamsize(values.size() * sizeof(uint16_t)));
+		if (!file) {
+			SIBR_WRG << "[SoftVisibilityMaps] Unable to write cache file " << path << "." << std::endl;
+		}
+	}
+
+	void SoftVisibilityMaps::benchmark(uint numMaps, uint w, uint h)
+	{
+		// Slanted backgrounds with boxes in front of them.
+		std::mt19937 rng(7);
+		std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+		std::vector<sibr::ImageL32F> depthMaps(numMaps);
+		for (uint i = 0; i < numMaps; ++i) {
+			depthMaps[i] = sibr::ImageL32F(w, h);
+			cv::Mat & depth = depthMaps[i].toOpenCVnonConst();
+			const float slope = 10.0f * uniform(rng);
+			for (int y = 0; y < int(h); ++y) {
+				for (int x = 0; x < int(w); ++x) {
+					depth.at<float>(y, x) = 50.0f + slope * float(x) / float(w);
+				}
+			}
+			for (int b = 0; b < 12; ++b) {
+				const int x0 = int(uniform(rng) * w), y0 = int(uniform(rng) * h);
+				const int bw = int(uniform(rng) * w / 4) + 1, bh = int(uniform(rng) * h / 4) + 1;
+				const cv::Rect box = cv::Rect(x0, y0, bw, bh) & cv::Rect(0, 0, int(w), int(h));
+				depth(box).setTo(10.0f + 30.0f * uniform(rng));
+			}
+		}
+
+		Timer timer(true);
+		std::vector<sibr::ImageL32F> reference(numMaps);
+		sibr::parallelFor(0, int(numMaps), [&](int i) {
+			sibr::ImageRGBA packed;
+			referenceVisibilityMap(depthMaps[i], packed);
+			reference[i] = sibr::convertRGBAtoL32F(packed);
+		}, 1);
+		const double referenceTime = timer.deltaTimeFromLastTic<Timer::micro>() * 1e-3;
+
+		timer.tic();
+		std::vector<sibr::ImageL32F> maps;
+		computeAll(depthMaps, maps);
+		const double batchTime = timer.deltaTimeFromLastTic<Timer::micro>() * 1e-3;
+
+		// Distances far from any edge do not affect the blending.
+		float maxError = 0.0f;
+		for (uint i = 0; i < numMaps; ++i) {
+			const cv::Mat & a = reference[i].toOpenCV();
+			const cv::Mat & b = maps[i].toOpenCV();
+			for (int y = 0; y < int(h); ++y) {
+				for (int x = 0; x < int(w); ++x) {
+					maxError = std::max(maxError, std::abs(std::min(a.at<float>(y, x), 1000.0f) - std::min(b.at<float>(y, x), 1000.0f)));
+				}
+			}
+		}
+
+		SIBR_LOG << "[SoftVisibilityMaps] " << numMaps << " maps of " << w << "x" << h << ": reference " << referenceTime << "ms, batch "
+			<< batchTime << "ms, max difference " << maxError << " pixels." << std::endl;
+	}
+
+} /*namespace sibr*/
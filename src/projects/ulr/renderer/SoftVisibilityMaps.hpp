@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+# include "Config.hpp"
+# include <core/system/Config.hpp>
+# include <core/graphics/Image.hpp>
+
+namespace sibr {
+
+	/**
+	 * \class SoftVisibilityMaps
+	 * \brief Batch generation of the soft visibility maps used by ULRV2: for each input camera, the distance in pixels
+	 * to the closest depth discontinuity.
+	 * Edges are detected row by row with branchless loops, and distances are computed with an exact separable
+	 * Euclidean distance transform (Felzenszwalb and Huttenlocher), so results match cv::distanceTransform with DIST_MASK_PRECISE.
+	 * Maps are written directly as single channel float images, and can be cached on disk in a 16-bit fixed point format.
+	 */
+	class SIBR_EXP_ULR_EXPORT SoftVisibilityMaps
+	{
+	public:
+
+		/**
+		 * Detect depth discontinuities.
+		 * \param depthMap the depth map
+		 * \param threshold minimal depth difference between 4-neighbours to create an edge
+		 * \param edges will contain 0 on both sides of discontinuities, 255 elsewhere
+		 */
+		static void computeEdges(const sibr::ImageL32F & depthMap, float threshold, sibr::ImageL8 & edges);
+
+		/**
+		 * Exact Euclidean distance to the closest zero pixel.
+		 * \param edges the edge map, 0 on edges
+		 * \param distances will contain the distance in pixels, a large value if there are no edges at all
+		 */
+		static void distanceTransform(const sibr::ImageL8 & edges, sibr::ImageL32F & distances);
+
+		/**
+		 * Compute the soft visibility map of a depth map.
+		 * \param depthMap the depth map
+		 * \param out will contain the distance to the closest discontinuity
+		 * \param threshold minimal depth difference to create a discontinuity
+		 */
+		static void compute(const sibr::ImageL32F & depthMap, sibr::ImageL32F & out, float threshold = 2.5f);
+
+		/**
+		 * Compute the soft visibility maps of all input cameras in parallel.
+		 * \param depthMaps the depth maps
+		 * \param out will contain the maps, in the same order
+		 * \param threshold minimal depth difference to create a discontinuity
+		 * \param cacheDirectory if not empty, maps are loaded from this directory when available and saved in it otherwise
+		 */
+		static void computeAll(const std::vector<sibr::ImageL32F> & depthMaps, std::vector<sibr::ImageL32F> & out,
+			float threshold = 2.5f, const std::string & cacheDirectory = "");
+
+		/**
+		 * Compare the batch generation with the per-camera routine of ULRV2View on synthetic depth maps, logging timings and differences.
+		 * \param numMaps number of depth maps
+		 * \param w depth maps width
+		 * \param h depth maps height
+		 */
+		static void benchmark(uint numMaps = 64, uint w = 1296, uint h = 864);
+
+	private:
+
+		/**
+		 * Load a map from the cache.
+		 * \param path the cache file
+		 * \param w the expected width
+		 * \param h the expected height
+		 * \param out will contain the map
+		 * \return false if the file is missing or invalid
+		 */
+		static bool loadCached(const std::string & path, uint w, uint h, sibr::ImageL32F & out);
+
+		/**
+		 * Save a map to the cache.
+		 * \param path the cache file
+		 * \param map the map to save
+		 */
+		static void saveCached(const std::string & path, const sibr::ImageL32F & map);
+	};
+
+} /*namespace sibr*/
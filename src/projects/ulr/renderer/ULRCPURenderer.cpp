@@ -0,0 +1,437 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#include <projects/ulr/renderer/ULRCPURenderer.hpp>
+
+// Same constants as the shaders.
+#define INFTY_W 100000.0f
+#define BETA 	1e-1f
+
+namespace sibr {
+
+	namespace {
+
+		/** Bilinear lookup with clamp to edge, as the GPU samplers.
+		 * Texture coordinates have v pointing up, the images being uploaded flipped.
+		 */
+		template<typename T, int N>
+		void sampleBilinear(const cv::Mat & img, const Vector2f & uv, float scale, float * out)
+		{
+			const float x = uv.x() * float(img.cols) - 0.5f;
+			const float y = (1.0f - uv.y()) * float(img.rows) - 0.5f;
+			const int x0 = int(std::floor(x));
+			const int y0 = int(std::floor(y));
+			const float fx = x - float(x0);
+			const float fy = y - float(y0);
+			const int xa = sibr::clamp(x0, 0, img.cols - 1), xb = sibr::clamp(x0 + 1, 0, img.cols - 1);
+			const int ya = sibr::clamp(y0, 0, img.rows - 1), yb = sibr::clamp(y0 + 1, 0, img.rows - 1);
+			const T * r0 = img.ptr<T>(ya);
+			const T * r1 = img.ptr<T>(yb);
+			for (int c = 0; c < N; ++c) {
+				const float top = (1.0f - fx) * float(r0[xa * N + c]) + fx * float(r0[xb * N + c]);
+				const float bottom = (1.0f - fx) * float(r1[xa * N + c]) + fx * float(r1[xb * N + c]);
+				out[c] = scale * ((1.0f - fy) * top + fy * bottom);
+			}
+		}
+
+		/** Random debug color of a camera, same hash as getRandomColor in the shaders. */
+		Vector3f randomColor(int x)
+		{
+			// Color 0 is black, so we shift everything.
+			uint32_t p = uint32_t(x + 1);
+			p = 1103515245U * ((p >> 1U) ^ (p));
+			const uint32_t h32 = 1103515245U * ((p) ^ (p >> 3U));
+			const uint32_t n = h32 ^ (h32 >> 16);
+			return Vector3f(float(n & 0x7fffffffU), float((n * 16807U) & 0x7fffffffU), float((n * 48271U) & 0x7fffffffU)) / float(0x7fffffff);
+		}
+
+		/** ULR penalty: angle between the input and novel rays, plus a resolution term. */
+		float penalty(const Vector3f & point, const Vector3f & camPos, const Vector3f & eyePos, bool occTest)
+		{
+			const Vector3f v1 = point - camPos;
+			const Vector3f v2 = point - eyePos;
+			const float dist_i2p = v1.norm();
+			const float dist_n2p = v2.norm();
+			const float penalty_ang = float(occTest) * std::max(0.0001f, std::acos(sibr::clamp(v1.dot(v2) / (dist_i2p * dist_n2p), -1.0f, 1.0f)));
+			const float penalty_res = std::max(0.0001f, (dist_i2p - dist_n2p) / dist_i2p);
+			return penalty_ang + BETA * penalty_res;
+		}
+
+	}
+
+	ULRCPURenderer::ULRCPURenderer(const std::vector<InputCamera::Ptr> & cameras, const std::vector<ImageRGB::Ptr> & images, const sibr::Mesh & proxy, int tileSize)
+		: _images(images), _tileSize(std::max(1, tileSize))
+	{
+		if (cameras.size() != images.size()) {
+			SIBR_ERR << "[ULRCPURenderer] Cameras and images counts differ." << std::endl;
+		}
+
+		_raycaster.init();
+		_raycaster.addMesh(proxy);
+
+		for (const auto & cam : cameras) {
+			_cameras.push_back({ cam->viewproj(), cam->position(), cam->dir() });
+			_selected.push_back(cam->isActive() ? 1 : 0);
+		}
+
+		// Input depth maps, at the images resolution.
+		std::vector<Vector3f> positions;
+		_depths.resize(cameras.size());
+		for (size_t i = 0; i < cameras.size(); ++i) {
+			castProxy(*cameras[i], images[i]->w(), images[i]->h(), positions, _depths[i]);
+		}
+		SIBR_LOG << "[ULRCPURenderer] Computed " << cameras.size() << " input depth maps." << std::endl;
+	}
+
+	void ULRCPURenderer::updateCameras(const std::vector<uint> & camIds)
+	{
+		std::fill(_selected.begin(), _selected.end(), 0);
+		for (const auto & camId : camIds) {
+			_selected[camId] = 1;
+		}
+	}
+
+	void ULRCPURenderer::castProxy(const sibr::Camera & cam, uint w, uint h, std::vector<Vector3f> & positions, sibr::ImageL32F & depths) const
+	{
+		positions.assign(size_t(w) * size_t(h), Vector3f(0.0f, 0.0f, 0.0f));
+		depths = sibr::ImageL32F(w, h, 1.0f);
+		cv::Mat & depthsCV = depths.toOpenCVnonConst();
+
+#pragma omp parallel for
+		for (int y = 0; y < int(h); ++y) {
+			float * depthRow = depthsCV.ptr<float>(y);
+			for (int x = 0; x < int(w); ++x) {
+				// Rays go from the near to the far plane, through the pixel center.
+				const float ndcX = 2.0f * (float(x) + 0.5f) / float(w) - 1.0f;
+				const float ndcY = 1.0f - 2.0f * (float(y) + 0.5f) / float(h);
+				const Vector3f origin = cam.unproject(Vector3f(ndcX, ndcY, -1.0f));
+				const Vector3f dir = (cam.unproject(Vector3f(ndcX, ndcY, 1.0f)) - origin).normalized();
+				const RayHit hit = _raycaster.intersect(Ray(origin, dir));
+				if (!hit.hitSomething()) {
+					continue;
+				}
+				const Vector3f point = origin + hit.dist() * dir;
+				const float depth = cam.project(point).z() * 0.5f + 0.5f;
+				if (depth < 1.0f) {
+					positions[size_t(y) * w + x] = point;
+					depthRow[x] = depth;
+				}
+			}
+		}
+	}
+
+	bool ULRCPURenderer::projectInCamera(const Vector3f & point, size_t i, Vector3f & uvd) const
+	{
+		const CameraInfos & cam = _cameras[i];
+		const Vector4f p1 = cam.vp * Vector4f(point.x(), point.y(), point.z(), 1.0f);
+		uvd = (p1.head<3>() / p1.w()) * 0.5f + Vector3f(0.5f, 0.5f, 0.5f);
+		const float ndcX = std::abs(2.0f * uvd.x() - 1.0f);
+		const float ndcY = std::abs(2.0f * uvd.y() - 1.0f);
+		return ndcX <= 1.0f && ndcY <= 1.0f && cam.dir.dot(point - cam.pos) > 0.0f;
+	}
+
+	void ULRCPURenderer::sampleColor(size_t i, const Vector2f & uv, Vector3f & color) const
+	{
+		// As getRGBD in the shaders, only the color lookup is flipped.
+		const Vector2f rgbUV = _flipRGBs ? Vector2f(uv.x(), 1.0f - uv.y()) : uv;
+		sampleBilinear<uchar, 3>(_images[i]->toOpenCV(), rgbUV, 1.0f / 255.0f, color.data());
+	}
+
+	float ULRCPURenderer::maskValue(size_t i, const Vector2f & uv) const
+	{
+		float masked = 0.0f;
+		sampleBilinear<uchar, 1>(_masks[i]->toOpenCV(), uv, 1.0f / 255.0f, &masked);
+		return _invertMasks ? 1.0f - masked : masked;
+	}
+
+	bool ULRCPURenderer::shade(const Vector3f & point, const Vector3f & eyePos, Vector3f & out) const
+	{
+		switch (_weightsMode) {
+		case WeightsMode::VARIANCE_BASED:
+			return shadeVariance(point, eyePos, out);
+		case WeightsMode::ULR_FAST:
+			return shadeFast(point, eyePos, out);
+		default:
+			return shadeULR(point, eyePos, out);
+		}
+	}
+
+	bool ULRCPURenderer::shadeULR(const Vector3f & point, const Vector3f & eyePos, Vector3f & out) const
+	{
+		Candidate best[4];
+		bool atLeastOneValid = false;
+
+		for (size_t i = 0; i < _cameras.size(); ++i) {
+			if (_selected[i] == 0) {
+				continue;
+			}
+			Vector3f uvd;
+			if (!projectInCamera(point, i, uvd)) {
+				continue;
+			}
+			const Vector2f uv = uvd.head<2>();
+
+			Candidate candidate;
+			sampleColor(i, uv, candidate.color);
+
+			if (_useMasks && i < _masks.size() && _masks[i]) {
+				const float masked = maskValue(i, uv);
+				if (_areMasksBinary) {
+					if (masked < 0.5f) {
+						continue;
+					}
+				} else {
+					candidate.color *= masked;
+				}
+			}
+
+			if (_discardBlackPixels && candidate.color.isZero(0.0f)) {
+				continue;
+			}
+
+			if (_occTest) {
+				float depth;
+				sampleBilinear<float, 1>(_depths[i].toOpenCV(), uv, 1.0f, &depth);
+				if (std::abs(uvd.z() - depth) >= _epsilonOcclusion) {
+					continue;
+				}
+			}
+
+			if (_showWeights) {
+				candidate.color = randomColor(int(i));
+			}
+
+			atLeastOneValid = true;
+			candidate.w = penalty(point, _cameras[i].pos, eyePos, _occTest);
+
+			// insert at the appropriate rank among the four best candidates
+			if (candidate.w < best[3].w) {
+				int rank = 3;
+				while (rank > 0 && candidate.w < best[rank - 1].w) {
+					best[rank] = best[rank - 1];
+					--rank;
+				}
+				best[rank] = candidate;
+			}
+		}
+
+		if (!atLeastOneValid) {
+			return false;
+		}
+		if (_winnerTakesAll) {
+			out = best[0].color;
+			return true;
+		}
+
+		const float thresh = 1.0000001f * best[3].w;
+		float weights[4];
+		for (int c = 0; c < 3; ++c) {
+			weights[c] = std::max(0.0f, 1.0f - best[c].w / thresh);
+		}
+		weights[3] = 1.0f - 1.0f / 1.0000001f;
+
+		out = (weights[0] * best[0].color + weights[1] * best[1].color + weights[2] * best[2].color + weights[3] * best[3].color)
+			/ (weights[0] + weights[1] + weights[2] + weights[3]);
+		return true;
+	}
+
+	bool ULRCPURenderer::shadeVariance(const Vector3f & point, const Vector3f & eyePos, Vector3f & out) const
+	{
+		Vector3f colorSum(0.0f, 0.0f, 0.0f);
+		float weightSum = 0.0f;
+
+		for (size_t i = 0; i < _cameras.size(); ++i) {
+			if (_selected[i] == 0) {
+				continue;
+			}
+			Vector3f uvd;
+			if (!projectInCamera(point, i, uvd)) {
+				continue;
+			}
+			const Vector2f uv = uvd.head<2>();
+
+			Vector3f color;
+			sampleColor(i, uv, color);
+			if (_showWeights) {
+				color = randomColor(int(i));
+			}
+
+			if (_useMasks && i < _masks.size() && _masks[i]) {
+				const float masked = maskValue(i, uv);
+				if (_areMasksBinary) {
+					if (masked < 0.5f) {
+						continue;
+					}
+				} else {
+					color *= masked;
+				}
+			}
+
+			if (_discardBlackPixels && color.isZero(0.0f)) {
+				continue;
+			}
+
+			if (_occTest) {
+				float depth;
+				sampleBilinear<float, 1>(_depths[i].toOpenCV(), uv, 1.0f, &depth);
+				if (std::abs(uvd.z() - depth) >= _epsilonOcclusion) {
+					continue;
+				}
+			}
+
+			const float weight = 1.0f / penalty(point, _cameras[i].pos, eyePos, _occTest);
+			colorSum += weight * color;
+			weightSum += weight;
+		}
+
+		out = weightSum > 0.0f ? Vector3f(colorSum / weightSum) : Vector3f(0.0f, 0.0f, 0.0f);
+		return true;
+	}
+
+	bool ULRCPURenderer::shadeFast(const Vector3f & point, const Vector3f & eyePos, Vector3f & out) const
+	{
+		Candidate best[4];
+
+		for (size_t i = 0; i < _cameras.size(); ++i) {
+			if (_selected[i] == 0) {
+				continue;
+			}
+			Vector3f uvd;
+			if (!projectInCamera(point, i, uvd)) {
+				continue;
+			}
+
+			Candidate candidate;
+			candidate.uv = uvd.head<2>();
+			candidate.cam = int(i);
+
+			// Only the depth is read in the loop, colors are fetched for the four best cameras.
+			if (_occTest) {
+				float depth;
+				sampleBilinear<float, 1>(_depths[i].toOpenCV(), candidate.uv, 1.0f, &depth);
+				if (std::abs(uvd.z() - depth) >= _epsilonOcclusion) {
+					continue;
+				}
+			}
+
+			if (_useMasks && i < _masks.size() && _masks[i]) {
+				candidate.mask = maskValue(i, candidate.uv);
+				if (_areMasksBinary && candidate.mask < 0.5f) {
+					continue;
+				}
+			}
+
+			candidate.w = penalty(point, _cameras[i].pos, eyePos, _occTest);
+
+			if (candidate.w < best[3].w) {
+				int rank = 3;
+				while (rank > 0 && candidate.w < best[rank - 1].w) {
+					best[rank] = best[rank - 1];
+					--rank;
+				}
+				best[rank] = candidate;
+			}
+		}
+
+		if (best[0].w == INFTY_W) {
+			return false;
+		}
+
+		const float thresh = 1.0000001f * best[3].w;
+		float weights[4];
+		for (int c = 0; c < 3; ++c) {
+			weights[c] = std::max(0.0f, 1.0f - best[c].w / thresh);
+		}
+		weights[3] = 1.0f - 1.0f / 1.0000001f;
+
+		out.setZero();
+		for (int c = 0; c < 4; ++c) {
+			Vector3f color;
+			if (_showWeights) {
+				color = randomColor(best[c].cam);
+			} else {
+				sampleColor(size_t(best[c].cam), best[c].uv, color);
+				color *= best[c].mask;
+			}
+			out += weights[c] * color;
+		}
+		out /= (weights[0] + weights[1] + weights[2] + weights[3]);
+
+		if (_gammaCorrection) {
+			out = out.array().pow(1.0f / 2.2f);
+		}
+		return true;
+	}
+
+	void ULRCPURenderer::process(const sibr::Camera & eye, uint w, uint h, sibr::ImageRGBA & dst) const
+	{
+		std::vector<Vector3f> positions;
+		sibr::ImageL32F depths;
+		castProxy(eye, w, h, positions, depths);
+
+		dst = sibr::ImageRGBA(w, h, sibr::ImageRGBA::Pixel(0, 0, 0, 0));
+		cv::Mat & dstCV = dst.toOpenCVnonConst();
+
+		const int tilesX = (int(w) + _tileSize - 1) / _tileSize;
+		const int tilesY = (int(h) + _tileSize - 1) / _tileSize;
+
+		// Tiles have varying costs (background, number of visible cameras), distribute them dynamically.
+#pragma omp parallel for schedule(dynamic)
+		for (int tile = 0; tile < tilesX * tilesY; ++tile) {
+			const int x0 = (tile % tilesX) * _tileSize;
+			const int y0 = (tile / tilesX) * _tileSize;
+			const int x1 = std::min(int(w), x0 + _tileSize);
+			const int y1 = std::min(int(h), y0 + _tileSize);
+
+			for (int y = y0; y < y1; ++y) {
+				const float * depthRow = depths.toOpenCV().ptr<float>(y);
+				uchar * dstRow = dstCV.ptr<uchar>(y);
+				for (int x = x0; x < x1; ++x) {
+					// No intersection with the proxy.
+					if (depthRow[x] >= 1.0f) {
+						continue;
+					}
+					Vector3f color;
+					if (!shade(positions[size_t(y) * w + x], eye.position(), color)) {
+						continue;
+					}
+					for (int c = 0; c < 3; ++c) {
+						dstRow[4 * x + c] = uchar(std::round(sibr::clamp(color[c], 0.0f, 1.0f) * 255.0f));
+					}
+					dstRow[4 * x + 3] = 255;
+				}
+			}
+		}
+	}
+
+	size_t ULRCPURenderer::countDifferences(const sibr::ImageRGBA & a, const sibr::ImageRGBA & b, int tolerance)
+	{
+		if (a.w() != b.w() || a.h() != b.h()) {
+			SIBR_WRG << "[ULRCPURenderer] Comparing images of different sizes." << std::endl;
+			return size_t(std::max(a.w() * a.h(), b.w() * b.h()));
+		}
+		size_t count = 0;
+		for (uint y = 0; y < a.h(); ++y) {
+			const uchar * rowA = a.toOpenCV().ptr<uchar>(y);
+			const uchar * rowB = b.toOpenCV().ptr<uchar>(y);
+			for (uint x = 0; x < a.w(); ++x) {
+				bool differ = false;
+				for (int c = 0; c < 4; ++c) {
+					differ = differ || std::abs(int(rowA[4 * x + c]) - int(rowB[4 * x + c])) > tolerance;
+				}
+				count += differ ? 1 : 0;
+			}
+		}
+		return count;
+	}
+
+} /*namespace sibr*/
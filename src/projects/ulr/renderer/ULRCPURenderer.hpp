@@ -0,0 +1,198 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+# include "Config.hpp"
+# include <core/system/Config.hpp>
+# include <core/graphics/Image.hpp>
+# include <core/graphics/Mesh.hpp>
+# include <core/assets/InputCamera.hpp>
+# include <core/raycaster/Raycaster.hpp>
+
+namespace sibr {
+
+	/**
+	 * \class ULRCPURenderer
+	 * \brief CPU reference implementation of the ULRV3 blending (ulr_v3, ulr_v3_alt and ulr_v3_fast shaders), without any OpenGL context.
+	 * Proxy positions and input depth maps are computed with the raycaster instead of being rasterized, textures are sampled
+	 * bilinearly with clamping as the GPU does, and output tiles are rendered in parallel.
+	 * Results match the GPU version up to filtering precision, which makes it usable for regression tests and offline rendering.
+	 */
+	class SIBR_EXP_ULR_EXPORT ULRCPURenderer
+	{
+		SIBR_CLASS_PTR(ULRCPURenderer);
+
+	public:
+
+		/** Blending weights, same order as ULRV3View::WeightsMode. */
+		enum class WeightsMode { ULR, VARIANCE_BASED, ULR_FAST };
+
+		/**
+		 * Constructor, computes the input depth maps.
+		 * \param cameras The input cameras.
+		 * \param images The input images, in the same order.
+		 * \param proxy The geometric proxy.
+		 * \param tileSize Size of the square tiles rendered in parallel.
+		 */
+		ULRCPURenderer(const std::vector<InputCamera::Ptr> & cameras,
+			const std::vector<ImageRGB::Ptr> & images,
+			const sibr::Mesh & proxy,
+			int tileSize = 32
+		);
+
+		/**
+		 * Performs ULR rendering of a novel viewpoint.
+		 * \param eye The novel viewpoint.
+		 * \param w The output width.
+		 * \param h The output height.
+		 * \param dst Will contain the result, top row first. Pixels not covered by the proxy or without any valid input have a zero alpha.
+		 */
+		void process(const sibr::Camera & eye, uint w, uint h, sibr::ImageRGBA & dst) const;
+
+		/**
+		 *  Update which cameras should be used for rendering, based on the indices passed.
+		 *  \param camIds The indices to enable.
+		 **/
+		void updateCameras(const std::vector<uint> & camIds);
+
+		/** Set the masks used to ignore regions of the input images.
+		 * \param masks one mask per input image, 255 denoting valid pixels.
+		 */
+		void setMasks(const std::vector<ImageL8::Ptr> & masks) { _masks = masks; }
+
+		/** Count the pixels differing between two renderings, to compare against a reference.
+		 * \param a first image
+		 * \param b second image, of the same size
+		 * \param tolerance maximal difference allowed on each channel
+		 * \return the number of pixels with at least one channel differing by more than the tolerance
+		 */
+		static size_t countDifferences(const sibr::ImageRGBA & a, const sibr::ImageRGBA & b, int tolerance = 2);
+
+		/// Blending weights mode.
+		WeightsMode & weightsMode() { return _weightsMode; }
+
+		/// Set the epsilon occlusion threshold.
+		float & epsilonOcclusion() { return _epsilonOcclusion; }
+
+		/// Enable or disable the masks.
+		bool & useMasks() { return _useMasks; }
+
+		/// Are the masks binary.
+		bool & areMasksBinary() { return _areMasksBinary; }
+
+		/// Should the masks be inverted.
+		bool & invertMasks() { return _invertMasks; }
+
+		/// Ignore black input pixels.
+		bool & discardBlackPixels() { return _discardBlackPixels; }
+
+		/// Enable or diable occlusion testing.
+		bool & occTest() { return _occTest; }
+
+		/// Show debug weights.
+		bool & showWeights() { return _showWeights; }
+
+		/// Flip the input images vertically.
+		bool & flipRGBs() { return _flipRGBs; }
+
+		/// Set winner takes all weights strategy
+		bool & winnerTakesAll() { return _winnerTakesAll; }
+
+		/// Apply gamma correction to the output (fast ULR only, as the shader).
+		bool & gammaCorrection() { return _gammaCorrection; }
+
+		/** \return the depth map of an input camera, in [0,1] as stored in the GPU depth arrays. */
+		const sibr::ImageL32F & inputDepth(size_t i) const { return _depths[i]; }
+
+	private:
+
+		/** Input camera data used during blending. */
+		struct CameraInfos {
+			Matrix4f vp; ///< View projection matrix.
+			Vector3f pos; ///< Position.
+			Vector3f dir; ///< Viewing direction.
+		};
+
+		/** Candidate in the k-best selection, as in the shaders. */
+		struct Candidate {
+			Vector3f color = Vector3f(0.0f, 0.0f, 0.0f); ///< Color (ulr) or zero (fast ulr).
+			Vector2f uv = Vector2f(0.0f, 0.0f); ///< Texture coordinates (fast ulr).
+			float w = 100000.0f; ///< Penalty, INFTY_W when uninitialized.
+			float mask = 1.0f; ///< Mask value (fast ulr).
+			int cam = 0; ///< Camera index (fast ulr).
+		};
+
+		/** Raycast the proxy through the center of each pixel of a view.
+		 * \param cam the viewpoint
+		 * \param w the view width
+		 * \param h the view height
+		 * \param positions will contain the world positions, top row first
+		 * \param depths will contain the depths in [0,1], 1 where the proxy is not hit
+		 */
+		void castProxy(const sibr::Camera & cam, uint w, uint h, std::vector<Vector3f> & positions, sibr::ImageL32F & depths) const;
+
+		/** Shade a pixel with the selected weights mode.
+		 * \param point the proxy world position
+		 * \param eyePos the novel viewpoint position
+		 * \param out will contain the color
+		 * \return false if the pixel should be discarded
+		 */
+		bool shade(const Vector3f & point, const Vector3f & eyePos, Vector3f & out) const;
+
+		bool shadeULR(const Vector3f & point, const Vector3f & eyePos, Vector3f & out) const; ///< \copydoc shade
+		bool shadeVariance(const Vector3f & point, const Vector3f & eyePos, Vector3f & out) const; ///< \copydoc shade
+		bool shadeFast(const Vector3f & point, const Vector3f & eyePos, Vector3f & out) const; ///< \copydoc shade
+
+		/** Project a point in an input camera and check that it is in front of it and in its frustum.
+		 * \param point the world position
+		 * \param i the camera index
+		 * \param uvd will contain the texture coordinates and depth, in [0,1]
+		 * \return true if visible
+		 */
+		bool projectInCamera(const Vector3f & point, size_t i, Vector3f & uvd) const;
+
+		/** \return the mask value of a camera at the given texture coordinates, after inversion.
+		 * \param i the camera index
+		 * \param uv texture coordinates
+		 */
+		float maskValue(size_t i, const Vector2f & uv) const;
+
+		/** Sample the color of an input camera, flipped vertically if flipRGBs is set.
+		 * \param i the camera index
+		 * \param uv texture coordinates
+		 * \param color will contain the color in [0,1]
+		 */
+		void sampleColor(size_t i, const Vector2f & uv, Vector3f & color) const;
+
+		std::vector<CameraInfos> _cameras; ///< Input cameras.
+		std::vector<int> _selected; ///< Per-camera selection flag.
+		std::vector<ImageRGB::Ptr> _images; ///< Input images.
+		std::vector<ImageL8::Ptr> _masks; ///< Input masks.
+		std::vector<sibr::ImageL32F> _depths; ///< Input depth maps.
+		mutable sibr::Raycaster _raycaster; ///< Proxy raycaster.
+		int _tileSize; ///< Size of the tiles processed in parallel.
+
+		WeightsMode _weightsMode = WeightsMode::ULR;
+		float _epsilonOcclusion = 0.01f;
+		bool _occTest = true,
+			_useMasks = false,
+			_discardBlackPixels = true,
+			_areMasksBinary = true,
+			_invertMasks = false,
+			_showWeights = false,
+			_winnerTakesAll = false,
+			_gammaCorrection = false,
+			_flipRGBs = false;
+	};
+
+} /*namespace sibr*/
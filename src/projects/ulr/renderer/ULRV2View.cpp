@@ -14,10 +14,10 @@
 #include "Config.hpp"
 #include <core/assets/Resources.hpp>
 #include <projects/ulr/renderer/ULRV2View.hpp>
+#include <projects/ulr/renderer/SoftVisibilityMaps.hpp>
 #include <core/system/Vector.hpp>
 #include <core/graphics/Texture.hpp>
 #include <core/graphics/GUI.hpp>
-#include <map>
 
 namespace sibr { 
 	ULRV2View::~ULRV2View( )
@@ -36,6 +36,7 @@ ULRV2View::ULRV2View( const sibr::BasicIBRScene::Ptr& ibrScene, uint render_w, u
     std::cerr << "[ULR] setting number of images to blend "<< _numDistUlr << " " << _numAnglUlr << std::endl;
 
 	_ulr.reset(new ULRV2Renderer(ibrScene->cameras()->inputCameras(), render_w, render_h, _numDistUlr + _numAnglUlr));
+	_cameraIndex.reset(new InputCameraIndex(ibrScene->cameras()->inputCameras()));
 	uint w = render_w;
 	uint h = render_h;
 	_poissonRT.reset(new RenderTargetRGBA(w, h, SIBR_CLAMP_UVS));
@@ -151,114 +152,41 @@ void ULRV2View::onGUI() {
 
 void ULRV2View::computeVisibilityMap(const sibr::ImageL32F & depthMap, sibr::ImageRGBA & out)
 {
-	const float threshold_3d = 2.5f;
-	const std::vector<sibr::Vector2i> shifts = { { 1,0 },{ 0,1 },{ -1,0 },{ 0,-1 } };
-
-	sibr::ImageL8 edgeMap(depthMap.w(), depthMap.h(), 255);
-	for (uint i = 0; i < depthMap.h(); i++) {
-		for (uint j = 0; j < depthMap.w(); j++) {
-			sibr::Vector2i pos(j, i);
-			float currentDepth = depthMap(pos).x();
-			for (const auto & shift : shifts) {
-				Vector2i npos = pos + shift;
-				if (!depthMap.isInRange(npos)) { continue; }
-				if (std::abs(depthMap(npos).x() - currentDepth) > threshold_3d) {
-					edgeMap(pos).x() = 0;
-					break;
-				}
-			}
-		}
-	}
-
-	cv::Mat distance(depthMap.h(), depthMap.w(), CV_32FC1);
-	cv::distanceTransform(edgeMap.toOpenCVnonConst(), distance, cv::DIST_L2, cv::DIST_MASK_PRECISE);
-
 	sibr::ImageL32F outF;
-	outF.fromOpenCV(distance);
+	SoftVisibilityMaps::compute(depthMap, outF, 2.5f);
 	out = sibr::convertL32FtoRGBA(outF);
-
 }
 
 	// -----------------------------------------------------------------------
 
 std::vector<uint> ULRV2View::chosen_cameras(const sibr::Camera& eye) {
-    std::vector<uint> imgs_id;
-    std::multimap<float,uint> distMap;									// distance wise closest input cameras
-	std::multimap<float,uint> dang;									// angular distance from inputs to novel camera
-    for (uint i=0; i< _scene->cameras()->inputCameras().size(); i++ ) {
-        const sibr::InputCamera& inputCam = *_scene->cameras()->inputCameras()[i];
-        if (inputCam.isActive()) {
-			// Convert following to Eigen versions
-            float dist = sibr::distance(inputCam.position(), eye.position());
-            float angle = sibr::dot(inputCam.dir(),eye.dir());
-                distMap.insert(std::make_pair(dist,i));					// sort distances in increasing order
-				dang.insert(std::make_pair( acos(angle),i));				// sort angles in increasing order
-        }
-    }
-	for (uint i=0; i< _scene->cameras()->inputCameras().size(); i++) {
-        const sibr::InputCamera& inputCam = *_scene->cameras()->inputCameras()[i];
-        if (inputCam.isActive() && distMap.size() <= (_numDistUlr+_numAnglUlr)/2 ) {
-            float dist = sibr::distance(inputCam.position(),eye.position());
-            distMap.insert(std::make_pair(dist,i));					// sort distances in increasing order
-			}
-	}
-
-    std::multimap<float,uint>::const_iterator d_it(distMap.begin());	// select the _numDistUlr closest cameras
-	for (int i=0; d_it!=distMap.end() && i<_numDistUlr; d_it++,i++) {
-        imgs_id.push_back(d_it->second);
-    }
-
-	std::multimap<float,uint>::const_iterator a_it(dang.begin());    // select the NUM_ANG_ULR closest cameras
-	for (int i=0; a_it!=dang.end() && i<_numAnglUlr; a_it++,i++) {
-        imgs_id.push_back(a_it->second);
-    }
-
-	std::sort( imgs_id.begin(), imgs_id.end() );				// Avoid repetitions
-	imgs_id.erase( std::unique( imgs_id.begin(), imgs_id.end() ), imgs_id.end() );
+	// the _numDistUlr closest cameras and the _numAnglUlr cameras with the closest directions, without repetitions
+	std::vector<uint> imgs_id;
+	_cameraIndex->selectULR(eye.position(), eye.dir(), size_t(std::max(0, int(_numDistUlr))), size_t(std::max(0, int(_numAnglUlr))), imgs_id);
 
 	SIBR_ASSERT(imgs_id.size() <= _numDistUlr + _numAnglUlr);
-    return imgs_id;
+	return imgs_id;
 }
 
 std::vector<uint> ULRV2View::chosen_cameras_angdist(const sibr::Camera & eye)
 {
 	const auto & cams = _scene->cameras()->inputCameras();
+	const size_t total_size = size_t(std::max(0, _numAnglUlr + _numDistUlr));
+
+	// best angle / dist combined, back facing cameras rejected
 	std::vector<uint> out;
+	_cameraIndex->bestAngleOverDistance(eye.position(), eye.dir(), total_size, out);
 
-	// sort angle / dist combined
-	struct camAng
-	{
-		camAng() {}
-		camAng(float a, float d, int i) : ang(a), dist(d), id(i) {}
-		float ang, dist;
-		int id;
-		static bool compare(const camAng & a, const camAng & b) { return a.ang / a.dist > b.ang / b.dist;  }
-	};
-
-	int total_size = _numAnglUlr + _numDistUlr;
-
-	std::vector<camAng> allAng;
-	for (int id = 0; id < (int)cams.size(); ++id) {
-		const auto & cam = *cams[id];
-        float angle = sibr::dot(cam.dir(),eye.dir());
-		// reject back facing 
-		if( angle > 0.001 && cam.isActive()) {
-			float dist =  (cam.position() - eye.position()).norm();
-			allAng.push_back(camAng(angle, dist, id));		
+	// complete with any active camera if needed
+	if (out.size() < total_size) {
+		std::vector<bool> wasChosen(cams.size(), false);
+		for (uint id : out) {
+			wasChosen[id] = true;
 		}
-	}
-
-	std::vector<bool> wasChosen(cams.size(), false);
-
-	std::sort(allAng.begin(), allAng.end(), camAng::compare);
-	for (int id = 0; id < std::min((int)allAng.size(), total_size); ++id) {
-		out.push_back(allAng[id].id);
-		wasChosen[allAng[id].id] = true;
-	}
-
-	for (int id = 0; id < (int)cams.size(); ++id) {
-		if (!wasChosen[id] && out.size() < total_size && cams[id]->isActive()) {
-			out.push_back(id);
+		for (int id = 0; id < (int)cams.size() && out.size() < total_size; ++id) {
+			if (!wasChosen[id] && cams[id]->isActive()) {
+				out.push_back(id);
+			}
 		}
 	}
 
@@ -267,27 +195,8 @@ std::vector<uint> ULRV2View::chosen_cameras_angdist(const sibr::Camera & eye)
 
 std::vector<uint> ULRV2View::chosen_camerasNew(const sibr::Camera & eye)
 {
-	const auto & cams = _scene->cameras()->inputCameras();
-
-	struct camDist
-	{
-		camDist() {}
-		camDist(float d, int i) : dist(d), id(i) {}
-		float dist;
-		int id;
-		static bool compare(const camDist & a, const camDist & b) { return a.dist < b.dist;  }
-	};
-
-	std::vector<camDist> allDist;
-	for (int id = 0; id < (int)cams.size(); ++id) {
-		const auto & cam = *cams[id];
-		allDist.push_back(camDist((cam.position() - eye.position()).norm(), id));
-	}
-	std::sort(allDist.begin(), allDist.end(), camDist::compare);
 	std::vector<uint> out;
-	for (int id = 0; id < std::min((int)cams.size(),(int)_numDistUlr); ++id) {
-		out.push_back(allDist[id].id);
-	}
+	_cameraIndex->closestByDistance(eye.position(), size_t(std::max(0, _numDistUlr)), out, false);
 	return out;
 }
 
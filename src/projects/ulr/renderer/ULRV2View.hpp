@@ -17,6 +17,7 @@
 # include <core/graphics/Mesh.hpp>
 # include <core/view/ViewBase.hpp>
 # include "core/scene/BasicIBRScene.hpp"
+# include "core/scene/InputCameraIndex.hpp"
 # include <core/renderer/CopyRenderer.hpp>
 # include <projects/ulr/renderer/ULRV2Renderer.hpp>
 # include <core/renderer/PoissonRenderer.hpp>
@@ -142,7 +143,8 @@ namespace sibr {
 
 		/** Compute soft visibility map.
 		 *\param depthMap view depth map
-		 *\param out will contain the soft visibility map
+		 *\param out will contain the soft visibility map, packed in RGBA
+		 *\note Prefer SoftVisibilityMaps::computeAll to process all input cameras at once.
 		 */
 		void computeVisibilityMap(const sibr::ImageL32F & depthMap, sibr::ImageRGBA & out);
 
@@ -156,6 +158,7 @@ namespace sibr {
 	protected:
 		
 		std::shared_ptr<sibr::BasicIBRScene> _scene; ///< the current scene.
+		InputCameraIndex::Ptr _cameraIndex; ///< Spatial index over the input cameras, for selection.
 		std::shared_ptr<sibr::Mesh>	_altMesh; ///< For the cases when using a different mesh than the scene
 		int _numDistUlr, _numAnglUlr; ///< Number of cameras to select for each criterion.
 
@@ -20,34 +20,40 @@ sibr::ULRV3Renderer::ULRV3Renderer(const std::vector<InputCamera::Ptr> & cameras
 	fragString = fShader;
 	vertexString = vShader;
 	_maxNumCams = cameras.size();
-	_camsCount = int(_maxNumCams);
 
 	// Populate the cameraInfos array (will be uploaded to the GPU).
 	_cameraInfos.clear();
 	_cameraInfos.resize(_maxNumCams);
+	std::vector<int> selected(_maxNumCams, 0);
 	for (size_t i = 0; i < _maxNumCams; ++i) {
 		const auto & cam = *cameras[i];
 		_cameraInfos[i].vp = cam.viewproj();
 		_cameraInfos[i].pos = cam.position();
 		_cameraInfos[i].dir = cam.dir();
-		_cameraInfos[i].selected = cam.isActive();
+		selected[i] = cam.isActive() ? 1 : 0;
+		_cameraInfos[i].selected = selected[i];
 	}
 
-	// Compute the max number of cameras allowed.
-	GLint maxBlockSize = 0, maxSlicesSize = 0;
-	glGetIntegerv(GL_MAX_UNIFORM_BLOCK_SIZE, &maxBlockSize);
+	// The camera count is only limited by the number of layers in the input texture arrays.
+	GLint maxSlicesSize = 0;
 	glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxSlicesSize);
-	// For each camera we store a matrix, 2 vecs3, 2 floats (including padding).
-	const unsigned int bytesPerCamera = 4 * (16 + 2 * 3 + 2);
-	const unsigned int maxCamerasAllowed = std::min((unsigned int)maxSlicesSize, (unsigned int)(maxBlockSize / bytesPerCamera));
-	std::cout << "[ULRV3Renderer] " << "MAX_UNIFORM_BLOCK_SIZE: " << maxBlockSize << ", MAX_ARRAY_TEXTURE_LAYERS: " << maxSlicesSize << ", meaning at most " << maxCamerasAllowed << " cameras." << std::endl;
-
-	// Create UBO.
-	_uboIndex = 0;
-	glGenBuffers(1, &_uboIndex);
-	glBindBuffer(GL_UNIFORM_BUFFER, _uboIndex);
-	glBufferData(GL_UNIFORM_BUFFER, sizeof(CameraUBOInfos)*_maxNumCams, &_cameraInfos[0], GL_DYNAMIC_DRAW);
-	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	std::cout << "[ULRV3Renderer] " << "MAX_ARRAY_TEXTURE_LAYERS: " << maxSlicesSize << ", meaning at most " << maxSlicesSize << " cameras." << std::endl;
+	if (_maxNumCams > size_t(maxSlicesSize)) {
+		SIBR_WRG << "[ULRV3Renderer] " << _maxNumCams << " cameras will not fit in a texture array." << std::endl;
+	}
+
+	// Create the SSBOs, at least one element each as empty buffers can't be bound.
+	glGenBuffers(1, &_camerasBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, _camerasBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(CameraUBOInfos) * std::max(_maxNumCams, size_t(1)), nullptr, GL_DYNAMIC_DRAW);
+	if (_maxNumCams > 0) {
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(CameraUBOInfos) * _maxNumCams, &_cameraInfos[0]);
+	}
+	glGenBuffers(1, &_selectedBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, _selectedBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(int) * std::max(_maxNumCams, size_t(1)), nullptr, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	uploadSelection(selected);
 
 	// Setup shaders and uniforms.
 	setupShaders(fragString, vertexString);
@@ -61,11 +67,15 @@ sibr::ULRV3Renderer::ULRV3Renderer(const std::vector<InputCamera::Ptr> & cameras
 
 void sibr::ULRV3Renderer::setupShaders(const std::string & fShader, const std::string & vShader)
 {
+	fragString = fShader;
+	vertexString = vShader;
+
 	// Create shaders.
 	std::cout << "[ULRV3Renderer] Setting up shaders for " << _maxNumCams << " cameras." << std::endl;
 	GLShader::Define::List defines;
 	defines.emplace_back("NUM_CAMS", _maxNumCams);
 	defines.emplace_back("ULR_STREAMING", 0);
+	defines.emplace_back("ULR_RESIDENCY", _residency ? 1 : 0);
 
 	_ulrShader.init("ULRV3",
 		sibr::loadFile(sibr::getShadersDirectory("") + "/" + vShader + ".vert"),
@@ -135,19 +145,61 @@ void sibr::ULRV3Renderer::process(
 }
 
 void sibr::ULRV3Renderer::updateCameras(const std::vector<uint> & camIds) {
-	// Reset all cameras.
-	for(auto & caminfos : _cameraInfos) {
-		caminfos.selected = 0;
-	}
-	// Enabled the ones passed as indices.
+	// Enable the ones passed as indices, all others are disabled.
+	std::vector<int> selected(_maxNumCams, 0);
 	for (const auto & camId : camIds) {
-		_cameraInfos[camId].selected = 1;
+		if (camId < _maxNumCams) {
+			selected[camId] = 1;
+		}
+	}
+	uploadSelection(selected);
+}
+
+void sibr::ULRV3Renderer::setResidency(const InputTextureResidency::Ptr & residency) {
+	_residency = residency;
+	if (_residency && !_slotsBuffer) {
+		glGenBuffers(1, &_slotsBuffer);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, _slotsBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(int) * std::max(_maxNumCams, size_t(1)), nullptr, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	}
+	// The shaders read the images differently.
+	setupShaders(fragString, vertexString);
+}
+
+void sibr::ULRV3Renderer::uploadSelection(const std::vector<int> & selected) {
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, _camerasBuffer);
+	// Only upload the runs of cameras whose flag changed.
+	size_t cid = 0;
+	while (cid < _maxNumCams) {
+		if (_cameraInfos[cid].selected == selected[cid]) {
+			++cid;
+			continue;
+		}
+		const size_t begin = cid;
+		for (; cid < _maxNumCams && _cameraInfos[cid].selected != selected[cid]; ++cid) {
+			_cameraInfos[cid].selected = selected[cid];
+		}
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, sizeof(CameraUBOInfos) * begin, sizeof(CameraUBOInfos) * (cid - begin), &_cameraInfos[begin]);
 	}
 
-	// Update the content of the UBO.
-	glBindBuffer(GL_UNIFORM_BUFFER, _uboIndex);
-	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(CameraUBOInfos)*_maxNumCams, &_cameraInfos[0]);
-	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	// The shaders only loop over the selected cameras.
+	std::vector<int> selectedIds;
+	for (size_t i = 0; i < _maxNumCams; ++i) {
+		if (selected[i] != 0) {
+			selectedIds.push_back(int(i));
+		}
+	}
+	if (selectedIds != _selectedIds) {
+		_selectedIds = selectedIds;
+		_camsCount = int(_selectedIds.size());
+		if (!_selectedIds.empty()) {
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, _selectedBuffer);
+			glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(int) * _selectedIds.size(), &_selectedIds[0]);
+		}
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	CHECK_GL_ERROR;
 }
 
 void sibr::ULRV3Renderer::stopProfile()
@@ -244,16 +296,27 @@ void sibr::ULRV3Renderer::renderBlending(
 	glActiveTexture(GL_TEXTURE2);
 	glBindTexture(GL_TEXTURE_2D_ARRAY, inputDepths->handle());
 
+	// Cameras that are not resident are read from their low resolution tails.
+	if (_residency) {
+		const std::vector<int> & slots = _residency->cameraSlots();
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, _slotsBuffer);
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(int) * std::min(slots.size(), _maxNumCams), slots.data());
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, _slotsBuffer);
+
+		glActiveTexture(GL_TEXTURE6);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, _residency->tails()->handle());
+	}
+
 	// Pass the masks if enabled and available.
 	if (_useMasks && _masks.get()) {
 		glActiveTexture(GL_TEXTURE3);
 		glBindTexture(GL_TEXTURE_2D_ARRAY, _masks->handle());
 	}
 
-	// Bind UBO to shader, after all possible textures.
-	glBindBuffer(GL_UNIFORM_BUFFER, _uboIndex);
-	glBindBufferBase(GL_UNIFORM_BUFFER, 4, _uboIndex);
-	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	// Bind the camera infos and the selected indices.
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, _camerasBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, _selectedBuffer);
 
 	if (passthroughDepth) {
 		glEnable(GL_DEPTH_TEST);
@@ -19,6 +19,7 @@
 # include <core/graphics/Mesh.hpp>
 # include <core/renderer/RenderMaskHolder.hpp>
 # include <core/scene/BasicIBRScene.hpp>
+# include <core/scene/InputTextureResidency.hpp>
 # include <core/system/SimpleTimer.hpp>
 
 namespace sibr { 
@@ -26,7 +27,8 @@ namespace sibr {
 	/**
 	 * \class ULRV3Renderer
 	 * \brief Perform per-pixel Unstructured Lumigraph Rendering (Buehler et al., 2001). No selection is done on the CPU side.
-	 * Relies on texture arrays and uniform buffer objects to support a high number of cameras. 
+	 * Relies on texture arrays and shader storage buffers to support a high number of cameras. Only the cameras
+	 * selected with updateCameras are blended, using a compact list of indices.
 	 */
 	class SIBR_EXP_ULR_EXPORT ULRV3Renderer : public RenderMaskHolderArray
 	{
@@ -98,10 +100,19 @@ namespace sibr {
 
 		/** 
 		 *  Update which cameras should be used for rendering, based on the indices passed.
+		 *  Only the cameras whose state changed are uploaded to the GPU.
 		 *  \param camIds The indices to enable.
 		 **/
 		void updateCameras(const std::vector<uint> & camIds);
 
+		/**
+		 * Read the input images from a residency pool instead of a texture array holding all of them: resident cameras
+		 * are read from the pool slices, the others from their low resolution tails. The RGB texture array passed
+		 * to process must then be the residency slices.
+		 * \param residency the input images residency, or nullptr to read all images from the texture array
+		 */
+		void setResidency(const InputTextureResidency::Ptr & residency);
+
 		/// Set the epsilon occlusion threshold.
 		float & epsilonOcclusion() { return _epsilonOcclusion.get(); }
 
@@ -193,14 +204,14 @@ namespace sibr {
 			_gammaCorrection = false;
 
 		size_t _maxNumCams = 0;
-		GLuniform<int> _camsCount = 0;
+		GLuniform<int> _camsCount = 0; ///< Number of selected cameras.
 
 		GLuniform<float>					_epsilonOcclusion = 0.01f;
 		bool								_backFaceCulling = true;
 		bool								_clearDst = true;
 
 		/** Camera infos data structure shared between the CPU and GPU.
-			We have to be careful about alignment if we want to send those struct directly into the UBO. */
+			We have to be careful about alignment if we want to send those struct directly into the SSBO (std430 layout). */
 		struct CameraUBOInfos {	 
 			Matrix4f vp; ///< Matrix viewproj.
 			Vector3f pos; ///< Camera position.
@@ -209,8 +220,17 @@ namespace sibr {
 			float dummy = 0.0f; ///< Padding to a multiple of 16 bytes for alignment on the GPU.
 		};
 
+		/** Upload the list of selected cameras and the selection flags that changed.
+		 * \param selected the new per-camera selection flags
+		 */
+		void uploadSelection(const std::vector<int> & selected);
+
 		std::vector<CameraUBOInfos> _cameraInfos;
-		GLuint _uboIndex;
+		std::vector<int> _selectedIds; ///< Indices of the selected cameras, in increasing order.
+		GLuint _camerasBuffer = 0; ///< SSBO containing the camera infos.
+		GLuint _selectedBuffer = 0; ///< SSBO containing the selected indices.
+		InputTextureResidency::Ptr _residency; ///< Input images residency, if used.
+		GLuint _slotsBuffer = 0; ///< SSBO containing the resident slice of each camera.
 
 		bool		_profiling = false;
 		sibr::Timer	_depthPassTimer;
@@ -22,6 +22,7 @@ sibr::ULRV3View::ULRV3View(const sibr::BasicIBRScene::Ptr & ibrScene, uint rende
 
 	//  Renderers.
 	_ulrRenderer.reset(new ULRV3Renderer(ibrScene->cameras()->inputCameras(), w, h));
+	setupResidency();
 	_poissonRenderer.reset(new PoissonRenderer(w, h));
 	_poissonRenderer->enableFix() = true;
 
@@ -54,6 +55,7 @@ void sibr::ULRV3View::setScene(const sibr::BasicIBRScene::Ptr & newScene) {
 	}
 
 	_ulrRenderer.reset(new ULRV3Renderer(newScene->cameras()->inputCameras(), w, h, shaderName));
+	setupResidency();
 
 	// Tell the scene we are a priori using all active cameras.
 	std::vector<uint> imgs_ulr;
@@ -79,14 +81,33 @@ void sibr::ULRV3View::setMode(const WeightsMode mode) {
 	}
 }
 
+void sibr::ULRV3View::setupResidency() {
+	const InputTextureResidency::Ptr & residency = _scene->renderTargets()->getInputRGBResidencyPtr();
+	_ulrRenderer->setResidency(residency);
+	_cameraIndex.reset(residency ? new InputCameraIndex(_scene->cameras()->inputCameras()) : nullptr);
+}
+
 void sibr::ULRV3View::onRenderIBR(sibr::IRenderTarget & dst, const sibr::Camera & eye)
 {
+	// With the input images residency, page in as many cameras as there are slices, selected as in ULR.
+	// In the standard mode only those are blended, the other modes read the cameras that are not resident from the tails.
+	const InputTextureResidency::Ptr & residency = _scene->renderTargets()->getInputRGBResidencyPtr();
+	if (residency) {
+		const size_t numSlots = residency->policy().numSlots();
+		std::vector<uint> selected;
+		_cameraIndex->selectULR(eye.position(), eye.dir(), numSlots / 2, numSlots - numSlots / 2, selected);
+		residency->update(selected, eye);
+		if (_renderMode == ALL_CAMS && !selected.empty()) {
+			_ulrRenderer->updateCameras(selected);
+		}
+	}
+
 	// Perform ULR rendering, either directly to the destination RT, or to the intermediate RT when poisson blending is enabled.
 	_ulrRenderer->process(
-			_scene->proxies()->proxy(),
+			_scene->proxies()->proxyLOD(eye, float(dst.h()), _lodPixelError),
 			eye, 
 			_poissonBlend ? *_blendRT : dst,
-			_scene->renderTargets()->getInputRGBTextureArrayPtr(),
+			residency ? residency->slices() : _scene->renderTargets()->getInputRGBTextureArrayPtr(),
 		_scene->renderTargets()->getInputDepthMapArrayPtr()
 		);
 
@@ -147,6 +168,9 @@ void sibr::ULRV3View::onGUI()
 		ImGui::Checkbox("Occlusion Testing", &_ulrRenderer->occTest());
 		ImGui::Checkbox("Debug weights", &_ulrRenderer->showWeights());
 		ImGui::Checkbox("Gamma correction", &_ulrRenderer->gammaCorrection());
+		if (_scene->proxies()->lodCount() > 0) {
+			ImGui::SliderFloat("Proxy LOD error (px)", &_lodPixelError, 0.0f, 10.0f);
+		}
 		ImGui::PopItemWidth();
 	}
 	ImGui::End();
@@ -19,6 +19,7 @@
 # include <core/renderer/CopyRenderer.hpp>
 # include <projects/ulr/renderer/ULRV3Renderer.hpp>
 # include <core/renderer/PoissonRenderer.hpp>
+# include <core/scene/InputCameraIndex.hpp>
 
 namespace sibr { 
 
@@ -88,6 +89,9 @@ namespace sibr {
 		 */
 		void updateCameras(bool allowResetToDefault);
 
+		/** Make the renderer use the input images residency of the scene, if it has one. */
+		void setupResidency();
+
 		std::shared_ptr<sibr::BasicIBRScene> _scene; ///< The current scene.
 		ULRV3Renderer::Ptr		_ulrRenderer; ///< The ULR renderer.
 		PoissonRenderer::Ptr	_poissonRenderer; ///< The poisson filling renderer.
@@ -101,6 +105,8 @@ namespace sibr {
 		WeightsMode				_weightsMode = ULR_W; ///< Current blend weights mode.
 		int						_singleCamId = 0; ///< Selected camera for the single view mode.
 		int						_everyNCamStep = 1; ///< Camera step size for the every other N mode.
+		float					_lodPixelError = 0.0f; ///< Maximum proxy error in pixels when using levels of detail, 0 for the full proxy.
+		InputCameraIndex::Ptr	_cameraIndex; ///< Selects the cameras paged in each frame when using the input images residency.
 	};
 
 } /*namespace sibr*/ 
@@ -16,6 +16,7 @@
 # include <core/system/Config.hpp>
 # include <core/graphics/Mesh.hpp>
 # include <core/scene/BasicIBRScene.hpp>
+# include <core/scene/InputCameraIndex.hpp>
 # include <core/renderer/CopyRenderer.hpp>
 # include <projects/ulr/renderer/ULRRenderer.hpp>
 # include <core/view/ViewBase.hpp>
@@ -84,6 +85,7 @@ namespace sibr {
 
 		ULRRenderer::Ptr		_ulr; ///< Renderer.
 		std::shared_ptr<sibr::BasicIBRScene> _scene; ///< Scene.
+		InputCameraIndex::Ptr _cameraIndex; ///< Spatial index over the input cameras, for selection.
 		std::shared_ptr<sibr::Mesh>	_altMesh; ///< For the cases when using a different mesh than the scene
 		short int _numDistUlr, _numAnglUlr; ///< max number of selected cameras for each criterion.
 		std::vector<std::shared_ptr<RenderTargetRGBA32F> > _inputRTs; ///< input RTs -- usually RGB but can be alpha or other
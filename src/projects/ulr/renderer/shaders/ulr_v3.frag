@@ -10,10 +10,11 @@
  */
 
 
-#version 420
+#version 430
 
 #define NUM_CAMS (12)
 #define ULR_STREAMING (0)
+#define ULR_RESIDENCY (0)
 
 in vec2 vertex_coord;
 layout(location = 0) out vec4 out_color;
@@ -29,13 +30,19 @@ struct CameraInfos
   int selected;
   vec3 dir;
 };
-// They are stored in a contiguous buffer (UBO), lifting most limitations on the number of uniforms.
-layout(std140, binding=4) uniform InputCameras
+// They are stored in a shader storage buffer, there is no limit on the number of cameras.
+layout(std430, binding=4) readonly buffer InputCameras
 {
-  CameraInfos cameras[NUM_CAMS];
+  CameraInfos cameras[];
+};
+// Indices of the cameras selected for the current frame, only those are blended.
+layout(std430, binding=5) readonly buffer SelectedCameras
+{
+  int selectedCameras[];
 };
 
 // Uniforms.
+// Number of selected cameras.
 uniform int camsCount;
 uniform vec3 ncam_pos;
 uniform bool occ_test = true;
@@ -87,11 +94,33 @@ layout(binding=1) uniform sampler2DArray input_rgbs;
 layout(binding=2) uniform sampler2DArray input_depths;
 layout(binding=3) uniform sampler2DArray input_masks;
 
+#if ULR_RESIDENCY
+// Only some input images are resident at full resolution in input_rgbs, the others are read from their low resolution version.
+layout(binding=6) uniform sampler2DArray input_tails;
+// Slice of each camera in input_rgbs, -1 if it is not resident.
+layout(std430, binding=6) readonly buffer ResidentSlots
+{
+  int residentSlots[];
+};
+
+vec3 getRGB(vec3 xy_camid){
+	int slot = residentSlots[int(xy_camid.z)];
+	if(slot < 0){
+		return texture(input_tails, xy_camid).rgb;
+	}
+	return texture(input_rgbs, vec3(xy_camid.xy, slot)).rgb;
+}
+#else
+vec3 getRGB(vec3 xy_camid){
+	return texture(input_rgbs, xy_camid).rgb;
+}
+#endif
+
 vec4 getRGBD(vec3 xy_camid){
 	if(flipRGBs){
 		xy_camid.y = 1.0 - xy_camid.y;
 	}
-	vec3 rgb = texture(input_rgbs, xy_camid).rgb;
+	vec3 rgb = getRGB(xy_camid);
 	if(flipRGBs){
 		xy_camid.y = 1.0 - xy_camid.y;
 	}
@@ -136,13 +165,8 @@ void main(void){
 
   bool atLeastOneValid = false;
   
-  for(int i = 0; i < NUM_CAMS; i++){
-	if(i>=camsCount){
-		continue;
-	}
-	if(cameras[i].selected == 0){
-		continue;
-	}
+  for(int s = 0; s < camsCount; s++){
+	int i = selectedCameras[s];
 
 	vec3 uvd = project(point.xyz, cameras[i].vp);
 	vec2 ndc = abs(2.0*uvd.xy-1.0);
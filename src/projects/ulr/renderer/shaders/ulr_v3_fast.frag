@@ -10,10 +10,11 @@
  */
 
 
-#version 420
+#version 430
 
 #define NUM_CAMS (12)
 #define ULR_STREAMING (0)
+#define ULR_RESIDENCY (0)
 
 in vec2 vertex_coord;
 layout(location = 0) out vec4 out_color;
@@ -29,13 +30,19 @@ struct CameraInfos
   int selected;
   vec3 dir;
 };
-// They are stored in a contiguous buffer (UBO), lifting most limitations on the number of uniforms.
-layout(std140, binding=4) uniform InputCameras
+// They are stored in a shader storage buffer, there is no limit on the number of cameras.
+layout(std430, binding=4) readonly buffer InputCameras
 {
-  CameraInfos cameras[NUM_CAMS];
+  CameraInfos cameras[];
+};
+// Indices of the cameras selected for the current frame, only those are blended.
+layout(std430, binding=5) readonly buffer SelectedCameras
+{
+  int selectedCameras[];
 };
 
 // Uniforms.
+// Number of selected cameras.
 uniform int camsCount;
 uniform vec3 ncam_pos;
 uniform bool occ_test = true;
@@ -63,6 +70,28 @@ layout(binding=1) uniform sampler2DArray input_rgbs;
 layout(binding=2) uniform sampler2DArray input_depths;
 layout(binding=3) uniform sampler2DArray input_masks;
 
+#if ULR_RESIDENCY
+// Only some input images are resident at full resolution in input_rgbs, the others are read from their low resolution version.
+layout(binding=6) uniform sampler2DArray input_tails;
+// Slice of each camera in input_rgbs, -1 if it is not resident.
+layout(std430, binding=6) readonly buffer ResidentSlots
+{
+  int residentSlots[];
+};
+
+vec3 getRGB(vec3 xy_camid){
+	int slot = residentSlots[int(xy_camid.z)];
+	if(slot < 0){
+		return texture(input_tails, xy_camid).rgb;
+	}
+	return texture(input_rgbs, vec3(xy_camid.xy, slot)).rgb;
+}
+#else
+vec3 getRGB(vec3 xy_camid){
+	return texture(input_rgbs, xy_camid).rgb;
+}
+#endif
+
 
 float getMask(vec3 xy_camid){
 	return texture(input_masks, xy_camid).r;
@@ -98,13 +127,8 @@ void main(void){
   vec4  color2 = vec4(0.0,0.0,0.0,INFTY_W);
   vec4  color3 = vec4(0.0,0.0,0.0,INFTY_W);
   vec4 masks = vec4(1.0);
-  for(int i = 0; i < NUM_CAMS; i++){
-	if(i>=camsCount){
-		continue;
-	}
-	if(cameras[i].selected == 0){
-		continue;
-	}
+  for(int s = 0; s < camsCount; s++){
+	int i = selectedCameras[s];
 
 	vec3 uvd = project(point.xyz, cameras[i].vp);
 	vec2 ndc = abs(2.0*uvd.xy-1.0);
@@ -215,10 +239,10 @@ void main(void){
 		color3.rgb = getRandomColor(int(color3.z));
 	} else {
 		// Read from textures and apply masking.
-		color0.rgb = masks.x*texture(input_rgbs, color0.rgb).rgb;
-		color1.rgb = masks.y*texture(input_rgbs, color1.rgb).rgb;
-		color2.rgb = masks.z*texture(input_rgbs, color2.rgb).rgb;
-		color3.rgb = masks.w*texture(input_rgbs, color3.rgb).rgb;
+		color0.rgb = masks.x*getRGB(color0.rgb);
+		color1.rgb = masks.y*getRGB(color1.rgb);
+		color2.rgb = masks.z*getRGB(color2.rgb);
+		color3.rgb = masks.w*getRGB(color3.rgb);
 	}
 
     // blending